@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Decoder for the binary adapter trace written by the OpenOCD command
+ * "adapter trace start". The trace can be rendered as text, one line per
+ * record, or as JSON in the Chrome trace event format, which can be loaded
+ * in chrome://tracing or https://ui.perfetto.dev to visualise the queue
+ * flushes and the USB latency.
+ *
+ * The file format is described in src/jtag/adapter_trace.h.
+ *
+ * Build with: cc -o adapter_trace_decode adapter_trace_decode.c
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TRACE_MAGIC			"OCDTRACE"
+#define TRACE_VERSION		1
+#define TRACE_HEADER_SIZE	32
+#define TRACE_RECORD_SIZE	24
+
+struct record {
+	uint64_t timestamp;
+	uint32_t duration;
+	uint32_t value;
+	uint32_t bytes;
+	uint8_t kind;
+	uint8_t reg;
+	uint8_t ack;
+};
+
+/* Chrome trace thread ids, one lane per layer */
+enum lane {
+	LANE_QUEUE = 1,
+	LANE_USB = 2,
+	LANE_SWD = 3,
+};
+
+static const struct {
+	const char *name;
+	enum lane lane;
+} kinds[] = {
+	[1] = { "queue flush", LANE_QUEUE },
+	[2] = { "swd run", LANE_QUEUE },
+	[3] = { "usb write", LANE_USB },
+	[4] = { "usb read", LANE_USB },
+	[5] = { "usb xfer", LANE_USB },
+	[6] = { "DP read", LANE_SWD },
+	[7] = { "DP write", LANE_SWD },
+	[8] = { "AP read", LANE_SWD },
+	[9] = { "AP write", LANE_SWD },
+};
+
+static const char *ack_name(uint8_t ack)
+{
+	switch (ack) {
+	case 1:
+		return "OK";
+	case 2:
+		return "WAIT";
+	case 4:
+		return "FAULT";
+	default:
+		return "JUNK";
+	}
+}
+
+static uint32_t le_u32(const uint8_t *buf)
+{
+	return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+static uint64_t le_u64(const uint8_t *buf)
+{
+	return le_u32(buf) | (uint64_t)le_u32(buf + 4) << 32;
+}
+
+static const char *kind_name(uint8_t kind)
+{
+	if (kind < sizeof(kinds) / sizeof(kinds[0]) && kinds[kind].name)
+		return kinds[kind].name;
+	return "unknown";
+}
+
+static bool is_swd_transfer(uint8_t kind)
+{
+	return kind < sizeof(kinds) / sizeof(kinds[0]) && kinds[kind].lane == LANE_SWD;
+}
+
+static void print_text(const struct record *r)
+{
+	printf("%12.6f %8" PRIu32 "us  %-11s", r->timestamp / 1e6, r->duration, kind_name(r->kind));
+
+	if (is_swd_transfer(r->kind))
+		printf("  reg 0x%02x  0x%08" PRIx32 "  %s\n", r->reg, r->value, ack_name(r->ack));
+	else if (r->kind == 1 || r->kind == 2)
+		printf("  result %" PRId32 "\n", (int32_t)r->value);
+	else
+		printf("  cmd 0x%02x  out %" PRIu32 "  in/count %" PRIu32 "\n", r->reg, r->bytes, r->value);
+}
+
+static void print_json(const struct record *r, bool first)
+{
+	printf("%s\n{\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%" PRIu64,
+		first ? "" : ",", kind_name(r->kind),
+		r->kind < sizeof(kinds) / sizeof(kinds[0]) ? kinds[r->kind].lane : 0,
+		r->timestamp);
+
+	if (r->duration)
+		printf(",\"ph\":\"X\",\"dur\":%" PRIu32, r->duration);
+	else
+		printf(",\"ph\":\"i\",\"s\":\"t\"");
+
+	if (is_swd_transfer(r->kind))
+		printf(",\"args\":{\"reg\":\"0x%02x\",\"value\":\"0x%08" PRIx32 "\",\"ack\":\"%s\"}}",
+			r->reg, r->value, ack_name(r->ack));
+	else
+		printf(",\"args\":{\"cmd\":\"0x%02x\",\"bytes\":%" PRIu32 ",\"value\":%" PRIu32 "}}",
+			r->reg, r->bytes, r->value);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-j] tracefile\n"
+		"  -j  output Chrome/Perfetto trace event JSON instead of text\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	bool json = false;
+	int c;
+
+	while ((c = getopt(argc, argv, "jh")) != -1) {
+		switch (c) {
+		case 'j':
+			json = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	FILE *f = fopen(argv[optind], "rb");
+	if (!f) {
+		perror(argv[optind]);
+		return 1;
+	}
+
+	uint8_t buf[TRACE_HEADER_SIZE];
+	if (fread(buf, TRACE_HEADER_SIZE, 1, f) != 1 || memcmp(buf, TRACE_MAGIC, 8)) {
+		fprintf(stderr, "%s: not an adapter trace file\n", argv[optind]);
+		fclose(f);
+		return 1;
+	}
+
+	uint32_t version = le_u32(buf + 8);
+	uint32_t record_size = le_u32(buf + 12);
+	if (version != TRACE_VERSION || record_size < TRACE_RECORD_SIZE) {
+		fprintf(stderr, "%s: unsupported version %" PRIu32 ", record size %" PRIu32 "\n",
+			argv[optind], version, record_size);
+		fclose(f);
+		return 1;
+	}
+
+	uint64_t start_time = le_u64(buf + 16);
+	uint32_t record_count = le_u32(buf + 24);
+	uint32_t lost_count = le_u32(buf + 28);
+
+	if (json)
+		printf("{\"otherData\":{\"start_time_us\":%" PRIu64 ",\"lost\":%" PRIu32 "},"
+			"\"traceEvents\":[", start_time, lost_count);
+	else
+		printf("# %" PRIu32 " records, %" PRIu32 " lost\n"
+			"#    time [s] duration  kind\n", record_count, lost_count);
+
+	uint8_t *rec = malloc(record_size);
+	if (!rec) {
+		fclose(f);
+		return 1;
+	}
+
+	uint32_t i;
+	for (i = 0; i < record_count; i++) {
+		if (fread(rec, record_size, 1, f) != 1)
+			break;
+
+		struct record r = {
+			.timestamp = le_u64(rec),
+			.duration = le_u32(rec + 8),
+			.value = le_u32(rec + 12),
+			.bytes = le_u32(rec + 16),
+			.kind = rec[20],
+			.reg = rec[21],
+			.ack = rec[22],
+		};
+
+		if (json)
+			print_json(&r, i == 0);
+		else
+			print_text(&r);
+	}
+
+	if (json)
+		printf("\n]}\n");
+
+	free(rec);
+	fclose(f);
+
+	if (i != record_count) {
+		fprintf(stderr, "%s: truncated after %" PRIu32 " records\n", argv[optind], i);
+		return 1;
+	}
+
+	return 0;
+}
@@ -16,6 +16,7 @@
 #endif
 
 #include "log.h"
+#include "align.h"
 #include "command.h"
 #include "replacements.h"
 #include "time_support.h"
@@ -64,6 +65,43 @@ static const char * const log_strings[6] = {
 
 static int count;
 
+/*
+ * Deferred logging: when enabled, debug messages are formatted straight
+ * into a ring buffer and written out later from the server loop, so the
+ * code emitting them does not pay for the file I/O, the flush and the
+ * header formatting. Messages with level info and above are still written
+ * synchronously, after the pending debug messages, to preserve ordering.
+ */
+struct log_record {
+	const char *file;
+	const char *function;
+	int64_t time;
+	unsigned int line;
+	int count;
+	enum log_levels level;
+	/* length of the message following the record, without terminator */
+	unsigned int len;
+};
+
+#define LOG_RECORD_ALIGN		sizeof(int64_t)
+#define LOG_BUFFER_MIN_SIZE		1024
+
+static struct {
+	char *data;
+	size_t size;
+	/* next record is written at head, oldest record is read at tail */
+	size_t head;
+	size_t tail;
+	/* end of valid data before head wrapped around, only used if head < tail */
+	size_t wrap;
+	uint64_t records;
+	uint64_t dropped;
+	uint64_t dropped_reported;
+	size_t high_water;
+} log_buffer;
+
+static void log_buffer_drain(void);
+
 /* forward the log to the listeners */
 static void log_forward(const char *file, unsigned int line, const char *function, const char *string)
 {
@@ -77,6 +115,29 @@ static void log_forward(const char *file, unsigned int line, const char *functio
 	}
 }
 
+static const char *log_basename(const char *file)
+{
+	const char *f = strrchr(file, '/');
+	return f ? f + 1 : file;
+}
+
+static void log_write_debug_entry(enum log_levels level, int entry_count, int64_t t,
+		const char *file, int line, const char *function, const char *string)
+{
+#ifdef _DEBUG_FREE_SPACE_
+	struct mallinfo2 info = mallinfo2();
+#endif
+	fprintf(log_output, "%s%d %" PRId64 " %s:%d %s()"
+#ifdef _DEBUG_FREE_SPACE_
+		FORDBLKS_FORMAT
+#endif
+		": %s", log_strings[level + 1], entry_count, t, file, line, function,
+#ifdef _DEBUG_FREE_SPACE_
+		info.fordblks,
+#endif
+		string);
+}
+
 /* The log_puts() serves two somewhat different goals:
  *
  * - logging
@@ -93,8 +154,6 @@ static void log_puts(enum log_levels level,
 	const char *function,
 	const char *string)
 {
-	char *f;
-
 	if (!log_output) {
 		/* log_init() not called yet; print on stderr */
 		fputs(string, stderr);
@@ -102,6 +161,9 @@ static void log_puts(enum log_levels level,
 		return;
 	}
 
+	/* keep the order with respect to the deferred messages */
+	log_buffer_drain();
+
 	if (level == LOG_LVL_OUTPUT) {
 		/* do not prepend any headers, just print out what we were given and return */
 		fputs(string, log_output);
@@ -109,25 +171,11 @@ static void log_puts(enum log_levels level,
 		return;
 	}
 
-	f = strrchr(file, '/');
-	if (f)
-		file = f + 1;
+	file = log_basename(file);
 
 	if (debug_level >= LOG_LVL_DEBUG) {
 		/* print with count and time information */
-		int64_t t = timeval_ms() - start;
-#ifdef _DEBUG_FREE_SPACE_
-		struct mallinfo2 info = mallinfo2();
-#endif
-		fprintf(log_output, "%s%d %" PRId64 " %s:%d %s()"
-#ifdef _DEBUG_FREE_SPACE_
-			FORDBLKS_FORMAT
-#endif
-			": %s", log_strings[level + 1], count, t, file, line, function,
-#ifdef _DEBUG_FREE_SPACE_
-			info.fordblks,
-#endif
-			string);
+		log_write_debug_entry(level, count, timeval_ms() - start, file, line, function, string);
 	} else {
 		/* if we are using gdb through pipes then we do not want any output
 		 * to the pipe otherwise we get repeated strings */
@@ -142,6 +190,138 @@ static void log_puts(enum log_levels level,
 		log_forward(file, line, function, string);
 }
 
+static size_t log_buffer_used(void)
+{
+	if (log_buffer.head >= log_buffer.tail)
+		return log_buffer.head - log_buffer.tail;
+	return log_buffer.wrap - log_buffer.tail + log_buffer.head;
+}
+
+/* format a message into the ring buffer, or count it as dropped if it does not fit */
+static void log_buffer_vprintf(enum log_levels level, const char *file, unsigned int line,
+		const char *function, bool newline, const char *format, va_list args)
+{
+	const size_t hdr_size = ALIGN_UP(sizeof(struct log_record), LOG_RECORD_ALIGN);
+
+	/* try the contiguous space at head first, then after wrapping around */
+	for (unsigned int attempt = 0; attempt < 2; attempt++) {
+		/* head must not catch up with tail, that would look like an empty buffer */
+		size_t avail;
+		if (log_buffer.head >= log_buffer.tail)
+			avail = log_buffer.size - log_buffer.head;
+		else
+			avail = log_buffer.tail - log_buffer.head - LOG_RECORD_ALIGN;
+
+		if (avail > hdr_size + 2) {
+			struct log_record *rec = (struct log_record *)(log_buffer.data + log_buffer.head);
+			char *msg = (char *)rec + hdr_size;
+			/* leave room for the newline */
+			size_t msg_room = avail - hdr_size - 1;
+
+			va_list ap;
+			va_copy(ap, args);
+			int len = vsnprintf(msg, msg_room, format, ap);
+			va_end(ap);
+			if (len < 0)
+				return;
+
+			if ((size_t)len < msg_room) {
+				if (newline)
+					msg[len++] = '\n';
+				msg[len] = '\0';
+
+				rec->file = file;
+				rec->function = function;
+				rec->time = timeval_ms() - start;
+				rec->line = line;
+				rec->count = count;
+				rec->level = level;
+				rec->len = len;
+
+				log_buffer.head += ALIGN_UP(hdr_size + len + 1, LOG_RECORD_ALIGN);
+				log_buffer.records++;
+
+				size_t used = log_buffer_used();
+				if (used > log_buffer.high_water)
+					log_buffer.high_water = used;
+				return;
+			}
+		}
+
+		/* not enough space at the end of the buffer, wrap around */
+		if (log_buffer.head < log_buffer.tail || log_buffer.tail == 0)
+			break;
+		log_buffer.wrap = log_buffer.head;
+		log_buffer.head = 0;
+	}
+
+	log_buffer.dropped++;
+}
+
+static void log_buffer_drain(void)
+{
+	if (!log_buffer.data || !log_output)
+		return;
+
+	if (log_buffer.head == log_buffer.tail && log_buffer.dropped == log_buffer.dropped_reported)
+		return;
+
+	const size_t hdr_size = ALIGN_UP(sizeof(struct log_record), LOG_RECORD_ALIGN);
+
+	while (log_buffer.head != log_buffer.tail) {
+		if (log_buffer.head < log_buffer.tail && log_buffer.tail == log_buffer.wrap) {
+			log_buffer.tail = 0;
+			continue;
+		}
+
+		const struct log_record *rec = (const struct log_record *)(log_buffer.data + log_buffer.tail);
+		const char *msg = (const char *)rec + hdr_size;
+
+		log_write_debug_entry(rec->level, rec->count, rec->time,
+			log_basename(rec->file), rec->line, rec->function, msg);
+
+		log_buffer.tail += ALIGN_UP(hdr_size + rec->len + 1, LOG_RECORD_ALIGN);
+	}
+
+	/* empty, restart from the beginning to maximize contiguous space */
+	log_buffer.head = 0;
+	log_buffer.tail = 0;
+
+	if (log_buffer.dropped != log_buffer.dropped_reported) {
+		fprintf(log_output, "%s%" PRIu64 " debug messages dropped, log buffer full\n",
+			log_strings[LOG_LVL_WARNING + 1], log_buffer.dropped - log_buffer.dropped_reported);
+		log_buffer.dropped_reported = log_buffer.dropped;
+	}
+
+	fflush(log_output);
+}
+
+void log_flush(void)
+{
+	log_buffer_drain();
+}
+
+static int log_buffer_resize(size_t size)
+{
+	log_buffer_drain();
+
+	char *data = NULL;
+	if (size) {
+		data = malloc(size);
+		if (!data)
+			return ERROR_FAIL;
+	}
+
+	free(log_buffer.data);
+	log_buffer.data = data;
+	log_buffer.size = size;
+	log_buffer.head = 0;
+	log_buffer.tail = 0;
+	log_buffer.wrap = 0;
+	log_buffer.high_water = 0;
+	return ERROR_OK;
+}
+
 void log_printf(enum log_levels level,
 	const char *file,
 	unsigned int line,
@@ -158,6 +338,12 @@ void log_printf(enum log_levels level,
 
 	va_start(ap, format);
 
+	if (log_buffer.data && log_output && level >= LOG_LVL_DEBUG) {
+		log_buffer_vprintf(level, file, line, function, false, format, ap);
+		va_end(ap);
+		return;
+	}
+
 	string = alloc_vprintf(format, ap);
 	if (string) {
 		log_puts(level, file, line, function, string);
@@ -177,6 +363,11 @@ void log_vprintf_lf(enum log_levels level, const char *file, unsigned int line,
 	if (level > debug_level)
 		return;
 
+	if (log_buffer.data && log_output && level >= LOG_LVL_DEBUG) {
+		log_buffer_vprintf(level, file, line, function, true, format, args);
+		return;
+	}
+
 	tmp = alloc_vprintf(format, args);
 
 	if (!tmp)
@@ -242,6 +433,9 @@ COMMAND_HANDLER(handle_log_output_command)
 		command_print(CMD, "set log_output to default");
 	}
 
+	/* pending messages belong to the previous output */
+	log_buffer_drain();
+
 	if (log_output != stderr && log_output) {
 		/* Close previous log file, if it was open and wasn't stderr. */
 		fclose(log_output);
@@ -250,6 +444,43 @@ COMMAND_HANDLER(handle_log_output_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_log_buffer_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int size;
+		if (strcmp(CMD_ARGV[0], "off") == 0) {
+			size = 0;
+		} else {
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], size);
+			if (size < LOG_BUFFER_MIN_SIZE) {
+				command_print(CMD, "log buffer size must be at least %u bytes", LOG_BUFFER_MIN_SIZE);
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+		}
+
+		if (log_buffer_resize(ALIGN_DOWN(size, LOG_RECORD_ALIGN)) != ERROR_OK) {
+			command_print(CMD, "failed to allocate log buffer");
+			return ERROR_FAIL;
+		}
+		return ERROR_OK;
+	}
+
+	if (!log_buffer.data) {
+		command_print(CMD, "log buffer disabled");
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "log buffer size %zu bytes, %zu used, %zu peak",
+		log_buffer.size, log_buffer_used(), log_buffer.high_water);
+	command_print(CMD, "%" PRIu64 " messages buffered, %" PRIu64 " dropped",
+		log_buffer.records, log_buffer.dropped);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration log_command_handlers[] = {
 	{
 		.name = "log_output",
@@ -258,6 +489,14 @@ static const struct command_registration log_command_handlers[] = {
 		.help = "redirect logging to a file (default: stderr)",
 		.usage = "[file_name | 'default']",
 	},
+	{
+		.name = "log_buffer",
+		.handler = handle_log_buffer_command,
+		.mode = COMMAND_ANY,
+		.help = "Defer writing of debug messages through a ring buffer "
+			"of the given size, or display its statistics.",
+		.usage = "[size_in_bytes | 'off']",
+	},
 	{
 		.name = "debug_level",
 		.handler = handle_debug_level_command,
@@ -298,6 +537,8 @@ void log_init(void)
 
 void log_exit(void)
 {
+	log_buffer_resize(0);
+
 	if (log_output && log_output != stderr) {
 		/* Close log file, if it was open and wasn't stderr. */
 		fclose(log_output);
@@ -438,6 +679,9 @@ void keep_alive(void)
 	if (delta_time > KEEP_ALIVE_KICK_TIME_MS) {
 		last_time = current_time;
 
+		/* bound the latency of deferred messages during long operations */
+		log_buffer_drain();
+
 		/* this will keep the GDB connection alive */
 		server_keep_clients_alive();
 
@@ -63,6 +63,12 @@ __attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 5, 6)));
 void log_init(void);
 void log_exit(void);
 
+/**
+ * Write out the messages pending in the log buffer, if enabled.
+ * Invoked from the server loop when idle.
+ */
+void log_flush(void);
+
 int log_register_commands(struct command_context *cmd_ctx);
 
 void keep_alive(void);
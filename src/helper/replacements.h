@@ -276,6 +276,30 @@ typedef struct {
 
 #define PT_LOAD			1		/* Loadable program segment */
 
+typedef struct {
+	Elf32_Word sh_name;		/* Section name (string tbl index) */
+	Elf32_Word sh_type;		/* Section type */
+	Elf32_Word sh_flags;	/* Section flags */
+	Elf32_Addr sh_addr;		/* Section virtual addr at execution */
+	Elf32_Off sh_offset;	/* Section file offset */
+	Elf32_Word sh_size;		/* Section size in bytes */
+	Elf32_Word sh_link;		/* Link to another section */
+	Elf32_Word sh_info;		/* Additional section information */
+	Elf32_Word sh_addralign;	/* Section alignment */
+	Elf32_Word sh_entsize;	/* Entry size if section holds table */
+} Elf32_Shdr;
+
+#define SHT_SYMTAB		2		/* Symbol table */
+
+typedef struct {
+	Elf32_Word st_name;		/* Symbol name (string tbl index) */
+	Elf32_Addr st_value;	/* Symbol value */
+	Elf32_Word st_size;		/* Symbol size */
+	unsigned char st_info;	/* Symbol type and binding */
+	unsigned char st_other;	/* Symbol visibility */
+	Elf32_Half st_shndx;	/* Section index */
+} Elf32_Sym;
+
 #endif	/* HAVE_ELF_H */
 
 #ifndef HAVE_ELF64
@@ -314,6 +338,28 @@ typedef struct {
 	Elf64_Xword p_align;	/* Segment alignment */
 } Elf64_Phdr;
 
+typedef struct {
+	Elf64_Word sh_name;		/* Section name (string tbl index) */
+	Elf64_Word sh_type;		/* Section type */
+	Elf64_Xword sh_flags;	/* Section flags */
+	Elf64_Addr sh_addr;		/* Section virtual addr at execution */
+	Elf64_Off sh_offset;	/* Section file offset */
+	Elf64_Xword sh_size;	/* Section size in bytes */
+	Elf64_Word sh_link;		/* Link to another section */
+	Elf64_Word sh_info;		/* Additional section information */
+	Elf64_Xword sh_addralign;	/* Section alignment */
+	Elf64_Xword sh_entsize;	/* Entry size if section holds table */
+} Elf64_Shdr;
+
+typedef struct {
+	Elf64_Word st_name;		/* Symbol name (string tbl index) */
+	unsigned char st_info;	/* Symbol type and binding */
+	unsigned char st_other;	/* Symbol visibility */
+	Elf64_Half st_shndx;	/* Section index */
+	Elf64_Addr st_value;	/* Symbol value */
+	Elf64_Xword st_size;	/* Symbol size */
+} Elf64_Sym;
+
 #endif /* HAVE_ELF64 */
 
 #endif /* OPENOCD_HELPER_REPLACEMENTS_H */
@@ -28,3 +28,22 @@ int64_t timeval_ms(void)
 		return retval;
 	return (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
 }
+
+int64_t timeval_us(void)
+{
+	struct timeval now;
+	int retval = gettimeofday(&now, NULL);
+	if (retval < 0)
+		return retval;
+	return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+int64_t monotonic_us(void)
+{
+#if defined(CLOCK_MONOTONIC) && !defined(_WIN32)
+	struct timespec now;
+	if (clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+		return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+	return timeval_us();
+}
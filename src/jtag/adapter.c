@@ -12,6 +12,8 @@
 #endif
 
 #include "adapter.h"
+#include "adapter_stats.h"
+#include "adapter_trace.h"
 #include "jtag.h"
 #include "minidriver.h"
 #include "interface.h"
@@ -186,6 +188,8 @@ int adapter_init(struct command_context *cmd_ctx)
 
 int adapter_quit(void)
 {
+	adapter_trace_stop();
+
 	if (is_adapter_initialized() && adapter_driver->quit) {
 		int result = adapter_driver->quit();
 		if (result != ERROR_OK)
@@ -1143,6 +1147,13 @@ static const struct command_registration adapter_command_handlers[] = {
 		.usage = "",
 		.chain = adapter_usb_command_handlers,
 	},
+	{
+		.name = "trace",
+		.mode = COMMAND_ANY,
+		.help = "adapter transaction trace command group",
+		.usage = "",
+		.chain = adapter_trace_command_handlers,
+	},
 	{
 		.name = "assert",
 		.handler = handle_adapter_reset_de_assert,
@@ -1204,7 +1215,11 @@ static const struct command_registration interface_command_handlers[] = {
  */
 int adapter_register_commands(struct command_context *ctx)
 {
-	return register_commands(ctx, NULL, interface_command_handlers);
+	int retval = register_commands(ctx, NULL, interface_command_handlers);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return register_commands(ctx, "adapter", adapter_stats_command_handlers);
 }
 
 const char *adapter_gpio_get_name(enum adapter_gpio_config_index idx)
@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Performance counters of the communication with the debug adapter.
+ *
+ * The adapter drivers and the DAP layer account queue flushes, USB
+ * transfers, SWD WAIT/FAULT acks and MEM-AP register rewrites, together
+ * with latency histograms, to a scope. Each DAP is a scope of its own,
+ * all of them add to the adapter totals.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include "adapter_stats.h"
+#include <helper/log.h>
+
+struct adapter_stats adapter_stats_total = {
+	.name = "adapter",
+};
+
+static OOCD_LIST_HEAD(adapter_stats_scopes);
+
+static const char * const adapter_stat_names[ADAPTER_STAT_COUNT] = {
+	[ADAPTER_STAT_QUEUE_FLUSH] = "queue flushes",
+	[ADAPTER_STAT_USB_TRANSFER] = "USB transfers",
+	[ADAPTER_STAT_USB_BYTES_OUT] = "USB bytes out",
+	[ADAPTER_STAT_USB_BYTES_IN] = "USB bytes in",
+	[ADAPTER_STAT_DAP_RUN] = "DAP runs",
+	[ADAPTER_STAT_SWD_WAIT] = "SWD WAIT acks",
+	[ADAPTER_STAT_SWD_FAULT] = "SWD FAULT acks",
+	[ADAPTER_STAT_TAR_WRITE] = "TAR writes",
+	[ADAPTER_STAT_CSW_WRITE] = "CSW writes",
+	[ADAPTER_STAT_MEM_READ_BYTES] = "memory bytes read",
+	[ADAPTER_STAT_MEM_WRITE_BYTES] = "memory bytes written",
+};
+
+static const char * const adapter_latency_names[ADAPTER_LATENCY_COUNT] = {
+	[ADAPTER_LATENCY_QUEUE_FLUSH] = "queue flush",
+	[ADAPTER_LATENCY_USB] = "USB transfer",
+	[ADAPTER_LATENCY_DAP_RUN] = "DAP run",
+};
+
+void adapter_stats_register(struct adapter_stats *stats, const char *name)
+{
+	stats->name = name;
+	list_add_tail(&stats->lh, &adapter_stats_scopes);
+}
+
+void adapter_stats_unregister(struct adapter_stats *stats)
+{
+	list_del(&stats->lh);
+}
+
+static void adapter_stats_account_latency(struct adapter_stats *stats,
+		enum adapter_latency which, uint64_t latency_us)
+{
+	unsigned int bucket = 0;
+	while (bucket < ADAPTER_STATS_BUCKETS - 1 && latency_us >= (1ULL << bucket))
+		bucket++;
+
+	stats->latency[which][bucket]++;
+	stats->latency_total_us[which] += latency_us;
+}
+
+void adapter_stats_latency(struct adapter_stats *stats,
+		enum adapter_latency which, int64_t latency_us)
+{
+	/* the host clock could have been stepped back */
+	if (latency_us < 0)
+		latency_us = 0;
+
+	adapter_stats_account_latency(stats, which, latency_us);
+	if (stats != &adapter_stats_total)
+		adapter_stats_account_latency(&adapter_stats_total, which, latency_us);
+}
+
+void adapter_stats_usb(unsigned int bytes_out, unsigned int bytes_in, int64_t latency_us)
+{
+	adapter_stats_add(&adapter_stats_total, ADAPTER_STAT_USB_TRANSFER, 1);
+	adapter_stats_add(&adapter_stats_total, ADAPTER_STAT_USB_BYTES_OUT, bytes_out);
+	adapter_stats_add(&adapter_stats_total, ADAPTER_STAT_USB_BYTES_IN, bytes_in);
+	adapter_stats_latency(&adapter_stats_total, ADAPTER_LATENCY_USB, latency_us);
+}
+
+static void adapter_stats_reset(struct adapter_stats *stats)
+{
+	memset(stats->counter, 0, sizeof(stats->counter));
+	memset(stats->latency, 0, sizeof(stats->latency));
+	memset(stats->latency_total_us, 0, sizeof(stats->latency_total_us));
+}
+
+static void adapter_stats_print(struct command_invocation *cmd, const struct adapter_stats *stats)
+{
+	command_print(cmd, "%s:", stats->name);
+
+	for (unsigned int i = 0; i < ADAPTER_STAT_COUNT; i++)
+		command_print(cmd, "  %-22s %" PRIu64, adapter_stat_names[i], stats->counter[i]);
+
+	for (unsigned int i = 0; i < ADAPTER_LATENCY_COUNT; i++) {
+		uint64_t count = 0;
+		for (unsigned int b = 0; b < ADAPTER_STATS_BUCKETS; b++)
+			count += stats->latency[i][b];
+		if (!count)
+			continue;
+
+		command_print(cmd, "  %s latency, %" PRIu64 " samples, average %" PRIu64 " us:",
+			adapter_latency_names[i], count, stats->latency_total_us[i] / count);
+		for (unsigned int b = 0; b < ADAPTER_STATS_BUCKETS; b++) {
+			if (!stats->latency[i][b])
+				continue;
+			if (b < ADAPTER_STATS_BUCKETS - 1)
+				command_print(cmd, "    < %8llu us %12" PRIu64, 1ULL << b, stats->latency[i][b]);
+			else
+				command_print(cmd, "    >= %7llu us %12" PRIu64, 1ULL << (b - 1), stats->latency[i][b]);
+		}
+	}
+}
+
+COMMAND_HANDLER(handle_adapter_stats_command)
+{
+	struct adapter_stats *stats;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		adapter_stats_reset(&adapter_stats_total);
+		list_for_each_entry(stats, &adapter_stats_scopes, lh)
+			adapter_stats_reset(stats);
+		return ERROR_OK;
+	}
+
+	adapter_stats_print(CMD, &adapter_stats_total);
+	list_for_each_entry(stats, &adapter_stats_scopes, lh)
+		adapter_stats_print(CMD, stats);
+
+	return ERROR_OK;
+}
+
+const struct command_registration adapter_stats_command_handlers[] = {
+	{
+		.name = "stats",
+		.handler = handle_adapter_stats_command,
+		.mode = COMMAND_ANY,
+		.help = "Display or reset the performance counters of the "
+			"adapter and of each DAP",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
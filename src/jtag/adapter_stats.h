@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Performance counters of the communication with the debug adapter.
+ */
+
+#ifndef OPENOCD_JTAG_ADAPTER_STATS_H
+#define OPENOCD_JTAG_ADAPTER_STATS_H
+
+#include <helper/command.h>
+#include <helper/list.h>
+
+enum adapter_stat {
+	/** jtag_execute_queue() calls */
+	ADAPTER_STAT_QUEUE_FLUSH,
+	/** USB transfers to or from the adapter */
+	ADAPTER_STAT_USB_TRANSFER,
+	ADAPTER_STAT_USB_BYTES_OUT,
+	ADAPTER_STAT_USB_BYTES_IN,
+	/** dap_run() calls */
+	ADAPTER_STAT_DAP_RUN,
+	/** SWD queue runs which ended with a WAIT ack */
+	ADAPTER_STAT_SWD_WAIT,
+	/** SWD queue runs which ended with a FAULT ack */
+	ADAPTER_STAT_SWD_FAULT,
+	/** writes of the MEM-AP TAR register */
+	ADAPTER_STAT_TAR_WRITE,
+	/** writes of the MEM-AP CSW register */
+	ADAPTER_STAT_CSW_WRITE,
+	ADAPTER_STAT_MEM_READ_BYTES,
+	ADAPTER_STAT_MEM_WRITE_BYTES,
+	ADAPTER_STAT_COUNT,
+};
+
+enum adapter_latency {
+	ADAPTER_LATENCY_QUEUE_FLUSH,
+	ADAPTER_LATENCY_USB,
+	ADAPTER_LATENCY_DAP_RUN,
+	ADAPTER_LATENCY_COUNT,
+};
+
+/* bucket n counts latencies below 2^n us, the last one everything above */
+#define ADAPTER_STATS_BUCKETS	24
+
+struct adapter_stats {
+	/** name of the scope, shown by the 'adapter stats' command */
+	const char *name;
+	uint64_t counter[ADAPTER_STAT_COUNT];
+	uint64_t latency[ADAPTER_LATENCY_COUNT][ADAPTER_STATS_BUCKETS];
+	uint64_t latency_total_us[ADAPTER_LATENCY_COUNT];
+	struct list_head lh;
+};
+
+/** Totals of all the scopes */
+extern struct adapter_stats adapter_stats_total;
+
+/**
+ * Register a scope, e.g. a DAP, which gets listed by 'adapter stats'.
+ * @param name has to stay valid until the scope is unregistered.
+ */
+void adapter_stats_register(struct adapter_stats *stats, const char *name);
+void adapter_stats_unregister(struct adapter_stats *stats);
+
+/** Add to a counter of the scope and to the total. */
+static inline void adapter_stats_add(struct adapter_stats *stats,
+		enum adapter_stat stat, uint64_t value)
+{
+	stats->counter[stat] += value;
+	if (stats != &adapter_stats_total)
+		adapter_stats_total.counter[stat] += value;
+}
+
+/** Account a latency in us to the histogram of the scope and to the total. */
+void adapter_stats_latency(struct adapter_stats *stats,
+		enum adapter_latency which, int64_t latency_us);
+
+/** Account a USB transfer of the adapter driver. */
+void adapter_stats_usb(unsigned int bytes_out, unsigned int bytes_in, int64_t latency_us);
+
+extern const struct command_registration adapter_stats_command_handlers[];
+
+#endif /* OPENOCD_JTAG_ADAPTER_STATS_H */
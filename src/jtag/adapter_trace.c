@@ -0,0 +1,252 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Binary trace of the transactions between OpenOCD and the debug adapter.
+ *
+ * Records have a fixed size and are kept in a ring in memory, so that the
+ * cost while tracing is a copy of a few words. When the ring is full the
+ * oldest records are overwritten. The ring is written to the trace file
+ * when tracing is stopped, either by command or at exit.
+ * The file format is described in adapter_trace.h, the decoder is in
+ * contrib/adapter_trace_decode.c.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "adapter_trace.h"
+#include "swd.h"
+#include <helper/log.h>
+#include <helper/time_support.h>
+#include <helper/types.h>
+
+#define ADAPTER_TRACE_DEFAULT_RECORDS	(1024 * 1024)
+
+struct adapter_trace_record {
+	int64_t timestamp;
+	uint32_t duration;
+	uint32_t value;
+	uint32_t bytes;
+	uint8_t kind;
+	uint8_t reg;
+	uint8_t ack;
+};
+
+bool adapter_trace_enabled;
+
+static struct {
+	char *filename;
+	struct adapter_trace_record *records;
+	unsigned int size;
+	/* index of the next record to be written */
+	unsigned int next;
+	/* total number of records added since start */
+	uint64_t count;
+	int64_t start_time;
+} adapter_trace;
+
+int64_t adapter_trace_start(void)
+{
+	return adapter_trace_enabled ? timeval_us() : 0;
+}
+
+void adapter_trace_add(enum adapter_trace_kind kind, uint8_t reg, uint8_t ack,
+		uint32_t value, uint32_t bytes, int64_t start)
+{
+	if (!adapter_trace_enabled)
+		return;
+
+	int64_t now = timeval_us();
+	struct adapter_trace_record *r = &adapter_trace.records[adapter_trace.next];
+
+	if (start) {
+		r->timestamp = start - adapter_trace.start_time;
+		r->duration = now - start;
+	} else {
+		r->timestamp = now - adapter_trace.start_time;
+		r->duration = 0;
+	}
+	r->value = value;
+	r->bytes = bytes;
+	r->kind = kind;
+	r->reg = reg;
+	r->ack = ack;
+
+	if (++adapter_trace.next == adapter_trace.size)
+		adapter_trace.next = 0;
+	adapter_trace.count++;
+}
+
+void adapter_trace_swd(uint8_t cmd, uint8_t ack, uint32_t data)
+{
+	enum adapter_trace_kind kind;
+
+	if (cmd & SWD_CMD_APNDP)
+		kind = (cmd & SWD_CMD_RNW) ? ADAPTER_TRACE_AP_READ : ADAPTER_TRACE_AP_WRITE;
+	else
+		kind = (cmd & SWD_CMD_RNW) ? ADAPTER_TRACE_DP_READ : ADAPTER_TRACE_DP_WRITE;
+
+	adapter_trace_add(kind, (cmd & SWD_CMD_A32) >> 1, ack, data, 4, 0);
+}
+
+static int adapter_trace_write_file(void)
+{
+	FILE *file = fopen(adapter_trace.filename, "wb");
+	if (!file) {
+		LOG_ERROR("failed to open adapter trace file \"%s\"", adapter_trace.filename);
+		return ERROR_FAIL;
+	}
+
+	unsigned int record_count = MIN(adapter_trace.count, adapter_trace.size);
+	uint32_t lost_count = adapter_trace.count - record_count;
+	uint8_t buf[ADAPTER_TRACE_HEADER_SIZE];
+
+	memcpy(buf, ADAPTER_TRACE_MAGIC, 8);
+	h_u32_to_le(buf + 8, ADAPTER_TRACE_VERSION);
+	h_u32_to_le(buf + 12, ADAPTER_TRACE_RECORD_SIZE);
+	h_u64_to_le(buf + 16, adapter_trace.start_time);
+	h_u32_to_le(buf + 24, record_count);
+	h_u32_to_le(buf + 28, lost_count);
+
+	bool ok = fwrite(buf, ADAPTER_TRACE_HEADER_SIZE, 1, file) == 1;
+
+	/* oldest record first */
+	unsigned int index = (record_count < adapter_trace.size) ? 0 : adapter_trace.next;
+	for (unsigned int i = 0; ok && i < record_count; i++) {
+		const struct adapter_trace_record *r = &adapter_trace.records[index];
+
+		memset(buf, 0, ADAPTER_TRACE_RECORD_SIZE);
+		h_u64_to_le(buf, r->timestamp);
+		h_u32_to_le(buf + 8, r->duration);
+		h_u32_to_le(buf + 12, r->value);
+		h_u32_to_le(buf + 16, r->bytes);
+		buf[20] = r->kind;
+		buf[21] = r->reg;
+		buf[22] = r->ack;
+
+		ok = fwrite(buf, ADAPTER_TRACE_RECORD_SIZE, 1, file) == 1;
+
+		if (++index == adapter_trace.size)
+			index = 0;
+	}
+
+	if (fclose(file) != 0)
+		ok = false;
+
+	if (!ok) {
+		LOG_ERROR("failed to write adapter trace file \"%s\"", adapter_trace.filename);
+		return ERROR_FAIL;
+	}
+
+	LOG_INFO("adapter trace: %u records written to \"%s\", %" PRIu32 " lost",
+		record_count, adapter_trace.filename, lost_count);
+	return ERROR_OK;
+}
+
+int adapter_trace_stop(void)
+{
+	if (!adapter_trace.records)
+		return ERROR_OK;
+
+	adapter_trace_enabled = false;
+
+	int retval = adapter_trace_write_file();
+
+	free(adapter_trace.records);
+	adapter_trace.records = NULL;
+	free(adapter_trace.filename);
+	adapter_trace.filename = NULL;
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_adapter_trace_start_command)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	unsigned int size = ADAPTER_TRACE_DEFAULT_RECORDS;
+	if (CMD_ARGC == 2) {
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], size);
+		if (size == 0)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	int retval = adapter_trace_stop();
+	if (retval != ERROR_OK)
+		return retval;
+
+	adapter_trace.records = calloc(size, sizeof(*adapter_trace.records));
+	adapter_trace.filename = strdup(CMD_ARGV[0]);
+	if (!adapter_trace.records || !adapter_trace.filename) {
+		free(adapter_trace.records);
+		adapter_trace.records = NULL;
+		free(adapter_trace.filename);
+		adapter_trace.filename = NULL;
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	adapter_trace.size = size;
+	adapter_trace.next = 0;
+	adapter_trace.count = 0;
+	adapter_trace.start_time = timeval_us();
+	adapter_trace_enabled = true;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_adapter_trace_stop_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!adapter_trace.records) {
+		command_print(CMD, "adapter trace not running");
+		return ERROR_OK;
+	}
+
+	return adapter_trace_stop();
+}
+
+COMMAND_HANDLER(handle_adapter_trace_status_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!adapter_trace.records) {
+		command_print(CMD, "adapter trace not running");
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "adapter trace to \"%s\": %" PRIu64 " records, ring of %u",
+		adapter_trace.filename, adapter_trace.count, adapter_trace.size);
+	return ERROR_OK;
+}
+
+const struct command_registration adapter_trace_command_handlers[] = {
+	{
+		.name = "start",
+		.handler = handle_adapter_trace_start_command,
+		.mode = COMMAND_ANY,
+		.help = "Start recording adapter transactions, the trace "
+			"is written to the file when stopped",
+		.usage = "filename [ring_size_in_records]",
+	},
+	{
+		.name = "stop",
+		.handler = handle_adapter_trace_stop_command,
+		.mode = COMMAND_ANY,
+		.help = "Stop recording and write the trace file",
+		.usage = "",
+	},
+	{
+		.name = "status",
+		.handler = handle_adapter_trace_status_command,
+		.mode = COMMAND_ANY,
+		.help = "Display the state of the adapter trace",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
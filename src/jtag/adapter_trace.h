@@ -0,0 +1,92 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Binary trace of the transactions between OpenOCD and the debug adapter.
+ */
+
+#ifndef OPENOCD_JTAG_ADAPTER_TRACE_H
+#define OPENOCD_JTAG_ADAPTER_TRACE_H
+
+#include <helper/command.h>
+
+/*
+ * File layout, all fields little endian:
+ *
+ * header (32 bytes):
+ *   char     magic[8]         ADAPTER_TRACE_MAGIC
+ *   uint32_t version          ADAPTER_TRACE_VERSION
+ *   uint32_t record_size      ADAPTER_TRACE_RECORD_SIZE
+ *   uint64_t start_time       host time of the trace start, us since the epoch
+ *   uint32_t record_count     number of records following the header
+ *   uint32_t lost_count       older records overwritten in the ring
+ *
+ * records (ADAPTER_TRACE_RECORD_SIZE bytes each, oldest first):
+ *   uint64_t timestamp        us since start_time, begin of the transaction
+ *   uint32_t duration         us, 0 for single transfers
+ *   uint32_t value            register value, or kind specific
+ *   uint32_t bytes            bytes moved over the adapter link
+ *   uint8_t  kind             enum adapter_trace_kind
+ *   uint8_t  reg              DP/AP register offset
+ *   uint8_t  ack              SWD ack
+ *   uint8_t  reserved
+ */
+#define ADAPTER_TRACE_MAGIC			"OCDTRACE"
+#define ADAPTER_TRACE_VERSION		1
+#define ADAPTER_TRACE_HEADER_SIZE	32
+#define ADAPTER_TRACE_RECORD_SIZE	24
+
+enum adapter_trace_kind {
+	/** jtag_execute_queue(), value is the error code */
+	ADAPTER_TRACE_QUEUE_FLUSH = 1,
+	/** run of the SWD queue from the DAP layer, value is the error code */
+	ADAPTER_TRACE_SWD_RUN = 2,
+	/** USB packet sent to the adapter */
+	ADAPTER_TRACE_USB_WRITE = 3,
+	/** USB packet received from the adapter */
+	ADAPTER_TRACE_USB_READ = 4,
+	/** combined USB write and read, value holds the bytes read */
+	ADAPTER_TRACE_USB_XFER = 5,
+	ADAPTER_TRACE_DP_READ = 6,
+	ADAPTER_TRACE_DP_WRITE = 7,
+	ADAPTER_TRACE_AP_READ = 8,
+	ADAPTER_TRACE_AP_WRITE = 9,
+};
+
+/* checked inline so that disabled tracing costs a single test */
+extern bool adapter_trace_enabled;
+
+/**
+ * @returns the current time to be passed to adapter_trace_add() as start
+ * of a transaction, or 0 if tracing is disabled.
+ */
+int64_t adapter_trace_start(void);
+
+/**
+ * Append a record to the trace.
+ * @param start value returned by adapter_trace_start() when the
+ * transaction began, or 0 for a transaction without duration.
+ */
+void adapter_trace_add(enum adapter_trace_kind kind, uint8_t reg, uint8_t ack,
+		uint32_t value, uint32_t bytes, int64_t start);
+
+/** Append a record for an SWD transfer given by its command byte. */
+void adapter_trace_swd(uint8_t cmd, uint8_t ack, uint32_t data);
+
+#define ADAPTER_TRACE(kind, reg, ack, value, bytes, start) \
+	do { \
+		if (adapter_trace_enabled) \
+			adapter_trace_add(kind, reg, ack, value, bytes, start); \
+	} while (0)
+
+#define ADAPTER_TRACE_SWD(cmd, ack, data) \
+	do { \
+		if (adapter_trace_enabled) \
+			adapter_trace_swd(cmd, ack, data); \
+	} while (0)
+
+/** Write the pending trace to its file and stop tracing. */
+int adapter_trace_stop(void);
+
+extern const struct command_registration adapter_trace_command_handlers[];
+
+#endif /* OPENOCD_JTAG_ADAPTER_TRACE_H */
@@ -20,6 +20,8 @@
 #endif
 
 #include "adapter.h"
+#include "adapter_stats.h"
+#include "adapter_trace.h"
 #include "jtag.h"
 #include "swd.h"
 #include "interface.h"
@@ -1030,8 +1032,15 @@ int default_interface_jtag_execute_queue(void)
 
 void jtag_execute_queue_noclear(void)
 {
+	int64_t start = timeval_us();
+
 	jtag_flush_queue_count++;
-	jtag_set_error(interface_jtag_execute_queue());
+	int retval = interface_jtag_execute_queue();
+	jtag_set_error(retval);
+
+	adapter_stats_add(&adapter_stats_total, ADAPTER_STAT_QUEUE_FLUSH, 1);
+	adapter_stats_latency(&adapter_stats_total, ADAPTER_LATENCY_QUEUE_FLUSH, timeval_us() - start);
+	ADAPTER_TRACE(ADAPTER_TRACE_QUEUE_FLUSH, 0, 0, retval, 0, start);
 
 	if (jtag_flush_queue_sleep > 0) {
 		/* For debug purposes it can be useful to test performance
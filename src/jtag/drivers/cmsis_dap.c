@@ -30,6 +30,8 @@
 #include <transport/transport.h>
 #include "helper/replacements.h"
 #include <jtag/adapter.h>
+#include <jtag/adapter_stats.h>
+#include <jtag/adapter_trace.h>
 #include <jtag/swd.h>
 #include <jtag/interface.h>
 #include <jtag/commands.h>
@@ -355,6 +357,7 @@ static int cmsis_dap_xfer(struct cmsis_dap *dap, int txlen)
 	}
 
 	uint8_t current_cmd = dap->command[0];
+	int64_t start = timeval_us();
 	int retval = dap->backend->write(dap, txlen, LIBUSB_TIMEOUT_MS);
 	if (retval < 0)
 		return retval;
@@ -364,6 +367,9 @@ static int cmsis_dap_xfer(struct cmsis_dap *dap, int txlen)
 	if (retval < 0)
 		return retval;
 
+	adapter_stats_usb(txlen, retval, timeval_us() - start);
+	ADAPTER_TRACE(ADAPTER_TRACE_USB_XFER, current_cmd, 0, retval, txlen, start);
+
 	uint8_t *resp = dap->response;
 	if (resp[0] == DAP_ERROR) {
 		LOG_ERROR("CMSIS-DAP command 0x%" PRIx8 " not implemented", current_cmd);
@@ -864,11 +870,14 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 		}
 	}
 
+	int64_t start = timeval_us();
 	int retval = dap->backend->write(dap, idx, LIBUSB_TIMEOUT_MS);
 	if (retval < 0) {
 		queued_retval = retval;
 		goto skip;
 	}
+	adapter_stats_usb(idx, 0, timeval_us() - start);
+	ADAPTER_TRACE(ADAPTER_TRACE_USB_WRITE, block->command, 0, block->transfer_count, idx, start);
 
 	unsigned int packet_count = dap->quirk_mode ? 1 : dap->packet_count;
 	dap->pending_fifo_put_idx = (dap->pending_fifo_put_idx + 1) % packet_count;
@@ -905,6 +914,7 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, enum cmsis_dap_blo
 	}
 
 	/* get reply */
+	int64_t start = timeval_us();
 	retval = dap->backend->read(dap, LIBUSB_TIMEOUT_MS, blocking);
 	bool timeout = (retval == ERROR_TIMEOUT_REACHED || retval == 0);
 	if (timeout && blocking == CMSIS_DAP_NON_BLOCKING)
@@ -922,6 +932,9 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, enum cmsis_dap_blo
 		goto skip;
 	}
 
+	adapter_stats_usb(0, retval, timeval_us() - start);
+	ADAPTER_TRACE(ADAPTER_TRACE_USB_READ, block->command, 0, block->transfer_count, retval, start);
+
 	uint8_t *resp = dap->response;
 	if (resp[0] != block->command) {
 		LOG_ERROR("CMSIS-DAP command mismatch. Expected 0x%x received 0x%" PRIx8,
@@ -949,6 +962,8 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, enum cmsis_dap_blo
 	if (ack != SWD_ACK_OK) {
 		LOG_DEBUG("SWD ack not OK @ %d %s", transfer_count,
 			  ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK");
+		if (transfer_count < block->transfer_count)
+			ADAPTER_TRACE_SWD(block->transfers[transfer_count].cmd, ack, 0);
 		queued_retval = swd_ack_to_error_code(ack);
 		/* TODO: use results of transfers completed before the error occurred? */
 		goto skip;
@@ -975,6 +990,7 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, enum cmsis_dap_blo
 			idx += 4;
 
 			LOG_DEBUG_IO("Read result: %" PRIx32, data);
+			ADAPTER_TRACE_SWD(transfer->cmd, SWD_ACK_OK, data);
 
 			/* Imitate posted AP reads */
 			if ((transfer->cmd & SWD_CMD_APNDP) ||
@@ -985,6 +1001,8 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, enum cmsis_dap_blo
 
 			if (transfer->buffer)
 				*(uint32_t *)(transfer->buffer) = tmp;
+		} else {
+			ADAPTER_TRACE_SWD(transfer->cmd, SWD_ACK_OK, transfer->data);
 		}
 	}
 
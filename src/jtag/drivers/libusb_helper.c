@@ -13,7 +13,9 @@
 #include <string.h>
 
 #include <helper/log.h>
+#include <helper/time_support.h>
 #include <jtag/adapter.h>
+#include <jtag/adapter_stats.h>
 #include "libusb_helper.h"
 
 /*
@@ -230,8 +232,13 @@ int jtag_libusb_control_transfer(struct libusb_device_handle *dev, uint8_t reque
 		uint8_t request, uint16_t value, uint16_t index, char *bytes,
 		uint16_t size, unsigned int timeout, int *transferred)
 {
+	int64_t start = timeval_us();
 	int retval = libusb_control_transfer(dev, request_type, request, value, index,
 				(unsigned char *)bytes, size, timeout);
+	if (retval >= 0) {
+		bool in = request_type & LIBUSB_ENDPOINT_IN;
+		adapter_stats_usb(in ? 0 : retval, in ? retval : 0, timeval_us() - start);
+	}
 
 	if (retval < 0) {
 		LOG_ERROR("libusb_control_transfer error: %s", libusb_error_name(retval));
@@ -253,8 +260,10 @@ int jtag_libusb_bulk_write(struct libusb_device_handle *dev, int ep, char *bytes
 
 	*transferred = 0;
 
+	int64_t start = timeval_us();
 	ret = libusb_bulk_transfer(dev, ep, (unsigned char *)bytes, size,
 				   transferred, timeout);
+	adapter_stats_usb(*transferred, 0, timeval_us() - start);
 	if (ret != LIBUSB_SUCCESS) {
 		LOG_ERROR("libusb_bulk_write error: %s", libusb_error_name(ret));
 		return jtag_libusb_error(ret);
@@ -270,8 +279,10 @@ int jtag_libusb_bulk_read(struct libusb_device_handle *dev, int ep, char *bytes,
 
 	*transferred = 0;
 
+	int64_t start = timeval_us();
 	ret = libusb_bulk_transfer(dev, ep, (unsigned char *)bytes, size,
 				   transferred, timeout);
+	adapter_stats_usb(0, *transferred, timeval_us() - start);
 	if (ret != LIBUSB_SUCCESS) {
 		LOG_ERROR("libusb_bulk_read error: %s", libusb_error_name(ret));
 		return jtag_libusb_error(ret);
@@ -13,6 +13,8 @@
 #include "helper/log.h"
 #include "helper/replacements.h"
 #include "helper/time_support.h"
+#include "jtag/adapter_stats.h"
+#include "jtag/adapter_trace.h"
 #include "libusb_helper.h"
 #include <libusb.h>
 
@@ -865,6 +867,7 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 	if (ctx->write_count == 0)
 		return retval;
 
+	int64_t usb_start = timeval_us();
 	struct libusb_transfer *read_transfer = NULL;
 	struct transfer_result read_result = { .ctx = ctx, .done = true };
 	if (ctx->read_count) {
@@ -946,6 +949,10 @@ error_check:
 		retval = ERROR_OK;
 	}
 
+	adapter_stats_usb(write_result.transferred, read_result.transferred, timeval_us() - usb_start);
+	ADAPTER_TRACE(ADAPTER_TRACE_USB_XFER, 0, 0, read_result.transferred,
+		write_result.transferred, usb_start);
+
 	if (retval != ERROR_OK)
 		mpsse_purge(ctx);
 
@@ -72,8 +72,21 @@ static const struct freertos_params freertos_params_list[] = {
 	},
 };
 
+/* The thread table of the last update, kept across halts */
+struct freertos_private {
+	const struct freertos_params *params;
+	bool threads_valid;
+	uint32_t task_count;
+	uint32_t task_number;
+	uint32_t top_used_priority;
+	/* the List_t headers of all the task lists */
+	uint8_t *list_heads;
+	size_t list_heads_size;
+};
+
 static bool freertos_detect_rtos(struct target *target);
 static int freertos_create(struct target *target);
+static void freertos_destroy(struct rtos *rtos);
 static int freertos_update_threads(struct rtos *rtos);
 static int freertos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 		struct rtos_reg **reg_list, int *num_regs);
@@ -84,6 +97,7 @@ const struct rtos_type freertos_rtos = {
 
 	.detect_rtos = freertos_detect_rtos,
 	.create = freertos_create,
+	.destroy = freertos_destroy,
 	.update_threads = freertos_update_threads,
 	.get_thread_reg_list = freertos_get_thread_reg_list,
 	.get_symbol_list_to_lookup = freertos_get_symbol_list_to_lookup,
@@ -102,6 +116,7 @@ enum freertos_symbol_values {
 	FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS = 9,
 	FREERTOS_VAL_UX_TOP_USED_PRIORITY = 10,
 	FREERTOS_VAL_X_SCHEDULER_RUNNING = 11,
+	FREERTOS_VAL_UX_TASK_NUMBER = 12,
 };
 
 struct symbols {
@@ -122,6 +137,7 @@ static const struct symbols freertos_symbol_list[] = {
 	{ "uxCurrentNumberOfTasks", false },
 	{ "uxTopUsedPriority", true }, /* Unavailable since v7.5.3 */
 	{ "xSchedulerRunning", false },
+	{ "uxTaskNumber", true }, /* Bumped on each task creation and deletion */
 	{ NULL, false }
 };
 
@@ -130,16 +146,202 @@ static const struct symbols freertos_symbol_list[] = {
 /* may be problems reading if sizes are not 32 bit long integers. */
 /* test mallocs for failure */
 
+#define FREERTOS_THREAD_NAME_STR_SIZE (200)
+
+/* Scheduler variables read at each update */
+enum freertos_state_word {
+	FREERTOS_STATE_NUMBER_OF_TASKS,
+	FREERTOS_STATE_CURRENT_TCB,
+	FREERTOS_STATE_SCHEDULER_RUNNING,
+	FREERTOS_STATE_TOP_USED_PRIORITY,
+	FREERTOS_STATE_TASK_NUMBER,
+	FREERTOS_STATE_WORDS,
+};
+
+static const enum freertos_symbol_values freertos_state_symbols[FREERTOS_STATE_WORDS] = {
+	[FREERTOS_STATE_NUMBER_OF_TASKS] = FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS,
+	[FREERTOS_STATE_CURRENT_TCB] = FREERTOS_VAL_PX_CURRENT_TCB,
+	[FREERTOS_STATE_SCHEDULER_RUNNING] = FREERTOS_VAL_X_SCHEDULER_RUNNING,
+	[FREERTOS_STATE_TOP_USED_PRIORITY] = FREERTOS_VAL_UX_TOP_USED_PRIORITY,
+	[FREERTOS_STATE_TASK_NUMBER] = FREERTOS_VAL_UX_TASK_NUMBER,
+};
+
+/* Read the scheduler variables in one transaction, missing optional ones read as 0 */
+static int freertos_read_state(struct rtos *rtos, uint32_t *state)
+{
+	struct target_memory_access accesses[FREERTOS_STATE_WORDS];
+	uint8_t words[FREERTOS_STATE_WORDS][4] = { { 0 } };
+	unsigned int num_accesses = 0;
+
+	for (unsigned int i = 0; i < FREERTOS_STATE_WORDS; i++) {
+		symbol_address_t address = rtos->symbols[freertos_state_symbols[i]].address;
+		if (address == 0)
+			continue;
+		accesses[num_accesses].address = address;
+		accesses[num_accesses].size = sizeof(words[i]);
+		accesses[num_accesses].buffer = words[i];
+		accesses[num_accesses].write = false;
+		num_accesses++;
+	}
+
+	int retval = target_access_memory_batch(rtos->target, accesses, num_accesses);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < FREERTOS_STATE_WORDS; i++)
+		state[i] = target_buffer_get_u32(rtos->target, words[i]);
+	return ERROR_OK;
+}
+
+/* Read the List_t headers of all the task lists in one transaction */
+static int freertos_read_list_heads(struct rtos *rtos, const symbol_address_t *list_of_lists,
+		unsigned int num_lists, uint8_t *heads)
+{
+	const struct freertos_private *priv = rtos->rtos_specific_params;
+	unsigned int list_width = priv->params->list_width;
+	struct target_memory_access *accesses = calloc(num_lists, sizeof(*accesses));
+	unsigned int num_accesses = 0;
+
+	if (!accesses) {
+		LOG_ERROR("Error allocating memory for %u lists", num_lists);
+		return ERROR_FAIL;
+	}
+
+	memset(heads, 0, num_lists * list_width);
+	for (unsigned int i = 0; i < num_lists; i++) {
+		if (list_of_lists[i] == 0)
+			continue;
+		accesses[num_accesses].address = list_of_lists[i];
+		accesses[num_accesses].size = list_width;
+		accesses[num_accesses].buffer = heads + i * list_width;
+		accesses[num_accesses].write = false;
+		num_accesses++;
+	}
+
+	int retval = target_access_memory_batch(rtos->target, accesses, num_accesses);
+	free(accesses);
+	return retval;
+}
+
+/*
+ * Mark the running thread in a thread table which is still valid,
+ * the same way a refresh of the table does.
+ */
+static int freertos_mark_current_thread(struct rtos *rtos, threadid_t current_thread)
+{
+	rtos->current_thread = current_thread;
+	rtos->current_threadid = -1;
+
+	for (int i = 0; i < rtos->thread_count; i++) {
+		struct thread_detail *detail = &rtos->thread_details[i];
+		bool running = detail->threadid == current_thread;
+
+		if (running && !detail->extra_info_str) {
+			detail->extra_info_str = strdup("State: Running");
+			if (!detail->extra_info_str)
+				return ERROR_FAIL;
+		} else if (!running && detail->extra_info_str) {
+			free(detail->extra_info_str);
+			detail->extra_info_str = NULL;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+static const struct thread_detail *freertos_find_thread(const struct thread_detail *details,
+		int count, threadid_t threadid)
+{
+	for (int i = 0; i < count; i++)
+		if (details[i].threadid == threadid)
+			return &details[i];
+	return NULL;
+}
+
+/*
+ * Read the names of the threads in one transaction. The names of the
+ * threads of the previous table are reused when no TCB can have been
+ * reused by a new task since: uxTaskNumber, bumped on each creation and
+ * deletion of a task, has to account exactly for the new TCBs.
+ */
+static int freertos_read_thread_names(struct rtos *rtos, struct thread_detail *details,
+		unsigned int first, unsigned int count, const struct thread_detail *old_details,
+		int old_count, bool keep_old_names)
+{
+	const struct freertos_private *priv = rtos->rtos_specific_params;
+	struct target_memory_access *accesses = calloc(count, sizeof(*accesses));
+	char *names = malloc((size_t)count * FREERTOS_THREAD_NAME_STR_SIZE);
+	unsigned int num_accesses = 0;
+	int retval = ERROR_OK;
+
+	if (!accesses || !names) {
+		LOG_ERROR("Error allocating memory for %u thread names", count);
+		free(accesses);
+		free(names);
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = first; i < first + count; i++) {
+		const struct thread_detail *old = keep_old_names ?
+			freertos_find_thread(old_details, old_count, details[i].threadid) : NULL;
+		if (old && old->thread_name_str) {
+			details[i].thread_name_str = strdup(old->thread_name_str);
+			continue;
+		}
+		accesses[num_accesses].address = details[i].threadid + priv->params->thread_name_offset;
+		accesses[num_accesses].size = FREERTOS_THREAD_NAME_STR_SIZE;
+		accesses[num_accesses].buffer = (uint8_t *)names + num_accesses * FREERTOS_THREAD_NAME_STR_SIZE;
+		accesses[num_accesses].write = false;
+		num_accesses++;
+	}
+
+	if (num_accesses)
+		retval = target_access_memory_batch(rtos->target, accesses, num_accesses);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading thread names in FreeRTOS thread list");
+		goto out;
+	}
+
+	unsigned int n = 0;
+	for (unsigned int i = first; i < first + count; i++) {
+		if (details[i].thread_name_str)
+			continue;
+
+		char *tmp_str = names + n++ * FREERTOS_THREAD_NAME_STR_SIZE;
+		tmp_str[FREERTOS_THREAD_NAME_STR_SIZE - 1] = '\x00';
+		LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value '%s'",
+			details[i].threadid + priv->params->thread_name_offset, tmp_str);
+
+		if (tmp_str[0] == '\x00')
+			strcpy(tmp_str, "No Name");
+		details[i].thread_name_str = strdup(tmp_str);
+	}
+
+out:
+	free(accesses);
+	free(names);
+	return retval;
+}
+
+/*
+ * The thread table is kept across halts. It is re-read only when the set
+ * of tasks can have changed: when the number of tasks, uxTaskNumber
+ * (when the symbol is found) or, without uxTaskNumber, the headers of the
+ * task lists have changed. Otherwise
+ * only the running thread is updated, from a single memory transaction.
+ */
 static int freertos_update_threads(struct rtos *rtos)
 {
 	int retval;
 	unsigned int tasks_found = 0;
 	const struct freertos_params *param;
+	struct freertos_private *priv;
 
 	if (!rtos->rtos_specific_params)
 		return -1;
 
-	param = (const struct freertos_params *) rtos->rtos_specific_params;
+	priv = rtos->rtos_specific_params;
+	param = priv->params;
 
 	if (!rtos->symbols) {
 		LOG_ERROR("No symbols for FreeRTOS");
@@ -151,58 +353,38 @@ static int freertos_update_threads(struct rtos *rtos)
 		return -2;
 	}
 
-	uint32_t thread_list_size = 0;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS].address,
-			&thread_list_size);
-	LOG_DEBUG("FreeRTOS: Read uxCurrentNumberOfTasks at 0x%" PRIx64 ", value %" PRIu32,
-										rtos->symbols[FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS].address,
-										thread_list_size);
-
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Could not read FreeRTOS thread count from target");
-		return retval;
-	}
-
-	/* wipe out previous thread details if any */
-	rtos_free_threadlist(rtos);
-
-	/* read the current thread */
-	uint32_t pointer_casts_are_bad;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_PX_CURRENT_TCB].address,
-			&pointer_casts_are_bad);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Error reading current thread in FreeRTOS thread list");
-		return retval;
-	}
-	rtos->current_thread = pointer_casts_are_bad;
-	LOG_DEBUG("FreeRTOS: Read pxCurrentTCB at 0x%" PRIx64 ", value 0x%" PRIx64,
-										rtos->symbols[FREERTOS_VAL_PX_CURRENT_TCB].address,
-										rtos->current_thread);
-
-	/* read scheduler running */
-	uint32_t scheduler_running;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_X_SCHEDULER_RUNNING].address,
-			&scheduler_running);
+	uint32_t state[FREERTOS_STATE_WORDS];
+	retval = freertos_read_state(rtos, state);
 	if (retval != ERROR_OK) {
-		LOG_ERROR("Error reading FreeRTOS scheduler state");
+		LOG_ERROR("Could not read FreeRTOS scheduler state from target");
+		priv->threads_valid = false;
 		return retval;
 	}
-	LOG_DEBUG("FreeRTOS: Read xSchedulerRunning at 0x%" PRIx64 ", value 0x%" PRIx32,
-										rtos->symbols[FREERTOS_VAL_X_SCHEDULER_RUNNING].address,
-										scheduler_running);
 
-	if ((thread_list_size  == 0) || (rtos->current_thread == 0) || (scheduler_running != 1)) {
+	uint32_t thread_list_size = state[FREERTOS_STATE_NUMBER_OF_TASKS];
+	threadid_t current_thread = state[FREERTOS_STATE_CURRENT_TCB];
+	uint32_t scheduler_running = state[FREERTOS_STATE_SCHEDULER_RUNNING];
+	uint32_t top_used_priority = state[FREERTOS_STATE_TOP_USED_PRIORITY];
+	uint32_t task_number = state[FREERTOS_STATE_TASK_NUMBER];
+	bool have_task_number = rtos->symbols[FREERTOS_VAL_UX_TASK_NUMBER].address != 0;
+	LOG_DEBUG("FreeRTOS: uxCurrentNumberOfTasks %" PRIu32 ", pxCurrentTCB 0x%" PRIx64
+		", xSchedulerRunning %" PRIu32 ", uxTopUsedPriority %" PRIu32 ", uxTaskNumber %" PRIu32,
+		thread_list_size, current_thread, scheduler_running, top_used_priority, task_number);
+
+	bool was_valid = priv->threads_valid;
+	uint32_t old_task_number = priv->task_number;
+	priv->threads_valid = false;
+
+	if ((thread_list_size  == 0) || (current_thread == 0) || (scheduler_running != 1)) {
 		/* Either : No RTOS threads - there is always at least the current execution though */
 		/* OR     : No current thread - all threads suspended - show the current execution
 		 * of idling */
+		rtos_free_threadlist(rtos);
+
 		char tmp_str[] = "Current Execution";
 		thread_list_size++;
 		tasks_found++;
-		rtos->thread_details = malloc(
-				sizeof(struct thread_detail) * thread_list_size);
+		rtos->thread_details = calloc(thread_list_size, sizeof(struct thread_detail));
 		if (!rtos->thread_details) {
 			LOG_ERROR("Error allocating memory for %d threads", thread_list_size);
 			return ERROR_FAIL;
@@ -213,38 +395,29 @@ static int freertos_update_threads(struct rtos *rtos)
 		rtos->thread_details->extra_info_str = NULL;
 		rtos->thread_details->thread_name_str = malloc(sizeof(tmp_str));
 		strcpy(rtos->thread_details->thread_name_str, tmp_str);
+		rtos->thread_count = 1;
 
-		if (thread_list_size == 1) {
-			rtos->thread_count = 1;
+		if (thread_list_size == 1)
 			return ERROR_OK;
-		}
-	} else {
-		/* create space for new thread details */
-		rtos->thread_details = malloc(
-				sizeof(struct thread_detail) * thread_list_size);
-		if (!rtos->thread_details) {
-			LOG_ERROR("Error allocating memory for %d threads", thread_list_size);
-			return ERROR_FAIL;
-		}
+		was_valid = false;
+	} else if (was_valid && have_task_number && thread_list_size == priv->task_count &&
+			task_number == old_task_number && top_used_priority == priv->top_used_priority &&
+			freertos_find_thread(rtos->thread_details, rtos->thread_count, current_thread)) {
+		/* no task created or deleted since the last walk */
+		priv->threads_valid = true;
+		return freertos_mark_current_thread(rtos, current_thread);
 	}
 
 	/* Find out how many lists are needed to be read from pxReadyTasksLists, */
 	if (rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address == 0) {
 		LOG_ERROR("FreeRTOS: uxTopUsedPriority is not defined, consult the OpenOCD manual for a work-around");
+		rtos_free_threadlist(rtos);
 		return ERROR_FAIL;
 	}
-	uint32_t top_used_priority = 0;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address,
-			&top_used_priority);
-	if (retval != ERROR_OK)
-		return retval;
-	LOG_DEBUG("FreeRTOS: Read uxTopUsedPriority at 0x%" PRIx64 ", value %" PRIu32,
-										rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address,
-										top_used_priority);
 	if (top_used_priority > FREERTOS_MAX_PRIORITIES) {
 		LOG_ERROR("FreeRTOS top used priority is unreasonably big, not proceeding: %" PRIu32,
 			top_used_priority);
+		rtos_free_threadlist(rtos);
 		return ERROR_FAIL;
 	}
 
@@ -273,116 +446,152 @@ static int freertos_update_threads(struct rtos *rtos)
 	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_SUSPENDED_TASK_LIST].address;
 	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_TASKS_WAITING_TERMINATION].address;
 
+	size_t heads_size = num_lists * param->list_width;
+	uint8_t *heads = malloc(heads_size);
+	if (!heads) {
+		LOG_ERROR("Error allocating memory for %u lists", num_lists);
+		free(list_of_lists);
+		return ERROR_FAIL;
+	}
+
+	retval = freertos_read_list_heads(rtos, list_of_lists, num_lists, heads);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading FreeRTOS thread lists");
+		goto out;
+	}
+
+	if (was_valid && !have_task_number && thread_list_size == priv->task_count &&
+			top_used_priority == priv->top_used_priority &&
+			heads_size == priv->list_heads_size &&
+			memcmp(heads, priv->list_heads, heads_size) == 0 &&
+			freertos_find_thread(rtos->thread_details, rtos->thread_count, current_thread)) {
+		/* the task lists look the same as in the last walk */
+		priv->threads_valid = true;
+		retval = freertos_mark_current_thread(rtos, current_thread);
+		goto out;
+	}
+
+	/* the names of the previous table may be reused */
+	struct thread_detail *old_details = NULL;
+	int old_count = 0;
+	if (tasks_found == 0) {
+		old_details = rtos->thread_details;
+		old_count = rtos->thread_count;
+		rtos->thread_details = NULL;
+		rtos->thread_count = 0;
+
+		/* create space for new thread details */
+		rtos->thread_details = calloc(thread_list_size, sizeof(struct thread_detail));
+		if (!rtos->thread_details) {
+			LOG_ERROR("Error allocating memory for %d threads", thread_list_size);
+			retval = ERROR_FAIL;
+			goto out_old;
+		}
+		rtos->current_thread = current_thread;
+		rtos->current_threadid = -1;
+	}
+	unsigned int first_task = tasks_found;
+
+	/* pxNext and pvOwner of a list item are read at once */
+	unsigned int item_first = MIN(param->list_elem_next_offset, param->list_elem_content_offset);
+	unsigned int item_size = MAX(param->list_elem_next_offset, param->list_elem_content_offset) +
+		param->pointer_width - item_first;
+	uint8_t item[16];
+	assert(item_size <= sizeof(item));
+
 	for (unsigned int i = 0; i < num_lists; i++) {
 		if (list_of_lists[i] == 0)
 			continue;
 
-		/* Read the number of threads in this list */
-		uint32_t list_thread_count = 0;
-		retval = target_read_u32(rtos->target,
-				list_of_lists[i],
-				&list_thread_count);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading number of threads in FreeRTOS thread list");
-			free(list_of_lists);
-			return retval;
-		}
+		/* The number of threads in this list */
+		uint8_t *head = heads + i * param->list_width;
+		uint32_t list_thread_count = target_buffer_get_u32(rtos->target, head);
 		LOG_DEBUG("FreeRTOS: Read thread count for list %u at 0x%" PRIx64 ", value %" PRIu32,
 										i, list_of_lists[i], list_thread_count);
 
 		if (list_thread_count == 0)
 			continue;
 
-		/* Read the location of first list item */
+		/* The location of first list item */
 		uint32_t prev_list_elem_ptr = -1;
-		uint32_t list_elem_ptr = 0;
-		retval = target_read_u32(rtos->target,
-				list_of_lists[i] + param->list_next_offset,
-				&list_elem_ptr);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
-			free(list_of_lists);
-			return retval;
-		}
+		uint32_t list_elem_ptr = target_buffer_get_u32(rtos->target, head + param->list_next_offset);
 		LOG_DEBUG("FreeRTOS: Read first item for list %u at 0x%" PRIx64 ", value 0x%" PRIx32,
 										i, list_of_lists[i] + param->list_next_offset, list_elem_ptr);
 
 		while ((list_thread_count > 0) && (list_elem_ptr != 0) &&
 				(list_elem_ptr != prev_list_elem_ptr) &&
 				(tasks_found < thread_list_size)) {
-			/* Get the location of the thread structure. */
-			retval = target_read_u32(rtos->target,
-					list_elem_ptr + param->list_elem_content_offset,
-					&pointer_casts_are_bad);
+			/* Get the location of the thread structure and the next item. */
+			retval = target_read_buffer(rtos->target, list_elem_ptr + item_first,
+					item_size, item);
 			if (retval != ERROR_OK) {
 				LOG_ERROR("Error reading thread list item object in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
+				goto out_old;
 			}
-			rtos->thread_details[tasks_found].threadid = pointer_casts_are_bad;
+			rtos->thread_details[tasks_found].threadid = target_buffer_get_u32(rtos->target,
+				item + param->list_elem_content_offset - item_first);
+			rtos->thread_details[tasks_found].exists = true;
 			LOG_DEBUG("FreeRTOS: Read Thread ID at 0x%" PRIx32 ", value 0x%" PRIx64,
 										list_elem_ptr + param->list_elem_content_offset,
 										rtos->thread_details[tasks_found].threadid);
 
-			/* get thread name */
-
-			#define FREERTOS_THREAD_NAME_STR_SIZE (200)
-			char tmp_str[FREERTOS_THREAD_NAME_STR_SIZE];
-
-			/* Read the thread name */
-			retval = target_read_buffer(rtos->target,
-					rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-					FREERTOS_THREAD_NAME_STR_SIZE,
-					(uint8_t *)&tmp_str);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
-			tmp_str[FREERTOS_THREAD_NAME_STR_SIZE-1] = '\x00';
-			LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value '%s'",
-										rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-										tmp_str);
-
-			if (tmp_str[0] == '\x00')
-				strcpy(tmp_str, "No Name");
-
-			rtos->thread_details[tasks_found].thread_name_str =
-				malloc(strlen(tmp_str)+1);
-			strcpy(rtos->thread_details[tasks_found].thread_name_str, tmp_str);
-			rtos->thread_details[tasks_found].exists = true;
-
-			if (rtos->thread_details[tasks_found].threadid == rtos->current_thread) {
-				char running_str[] = "State: Running";
-				rtos->thread_details[tasks_found].extra_info_str = malloc(
-						sizeof(running_str));
-				strcpy(rtos->thread_details[tasks_found].extra_info_str,
-					running_str);
-			} else
-				rtos->thread_details[tasks_found].extra_info_str = NULL;
-
 			tasks_found++;
 			list_thread_count--;
 			rtos->thread_count = tasks_found;
 
 			prev_list_elem_ptr = list_elem_ptr;
-			list_elem_ptr = 0;
-			retval = target_read_u32(rtos->target,
-					prev_list_elem_ptr + param->list_elem_next_offset,
-					&list_elem_ptr);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading next thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
+			list_elem_ptr = target_buffer_get_u32(rtos->target,
+				item + param->list_elem_next_offset - item_first);
 			LOG_DEBUG("FreeRTOS: Read next thread location at 0x%" PRIx32 ", value 0x%" PRIx32,
 										prev_list_elem_ptr + param->list_elem_next_offset,
 										list_elem_ptr);
 		}
 	}
 
+	/* every new TCB has to be a task created since the last walk */
+	unsigned int new_threads = 0;
+	for (unsigned int i = first_task; i < tasks_found; i++)
+		if (!freertos_find_thread(old_details, old_count, rtos->thread_details[i].threadid))
+			new_threads++;
+	bool keep_old_names = was_valid && have_task_number &&
+		task_number - old_task_number == new_threads;
+
+	retval = freertos_read_thread_names(rtos, rtos->thread_details, first_task,
+		tasks_found - first_task, old_details, old_count, keep_old_names);
+	if (retval != ERROR_OK)
+		goto out_old;
+
+	for (unsigned int i = first_task; i < tasks_found; i++)
+		if (rtos->thread_details[i].threadid == rtos->current_thread)
+			rtos->thread_details[i].extra_info_str = strdup("State: Running");
+
+	if (first_task == 0) {
+		uint8_t *list_heads = realloc(priv->list_heads, heads_size);
+		if (list_heads) {
+			memcpy(list_heads, heads, heads_size);
+			priv->list_heads = list_heads;
+			priv->list_heads_size = heads_size;
+			priv->task_count = thread_list_size;
+			priv->task_number = task_number;
+			priv->top_used_priority = top_used_priority;
+			priv->threads_valid = true;
+		}
+	}
+
+out_old:
+	if (old_details) {
+		for (int i = 0; i < old_count; i++) {
+			free(old_details[i].thread_name_str);
+			free(old_details[i].extra_info_str);
+		}
+		free(old_details);
+	}
+	if (retval != ERROR_OK)
+		rtos_free_threadlist(rtos);
+out:
+	free(heads);
 	free(list_of_lists);
-	return 0;
+	return retval;
 }
 
 static int freertos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
@@ -401,7 +610,7 @@ static int freertos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 	if (!rtos->rtos_specific_params)
 		return -1;
 
-	param = (const struct freertos_params *) rtos->rtos_specific_params;
+	param = ((const struct freertos_private *)rtos->rtos_specific_params)->params;
 
 	/* Read the stack pointer */
 	uint32_t pointer_casts_are_bad;
@@ -529,14 +738,41 @@ static bool freertos_detect_rtos(struct target *target)
 	return false;
 }
 
+static int freertos_reset_handler(struct target *target, enum target_reset_mode reset_mode, void *priv)
+{
+	struct freertos_private *freertos = priv;
+
+	/* the tasks are created again after the reset */
+	freertos->threads_valid = false;
+
+	return ERROR_OK;
+}
+
 static int freertos_create(struct target *target)
 {
 	for (unsigned int i = 0; i < ARRAY_SIZE(freertos_params_list); i++)
 		if (strcmp(freertos_params_list[i].target_name, target_type_name(target)) == 0) {
-			target->rtos->rtos_specific_params = (void *)&freertos_params_list[i];
+			struct freertos_private *priv = calloc(1, sizeof(*priv));
+			if (!priv) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+			priv->params = &freertos_params_list[i];
+			target->rtos->rtos_specific_params = priv;
+			target_register_reset_callback(freertos_reset_handler, priv);
 			return ERROR_OK;
 		}
 
 	LOG_ERROR("Could not find target in FreeRTOS compatibility list");
 	return ERROR_FAIL;
 }
+
+static void freertos_destroy(struct rtos *rtos)
+{
+	struct freertos_private *priv = rtos->rtos_specific_params;
+
+	target_unregister_reset_callback(freertos_reset_handler, priv);
+	free(priv->list_heads);
+	free(priv);
+	rtos->rtos_specific_params = NULL;
+}
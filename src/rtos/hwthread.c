@@ -266,19 +266,19 @@ static int hwthread_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 		return ERROR_FAIL;
 	}
 
+	register_fetch_list(reg_list, reg_list_size);
+
 	j = 0;
 	for (int i = 0; i < reg_list_size; i++) {
 		if (!reg_list[i] || !reg_list[i]->exist || reg_list[i]->hidden)
 			continue;
-		if (!reg_list[i]->valid) {
-			retval = reg_list[i]->type->get(reg_list[i]);
-			if (retval != ERROR_OK) {
-				LOG_TARGET_ERROR(curr, "Couldn't get register %s",
-					reg_list[i]->name);
-				free(reg_list);
-				free(*rtos_reg_list);
-				return retval;
-			}
+		retval = target_get_reg_snapshot(curr, reg_list[i]);
+		if (retval != ERROR_OK) {
+			LOG_TARGET_ERROR(curr, "Couldn't get register %s",
+				reg_list[i]->name);
+			free(reg_list);
+			free(*rtos_reg_list);
+			return retval;
 		}
 		(*rtos_reg_list)[j].number = reg_list[i]->number;
 		(*rtos_reg_list)[j].size = reg_list[i]->size;
@@ -311,14 +311,14 @@ static int hwthread_get_thread_reg(struct rtos *rtos, int64_t thread_id,
 		return ERROR_FAIL;
 	}
 
-	struct reg *reg = register_get_by_number(curr->reg_cache, reg_num, true);
+	struct reg *reg = target_get_reg_by_number(curr, reg_num, true);
 	if (!reg) {
 		LOG_TARGET_ERROR(curr, "Couldn't find register %" PRIu32 " in thread %" PRId64,
 			reg_num, thread_id);
 		return ERROR_FAIL;
 	}
 
-	if (reg->type->get(reg) != ERROR_OK)
+	if (target_get_reg_snapshot(curr, reg) != ERROR_OK)
 		return ERROR_FAIL;
 
 	rtos_reg->number = reg->number;
@@ -341,7 +341,7 @@ static int hwthread_set_reg(struct rtos *rtos, uint32_t reg_num, uint8_t *reg_va
 	if (!curr)
 		return ERROR_FAIL;
 
-	struct reg *reg = register_get_by_number(curr->reg_cache, reg_num, true);
+	struct reg *reg = target_get_reg_by_number(curr, reg_num, true);
 	if (!reg)
 		return ERROR_FAIL;
 
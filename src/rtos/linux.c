@@ -206,6 +206,8 @@ static int linux_os_thread_reg_list(struct rtos *rtos,
 
 	*reg_list = calloc(*num_regs, sizeof(struct rtos_reg));
 
+	register_fetch_list(gdb_reg_list, *num_regs);
+
 	for (int i = 0; i < *num_regs; ++i) {
 		if (!gdb_reg_list[i]->valid)
 			gdb_reg_list[i]->type->get(gdb_reg_list[i]);
@@ -77,6 +77,8 @@ static void os_free(struct target *target)
 	if (!target->rtos)
 		return;
 
+	if (target->rtos->type->destroy && target->rtos->rtos_specific_params)
+		target->rtos->type->destroy(target->rtos);
 	free(target->rtos->symbols);
 	rtos_free_threadlist(target->rtos);
 	free(target->rtos);
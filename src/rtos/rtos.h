@@ -59,6 +59,8 @@ struct rtos_type {
 	const char *name;
 	bool (*detect_rtos)(struct target *target);
 	int (*create)(struct target *target);
+	/** Release what create() allocated, optional */
+	void (*destroy)(struct rtos *rtos);
 	int (*smp_init)(struct target *target);
 	int (*update_threads)(struct rtos *rtos);
 	/** Return a list of general registers, with their values filled out. */
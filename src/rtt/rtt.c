@@ -19,6 +19,19 @@
 
 #include "rtt.h"
 
+/* Up-channel fill level in percent at which the polling interval is halved */
+#define RTT_FILL_HIGH	25
+
+/* Last control block address found for a target and an ID */
+struct rtt_cb_cache_entry {
+	struct target *target;
+	char id[RTT_CB_MAX_ID_LENGTH];
+	target_addr_t address;
+	struct list_head lh;
+};
+
+static OOCD_LIST_HEAD(rtt_cb_cache);
+
 static struct {
 	struct rtt_source source;
 	/** Control block. */
@@ -43,6 +56,10 @@ static struct {
 	size_t sink_list_length;
 
 	unsigned int polling_interval;
+	/** Minimum polling interval of the adaptive polling. */
+	unsigned int polling_interval_min;
+	/** Polling interval the read callback is registered with. */
+	unsigned int polling_interval_current;
 } rtt;
 
 int rtt_init(void)
@@ -58,23 +75,71 @@ int rtt_init(void)
 	rtt.started = false;
 
 	rtt.polling_interval = 100;
+	rtt.polling_interval_min = rtt.polling_interval;
+	rtt.polling_interval_current = rtt.polling_interval;
 
 	return ERROR_OK;
 }
 
 int rtt_exit(void)
 {
+	struct rtt_cb_cache_entry *entry, *tmp;
+
+	list_for_each_entry_safe(entry, tmp, &rtt_cb_cache, lh) {
+		list_del(&entry->lh);
+		free(entry);
+	}
+
 	free(rtt.sink_list);
 
 	return ERROR_OK;
 }
 
+static int read_channel_callback(void *user_data);
+
+static void schedule_read_channel_callback(unsigned int interval)
+{
+	if (rtt.started && interval != rtt.polling_interval_current) {
+		target_unregister_timer_callback(&read_channel_callback, NULL);
+		target_register_timer_callback(&read_channel_callback, interval, 1,
+			NULL);
+	}
+
+	rtt.polling_interval_current = interval;
+}
+
+/*
+ * Shorten the polling interval while the up-channels are filling, so that
+ * the target buffers do not overflow, and extend it while they are idle.
+ */
+static void adapt_polling_interval(const struct rtt_poll_status *status)
+{
+	unsigned int interval = rtt.polling_interval_current;
+
+	if (rtt.polling_interval_min >= rtt.polling_interval)
+		return;
+
+	if (status->max_fill >= RTT_FILL_HIGH)
+		interval /= 2;
+	else if (!status->bytes)
+		interval *= 2;
+
+	interval = MAX(interval, rtt.polling_interval_min);
+	interval = MIN(interval, rtt.polling_interval);
+
+	if (interval != rtt.polling_interval_current)
+		LOG_DEBUG("rtt: Polling interval %u ms", interval);
+
+	schedule_read_channel_callback(interval);
+}
+
 static int read_channel_callback(void *user_data)
 {
 	int ret;
+	struct rtt_poll_status status = { 0 };
 
 	ret = rtt.source.read(rtt.target, &rtt.ctrl, rtt.sink_list,
-		rtt.sink_list_length, NULL);
+		rtt.sink_list_length, &status, NULL);
 
 	if (ret != ERROR_OK) {
 		target_unregister_timer_callback(&read_channel_callback, NULL);
@@ -82,6 +147,8 @@ static int read_channel_callback(void *user_data)
 		return ret;
 	}
 
+	adapt_polling_interval(&status);
+
 	return ERROR_OK;
 }
 
@@ -121,6 +188,50 @@ int rtt_register_source(const struct rtt_source source,
 	return ERROR_OK;
 }
 
+static struct rtt_cb_cache_entry *find_cached_control_block(void)
+{
+	struct rtt_cb_cache_entry *entry;
+
+	list_for_each_entry(entry, &rtt_cb_cache, lh) {
+		if (entry->target == rtt.target && !strcmp(entry->id, rtt.id))
+			return entry;
+	}
+
+	return NULL;
+}
+
+static void cache_control_block(target_addr_t address)
+{
+	struct rtt_cb_cache_entry *entry = find_cached_control_block();
+
+	if (!entry) {
+		entry = calloc(1, sizeof(*entry));
+
+		if (!entry)
+			return;
+
+		entry->target = rtt.target;
+		strcpy(entry->id, rtt.id);
+		list_add(&entry->lh, &rtt_cb_cache);
+	}
+
+	entry->address = address;
+}
+
+/* Check that the control block with the configured ID is at the address */
+static bool verify_control_block(target_addr_t address)
+{
+	struct rtt_control ctrl;
+
+	if (address < rtt.addr || address - rtt.addr >= rtt.size)
+		return false;
+
+	if (rtt.source.read_cb(rtt.target, address, &ctrl, NULL) != ERROR_OK)
+		return false;
+
+	return !strncmp(ctrl.id, rtt.id, strlen(rtt.id));
+}
+
 int rtt_start(void)
 {
 	int ret;
@@ -129,9 +240,20 @@ int rtt_start(void)
 	if (rtt.started)
 		return ERROR_OK;
 
+	/* The control block could have moved, e.g. with a new firmware */
+	if (rtt.found_cb && !rtt.changed && !verify_control_block(rtt.ctrl.address))
+		rtt.found_cb = false;
+
 	if (!rtt.found_cb || rtt.changed) {
-		rtt.source.find_cb(rtt.target, &addr, rtt.size, rtt.id,
-			&rtt.found_cb, NULL);
+		const struct rtt_cb_cache_entry *cached = find_cached_control_block();
+
+		if (cached && verify_control_block(cached->address)) {
+			addr = cached->address;
+			rtt.found_cb = true;
+		} else {
+			rtt.source.find_cb(rtt.target, &addr, rtt.size, rtt.id,
+				&rtt.found_cb, NULL);
+		}
 
 		rtt.changed = false;
 
@@ -139,6 +261,7 @@ int rtt_start(void)
 			LOG_INFO("rtt: Control block found at 0x%" TARGET_PRIxADDR,
 				addr);
 			rtt.ctrl.address = addr;
+			cache_control_block(addr);
 		} else {
 			LOG_ERROR("rtt: No control block found");
 			return ERROR_FAIL;
@@ -155,8 +278,9 @@ int rtt_start(void)
 	if (ret != ERROR_OK)
 		return ret;
 
+	rtt.polling_interval_current = rtt.polling_interval;
 	target_register_timer_callback(&read_channel_callback,
-		rtt.polling_interval, 1, NULL);
+		rtt.polling_interval_current, 1, NULL);
 	rtt.started = true;
 
 	return ERROR_OK;
@@ -204,7 +328,7 @@ static int adjust_sink_list(size_t length)
 }
 
 int rtt_register_sink(unsigned int channel_index, rtt_sink_read read,
-		void *user_data)
+		rtt_sink_space space, void *user_data)
 {
 	struct rtt_sink_list *tmp;
 
@@ -221,6 +345,7 @@ int rtt_register_sink(unsigned int channel_index, rtt_sink_read read,
 		return ERROR_FAIL;
 
 	tmp->read = read;
+	tmp->space = space;
 	tmp->user_data = user_data;
 	tmp->next = rtt.sink_list[channel_index];
 
@@ -274,17 +399,48 @@ int rtt_set_polling_interval(unsigned int interval)
 	if (!interval)
 		return ERROR_FAIL;
 
-	if (rtt.polling_interval != interval) {
-		target_unregister_timer_callback(&read_channel_callback, NULL);
-		target_register_timer_callback(&read_channel_callback, interval, 1,
-			NULL);
-	}
-
 	rtt.polling_interval = interval;
+	rtt.polling_interval_min = interval;
+	schedule_read_channel_callback(interval);
 
 	return ERROR_OK;
 }
 
+int rtt_get_adaptive_polling(unsigned int *min_interval,
+		unsigned int *current_interval)
+{
+	if (!min_interval || !current_interval)
+		return ERROR_FAIL;
+
+	*min_interval = rtt.polling_interval_min;
+	*current_interval = rtt.polling_interval_current;
+
+	return ERROR_OK;
+}
+
+int rtt_set_adaptive_polling(unsigned int min_interval)
+{
+	if (!min_interval || min_interval > rtt.polling_interval)
+		return ERROR_FAIL;
+
+	rtt.polling_interval_min = min_interval;
+
+	return ERROR_OK;
+}
+
+size_t rtt_sink_list_space(unsigned int channel_index,
+		const struct rtt_sink_list *sinks)
+{
+	size_t space = SIZE_MAX;
+
+	for (const struct rtt_sink_list *sink = sinks; sink; sink = sink->next) {
+		if (sink->space)
+			space = MIN(space, sink->space(channel_index, sink->user_data));
+	}
+
+	return space;
+}
+
 int rtt_write_channel(unsigned int channel_index, const uint8_t *buffer,
 		size_t *length)
 {
@@ -80,8 +80,17 @@ struct rtt_channel_info {
 typedef int (*rtt_sink_read)(unsigned int channel, const uint8_t *buffer,
 		size_t length, void *user_data);
 
+/**
+ * Get the number of bytes a sink can take without loss or blocking. Data
+ * of a channel is left in the target buffer while one of its sinks is
+ * congested.
+ */
+typedef size_t (*rtt_sink_space)(unsigned int channel, void *user_data);
+
 struct rtt_sink_list {
 	rtt_sink_read read;
+	/** Optional, a sink without it takes any amount of data. */
+	rtt_sink_space space;
 	void *user_data;
 
 	struct rtt_sink_list *next;
@@ -95,6 +104,14 @@ enum rtt_channel_type {
 	RTT_CHANNEL_TYPE_DOWN
 };
 
+/** Result of a read of the up-channels, used to adapt the polling interval. */
+struct rtt_poll_status {
+	/** Number of bytes read from all up-channels. */
+	size_t bytes;
+	/** Highest fill level of an up-channel buffer, in percent. */
+	unsigned int max_fill;
+};
+
 /** RTT source. */
 struct rtt_source {
 	int (*find_cb)(struct target *target,
@@ -112,7 +129,8 @@ struct rtt_source {
 	int (*stop)(struct target *target, void *user_data);
 	int (*read)(struct target *target,
 		const struct rtt_control *ctrl, struct rtt_sink_list **sinks,
-		size_t num_channels, void *user_data);
+		size_t num_channels, struct rtt_poll_status *status,
+		void *user_data);
 	int (*write)(struct target *target,
 		struct rtt_control *ctrl, unsigned int channel,
 		const uint8_t *buffer, size_t *length, void *user_data);
@@ -186,6 +204,42 @@ int rtt_get_polling_interval(unsigned int *interval);
  */
 int rtt_set_polling_interval(unsigned int interval);
 
+/**
+ * Get the parameters of the adaptive polling.
+ *
+ * @param[out] min_interval Minimum polling interval in milliseconds, equal to
+ *                          the polling interval if adaptive polling is off.
+ * @param[out] current_interval Polling interval currently used.
+ *
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_get_adaptive_polling(unsigned int *min_interval,
+		unsigned int *current_interval);
+
+/**
+ * Set the minimum polling interval. The polling interval is shortened down
+ * to it while up-channels are filling, and is extended up to the polling
+ * interval while they are idle.
+ *
+ * @param[in] min_interval Minimum polling interval in milliseconds, the
+ *                         polling interval disables adaptive polling.
+ *
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_set_adaptive_polling(unsigned int min_interval);
+
+/**
+ * Get the number of bytes all sinks of a channel can take.
+ *
+ * @param[in] channel_index Channel index.
+ * @param[in] sinks Sinks of the channel.
+ *
+ * @returns The space of the most congested sink, SIZE_MAX if none of the
+ *          sinks reports its space.
+ */
+size_t rtt_sink_list_space(unsigned int channel_index,
+		const struct rtt_sink_list *sinks);
+
 /**
  * Get whether RTT is configured.
  *
@@ -224,12 +278,13 @@ int rtt_read_channel_info(unsigned int channel_index,
  *
  * @param[in] channel_index Channel index.
  * @param[in] read Read callback function.
+ * @param[in] space Optional callback function to get the available space.
  * @param[in,out] user_data User data to be passed to the callback function.
  *
  * @returns ERROR_OK on success, an error code on failure.
  */
 int rtt_register_sink(unsigned int channel_index, rtt_sink_read read,
-		void *user_data);
+		rtt_sink_space space, void *user_data);
 
 /**
  * Unregister an RTT sink.
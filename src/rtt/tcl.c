@@ -9,25 +9,20 @@
 #endif
 
 #include <helper/log.h>
+#include <target/image.h>
 #include <target/rtt.h>
 
 #include "rtt.h"
 
 #define CHANNEL_NAME_SIZE	128
 
-COMMAND_HANDLER(handle_rtt_setup_command)
+#define DEFAULT_ID		"SEGGER RTT"
+#define DEFAULT_SYMBOL	"_SEGGER_RTT"
+
+static void register_target_source(struct target *target)
 {
 	struct rtt_source source;
 
-	const char *DEFAULT_ID = "SEGGER RTT";
-	const char *selected_id;
-	if (CMD_ARGC < 2 || CMD_ARGC > 3)
-		return ERROR_COMMAND_SYNTAX_ERROR;
-	if (CMD_ARGC == 2)
-		selected_id = DEFAULT_ID;
-	else
-		selected_id = CMD_ARGV[2];
-
 	source.find_cb = &target_rtt_find_control_block;
 	source.read_cb = &target_rtt_read_control_block;
 	source.start = &target_rtt_start;
@@ -36,13 +31,26 @@ COMMAND_HANDLER(handle_rtt_setup_command)
 	source.write = &target_rtt_write_callback;
 	source.read_channel_info = &target_rtt_read_channel_info;
 
+	rtt_register_source(source, target);
+}
+
+COMMAND_HANDLER(handle_rtt_setup_command)
+{
+	const char *selected_id;
+	if (CMD_ARGC < 2 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 2)
+		selected_id = DEFAULT_ID;
+	else
+		selected_id = CMD_ARGV[2];
+
 	target_addr_t address;
 	uint32_t size;
 
 	COMMAND_PARSE_NUMBER(target_addr, CMD_ARGV[0], address);
 	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
 
-	rtt_register_source(source, get_current_target(CMD_CTX));
+	register_target_source(get_current_target(CMD_CTX));
 
 	if (rtt_setup(address, size, selected_id) != ERROR_OK)
 		return ERROR_FAIL;
@@ -50,6 +58,40 @@ COMMAND_HANDLER(handle_rtt_setup_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_rtt_setup_elf_command)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	const char *selected_id = CMD_ARGC >= 2 ? CMD_ARGV[1] : DEFAULT_ID;
+	const char *symbol = CMD_ARGC >= 3 ? CMD_ARGV[2] : DEFAULT_SYMBOL;
+
+	struct image image;
+	target_addr_t address;
+
+	int ret = image_open(&image, CMD_ARGV[0], "elf");
+	if (ret != ERROR_OK)
+		return ret;
+
+	ret = image_find_symbol(&image, symbol, &address);
+	image_close(&image);
+
+	if (ret != ERROR_OK) {
+		command_print(CMD, "rtt: Symbol '%s' not found in %s", symbol, CMD_ARGV[0]);
+		return ERROR_FAIL;
+	}
+
+	LOG_DEBUG("rtt: Symbol '%s' at 0x%" TARGET_PRIxADDR, symbol, address);
+
+	register_target_source(get_current_target(CMD_CTX));
+
+	/* the search area is the control block */
+	if (rtt_setup(address, RTT_CB_SIZE, selected_id) != ERROR_OK)
+		return ERROR_FAIL;
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_rtt_start_command)
 {
 	if (CMD_ARGC > 0)
@@ -75,27 +117,55 @@ COMMAND_HANDLER(handle_rtt_polling_interval_command)
 {
 	if (CMD_ARGC == 0) {
 		int ret;
-		unsigned int interval;
+		unsigned int interval, min_interval, current_interval;
 
 		ret = rtt_get_polling_interval(&interval);
 
+		if (ret == ERROR_OK)
+			ret = rtt_get_adaptive_polling(&min_interval, &current_interval);
+
 		if (ret != ERROR_OK) {
 			command_print(CMD, "Failed to get polling interval");
 			return ret;
 		}
 
-		command_print(CMD, "%u ms", interval);
-	} else if (CMD_ARGC == 1) {
+		if (min_interval < interval)
+			command_print(CMD, "%u ms, adaptive from %u ms, currently %u ms",
+				interval, min_interval, current_interval);
+		else
+			command_print(CMD, "%u ms", interval);
+	} else if (CMD_ARGC <= 2) {
 		int ret;
 		unsigned int interval;
+		unsigned int min_interval;
 
 		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], interval);
+
+		if (CMD_ARGC == 2) {
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], min_interval);
+
+			/* check before any change */
+			if (!min_interval || min_interval > interval) {
+				command_print(CMD, "Invalid minimum polling interval");
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+		}
+
 		ret = rtt_set_polling_interval(interval);
 
 		if (ret != ERROR_OK) {
 			command_print(CMD, "Failed to set polling interval");
 			return ret;
 		}
+
+		if (CMD_ARGC == 2) {
+			ret = rtt_set_adaptive_polling(min_interval);
+
+			if (ret != ERROR_OK) {
+				command_print(CMD, "Invalid minimum polling interval");
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+		}
 	} else {
 		return ERROR_COMMAND_SYNTAX_ERROR;
 	}
@@ -226,6 +296,14 @@ static const struct command_registration rtt_subcommand_handlers[] = {
 		.help = "setup RTT",
 		.usage = "<address> <size> [ID]"
 	},
+	{
+		.name = "setup_elf",
+		.handler = handle_rtt_setup_elf_command,
+		.mode = COMMAND_ANY,
+		.help = "setup RTT with the control block address from the "
+			"symbol table of an ELF file",
+		.usage = "<elf_file> [ID [symbol]]"
+	},
 	{
 		.name = "start",
 		.handler = handle_rtt_start_command,
@@ -244,8 +322,9 @@ static const struct command_registration rtt_subcommand_handlers[] = {
 		.name = "polling_interval",
 		.handler = handle_rtt_polling_interval_command,
 		.mode = COMMAND_EXEC,
-		.help = "show or set polling interval in ms",
-		.usage = "[interval]"
+		.help = "show or set polling interval in ms, with a minimum "
+			"interval the polling adapts to the traffic",
+		.usage = "[interval [min_interval]]"
 	},
 	{
 		.name = "channels",
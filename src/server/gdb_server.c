@@ -1246,10 +1246,7 @@ static void gdb_target_to_reg(struct target *target,
 /* get register value if needed and fill the buffer accordingly */
 static int gdb_get_reg_value_as_str(struct target *target, char *tstr, struct reg *reg)
 {
-	int retval = ERROR_OK;
-
-	if (!reg->valid)
-		retval = reg->type->get(reg);
+	int retval = target_get_reg_snapshot(target, reg);
 
 	const unsigned int len = DIV_ROUND_UP(reg->size, 8) * 2;
 	switch (retval) {
@@ -1304,6 +1301,9 @@ static int gdb_get_registers_packet(struct connection *connection,
 
 	reg_packet_p = reg_packet;
 
+	/* the registers not read in batch are read one by one below */
+	register_fetch_list(reg_list, reg_list_size);
+
 	for (i = 0; i < reg_list_size; i++) {
 		if (!reg_list[i] || !reg_list[i]->exist || reg_list[i]->hidden)
 			continue;
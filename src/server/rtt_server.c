@@ -21,8 +21,15 @@
  *
  * This server allows access to Real Time Transfer (RTT) channels via TCP
  * connections.
+ *
+ * Data the socket does not accept right away is kept in a backlog of
+ * limited size. While the backlog is not empty the connection reports no
+ * space to RTT, which leaves the data in the target buffer.
  */
 
+/* Maximum amount of data kept for a slow client */
+#define RTT_SERVER_BACKLOG_SIZE	(64 * 1024)
+
 struct rtt_service {
 	unsigned int channel;
 	char *hello_message;
@@ -32,32 +39,101 @@ struct rtt_connection_data {
 	unsigned char buffer[64];
 	unsigned int length;
 	unsigned int offset;
+
+	/* data not yet accepted by the socket */
+	uint8_t *backlog;
+	size_t backlog_length;
 };
 
+/* Write as much as the socket accepts, the amount written is returned in *written */
+static int write_nonblocking(struct connection *connection, const uint8_t *buffer,
+		size_t length, size_t *written)
+{
+	*written = 0;
+
+	while (*written < length) {
+		int ret = connection_write(connection, buffer + *written, length - *written);
+
+		if (ret < 0) {
+#ifdef _WIN32
+			bool retry = (WSAGetLastError() == WSAEWOULDBLOCK);
+#else
+			bool retry = (errno == EAGAIN);
+#endif
+			if (retry)
+				return ERROR_OK;
+
+			LOG_ERROR("Failed to write data to socket.");
+			return ERROR_FAIL;
+		}
+
+		*written += ret;
+	}
+
+	return ERROR_OK;
+}
+
+static int flush_backlog(struct connection *connection)
+{
+	struct rtt_connection_data *data = connection->priv;
+	size_t written;
+
+	if (!data->backlog_length)
+		return ERROR_OK;
+
+	int ret = write_nonblocking(connection, data->backlog, data->backlog_length,
+		&written);
+
+	data->backlog_length -= written;
+	memmove(data->backlog, data->backlog + written, data->backlog_length);
+
+	return ret;
+}
+
 static int read_callback(unsigned int channel, const uint8_t *buffer,
 		size_t length, void *user_data)
 {
 	int ret;
 	struct connection *connection;
-	size_t offset;
+	struct rtt_connection_data *data;
+	size_t written = 0;
 
 	connection = (struct connection *)user_data;
-	offset = 0;
+	data = connection->priv;
 
-	while (offset < length) {
-		ret = connection_write(connection, buffer + offset, length - offset);
+	ret = flush_backlog(connection);
 
-		if (ret < 0) {
-			LOG_ERROR("Failed to write data to socket.");
-			return ERROR_FAIL;
-		}
+	if (ret == ERROR_OK && !data->backlog_length)
+		ret = write_nonblocking(connection, buffer, length, &written);
+
+	if (ret != ERROR_OK)
+		return ret;
+
+	length -= written;
 
-		offset += ret;
+	if (length > RTT_SERVER_BACKLOG_SIZE - data->backlog_length) {
+		LOG_WARNING("rtt: Client of channel %u too slow, %zu bytes dropped",
+			channel, length);
+		return ERROR_OK;
 	}
 
+	memcpy(data->backlog + data->backlog_length, buffer + written, length);
+	data->backlog_length += length;
+
 	return ERROR_OK;
 }
 
+static size_t space_callback(unsigned int channel, void *user_data)
+{
+	struct connection *connection = user_data;
+	struct rtt_connection_data *data = connection->priv;
+
+	if (flush_backlog(connection) != ERROR_OK || data->backlog_length)
+		return 0;
+
+	return RTT_SERVER_BACKLOG_SIZE;
+}
+
 static int rtt_new_connection(struct connection *connection)
 {
 	int ret;
@@ -71,12 +147,21 @@ static int rtt_new_connection(struct connection *connection)
 		return ERROR_FAIL;
 	}
 
+	data->backlog = malloc(RTT_SERVER_BACKLOG_SIZE);
+
+	if (!data->backlog) {
+		LOG_ERROR("Out of memory");
+		free(data);
+		return ERROR_FAIL;
+	}
+
 	connection->priv = data;
 	service = connection->service->priv;
 
 	LOG_DEBUG("rtt: New connection for channel %u", service->channel);
 
-	ret = rtt_register_sink(service->channel, &read_callback, connection);
+	ret = rtt_register_sink(service->channel, &read_callback, &space_callback,
+		connection);
 
 	if (ret != ERROR_OK)
 		return ret;
@@ -94,7 +179,9 @@ static int rtt_connection_closed(struct connection *connection)
 	service = (struct rtt_service *)connection->service->priv;
 	rtt_unregister_sink(service->channel, &read_callback, connection);
 
-	free(connection->priv);
+	struct rtt_connection_data *data = connection->priv;
+	free(data->backlog);
+	free(data);
 
 	LOG_DEBUG("rtt: Connection for channel %u closed", service->channel);
 	return ERROR_OK;
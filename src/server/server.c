@@ -432,7 +432,7 @@ int server_loop(struct command_context *command_context)
 	/* used in accept() */
 	int retval;
 
-	int64_t next_event = timeval_ms() + polling_period;
+	int64_t next_event = monotonic_us() + polling_period * 1000LL;
 
 #ifndef _WIN32
 	if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
@@ -475,12 +475,13 @@ int server_loop(struct command_context *command_context)
 			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
 		} else {
 			/* Timeout socket_select() when a target timer expires or every polling_period */
-			int timeout_ms = next_event - timeval_ms();
-			if (timeout_ms < 0)
-				timeout_ms = 0;
-			else if (timeout_ms > polling_period)
-				timeout_ms = polling_period;
-			tv.tv_usec = timeout_ms * 1000;
+			int64_t timeout_us = next_event - monotonic_us();
+			if (timeout_us < 0)
+				timeout_us = 0;
+			else if (timeout_us > polling_period * 1000LL)
+				timeout_us = polling_period * 1000LL;
+			tv.tv_sec = timeout_us / 1000000;
+			tv.tv_usec = timeout_us % 1000000;
 			/* Only while we're sleeping we'll let others run */
 			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
 		}
@@ -583,6 +584,9 @@ int server_loop(struct command_context *command_context)
 			}
 		}
 
+		/* write out deferred log messages */
+		log_flush();
+
 #ifdef _WIN32
 		MSG msg;
 		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
@@ -34,13 +34,18 @@ enum halt_mode {
 	HALT_SYNC,
 };
 
+/* words moved per queue run by the memory-access mode transfers */
+#define AARCH64_MA_BLOCK_WORDS	8192
+
 struct aarch64_private_config {
 	struct adiv5_private_config adiv5_config;
 	struct arm_cti *cti;
 };
 
 static int aarch64_poll(struct target *target);
+static int aarch64_poll_prsr(struct target *target, uint32_t prsr, const uint32_t *entry_dscr);
 static int aarch64_debug_entry(struct target *target);
+static int aarch64_debug_entry_dscr(struct target *target, uint32_t dscr);
 static int aarch64_restore_context(struct target *target, bool bpwp);
 static int aarch64_set_breakpoint(struct target *target,
 	struct breakpoint *breakpoint, uint8_t matchmode);
@@ -127,6 +132,7 @@ static int aarch64_mmu_modify(struct target *target, int enable)
 	int retval = ERROR_OK;
 	enum arm_mode target_mode = ARM_MODE_ANY;
 	uint32_t instr = 0;
+	uint64_t sctlr = aarch64->system_control_reg_curr;
 
 	if (enable) {
 		/*	if mmu enabled at target stop and mmu not enable */
@@ -134,21 +140,25 @@ static int aarch64_mmu_modify(struct target *target, int enable)
 			LOG_ERROR("trying to enable mmu on target stopped with mmu disable");
 			return ERROR_FAIL;
 		}
-		if (!(aarch64->system_control_reg_curr & 0x1U))
-			aarch64->system_control_reg_curr |= 0x1U;
+		if (!(sctlr & 0x1U))
+			sctlr |= 0x1U;
 	} else {
-		if (aarch64->system_control_reg_curr & 0x4U) {
+		if (sctlr & 0x4U) {
 			/*  data cache is active */
-			aarch64->system_control_reg_curr &= ~0x4U;
+			sctlr &= ~0x4U;
 			/* flush data cache armv8 function to be called */
 			if (armv8->armv8_mmu.armv8_cache.flush_all_data_cache)
 				armv8->armv8_mmu.armv8_cache.flush_all_data_cache(target);
 		}
-		if ((aarch64->system_control_reg_curr & 0x1U)) {
-			aarch64->system_control_reg_curr &= ~0x1U;
+		if ((sctlr & 0x1U)) {
+			sctlr &= ~0x1U;
 		}
 	}
 
+	/* already in the requested state, e.g. for consecutive memory accesses */
+	if (sctlr == aarch64->system_control_reg_curr)
+		return ERROR_OK;
+
 	switch (armv8->arm.core_mode) {
 	case ARMV8_64_EL0T:
 		target_mode = ARMV8_64_EL1H;
@@ -184,8 +194,10 @@ static int aarch64_mmu_modify(struct target *target, int enable)
 	if (target_mode != ARM_MODE_ANY)
 		armv8_dpm_modeswitch(&armv8->dpm, target_mode);
 
-	retval = armv8->dpm.instr_write_data_r0_64(&armv8->dpm, instr,
-				aarch64->system_control_reg_curr);
+	retval = armv8->dpm.instr_write_data_r0_64(&armv8->dpm, instr, sctlr);
+	/* a failed write leaves the core as it was */
+	if (retval == ERROR_OK)
+		aarch64->system_control_reg_curr = sctlr;
 
 	if (target_mode != ARM_MODE_ANY)
 		armv8_dpm_modeswitch(&armv8->dpm, ARM_MODE_ANY);
@@ -332,40 +344,184 @@ static int aarch64_wait_halt_one(struct target *target)
 	return retval;
 }
 
-static int aarch64_prepare_halt_smp(struct target *target, bool exc_target, struct target **p_first)
+/*
+ * SMP group run control
+ *
+ * The registers of all the PEs of the group are accessed in passes: the
+ * accesses of a pass are queued for every PE, then the queues of the DAPs
+ * are run once, instead of one round trip per access and per PE.
+ */
+struct aarch64_smp_pe {
+	struct target *target;
+	uint32_t prsr;
+	uint32_t dscr;
+	uint32_t gate;
+	uint32_t trout;
+	bool done;
+};
+
+/* The examined PEs of the group, but the excluded one, in a state accepted by filter */
+static struct aarch64_smp_pe *aarch64_smp_list(struct target *target, struct target *excluded,
+		bool (*filter)(struct target *target), unsigned int *p_count)
 {
-	int retval = ERROR_OK;
 	struct target_list *head;
-	struct target *first = NULL;
+	unsigned int count = 0;
 
-	LOG_DEBUG("target %s exc %i", target_name(target), exc_target);
+	foreach_smp_target(head, target->smp_targets)
+		count++;
+
+	struct aarch64_smp_pe *pes = calloc(count ? count : 1, sizeof(*pes));
+	if (!pes) {
+		LOG_ERROR("Out of memory");
+		return NULL;
+	}
 
+	count = 0;
 	foreach_smp_target(head, target->smp_targets) {
 		struct target *curr = head->target;
-		struct armv8_common *armv8 = target_to_armv8(curr);
 
-		if (exc_target && curr == target)
+		if (curr == excluded || !target_was_examined(curr))
 			continue;
-		if (!target_was_examined(curr))
+		if (filter && !filter(curr))
 			continue;
-		if (curr->state != TARGET_RUNNING)
+		pes[count++].target = curr;
+	}
+
+	*p_count = count;
+	return pes;
+}
+
+static bool aarch64_smp_is_running(struct target *target)
+{
+	return target->state == TARGET_RUNNING;
+}
+
+static bool aarch64_smp_is_halted(struct target *target)
+{
+	return target->state == TARGET_HALTED;
+}
+
+/* Run the queued accesses, once per DAP of the debug and CTI APs */
+static int aarch64_smp_run(struct aarch64_smp_pe *pes, unsigned int count)
+{
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < 2 * count; i++) {
+		struct armv8_common *armv8 = target_to_armv8(pes[i / 2].target);
+		struct adiv5_dap *dap = (i & 1) ? arm_cti_dap(armv8->cti) : armv8->debug_ap->dap;
+		bool seen = false;
+
+		for (unsigned int j = 0; j < i && !seen; j++) {
+			struct armv8_common *other = target_to_armv8(pes[j / 2].target);
+			seen = dap == ((j & 1) ? arm_cti_dap(other->cti) : other->debug_ap->dap);
+		}
+		if (seen)
 			continue;
 
+		int retval2 = dap_run(dap);
+		if (retval == ERROR_OK)
+			retval = retval2;
+	}
+
+	return retval;
+}
+
+/* Read PRSR of the PEs, clearing its sticky bits */
+static int aarch64_smp_read_prsr(struct aarch64_smp_pe *pes, unsigned int count)
+{
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < count && retval == ERROR_OK; i++) {
+		struct armv8_common *armv8 = target_to_armv8(pes[i].target);
+
+		retval = mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_PRSR, &pes[i].prsr);
+	}
+
+	int retval2 = aarch64_smp_run(pes, count);
+	if (retval == ERROR_OK)
+		retval = retval2;
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < count; i++)
+		target_to_armv8(pes[i].target)->sticky_reset |= pes[i].prsr & PRSR_SR;
+
+	return ERROR_OK;
+}
+
+/*
+ * Acknowledge the CTI halt event of the PEs, queued before the caller runs
+ * the queues. The output trigger is read back and checked by
+ * aarch64_smp_check_ack().
+ */
+static int aarch64_smp_queue_ack(struct aarch64_smp_pe *pe)
+{
+	struct armv8_common *armv8 = target_to_armv8(pe->target);
+
+	int retval = arm_cti_queue_write_reg(armv8->cti, CTI_INACK, CTI_TRIG(HALT));
+	if (retval == ERROR_OK)
+		retval = arm_cti_queue_read_reg(armv8->cti, CTI_TROUT_STATUS, &pe->trout);
+	return retval;
+}
+
+static int aarch64_smp_check_ack(struct aarch64_smp_pe *pe)
+{
+	/* still asserted, wait for it */
+	if (pe->trout & CTI_TRIG(HALT))
+		return arm_cti_ack_events(target_to_armv8(pe->target)->cti, CTI_TRIG(HALT));
+	return ERROR_OK;
+}
+
+static int aarch64_prepare_halt_smp(struct target *target, bool exc_target, struct target **p_first)
+{
+	int retval = ERROR_OK;
+	struct target *first = NULL;
+	unsigned int count;
+
+	LOG_DEBUG("target %s exc %i", target_name(target), exc_target);
+
+	struct aarch64_smp_pe *pes = aarch64_smp_list(target, exc_target ? target : NULL,
+			aarch64_smp_is_running, &count);
+	if (!pes)
+		return ERROR_FAIL;
+
+	/* read DSCR and the CTI gate of all the PEs ... */
+	for (unsigned int i = 0; i < count && retval == ERROR_OK; i++) {
+		struct armv8_common *armv8 = target_to_armv8(pes[i].target);
+
+		retval = mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DSCR, &pes[i].dscr);
+		if (retval == ERROR_OK)
+			retval = arm_cti_queue_read_reg(armv8->cti, CTI_GATE, &pes[i].gate);
+	}
+	int retval2 = aarch64_smp_run(pes, count);
+	if (retval == ERROR_OK)
+		retval = retval2;
+
+	/* ... then allow halting debug and open the gate of channel 0 in one pass */
+	for (unsigned int i = 0; i < count && retval == ERROR_OK; i++) {
+		struct target *curr = pes[i].target;
+		struct armv8_common *armv8 = target_to_armv8(curr);
+
 		/* HACK: mark this target as prepared for halting */
 		curr->debug_reason = DBG_REASON_DBGRQ;
 
 		/* open the gate for channel 0 to let HALT requests pass to the CTM */
-		retval = arm_cti_ungate_channel(armv8->cti, 0);
+		retval = arm_cti_queue_write_reg(armv8->cti, CTI_GATE, pes[i].gate | CTI_CHNL(0));
 		if (retval == ERROR_OK)
-			retval = aarch64_set_dscr_bits(curr, DSCR_HDE, DSCR_HDE);
-		if (retval != ERROR_OK)
-			break;
+			retval = mem_ap_write_u32(armv8->debug_ap,
+					armv8->debug_base + CPUV8_DBG_DSCR, pes[i].dscr | DSCR_HDE);
 
 		LOG_DEBUG("target %s prepared", target_name(curr));
 
 		if (!first)
 			first = curr;
 	}
+	if (retval == ERROR_OK)
+		retval = aarch64_smp_run(pes, count);
+
+	free(pes);
 
 	if (p_first) {
 		if (exc_target && first)
@@ -424,30 +580,26 @@ static int aarch64_halt_smp(struct target *target, bool exc_target)
 	if (retval != ERROR_OK)
 		return retval;
 
-	/* wait for all PEs to halt */
+	unsigned int count;
+	struct aarch64_smp_pe *pes = aarch64_smp_list(target, NULL, NULL, &count);
+	if (!pes)
+		return ERROR_FAIL;
+
+	/* wait for all PEs to halt, reading their status in one pass */
 	int64_t then = timeval_ms();
 	for (;;) {
-		bool all_halted = true;
-		struct target_list *head;
-		struct target *curr;
-
-		foreach_smp_target(head, target->smp_targets) {
-			int halted;
+		struct target *curr = NULL;
 
-			curr = head->target;
-
-			if (!target_was_examined(curr))
-				continue;
-
-			retval = aarch64_check_state_one(curr, PRSR_HALT, PRSR_HALT, &halted, NULL);
-			if (retval != ERROR_OK || !halted) {
-				all_halted = false;
-				break;
-			}
-		}
+		if (aarch64_smp_read_prsr(pes, count) != ERROR_OK)
+			curr = count ? pes[0].target : target;
+		for (unsigned int i = 0; i < count && !curr; i++)
+			if (!(pes[i].prsr & PRSR_HALT))
+				curr = pes[i].target;
 
-		if (all_halted)
+		if (!curr) {
+			retval = ERROR_OK;
 			break;
+		}
 
 		if (timeval_ms() > then + 1000) {
 			retval = ERROR_TARGET_TIMEOUT;
@@ -466,6 +618,7 @@ static int aarch64_halt_smp(struct target *target, bool exc_target)
 			break;
 	}
 
+	free(pes);
 	return retval;
 }
 
@@ -480,29 +633,63 @@ static int update_halt_gdb(struct target *target, enum target_debug_reason debug
 		aarch64_halt_smp(target, true);
 	}
 
-	/* poll all targets in the group, but skip the target that serves GDB */
+	/* remember the gdb_service->target */
 	foreach_smp_target(head, target->smp_targets) {
 		curr = head->target;
-		/* skip calling context */
-		if (curr == target)
-			continue;
-		if (!target_was_examined(curr))
-			continue;
-		/* skip targets that were already halted */
-		if (curr->state == TARGET_HALTED)
-			continue;
-		/* remember the gdb_service->target */
-		if (curr->gdb_service)
+		if (curr != target && target_was_examined(curr) &&
+				curr->state != TARGET_HALTED && curr->gdb_service)
 			gdb_target = curr->gdb_service->target;
-		/* skip it */
-		if (curr == gdb_target)
+	}
+
+	/* poll all targets in the group, but skip the target that serves GDB */
+	unsigned int count = 0;
+	struct aarch64_smp_pe *pes = aarch64_smp_list(target, target, NULL, &count);
+	unsigned int n = 0;
+	for (unsigned int i = 0; pes && i < count; i++) {
+		curr = pes[i].target;
+		/* skip targets that were already halted, and the one of GDB */
+		if (curr->state != TARGET_HALTED && curr != gdb_target)
+			pes[n++] = pes[i];
+	}
+
+	/*
+	 * Read the status of these PEs in one pass, then start the debug
+	 * entry of the halted ones in one more: clear the sticky errors, read
+	 * DSCR and acknowledge the CTI halt event.
+	 */
+	int retval = pes ? aarch64_smp_read_prsr(pes, n) : ERROR_FAIL;
+	for (unsigned int i = 0; i < n && retval == ERROR_OK; i++) {
+		struct armv8_common *armv8 = target_to_armv8(pes[i].target);
+
+		if (!(pes[i].prsr & PRSR_HALT))
 			continue;
+		retval = mem_ap_write_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DRCR, DRCR_CSE);
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_u32(armv8->debug_ap,
+					armv8->debug_base + CPUV8_DBG_DSCR, &pes[i].dscr);
+		if (retval == ERROR_OK)
+			retval = aarch64_smp_queue_ack(&pes[i]);
+	}
+	if (retval == ERROR_OK)
+		retval = aarch64_smp_run(pes, n);
+	for (unsigned int i = 0; i < n && retval == ERROR_OK; i++)
+		if (pes[i].prsr & PRSR_HALT)
+			retval = aarch64_smp_check_ack(&pes[i]);
+
+	for (unsigned int i = 0; i < n; i++) {
+		curr = pes[i].target;
 
 		/* avoid recursion in aarch64_poll() */
 		curr->smp = 0;
-		aarch64_poll(curr);
+		if (retval != ERROR_OK)
+			aarch64_poll(curr);
+		else
+			aarch64_poll_prsr(curr, pes[i].prsr,
+					(pes[i].prsr & PRSR_HALT) ? &pes[i].dscr : NULL);
 		curr->smp = 1;
 	}
+	free(pes);
 
 	/* after all targets were updated, poll the gdb serving target */
 	if (gdb_target && gdb_target != target)
@@ -517,15 +704,25 @@ static int update_halt_gdb(struct target *target, enum target_debug_reason debug
 
 static int aarch64_poll(struct target *target)
 {
-	struct armv8_common *armv8 = target_to_armv8(target);
-	enum target_state prev_target_state;
-	int retval = ERROR_OK;
 	uint32_t prsr;
 
-	retval = aarch64_read_prsr(target, &prsr);
+	int retval = aarch64_read_prsr(target, &prsr);
 	if (retval != ERROR_OK)
 		return retval;
 
+	return aarch64_poll_prsr(target, prsr, NULL);
+}
+
+/*
+ * Update the state of the target from PRSR. entry_dscr is DSCR if the
+ * start of the debug entry was done already, in a pass over the SMP group.
+ */
+static int aarch64_poll_prsr(struct target *target, uint32_t prsr, const uint32_t *entry_dscr)
+{
+	struct armv8_common *armv8 = target_to_armv8(target);
+	enum target_state prev_target_state;
+	int retval = ERROR_OK;
+
 	if (armv8->sticky_reset) {
 		armv8->sticky_reset = false;
 		if (target->state != TARGET_RESET) {
@@ -546,7 +743,10 @@ static int aarch64_poll(struct target *target)
 			/* We have a halting debug event */
 			target->state = TARGET_HALTED;
 			LOG_DEBUG("Target %s halted", target_name(target));
-			retval = aarch64_debug_entry(target);
+			if (entry_dscr)
+				retval = aarch64_debug_entry_dscr(target, *entry_dscr);
+			else
+				retval = aarch64_debug_entry(target);
 			if (retval != ERROR_OK)
 				return retval;
 
@@ -757,100 +957,129 @@ static int aarch64_prep_restart_smp(struct target *target,
 		bool handle_breakpoints, struct target **p_first)
 {
 	int retval = ERROR_OK;
-	struct target_list *head;
 	struct target *first = NULL;
 	uint64_t address;
+	unsigned int count;
 
-	foreach_smp_target(head, target->smp_targets) {
-		struct target *curr = head->target;
+	/* skip calling target */
+	struct aarch64_smp_pe *pes = aarch64_smp_list(target, target, aarch64_smp_is_halted, &count);
+	if (!pes)
+		return ERROR_FAIL;
 
-		/* skip calling target */
-		if (curr == target)
-			continue;
-		if (!target_was_examined(curr))
-			continue;
-		if (curr->state != TARGET_HALTED)
-			continue;
+	for (unsigned int i = 0; i < count; i++) {
+		struct target *curr = pes[i].target;
 
 		/*  resume at current address, not in step mode */
 		retval = aarch64_restore_one(curr, true, &address, handle_breakpoints,
 			false);
-		if (retval == ERROR_OK)
-			retval = aarch64_prepare_restart_one(curr);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("failed to restore target %s", target_name(curr));
-			break;
+			goto done;
 		}
 		/* remember the first valid target in the group */
 		if (!first)
 			first = curr;
 	}
 
+	/*
+	 * Prepare the restart of all these PEs, as aarch64_prepare_restart_one()
+	 * does, in two passes: acknowledge the CTI halt event and read DSCR and
+	 * the CTI gate, then set the gates and DSCR.HDE and clear PRSR.SDR.
+	 */
+	for (unsigned int i = 0; i < count && retval == ERROR_OK; i++) {
+		struct armv8_common *armv8 = target_to_armv8(pes[i].target);
+
+		retval = mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DSCR, &pes[i].dscr);
+		if (retval == ERROR_OK)
+			retval = aarch64_smp_queue_ack(&pes[i]);
+		if (retval == ERROR_OK)
+			retval = arm_cti_queue_read_reg(armv8->cti, CTI_GATE, &pes[i].gate);
+	}
+	if (retval == ERROR_OK)
+		retval = aarch64_smp_run(pes, count);
+
+	for (unsigned int i = 0; i < count && retval == ERROR_OK; i++) {
+		struct armv8_common *armv8 = target_to_armv8(pes[i].target);
+
+		if ((pes[i].dscr & DSCR_ITE) == 0)
+			LOG_ERROR("DSCR.ITE must be set before leaving debug!");
+		if ((pes[i].dscr & DSCR_ERR) != 0)
+			LOG_ERROR("DSCR.ERR must be cleared before leaving debug!");
+
+		retval = aarch64_smp_check_ack(&pes[i]);
+		if (retval == ERROR_OK)
+			retval = arm_cti_queue_write_reg(armv8->cti, CTI_GATE,
+					(pes[i].gate | CTI_CHNL(1)) & ~CTI_CHNL(0));
+		if (retval == ERROR_OK)
+			retval = mem_ap_write_u32(armv8->debug_ap,
+					armv8->debug_base + CPUV8_DBG_DSCR, pes[i].dscr | DSCR_HDE);
+	}
+	if (retval == ERROR_OK)
+		retval = aarch64_smp_read_prsr(pes, count);
+	if (retval != ERROR_OK)
+		LOG_ERROR("failed to prepare the restart of the SMP group");
+
+done:
+	free(pes);
+
 	if (p_first)
 		*p_first = first;
 
 	return retval;
 }
 
-
-static int aarch64_step_restart_smp(struct target *target)
+/*
+ * Wait for the PEs of the group, but the calling target, to restart. The
+ * status of all the PEs is read in one pass.
+ */
+static int aarch64_wait_restart_smp(struct target *target)
 {
 	int retval = ERROR_OK;
-	struct target_list *head;
-	struct target *first = NULL;
-
-	LOG_DEBUG("%s", target_name(target));
+	unsigned int count;
 
-	retval = aarch64_prep_restart_smp(target, false, &first);
-	if (retval != ERROR_OK)
-		return retval;
-
-	if (first)
-		retval = aarch64_do_restart_one(first, RESTART_LAZY);
-	if (retval != ERROR_OK) {
-		LOG_DEBUG("error restarting target %s", target_name(first));
-		return retval;
-	}
+	struct aarch64_smp_pe *pes = aarch64_smp_list(target, target, NULL, &count);
+	if (!pes)
+		return ERROR_FAIL;
 
 	int64_t then = timeval_ms();
 	for (;;) {
-		struct target *curr = target;
-		bool all_resumed = true;
+		struct target *curr = NULL;
 
-		foreach_smp_target(head, target->smp_targets) {
-			uint32_t prsr;
-			int resumed;
-
-			curr = head->target;
+		if (aarch64_smp_read_prsr(pes, count) != ERROR_OK)
+			curr = count ? pes[0].target : target;
 
-			if (curr == target)
-				continue;
-
-			if (!target_was_examined(curr))
+		for (unsigned int i = 0; i < count && !curr; i++) {
+			/*
+			 * if PRSR.SDR was set, the PE did restart, even if it's
+			 * now already halted again (e.g. due to breakpoint)
+			 */
+			if (pes[i].done)
 				continue;
-
-			retval = aarch64_check_state_one(curr,
-					PRSR_SDR, PRSR_SDR, &resumed, &prsr);
-			if (retval != ERROR_OK || (!resumed && (prsr & PRSR_HALT))) {
-				all_resumed = false;
+			if (!(pes[i].prsr & PRSR_SDR) && (pes[i].prsr & PRSR_HALT)) {
+				curr = pes[i].target;
 				break;
 			}
+			pes[i].done = true;
 
-			if (curr->state != TARGET_RUNNING) {
-				curr->state = TARGET_RUNNING;
-				curr->debug_reason = DBG_REASON_NOTHALTED;
-				target_call_event_callbacks(curr, TARGET_EVENT_RESUMED);
+			if (pes[i].target->state != TARGET_RUNNING) {
+				pes[i].target->state = TARGET_RUNNING;
+				pes[i].target->debug_reason = DBG_REASON_NOTHALTED;
+				target_call_event_callbacks(pes[i].target, TARGET_EVENT_RESUMED);
 			}
 		}
 
-		if (all_resumed)
+		if (!curr) {
+			retval = ERROR_OK;
 			break;
+		}
 
 		if (timeval_ms() > then + 1000) {
-			LOG_ERROR("%s: timeout waiting for target resume", __func__);
+			LOG_ERROR("%s: timeout waiting for target %s to resume", __func__, target_name(curr));
 			retval = ERROR_TARGET_TIMEOUT;
 			break;
 		}
+
 		/*
 		 * HACK: on Hi6220 there are 8 cores organized in 2 clusters
 		 * and it looks like the CTI's are not connected by a common
@@ -861,11 +1090,34 @@ static int aarch64_step_restart_smp(struct target *target)
 		retval = aarch64_do_restart_one(curr, RESTART_LAZY);
 		if (retval != ERROR_OK)
 			break;
-}
+	}
 
+	free(pes);
 	return retval;
 }
 
+
+static int aarch64_step_restart_smp(struct target *target)
+{
+	int retval = ERROR_OK;
+	struct target *first = NULL;
+
+	LOG_DEBUG("%s", target_name(target));
+
+	retval = aarch64_prep_restart_smp(target, false, &first);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (first)
+		retval = aarch64_do_restart_one(first, RESTART_LAZY);
+	if (retval != ERROR_OK) {
+		LOG_DEBUG("error restarting target %s", target_name(first));
+		return retval;
+	}
+
+	return aarch64_wait_restart_smp(target);
+}
+
 static int aarch64_resume(struct target *target, bool current,
 	target_addr_t address, bool handle_breakpoints, bool debug_execution)
 {
@@ -900,58 +1152,8 @@ static int aarch64_resume(struct target *target, bool current,
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (target->smp) {
-		int64_t then = timeval_ms();
-		for (;;) {
-			struct target *curr = target;
-			struct target_list *head;
-			bool all_resumed = true;
-
-			foreach_smp_target(head, target->smp_targets) {
-				uint32_t prsr;
-				int resumed;
-
-				curr = head->target;
-				if (curr == target)
-					continue;
-				if (!target_was_examined(curr))
-					continue;
-
-				retval = aarch64_check_state_one(curr,
-						PRSR_SDR, PRSR_SDR, &resumed, &prsr);
-				if (retval != ERROR_OK || (!resumed && (prsr & PRSR_HALT))) {
-					all_resumed = false;
-					break;
-				}
-
-				if (curr->state != TARGET_RUNNING) {
-					curr->state = TARGET_RUNNING;
-					curr->debug_reason = DBG_REASON_NOTHALTED;
-					target_call_event_callbacks(curr, TARGET_EVENT_RESUMED);
-				}
-			}
-
-			if (all_resumed)
-				break;
-
-			if (timeval_ms() > then + 1000) {
-				LOG_ERROR("%s: timeout waiting for target %s to resume", __func__, target_name(curr));
-				retval = ERROR_TARGET_TIMEOUT;
-				break;
-			}
-
-			/*
-			 * HACK: on Hi6220 there are 8 cores organized in 2 clusters
-			 * and it looks like the CTI's are not connected by a common
-			 * trigger matrix. It seems that we need to halt one core in each
-			 * cluster explicitly. So if we find that a core has not halted
-			 * yet, we trigger an explicit resume for the second cluster.
-			 */
-			retval = aarch64_do_restart_one(curr, RESTART_LAZY);
-			if (retval != ERROR_OK)
-				break;
-		}
-	}
+	if (target->smp)
+		retval = aarch64_wait_restart_smp(target);
 
 	if (retval != ERROR_OK)
 		return retval;
@@ -975,8 +1177,6 @@ static int aarch64_debug_entry(struct target *target)
 {
 	int retval = ERROR_OK;
 	struct armv8_common *armv8 = target_to_armv8(target);
-	struct arm_dpm *dpm = &armv8->dpm;
-	enum arm_state core_state;
 	uint32_t dscr;
 
 	/* make sure to clear all sticky errors */
@@ -991,6 +1191,17 @@ static int aarch64_debug_entry(struct target *target)
 	if (retval != ERROR_OK)
 		return retval;
 
+	return aarch64_debug_entry_dscr(target, dscr);
+}
+
+/* Debug entry, once the sticky errors are cleared and the CTI halt event acknowledged */
+static int aarch64_debug_entry_dscr(struct target *target, uint32_t dscr)
+{
+	int retval = ERROR_OK;
+	struct armv8_common *armv8 = target_to_armv8(target);
+	struct arm_dpm *dpm = &armv8->dpm;
+	enum arm_state core_state;
+
 	LOG_DEBUG("%s dscr = 0x%08" PRIx32, target_name(target), dscr);
 
 	dpm->dscr = dscr;
@@ -1032,6 +1243,11 @@ static int aarch64_debug_entry(struct target *target)
 		armv8->dpm.wp_addr = edwar;
 	}
 
+	/* the translations and cache state of the previous halt may no longer hold */
+	armv8_mmu_invalidate_translations(armv8);
+	armv8->sysbus.caches_clean = false;
+	arm_sysbus_set_security(&armv8->sysbus, !(dscr & DSCR_NON_SECURE));
+
 	retval = armv8_dpm_read_current_registers(&armv8->dpm);
 
 	if (retval == ERROR_OK && armv8->post_debug_entry)
@@ -1104,6 +1320,7 @@ static int aarch64_post_debug_entry(struct target *target)
 	} else {
 		armv8->armv8_mmu.mmu_enabled = aarch64->system_control_reg & 0x1U;
 	}
+	armv8->sysbus.mmu_state_known = true;
 	armv8->armv8_mmu.armv8_cache.d_u_cache_enabled =
 		aarch64->system_control_reg & 0x4U;
 	armv8->armv8_mmu.armv8_cache.i_cache_enabled =
@@ -1239,6 +1456,8 @@ static int aarch64_restore_context(struct target *target, bool bpwp)
 	if (armv8->pre_restore_context)
 		armv8->pre_restore_context(target);
 
+	armv8_mmu_invalidate_translations(armv8);
+
 	retval = armv8_dpm_write_dirty_registers(&armv8->dpm, bpwp);
 	if (retval == ERROR_OK) {
 		/* registers are now invalid */
@@ -2149,29 +2368,45 @@ static int aarch64_write_cpu_memory_fast(struct target *target,
 	uint32_t count, const uint8_t *buffer, uint32_t *dscr)
 {
 	struct armv8_common *armv8 = target_to_armv8(target);
+	struct adiv5_ap *ap = armv8->debug_ap;
+	target_addr_t base = armv8->debug_base;
 	struct arm *arm = &armv8->arm;
 	int retval;
+	uint32_t status;
 
 	armv8_reg_current(arm, 1)->dirty = true;
 
-	/* Step 1.d   - Change DCC to memory mode */
+	/* Step 1.d   - Change DCC to memory mode, queued with the first block */
 	*dscr |= DSCR_MA;
-	retval =  mem_ap_write_atomic_u32(armv8->debug_ap,
-			armv8->debug_base + CPUV8_DBG_DSCR, *dscr);
-	if (retval != ERROR_OK)
-		return retval;
+	retval = mem_ap_write_u32(ap, base + CPUV8_DBG_DSCR, *dscr);
+
+	/*
+	 * Step 2.a   - Do the write, streamed in blocks. DSCR is read along
+	 * with each block, so an abort stops the transfer without a round
+	 * trip of its own; the caller reports it.
+	 */
+	while (count && retval == ERROR_OK) {
+		uint32_t block = MIN(count, AARCH64_MA_BLOCK_WORDS);
 
+		for (uint32_t i = 0; i < block && retval == ERROR_OK; i++)
+			retval = mem_ap_write_u32(ap, base + CPUV8_DBG_DTRRX, le_to_h_u32(buffer + 4 * i));
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_u32(ap, base + CPUV8_DBG_DSCR, &status);
+		if (retval == ERROR_OK)
+			retval = dap_run(ap->dap);
+		if (retval == ERROR_OK && (status & DSCR_ERR))
+			break;
 
-	/* Step 2.a   - Do the write */
-	retval = mem_ap_write_buf_noincr(armv8->debug_ap,
-					buffer, 4, count, armv8->debug_base + CPUV8_DBG_DTRRX);
+		buffer += 4 * block;
+		count -= block;
+		keep_alive();
+	}
 	if (retval != ERROR_OK)
 		return retval;
 
 	/* Step 3.a   - Switch DTR mode back to Normal mode */
 	*dscr &= ~DSCR_MA;
-	retval = mem_ap_write_atomic_u32(armv8->debug_ap,
-				armv8->debug_base + CPUV8_DBG_DSCR, *dscr);
+	retval = mem_ap_write_atomic_u32(ap, base + CPUV8_DBG_DSCR, *dscr);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -2209,12 +2444,14 @@ static int aarch64_write_cpu_memory(struct target *target,
 	if (retval != ERROR_OK)
 		return retval;
 
-	/* Set Normal access mode  */
-	dscr = (dscr & ~DSCR_MA);
-	retval = mem_ap_write_atomic_u32(armv8->debug_ap,
-			armv8->debug_base + CPUV8_DBG_DSCR, dscr);
-	if (retval != ERROR_OK)
-		return retval;
+	/* Set Normal access mode, left by an interrupted transfer */
+	if (dscr & DSCR_MA) {
+		dscr &= ~DSCR_MA;
+		retval = mem_ap_write_atomic_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DSCR, dscr);
+		if (retval != ERROR_OK)
+			return retval;
+	}
 
 	if (arm->core_state == ARM_STATE_AARCH64) {
 		/* Write X0 with value 'address' using write procedure */
@@ -2353,10 +2590,12 @@ static int aarch64_read_cpu_memory_fast(struct target *target,
 	uint32_t count, uint8_t *buffer, uint32_t *dscr)
 {
 	struct armv8_common *armv8 = target_to_armv8(target);
+	struct adiv5_ap *ap = armv8->debug_ap;
+	target_addr_t base = armv8->debug_base;
 	struct arm_dpm *dpm = &armv8->dpm;
 	struct arm *arm = &armv8->arm;
 	int retval;
-	uint32_t value;
+	uint32_t value, status;
 
 	/* Mark X1 as dirty */
 	armv8_reg_current(arm, 1)->dirty = true;
@@ -2374,16 +2613,11 @@ static int aarch64_read_cpu_memory_fast(struct target *target,
 
 	/* Step 1.e - Change DCC to memory mode */
 	*dscr |= DSCR_MA;
-	retval =  mem_ap_write_atomic_u32(armv8->debug_ap,
-			armv8->debug_base + CPUV8_DBG_DSCR, *dscr);
-	if (retval != ERROR_OK)
-		return retval;
+	retval = mem_ap_write_u32(ap, base + CPUV8_DBG_DSCR, *dscr);
 
 	/* Step 1.f - read DBGDTRTX and discard the value */
-	retval = mem_ap_read_atomic_u32(armv8->debug_ap,
-			armv8->debug_base + CPUV8_DBG_DTRTX, &value);
-	if (retval != ERROR_OK)
-		return retval;
+	if (retval == ERROR_OK)
+		retval = mem_ap_read_u32(ap, base + CPUV8_DBG_DTRTX, &value);
 
 	count--;
 	/* Read the data - Each read of the DTRTX register causes the instruction to be reissued
@@ -2392,25 +2626,54 @@ static int aarch64_read_cpu_memory_fast(struct target *target,
 	 * This data is read in aligned to 32 bit boundary.
 	 */
 
+	uint32_t *words = NULL;
 	if (count) {
-		/* Step 2.a - Loop n-1 times, each read of DBGDTRTX reads the data from [X0] and
-		 * increments X0 by 4. */
-		retval = mem_ap_read_buf_noincr(armv8->debug_ap, buffer, 4, count,
-									armv8->debug_base + CPUV8_DBG_DTRTX);
+		words = malloc(MIN(count, AARCH64_MA_BLOCK_WORDS) * sizeof(*words));
+		if (!words) {
+			LOG_ERROR("Out of memory");
+			retval = ERROR_FAIL;
+		}
+	}
+
+	/*
+	 * Step 2.a - Loop n-1 times, each read of DBGDTRTX reads the data from [X0] and
+	 * increments X0 by 4. The reads are streamed in blocks, each one run with a
+	 * read of DSCR to stop at the first abort.
+	 */
+	uint32_t done = 0;
+	while (done < count && retval == ERROR_OK) {
+		uint32_t block = MIN(count - done, AARCH64_MA_BLOCK_WORDS);
+
+		for (uint32_t i = 0; i < block && retval == ERROR_OK; i++)
+			retval = mem_ap_read_u32(ap, base + CPUV8_DBG_DTRTX, &words[i]);
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_u32(ap, base + CPUV8_DBG_DSCR, &status);
+		if (retval == ERROR_OK)
+			retval = dap_run(ap->dap);
 		if (retval != ERROR_OK)
-			return retval;
+			break;
+
+		for (uint32_t i = 0; i < block; i++)
+			h_u32_to_le(buffer + 4 * (done + i), words[i]);
+		done += block;
+		keep_alive();
+
+		if (status & DSCR_ERR)
+			break;
 	}
+	free(words);
+	if (retval != ERROR_OK)
+		return retval;
 
 	/* Step 3.a - set DTR access mode back to Normal mode	*/
 	*dscr &= ~DSCR_MA;
-	retval =  mem_ap_write_atomic_u32(armv8->debug_ap,
-					armv8->debug_base + CPUV8_DBG_DSCR, *dscr);
-	if (retval != ERROR_OK)
-		return retval;
+	retval = mem_ap_write_u32(ap, base + CPUV8_DBG_DSCR, *dscr);
 
 	/* Step 3.b - read DBGDTRTX for the final value */
-	retval = mem_ap_read_atomic_u32(armv8->debug_ap,
-			armv8->debug_base + CPUV8_DBG_DTRTX, &value);
+	if (retval == ERROR_OK)
+		retval = mem_ap_read_u32(ap, base + CPUV8_DBG_DTRTX, &value);
+	if (retval == ERROR_OK)
+		retval = dap_run(ap->dap);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -2452,12 +2715,14 @@ static int aarch64_read_cpu_memory(struct target *target,
 
 	/* This algorithm comes from DDI0487A.g, chapter J9.1 */
 
-	/* Set Normal access mode  */
-	dscr &= ~DSCR_MA;
-	retval =  mem_ap_write_atomic_u32(armv8->debug_ap,
-			armv8->debug_base + CPUV8_DBG_DSCR, dscr);
-	if (retval != ERROR_OK)
-		return retval;
+	/* Set Normal access mode, left by an interrupted transfer */
+	if (dscr & DSCR_MA) {
+		dscr &= ~DSCR_MA;
+		retval = mem_ap_write_atomic_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DSCR, dscr);
+		if (retval != ERROR_OK)
+			return retval;
+	}
 
 	if (arm->core_state == ARM_STATE_AARCH64) {
 		/* Write X0 with value 'address' using write procedure */
@@ -2509,39 +2774,128 @@ static int aarch64_read_cpu_memory(struct target *target,
 	return ERROR_OK;
 }
 
-static int aarch64_read_phys_memory(struct target *target,
+/*
+ * Prepare an access through the system MEM-AP. In debug state the data
+ * caches are cleaned and disabled once per halt, as for the physical
+ * accesses through the core; a running core is accessed as it is.
+ */
+static int aarch64_sysbus_prepare(struct target *target, enum arm_sysbus_policy policy)
+{
+	struct armv8_common *armv8 = target_to_armv8(target);
+	int retval;
+
+	if (policy != ARM_SYSBUS_BUS || target->state != TARGET_HALTED || armv8->sysbus.caches_clean)
+		return ERROR_OK;
+
+	retval = aarch64_mmu_modify(target, 0);
+	if (retval != ERROR_OK)
+		return retval;
+
+	armv8->sysbus.caches_clean = true;
+	return ERROR_OK;
+}
+
+static int aarch64_read_routed_memory(struct target *target,
 	target_addr_t address, uint32_t size,
-	uint32_t count, uint8_t *buffer)
+	uint32_t count, uint8_t *buffer, bool phys)
 {
-	int retval = ERROR_COMMAND_SYNTAX_ERROR;
+	struct armv8_common *armv8 = target_to_armv8(target);
+	int retval = ERROR_OK;
 
-	if (count && buffer) {
-		/* read memory through APB-AP */
-		retval = aarch64_mmu_modify(target, 0);
-		if (retval != ERROR_OK)
-			return retval;
-		retval = aarch64_read_cpu_memory(target, address, size, count, buffer);
+	while (count && retval == ERROR_OK) {
+		uint32_t n;
+		enum arm_sysbus_policy policy = arm_sysbus_route(&armv8->sysbus,
+				address, size, count, &n);
+
+		if (policy == ARM_SYSBUS_CPU) {
+			/* read memory through APB-AP */
+			if (phys)
+				retval = aarch64_mmu_modify(target, 0);
+			if (retval == ERROR_OK)
+				retval = aarch64_read_cpu_memory(target, address, size, n, buffer);
+		} else {
+			retval = aarch64_sysbus_prepare(target, policy);
+			if (retval == ERROR_OK)
+				retval = mem_ap_read_buf(armv8->sysbus.ap, buffer, size, n, address);
+		}
+
+		address += n * size;
+		buffer += n * size;
+		count -= n;
+	}
+
+	return retval;
+}
+
+static int aarch64_write_routed_memory(struct target *target,
+	target_addr_t address, uint32_t size,
+	uint32_t count, const uint8_t *buffer, bool phys)
+{
+	struct armv8_common *armv8 = target_to_armv8(target);
+	bool i_cache_stale = false;
+	int retval = ERROR_OK;
+
+	while (count && retval == ERROR_OK) {
+		uint32_t n;
+		enum arm_sysbus_policy policy = arm_sysbus_route(&armv8->sysbus,
+				address, size, count, &n);
+
+		if (policy == ARM_SYSBUS_CPU) {
+			/* write memory through APB-AP */
+			if (phys)
+				retval = aarch64_mmu_modify(target, 0);
+			if (retval == ERROR_OK)
+				retval = aarch64_write_cpu_memory(target, address, size, n, buffer);
+		} else {
+			retval = aarch64_sysbus_prepare(target, policy);
+			if (retval == ERROR_OK)
+				retval = mem_ap_write_buf(armv8->sysbus.ap, buffer, size, n, address);
+			i_cache_stale |= policy == ARM_SYSBUS_BUS;
+		}
+
+		address += n * size;
+		buffer += n * size;
+		count -= n;
 	}
+
+	/* the instruction cache does not snoop the system bus */
+	if (retval == ERROR_OK && i_cache_stale && target->state == TARGET_HALTED
+			&& armv8->armv8_mmu.armv8_cache.i_cache_enabled)
+		retval = armv8_cache_i_inner_clean_inval_all(armv8);
+
 	return retval;
 }
 
+static int aarch64_read_phys_memory(struct target *target,
+	target_addr_t address, uint32_t size,
+	uint32_t count, uint8_t *buffer)
+{
+	if (!count || !buffer)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	return aarch64_read_routed_memory(target, address, size, count, buffer, true);
+}
+
 static int aarch64_read_memory(struct target *target, target_addr_t address,
 	uint32_t size, uint32_t count, uint8_t *buffer)
 {
-	bool mmu_enabled = false;
+	struct armv8_common *armv8 = target_to_armv8(target);
 	int retval;
 
-	/* determine if MMU was enabled on target stop */
-	retval = aarch64_mmu(target, &mmu_enabled);
+	/* without the MMU at the last halt, virtual and physical addresses match */
+	if (armv8->is_armv8r || (armv8->sysbus.mmu_state_known && !armv8->armv8_mmu.mmu_enabled))
+		return aarch64_read_routed_memory(target, address, size, count, buffer, false);
+
+	if (target->state != TARGET_HALTED) {
+		LOG_TARGET_ERROR(target, "not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	/* enable MMU as we could have disabled it for phys access */
+	retval = aarch64_mmu_modify(target, 1);
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (mmu_enabled) {
-		/* enable MMU as we could have disabled it for phys access */
-		retval = aarch64_mmu_modify(target, 1);
-		if (retval != ERROR_OK)
-			return retval;
-	}
 	return aarch64_read_cpu_memory(target, address, size, count, buffer);
 }
 
@@ -2549,36 +2903,32 @@ static int aarch64_write_phys_memory(struct target *target,
 	target_addr_t address, uint32_t size,
 	uint32_t count, const uint8_t *buffer)
 {
-	int retval = ERROR_COMMAND_SYNTAX_ERROR;
-
-	if (count && buffer) {
-		/* write memory through APB-AP */
-		retval = aarch64_mmu_modify(target, 0);
-		if (retval != ERROR_OK)
-			return retval;
-		return aarch64_write_cpu_memory(target, address, size, count, buffer);
-	}
+	if (!count || !buffer)
+		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	return retval;
+	return aarch64_write_routed_memory(target, address, size, count, buffer, true);
 }
 
 static int aarch64_write_memory(struct target *target, target_addr_t address,
 	uint32_t size, uint32_t count, const uint8_t *buffer)
 {
-	bool mmu_enabled = false;
+	struct armv8_common *armv8 = target_to_armv8(target);
 	int retval;
 
-	/* determine if MMU was enabled on target stop */
-	retval = aarch64_mmu(target, &mmu_enabled);
+	/* without the MMU at the last halt, virtual and physical addresses match */
+	if (armv8->is_armv8r || (armv8->sysbus.mmu_state_known && !armv8->armv8_mmu.mmu_enabled))
+		return aarch64_write_routed_memory(target, address, size, count, buffer, false);
+
+	if (target->state != TARGET_HALTED) {
+		LOG_TARGET_ERROR(target, "not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	/* enable MMU as we could have disabled it for phys access */
+	retval = aarch64_mmu_modify(target, 1);
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (mmu_enabled) {
-		/* enable MMU as we could have disabled it for phys access */
-		retval = aarch64_mmu_modify(target, 1);
-		if (retval != ERROR_OK)
-			return retval;
-	}
 	return aarch64_write_cpu_memory(target, address, size, count, buffer);
 }
 
@@ -2655,6 +3005,11 @@ static int aarch64_examine_first(struct target *target)
 
 	armv8->debug_ap->memaccess_tck = 10;
 
+	/* optional, memory is accessed through the core without it */
+	retval = arm_sysbus_examine(&armv8->sysbus, swjdp);
+	if (retval != ERROR_OK)
+		return retval;
+
 	if (!target->dbgbase_set) {
 		/* Lookup Processor DAP */
 		retval = dap_lookup_cs_component(armv8->debug_ap, ARM_CS_C9_DEVTYPE_CORE_DEBUG,
@@ -2807,6 +3162,8 @@ static int aarch64_init_arch_info(struct target *target,
 	armv8->armv8_mmu.read_physical_memory = aarch64_read_phys_memory;
 
 	armv8_init_arch_info(target, armv8);
+	arm_sysbus_init(&armv8->sysbus);
+	armv8->arm.sysbus = &armv8->sysbus;
 	target_register_timer_callback(aarch64_handle_target_request, 1,
 		TARGET_TIMER_TYPE_PERIODIC, target);
 
@@ -2867,6 +3224,7 @@ static void aarch64_deinit_target(struct target *target)
 
 	if (armv8->debug_ap)
 		dap_put_ap(armv8->debug_ap);
+	arm_sysbus_release(&armv8->sysbus);
 
 	armv8_free_reg_cache(target);
 	free(aarch64->brp_list);
@@ -3213,6 +3571,9 @@ static const struct command_registration aarch64_exec_command_handlers[] = {
 		.help = "read coprocessor register",
 		.usage = "cpnum op1 CRn CRm op2",
 	},
+	{
+		.chain = arm_sysbus_command_handlers,
+	},
 	{
 		.chain = smp_command_handlers,
 	},
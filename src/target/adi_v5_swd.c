@@ -39,6 +39,7 @@
 #include <helper/time_support.h>
 
 #include <transport/transport.h>
+#include <jtag/adapter_trace.h>
 #include <jtag/interface.h>
 
 #include <jtag/swd.h>
@@ -84,8 +85,17 @@ static void swd_clear_sticky_errors(struct adiv5_dap *dap)
 static int swd_run_inner(struct adiv5_dap *dap)
 {
 	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
+	int64_t trace_start = adapter_trace_start();
 
-	return swd->run();
+	int retval = swd->run();
+
+	if (retval == ERROR_WAIT)
+		adapter_stats_add(&dap->stats, ADAPTER_STAT_SWD_WAIT, 1);
+	else if (retval == ERROR_SWD_FAULT)
+		adapter_stats_add(&dap->stats, ADAPTER_STAT_SWD_FAULT, 1);
+
+	ADAPTER_TRACE(ADAPTER_TRACE_SWD_RUN, 0, 0, retval, 0, trace_start);
+	return retval;
 }
 
 static inline int check_sync(struct adiv5_dap *dap)
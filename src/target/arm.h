@@ -255,6 +255,9 @@ struct arm {
 	 * used to make requests to the target.
 	 */
 	struct adiv5_dap *dap;
+
+	/** Memory access through a system bus MEM-AP, if the core supports it. */
+	struct arm_sysbus *sysbus;
 };
 
 /** Convert target handle to generic ARM target state handle. */
@@ -111,6 +111,7 @@ static int mem_ap_setup_csw(struct adiv5_ap *ap, uint32_t csw)
 			return retval;
 		}
 		ap->csw_value = csw;
+		adapter_stats_add(&ap->dap->stats, ADAPTER_STAT_CSW_WRITE, 1);
 	}
 	return ERROR_OK;
 }
@@ -131,6 +132,7 @@ static int mem_ap_setup_tar(struct adiv5_ap *ap, target_addr_t tar)
 		}
 		ap->tar_value = tar;
 		ap->tar_valid = true;
+		adapter_stats_add(&ap->dap->stats, ADAPTER_STAT_TAR_WRITE, 1);
 	}
 	return ERROR_OK;
 }
@@ -334,6 +336,71 @@ int mem_ap_write_atomic_u32(struct adiv5_ap *ap, target_addr_t address,
 	return dap_run(ap->dap);
 }
 
+/**
+ * Asynchronous (queued) read of consecutive words from memory.
+ * The TAR is written only when the auto-increment does not reach the
+ * next word, so several of these can share one flush of the queue.
+ *
+ * @param ap The MEM-AP to access.
+ * @param address Word aligned address of the first word.
+ * @param count Number of words to read.
+ * @param words points to where the words will be stored, in host order,
+ *	when the transaction queue is flushed (assuming no errors).
+ *
+ * @return ERROR_OK for success.  Otherwise a fault code.
+ */
+int mem_ap_queue_read_words(struct adiv5_ap *ap, target_addr_t address,
+		uint32_t count, uint32_t *words)
+{
+	adapter_stats_add(&ap->dap->stats, ADAPTER_STAT_MEM_READ_BYTES, 4 * count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		int retval = mem_ap_setup_transfer(ap, CSW_32BIT | CSW_ADDRINC_SINGLE,
+				address + 4 * i);
+		if (retval != ERROR_OK)
+			return retval;
+
+		retval = dap_queue_ap_read(ap, MEM_AP_REG_DRW(ap->dap), &words[i]);
+		if (retval != ERROR_OK)
+			return retval;
+
+		mem_ap_update_tar_cache(ap);
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * Asynchronous (queued) write of consecutive words to memory.
+ *
+ * @param ap The MEM-AP to access.
+ * @param address Word aligned address of the first word.
+ * @param count Number of words to write.
+ * @param words The words to write, in host order.
+ *
+ * @return ERROR_OK for success.  Otherwise a fault code.
+ */
+int mem_ap_queue_write_words(struct adiv5_ap *ap, target_addr_t address,
+		uint32_t count, const uint32_t *words)
+{
+	adapter_stats_add(&ap->dap->stats, ADAPTER_STAT_MEM_WRITE_BYTES, 4 * count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		int retval = mem_ap_setup_transfer(ap, CSW_32BIT | CSW_ADDRINC_SINGLE,
+				address + 4 * i);
+		if (retval != ERROR_OK)
+			return retval;
+
+		retval = dap_queue_ap_write(ap, MEM_AP_REG_DRW(ap->dap), words[i]);
+		if (retval != ERROR_OK)
+			return retval;
+
+		mem_ap_update_tar_cache(ap);
+	}
+
+	return ERROR_OK;
+}
+
 /**
  * Queue transactions setting up transfer parameters for the
  * currently selected MEM-AP. If transfer size or packing
@@ -486,6 +553,8 @@ static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t siz
 	size_t nbytes = size * count;
 	int retval = ERROR_OK;
 
+	adapter_stats_add(&dap->stats, ADAPTER_STAT_MEM_WRITE_BYTES, nbytes);
+
 	/* TI BE-32 Quirks mode:
 	 * Writes on big-endian TMS570 behave very strangely. Observed behavior:
 	 *   size   write address   bytes written in order
@@ -617,6 +686,8 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 	target_addr_t address = adr;
 	int retval = ERROR_OK;
 
+	adapter_stats_add(&dap->stats, ADAPTER_STAT_MEM_READ_BYTES, nbytes);
+
 	/* TI BE-32 Quirks mode:
 	 * Reads on big-endian TMS570 behave strangely differently than writes.
 	 * They read from the physical address requested, but with DRW byte-reversed.
@@ -21,6 +21,8 @@
  */
 
 #include <helper/list.h>
+#include <helper/time_support.h>
+#include <jtag/adapter_stats.h>
 #include "arm_jtag.h"
 #include "helper/bits.h"
 
@@ -434,6 +436,14 @@ struct adiv5_dap {
 
 	/* ADIv6 only field indicating ROM Table address size */
 	unsigned int asize;
+
+	/** Performance counters, shown by 'adapter stats' */
+	struct adapter_stats stats;
+
+	/** Poll reads of the targets on this DAP are queued, waiting for dap_run() */
+	bool poll_batch_pending;
+	/** Result of the dap_run() which completed the poll reads */
+	int poll_batch_retval;
 };
 
 /**
@@ -648,7 +658,15 @@ static inline int dap_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
 static inline int dap_run(struct adiv5_dap *dap)
 {
 	assert(dap->ops);
-	return dap->ops->run(dap);
+	int64_t start = timeval_us();
+	int retval = dap->ops->run(dap);
+	adapter_stats_add(&dap->stats, ADAPTER_STAT_DAP_RUN, 1);
+	adapter_stats_latency(&dap->stats, ADAPTER_LATENCY_DAP_RUN, timeval_us() - start);
+	if (dap->poll_batch_pending) {
+		dap->poll_batch_pending = false;
+		dap->poll_batch_retval = retval;
+	}
+	return retval;
 }
 
 static inline int dap_sync(struct adiv5_dap *dap)
@@ -706,6 +724,12 @@ int mem_ap_read_u32(struct adiv5_ap *ap,
 int mem_ap_write_u32(struct adiv5_ap *ap,
 		target_addr_t address, uint32_t value);
 
+/* Queued MEM-AP memory mapped transfers of consecutive words. */
+int mem_ap_queue_read_words(struct adiv5_ap *ap,
+		target_addr_t address, uint32_t count, uint32_t *words);
+int mem_ap_queue_write_words(struct adiv5_ap *ap,
+		target_addr_t address, uint32_t count, const uint32_t *words);
+
 /* Synchronous MEM-AP memory mapped single word transfers. */
 int mem_ap_read_atomic_u32(struct adiv5_ap *ap,
 		target_addr_t address, uint32_t *value);
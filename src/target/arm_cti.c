@@ -133,6 +133,24 @@ int arm_cti_read_reg(struct arm_cti *self, unsigned int reg, uint32_t *p_value)
 	return mem_ap_read_atomic_u32(self->ap, self->spot.base + reg, p_value);
 }
 
+int arm_cti_queue_write_reg(struct arm_cti *self, unsigned int reg, uint32_t value)
+{
+	return mem_ap_write_u32(self->ap, self->spot.base + reg, value);
+}
+
+int arm_cti_queue_read_reg(struct arm_cti *self, unsigned int reg, uint32_t *p_value)
+{
+	if (!p_value)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	return mem_ap_read_u32(self->ap, self->spot.base + reg, p_value);
+}
+
+struct adiv5_dap *arm_cti_dap(struct arm_cti *self)
+{
+	return self->ap->dap;
+}
+
 int arm_cti_pulse_channel(struct arm_cti *self, uint32_t channel)
 {
 	if (channel > 31)
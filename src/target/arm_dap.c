@@ -171,6 +171,7 @@ int dap_cleanup_all(void)
 		if (dap->ops && dap->ops->quit)
 			dap->ops->quit(dap);
 
+		adapter_stats_unregister(&dap->stats);
 		free(obj->name);
 		free(obj);
 	}
@@ -403,6 +404,7 @@ COMMAND_HANDLER(handle_dap_create)
 		goto err;
 
 	list_add_tail(&dap->lh, &all_dap);
+	adapter_stats_register(&dap->dap.stats, dap->name);
 
 	return ERROR_OK;
 
@@ -85,6 +85,18 @@ static int dpm_mrrc(struct target *target, int cpnum,
 	return retval;
 }
 
+/*
+ * Called after a write to a coprocessor register; for a 64-bit register
+ * written by MCRR, crn is the CRm of the instruction. SCTLR (c1), TTBR0,
+ * TTBR1, TTBCR (c2) and PRRR/NMRR or MAIR (c10) define the translations.
+ */
+void arm_dpm_report_cp_write(struct arm_dpm *dpm, int cpnum, uint32_t crn)
+{
+	if (cpnum == 15 && (crn == 1 || crn == 2 || crn == 10) &&
+			dpm->invalidate_translations)
+		dpm->invalidate_translations(dpm);
+}
+
 static int dpm_mcr(struct target *target, int cpnum,
 	uint32_t op1, uint32_t op2, uint32_t crn, uint32_t crm,
 	uint32_t value)
@@ -104,6 +116,8 @@ static int dpm_mcr(struct target *target, int cpnum,
 	retval = dpm->instr_write_data_r0(dpm,
 			ARMV4_5_MCR(cpnum, op1, 0, crn, crm, op2),
 			value);
+	if (retval == ERROR_OK)
+		arm_dpm_report_cp_write(dpm, cpnum, crn);
 
 	dpm->finish(dpm);
 	return retval;
@@ -126,6 +140,8 @@ static int dpm_mcrr(struct target *target, int cpnum,
 	/* read DCC into r0, r1; then write coprocessor register from R0, R1 */
 	retval = dpm->instr_write_data_r0_r1(dpm,
 			ARMV5_T_MCRR(cpnum, op, 0, 1, crm), value);
+	if (retval == ERROR_OK)
+		arm_dpm_report_cp_write(dpm, cpnum, crm);
 
 	dpm->finish(dpm);
 
@@ -111,6 +111,12 @@ struct arm_dpm {
 	struct reg *(*arm_reg_current)(struct arm *arm,
 			unsigned int regnum);
 
+	/**
+	 * Optional; drops the cached address translations after a debugger
+	 * write to a register of the translation regime, e.g. by "arm mcr".
+	 */
+	void (*invalidate_translations)(struct arm_dpm *dpm);
+
 	/* BREAKPOINT/WATCHPOINT SUPPORT */
 
 	/**
@@ -157,6 +163,7 @@ struct arm_dpm {
 
 int arm_dpm_setup(struct arm_dpm *dpm);
 int arm_dpm_initialize(struct arm_dpm *dpm);
+void arm_dpm_report_cp_write(struct arm_dpm *dpm, int cpnum, uint32_t crn);
 
 int arm_dpm_read_reg(struct arm_dpm *dpm, struct reg *r, unsigned int regnum);
 int arm_dpm_read_current_registers(struct arm_dpm *dpm);
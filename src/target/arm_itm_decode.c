@@ -0,0 +1,355 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Streaming decoder of the ITM/DWT trace protocol.
+ *
+ * The decoder is a state machine which walks the buffers received from the
+ * adapter in place. The TPIU formatter frames, when enabled, are
+ * demultiplexed 16 bytes at a time and only the bytes of the ITM source are
+ * passed on. Stimulus packets are handed to the caller as a pointer into the
+ * buffer, the payload is only copied when a packet is split across buffers.
+ *
+ * Relevant specifications from ARM include:
+ *
+ * ARMv7-M Architecture Reference Manual, Appendix D4    ARM DDI 0403E
+ * CoreSight(tm) Architecture Specification, Chapter D4  ARM IHI 0029E
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <helper/bits.h>
+#include <helper/types.h>
+#include "arm_itm_decode.h"
+
+/* full TPIU synchronization packet, as received on the wire */
+#define TPIU_FULL_SYNC			0xffffff7f
+
+/* ID of the padding in TPIU frames */
+#define TPIU_ID_NULL			0x00
+
+/* ITM synchronization: at least 47 zero bits followed by a one */
+#define ITM_SYNC_ZERO_BYTES		5
+#define ITM_SYNC_LAST_BYTE		0x80
+
+#define ITM_OVERFLOW			0x70
+#define ITM_GTS1				0x94
+#define ITM_GTS2				0xb4
+#define ITM_CONTINUATION		BIT(7)
+
+/* header bit of a source packet set for DWT (hardware) sources */
+#define ITM_SOURCE_HW			BIT(2)
+
+/* DWT discriminator IDs */
+#define DWT_EVENT_COUNTER		0
+#define DWT_EXCEPTION			1
+#define DWT_PC_SAMPLE			2
+#define DWT_DATA_PC_FIRST		8
+#define DWT_DATA_VALUE_FIRST	16
+#define DWT_DATA_VALUE_LAST		23
+
+static const char * const arm_itm_stat_names[ARM_ITM_STAT_COUNT] = {
+	[ARM_ITM_STAT_STIMULUS] = "stimulus packets",
+	[ARM_ITM_STAT_STIMULUS_BYTES] = "stimulus bytes",
+	[ARM_ITM_STAT_PC_SAMPLE] = "PC samples",
+	[ARM_ITM_STAT_EXCEPTION] = "exception packets",
+	[ARM_ITM_STAT_DATA_TRACE] = "data trace packets",
+	[ARM_ITM_STAT_COUNTER] = "event counter packets",
+	[ARM_ITM_STAT_TIMESTAMP] = "timestamps",
+	[ARM_ITM_STAT_EXTENSION] = "extension packets",
+	[ARM_ITM_STAT_SYNC] = "ITM syncs",
+	[ARM_ITM_STAT_OVERFLOW] = "ITM overflows",
+	[ARM_ITM_STAT_INVALID] = "invalid packets",
+	[ARM_ITM_STAT_TPIU_FRAMES] = "TPIU frames",
+	[ARM_ITM_STAT_TPIU_SYNC] = "TPIU syncs",
+	[ARM_ITM_STAT_TPIU_OTHER_BYTES] = "other source bytes",
+	[ARM_ITM_STAT_TPIU_UNSYNCED_BYTES] = "unsynced bytes",
+};
+
+const char *arm_itm_stat_name(enum arm_itm_stat stat)
+{
+	return arm_itm_stat_names[stat];
+}
+
+void arm_itm_decoder_init(struct arm_itm_decoder *decoder, bool formatter,
+		unsigned int stream_id, const struct arm_itm_decoder_callbacks *callbacks)
+{
+	memset(decoder, 0, sizeof(*decoder));
+	decoder->formatter = formatter;
+	decoder->stream_id = stream_id;
+	decoder->state = ARM_ITM_STATE_HEADER;
+	decoder->callbacks = *callbacks;
+}
+
+static void itm_event(struct arm_itm_decoder *decoder, const struct arm_itm_event *event)
+{
+	if (decoder->callbacks.event)
+		decoder->callbacks.event(decoder->callbacks.priv, event);
+}
+
+static unsigned int itm_source_payload_size(uint8_t header)
+{
+	static const unsigned int size[4] = { 0, 1, 2, 4 };
+	return size[header & 0x3];
+}
+
+static void itm_source_packet(struct arm_itm_decoder *decoder, uint8_t header,
+		const uint8_t *payload, unsigned int size)
+{
+	unsigned int id = header >> 3;
+
+	if (!(header & ITM_SOURCE_HW)) {
+		decoder->stats[ARM_ITM_STAT_STIMULUS]++;
+		decoder->stats[ARM_ITM_STAT_STIMULUS_BYTES] += size;
+		if (decoder->callbacks.stimulus)
+			decoder->callbacks.stimulus(decoder->callbacks.priv,
+				decoder->stimulus_page * 32 + id, payload, size);
+		return;
+	}
+
+	struct arm_itm_event event = {
+		.size = size,
+	};
+	for (unsigned int i = 0; i < size; i++)
+		event.value |= (uint32_t)payload[i] << (8 * i);
+
+	switch (id) {
+	case DWT_EVENT_COUNTER:
+		decoder->stats[ARM_ITM_STAT_COUNTER]++;
+		event.type = ARM_ITM_EVENT_COUNTER;
+		break;
+	case DWT_EXCEPTION:
+		if (size != 2)
+			goto invalid;
+		decoder->stats[ARM_ITM_STAT_EXCEPTION]++;
+		event.type = ARM_ITM_EVENT_EXCEPTION;
+		event.function = (payload[1] >> 4) & 0x3;
+		event.value &= 0x1ff;
+		break;
+	case DWT_PC_SAMPLE:
+		if (size == 2)
+			goto invalid;
+		decoder->stats[ARM_ITM_STAT_PC_SAMPLE]++;
+		event.type = ARM_ITM_EVENT_PC_SAMPLE;
+		event.sleep = (size == 1);
+		break;
+	case DWT_DATA_PC_FIRST ... DWT_DATA_VALUE_LAST:
+		decoder->stats[ARM_ITM_STAT_DATA_TRACE]++;
+		event.comparator = (id >> 1) & 0x3;
+		if (id >= DWT_DATA_VALUE_FIRST) {
+			event.type = ARM_ITM_EVENT_DATA_VALUE;
+			event.function = id & 1;
+		} else if (id & 1) {
+			event.type = ARM_ITM_EVENT_DATA_ADDRESS;
+		} else {
+			event.type = ARM_ITM_EVENT_DATA_PC;
+		}
+		break;
+	default:
+		goto invalid;
+	}
+
+	itm_event(decoder, &event);
+	return;
+
+invalid:
+	decoder->stats[ARM_ITM_STAT_INVALID]++;
+}
+
+static void itm_continuation(struct arm_itm_decoder *decoder, unsigned int max_size)
+{
+	decoder->state = ARM_ITM_STATE_CONTINUATION;
+	decoder->payload_length = 0;
+	decoder->payload_size = max_size;
+}
+
+/* all the headers but those of source packets */
+static void itm_protocol_header(struct arm_itm_decoder *decoder, uint8_t header)
+{
+	if (header == 0) {
+		decoder->zero_count++;
+		return;
+	}
+
+	if (header == ITM_SYNC_LAST_BYTE && decoder->zero_count >= ITM_SYNC_ZERO_BYTES) {
+		decoder->stats[ARM_ITM_STAT_SYNC]++;
+		decoder->zero_count = 0;
+		return;
+	}
+	decoder->zero_count = 0;
+
+	if (header == ITM_OVERFLOW) {
+		struct arm_itm_event event = {
+			.type = ARM_ITM_EVENT_OVERFLOW,
+		};
+		decoder->stats[ARM_ITM_STAT_OVERFLOW]++;
+		itm_event(decoder, &event);
+	} else if ((header & 0x0b) == 0x08) {
+		decoder->stats[ARM_ITM_STAT_EXTENSION]++;
+		if (header & ITM_CONTINUATION)
+			itm_continuation(decoder, 4);
+		else if (!(header & ITM_SOURCE_HW))
+			/* stimulus port page, selects the ports above 31 */
+			decoder->stimulus_page = (header >> 4) & 0x7;
+	} else if ((header & 0xcf) == 0xc0) {
+		/* local timestamp, format 1 */
+		decoder->stats[ARM_ITM_STAT_TIMESTAMP]++;
+		itm_continuation(decoder, 4);
+	} else if ((header & 0x8f) == 0x00) {
+		/* local timestamp, format 2 */
+		decoder->stats[ARM_ITM_STAT_TIMESTAMP]++;
+	} else if (header == ITM_GTS1 || header == ITM_GTS2) {
+		decoder->stats[ARM_ITM_STAT_TIMESTAMP]++;
+		itm_continuation(decoder, header == ITM_GTS1 ? 4 : 6);
+	} else {
+		decoder->stats[ARM_ITM_STAT_INVALID]++;
+	}
+}
+
+static void itm_decode(struct arm_itm_decoder *decoder, const uint8_t *buffer, size_t size)
+{
+	size_t i = 0;
+
+	while (i < size) {
+		switch (decoder->state) {
+		case ARM_ITM_STATE_HEADER: {
+			uint8_t header = buffer[i++];
+			unsigned int payload_size = itm_source_payload_size(header);
+
+			if (!payload_size) {
+				itm_protocol_header(decoder, header);
+				break;
+			}
+
+			decoder->zero_count = 0;
+			if (size - i >= payload_size) {
+				itm_source_packet(decoder, header, buffer + i, payload_size);
+				i += payload_size;
+				break;
+			}
+
+			decoder->header = header;
+			decoder->payload_length = 0;
+			decoder->payload_size = payload_size;
+			decoder->state = ARM_ITM_STATE_PAYLOAD;
+			break;
+		}
+		case ARM_ITM_STATE_PAYLOAD: {
+			size_t length = MIN(decoder->payload_size - decoder->payload_length, size - i);
+
+			memcpy(decoder->payload + decoder->payload_length, buffer + i, length);
+			decoder->payload_length += length;
+			i += length;
+
+			if (decoder->payload_length == decoder->payload_size) {
+				itm_source_packet(decoder, decoder->header, decoder->payload,
+					decoder->payload_size);
+				decoder->state = ARM_ITM_STATE_HEADER;
+			}
+			break;
+		}
+		case ARM_ITM_STATE_CONTINUATION:
+			decoder->payload_length++;
+			if (!(buffer[i++] & ITM_CONTINUATION)) {
+				decoder->state = ARM_ITM_STATE_HEADER;
+			} else if (decoder->payload_length == decoder->payload_size) {
+				decoder->stats[ARM_ITM_STAT_INVALID]++;
+				decoder->state = ARM_ITM_STATE_HEADER;
+			}
+			break;
+		}
+	}
+}
+
+/*
+ * Each even byte of a frame is either data, with its LSB in the last byte
+ * of the frame, or a new source ID. The auxiliary bit of an ID change tells
+ * whether the following data byte still belongs to the previous source.
+ */
+static void tpiu_decode_frame(struct arm_itm_decoder *decoder)
+{
+	const uint8_t *frame = decoder->frame;
+	uint8_t aux = frame[ARM_TPIU_FRAME_SIZE - 1];
+	uint8_t data[ARM_TPIU_FRAME_SIZE - 1];
+	uint8_t ids[ARM_TPIU_FRAME_SIZE - 1];
+	unsigned int count = 0;
+	unsigned int id = decoder->tpiu_id;
+
+	for (unsigned int i = 0; i < ARM_TPIU_FRAME_SIZE; i += 2) {
+		bool aux_bit = aux & BIT(i / 2);
+		bool last = (i == ARM_TPIU_FRAME_SIZE - 2);
+
+		if (!last && frame[i] == 0xff && frame[i + 1] == 0x7f) {
+			/* halfword synchronization, ignored */
+			continue;
+		}
+
+		if (frame[i] & 1) {
+			if (aux_bit && !last) {
+				ids[count] = id;
+				data[count++] = frame[i + 1];
+				id = frame[i] >> 1;
+				continue;
+			}
+			id = frame[i] >> 1;
+		} else {
+			ids[count] = id;
+			data[count++] = (frame[i] & 0xfe) | aux_bit;
+		}
+
+		if (!last) {
+			ids[count] = id;
+			data[count++] = frame[i + 1];
+		}
+	}
+	decoder->tpiu_id = id;
+	decoder->stats[ARM_ITM_STAT_TPIU_FRAMES]++;
+
+	/* pass on the runs of ITM bytes */
+	unsigned int start = 0;
+	for (unsigned int i = 0; i <= count; i++) {
+		if (i < count && ids[i] == decoder->stream_id)
+			continue;
+		if (i > start)
+			itm_decode(decoder, data + start, i - start);
+		if (i < count && ids[i] != TPIU_ID_NULL)
+			decoder->stats[ARM_ITM_STAT_TPIU_OTHER_BYTES]++;
+		start = i + 1;
+	}
+}
+
+static void tpiu_decode(struct arm_itm_decoder *decoder, const uint8_t *buffer, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		decoder->tpiu_sync_window = (decoder->tpiu_sync_window << 8) | buffer[i];
+		if (decoder->tpiu_sync_window == TPIU_FULL_SYNC) {
+			/* sync packets only occur between frames */
+			decoder->stats[ARM_ITM_STAT_TPIU_SYNC]++;
+			decoder->tpiu_synced = true;
+			decoder->frame_length = 0;
+			continue;
+		}
+
+		if (!decoder->tpiu_synced) {
+			decoder->stats[ARM_ITM_STAT_TPIU_UNSYNCED_BYTES]++;
+			continue;
+		}
+
+		decoder->frame[decoder->frame_length++] = buffer[i];
+		if (decoder->frame_length == ARM_TPIU_FRAME_SIZE) {
+			tpiu_decode_frame(decoder);
+			decoder->frame_length = 0;
+		}
+	}
+}
+
+void arm_itm_decode(struct arm_itm_decoder *decoder, const uint8_t *buffer, size_t size)
+{
+	if (decoder->formatter)
+		tpiu_decode(decoder, buffer, size);
+	else
+		itm_decode(decoder, buffer, size);
+}
@@ -0,0 +1,131 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Streaming decoder of the ARMv7-M ITM/DWT trace protocol, optionally
+ * wrapped in the frames of the CoreSight TPIU formatter.
+ */
+
+#ifndef OPENOCD_TARGET_ARM_ITM_DECODE_H
+#define OPENOCD_TARGET_ARM_ITM_DECODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ITM has 256 stimulus ports */
+#define ARM_ITM_STIMULUS_PORTS		256
+
+#define ARM_TPIU_FRAME_SIZE			16
+
+enum arm_itm_event_type {
+	/** DWT periodic PC sample, or the core was sleeping */
+	ARM_ITM_EVENT_PC_SAMPLE,
+	/** DWT exception trace */
+	ARM_ITM_EVENT_EXCEPTION,
+	/** DWT data trace, PC of the access matched by a comparator */
+	ARM_ITM_EVENT_DATA_PC,
+	/** DWT data trace, low halfword of the address matched by a comparator */
+	ARM_ITM_EVENT_DATA_ADDRESS,
+	/** DWT data trace, value read or written */
+	ARM_ITM_EVENT_DATA_VALUE,
+	/** DWT event counter wrap */
+	ARM_ITM_EVENT_COUNTER,
+	/** ITM overflow, trace data has been lost in the target */
+	ARM_ITM_EVENT_OVERFLOW,
+};
+
+enum arm_itm_exception_function {
+	ARM_ITM_EXCEPTION_ENTERED = 1,
+	ARM_ITM_EXCEPTION_EXITED = 2,
+	ARM_ITM_EXCEPTION_RETURNED = 3,
+};
+
+struct arm_itm_event {
+	enum arm_itm_event_type type;
+	/** PC, exception number, address, data value or counter flags */
+	uint32_t value;
+	/** exception function, or true for a data write */
+	unsigned int function;
+	/** DWT comparator of a data trace packet */
+	unsigned int comparator;
+	/** size in bytes of a data value */
+	unsigned int size;
+	/** PC sample taken while the core was sleeping, value is invalid */
+	bool sleep;
+};
+
+enum arm_itm_stat {
+	ARM_ITM_STAT_STIMULUS,
+	ARM_ITM_STAT_STIMULUS_BYTES,
+	ARM_ITM_STAT_PC_SAMPLE,
+	ARM_ITM_STAT_EXCEPTION,
+	ARM_ITM_STAT_DATA_TRACE,
+	ARM_ITM_STAT_COUNTER,
+	ARM_ITM_STAT_TIMESTAMP,
+	ARM_ITM_STAT_EXTENSION,
+	ARM_ITM_STAT_SYNC,
+	ARM_ITM_STAT_OVERFLOW,
+	/** reserved headers and malformed packets */
+	ARM_ITM_STAT_INVALID,
+	ARM_ITM_STAT_TPIU_FRAMES,
+	ARM_ITM_STAT_TPIU_SYNC,
+	/** bytes of other trace sources in the TPIU frames */
+	ARM_ITM_STAT_TPIU_OTHER_BYTES,
+	/** bytes received before the first TPIU synchronization */
+	ARM_ITM_STAT_TPIU_UNSYNCED_BYTES,
+	ARM_ITM_STAT_COUNT,
+};
+
+struct arm_itm_decoder_callbacks {
+	/**
+	 * Payload of a stimulus port packet. The data points into the
+	 * buffer passed to arm_itm_decode() whenever the packet is not split
+	 * across buffers or TPIU frames.
+	 */
+	void (*stimulus)(void *priv, unsigned int port, const uint8_t *data, unsigned int size);
+	/** Decoded hardware source packet or overflow */
+	void (*event)(void *priv, const struct arm_itm_event *event);
+	void *priv;
+};
+
+enum arm_itm_decoder_state {
+	ARM_ITM_STATE_HEADER,
+	ARM_ITM_STATE_PAYLOAD,
+	ARM_ITM_STATE_CONTINUATION,
+};
+
+struct arm_itm_decoder {
+	/** the stream is wrapped in TPIU formatter frames */
+	bool formatter;
+	/** TPIU source ID of the ITM, as programmed in ITM_TCR.TraceBusID */
+	unsigned int stream_id;
+
+	/* TPIU frame demultiplexer */
+	bool tpiu_synced;
+	uint32_t tpiu_sync_window;
+	unsigned int tpiu_id;
+	uint8_t frame[ARM_TPIU_FRAME_SIZE];
+	unsigned int frame_length;
+
+	/* ITM packet parser */
+	enum arm_itm_decoder_state state;
+	uint8_t header;
+	uint8_t payload[4];
+	unsigned int payload_length;
+	unsigned int payload_size;
+	unsigned int zero_count;
+	unsigned int stimulus_page;
+
+	struct arm_itm_decoder_callbacks callbacks;
+	uint64_t stats[ARM_ITM_STAT_COUNT];
+};
+
+void arm_itm_decoder_init(struct arm_itm_decoder *decoder, bool formatter,
+		unsigned int stream_id, const struct arm_itm_decoder_callbacks *callbacks);
+
+/** Decode a chunk of the trace stream, the state is kept across calls. */
+void arm_itm_decode(struct arm_itm_decoder *decoder, const uint8_t *buffer, size_t size);
+
+const char *arm_itm_stat_name(enum arm_itm_stat stat);
+
+#endif /* OPENOCD_TARGET_ARM_ITM_DECODE_H */
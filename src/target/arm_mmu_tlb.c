@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include "arm_mmu_tlb.h"
+
+void arm_mmu_tlb_invalidate(struct arm_mmu_tlb *tlb)
+{
+	memset(tlb->entries, 0, sizeof(tlb->entries));
+	tlb->next = 0;
+}
+
+bool arm_mmu_tlb_lookup(struct arm_mmu_tlb *tlb, target_addr_t va,
+		target_addr_t *pa, uint64_t *attr)
+{
+	for (unsigned int i = 0; i < ARM_MMU_TLB_ENTRIES; i++) {
+		const struct arm_mmu_tlb_entry *entry = &tlb->entries[i];
+
+		if (entry->mask && (va & ~entry->mask) == entry->va) {
+			*pa = entry->pa | (va & entry->mask);
+			if (attr)
+				*attr = entry->attr;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void arm_mmu_tlb_insert(struct arm_mmu_tlb *tlb, target_addr_t va, target_addr_t pa,
+		unsigned int size_shift, uint64_t attr)
+{
+	struct arm_mmu_tlb_entry *entry = &tlb->entries[tlb->next];
+	target_addr_t mask = ((target_addr_t)1 << size_shift) - 1;
+
+	entry->va = va & ~mask;
+	entry->pa = pa & ~mask;
+	entry->mask = mask;
+	entry->attr = attr;
+	tlb->next = (tlb->next + 1) % ARM_MMU_TLB_ENTRIES;
+}
@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Cache of the address translations done while the core is halted, for
+ * the ARMv7-A and ARMv8-A MMU code. It is valid for one halt only.
+ */
+
+#ifndef OPENOCD_TARGET_ARM_MMU_TLB_H
+#define OPENOCD_TARGET_ARM_MMU_TLB_H
+
+#include <helper/types.h>
+
+#define ARM_MMU_TLB_ENTRIES		64
+
+struct arm_mmu_tlb_entry {
+	target_addr_t va;
+	target_addr_t pa;
+	/** size - 1 of the page or block, zero for a free entry */
+	target_addr_t mask;
+	/** architecture specific attributes, e.g. the PAR of the translation */
+	uint64_t attr;
+};
+
+/** Small fully associative cache, replaced round robin */
+struct arm_mmu_tlb {
+	struct arm_mmu_tlb_entry entries[ARM_MMU_TLB_ENTRIES];
+	unsigned int next;
+};
+
+void arm_mmu_tlb_invalidate(struct arm_mmu_tlb *tlb);
+bool arm_mmu_tlb_lookup(struct arm_mmu_tlb *tlb, target_addr_t va,
+		target_addr_t *pa, uint64_t *attr);
+void arm_mmu_tlb_insert(struct arm_mmu_tlb *tlb, target_addr_t va, target_addr_t pa,
+		unsigned int size_shift, uint64_t attr);
+
+#endif /* OPENOCD_TARGET_ARM_MMU_TLB_H */
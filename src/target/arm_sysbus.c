@@ -0,0 +1,355 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <helper/log.h>
+#include <helper/nvp.h>
+#include "arm.h"
+#include "arm_adi_v5.h"
+#include "arm_sysbus.h"
+#include "target.h"
+
+static const struct nvp nvp_sysbus_policies[] = {
+	{ .name = "cpu", .value = ARM_SYSBUS_CPU },
+	{ .name = "bus", .value = ARM_SYSBUS_BUS },
+	{ .name = "bus-nocache", .value = ARM_SYSBUS_BUS_NOCACHE },
+	{ .name = NULL, .value = -1 },
+};
+
+void arm_sysbus_init(struct arm_sysbus *sysbus)
+{
+	/* the first AXI-AP or AHB-AP can be the one of another core */
+	sysbus->mode = ARM_SYSBUS_AP_NONE;
+	sysbus->ap_num = DP_APSEL_INVALID;
+	sysbus->ap = NULL;
+	sysbus->ap_type = 0;
+	sysbus->secure = false;
+	sysbus->caches_clean = false;
+	sysbus->mmu_state_known = false;
+	INIT_LIST_HEAD(&sysbus->regions);
+}
+
+static bool arm_sysbus_is_system_ap(uint32_t idr)
+{
+	switch (idr & AP_TYPE_MASK) {
+	case AP_TYPE_AXI_AP:
+	case AP_TYPE_AXI5_AP:
+	case AP_TYPE_AHB3_AP:
+	case AP_TYPE_AHB5_AP:
+	case AP_TYPE_AHB5H_AP:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * First AXI-AP or AHB-AP of the DAP, the APB-AP of the debug registers is
+ * never picked, nor an AP already in use, e.g. by a Cortex-M target
+ */
+static struct adiv5_ap *arm_sysbus_find_ap(struct adiv5_dap *dap)
+{
+	if (is_adiv6(dap)) {
+		LOG_DEBUG("On ADIv6 the system bus AP must be selected with 'sysbus ap'");
+		return NULL;
+	}
+
+	for (unsigned int ap_num = 0; ap_num <= DP_APSEL_MAX; ap_num++) {
+		struct adiv5_ap *ap = dap_get_ap(dap, ap_num);
+		if (!ap)
+			continue;
+
+		if (ap->refcount > 1) {
+			dap_put_ap(ap);
+			continue;
+		}
+
+		uint32_t idr = 0;
+		int retval = dap_queue_ap_read(ap, AP_REG_IDR(dap), &idr);
+		if (retval == ERROR_OK)
+			retval = dap_run(dap);
+		if (retval == ERROR_OK && arm_sysbus_is_system_ap(idr)) {
+			LOG_DEBUG("Found system bus AP at AP index: %u (IDR=0x%08" PRIX32 ")", ap_num, idr);
+			return ap;
+		}
+		dap_put_ap(ap);
+	}
+
+	return NULL;
+}
+
+/**
+ * Select the system MEM-AP as configured, searching the DAP for one in
+ * auto mode. Not finding one is not an error: the accesses then go through
+ * the core.
+ */
+int arm_sysbus_examine(struct arm_sysbus *sysbus, struct adiv5_dap *dap)
+{
+	if (!sysbus->ap) {
+		switch (sysbus->mode) {
+		case ARM_SYSBUS_AP_AUTO:
+			sysbus->ap = arm_sysbus_find_ap(dap);
+			if (!sysbus->ap) {
+				/* do not search again at each examine */
+				sysbus->mode = ARM_SYSBUS_AP_NONE;
+				LOG_DEBUG("No system bus AP found, memory is accessed through the core");
+				return ERROR_OK;
+			}
+			break;
+		case ARM_SYSBUS_AP_NUM:
+			sysbus->ap = dap_get_ap(dap, sysbus->ap_num);
+			if (!sysbus->ap) {
+				LOG_ERROR("Cannot get system bus AP #0x%" PRIx64, sysbus->ap_num);
+				return ERROR_FAIL;
+			}
+			break;
+		case ARM_SYSBUS_AP_NONE:
+			return ERROR_OK;
+		}
+	}
+
+	uint32_t idr = 0;
+	int retval = dap_queue_ap_read(sysbus->ap, AP_REG_IDR(dap), &idr);
+	if (retval == ERROR_OK)
+		retval = dap_run(dap);
+	if (retval == ERROR_OK)
+		retval = mem_ap_init(sysbus->ap);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Could not initialize the system bus AP");
+		dap_put_ap(sysbus->ap);
+		sysbus->ap = NULL;
+		return retval;
+	}
+
+	sysbus->ap_type = idr & AP_TYPE_MASK;
+	arm_sysbus_set_security(sysbus, sysbus->secure);
+
+	return ERROR_OK;
+}
+
+/**
+ * Make the accesses of the system MEM-AP Secure or Non-secure, as the
+ * core is at its debug entry.
+ */
+void arm_sysbus_set_security(struct arm_sysbus *sysbus, bool secure)
+{
+	struct adiv5_ap *ap = sysbus->ap;
+
+	sysbus->secure = secure;
+	if (!ap)
+		return;
+
+	switch (sysbus->ap_type) {
+	case AP_TYPE_AXI_AP:
+	case AP_TYPE_AXI5_AP:
+		ap->csw_default |= CSW_AXI_ARPROT0_PRIV;
+		if (secure)
+			ap->csw_default &= ~CSW_AXI_ARPROT1_NONSEC;
+		else
+			ap->csw_default |= CSW_AXI_ARPROT1_NONSEC;
+		break;
+	case AP_TYPE_AHB5_AP:
+	case AP_TYPE_AHB5H_AP:
+		if (secure)
+			ap->csw_default &= ~CSW_AHB_SPROT;
+		else
+			ap->csw_default |= CSW_AHB_SPROT;
+		break;
+	default:
+		/* AHB3: no Non-secure accesses */
+		break;
+	}
+}
+
+void arm_sysbus_release(struct arm_sysbus *sysbus)
+{
+	struct arm_sysbus_region *region, *tmp;
+
+	if (sysbus->ap) {
+		dap_put_ap(sysbus->ap);
+		sysbus->ap = NULL;
+	}
+
+	list_for_each_entry_safe(region, tmp, &sysbus->regions, lh) {
+		list_del(&region->lh);
+		free(region);
+	}
+}
+
+/**
+ * Policy for an access of @a count items of @a size bytes at the physical
+ * @a address. The policy holds for the first @a route_count items, the
+ * caller routes the rest of the access again.
+ */
+enum arm_sysbus_policy arm_sysbus_route(struct arm_sysbus *sysbus,
+		target_addr_t address, uint32_t size, uint32_t count, uint32_t *route_count)
+{
+	enum arm_sysbus_policy policy = ARM_SYSBUS_BUS;
+	target_addr_t end = (target_addr_t)-1;
+	struct arm_sysbus_region *region;
+
+	*route_count = count;
+	if (!sysbus->ap)
+		return ARM_SYSBUS_CPU;
+
+	list_for_each_entry(region, &sysbus->regions, lh) {
+		if (address >= region->base && address - region->base < region->size) {
+			policy = region->policy;
+			end = region->base + region->size;
+			break;
+		}
+		/* the default policy holds up to the next region */
+		if (region->base > address && region->base < end)
+			end = region->base;
+	}
+
+	if (end - address < (target_addr_t)count * size)
+		*route_count = MAX((end - address) / size, 1);
+
+	return policy;
+}
+
+static struct arm_sysbus *arm_sysbus_from_command(struct command_invocation *cmd)
+{
+	struct target *target = get_current_target(cmd->ctx);
+	struct arm *arm = target_to_arm(target);
+
+	if (!is_arm(arm) || !arm->sysbus) {
+		command_print(cmd, "current target has no system bus access");
+		return NULL;
+	}
+
+	return arm->sysbus;
+}
+
+COMMAND_HANDLER(arm_sysbus_handle_ap_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct arm_sysbus *sysbus = arm_sysbus_from_command(CMD);
+	if (!sysbus)
+		return ERROR_FAIL;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		enum arm_sysbus_mode mode;
+		uint64_t ap_num = DP_APSEL_INVALID;
+
+		if (!strcmp(CMD_ARGV[0], "auto")) {
+			mode = ARM_SYSBUS_AP_AUTO;
+		} else if (!strcmp(CMD_ARGV[0], "none")) {
+			mode = ARM_SYSBUS_AP_NONE;
+		} else {
+			COMMAND_PARSE_NUMBER(u64, CMD_ARGV[0], ap_num);
+			mode = ARM_SYSBUS_AP_NUM;
+		}
+
+		if (sysbus->ap) {
+			dap_put_ap(sysbus->ap);
+			sysbus->ap = NULL;
+		}
+		sysbus->mode = mode;
+		sysbus->ap_num = ap_num;
+
+		if (target_was_examined(target)) {
+			int retval = arm_sysbus_examine(sysbus, target_to_arm(target)->dap);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	if (sysbus->ap)
+		command_print(CMD, "system bus AP #0x%" PRIx64, sysbus->ap->ap_num);
+	else if (sysbus->mode == ARM_SYSBUS_AP_NONE || target_was_examined(target))
+		command_print(CMD, "no system bus AP, memory is accessed through the core");
+	else
+		command_print(CMD, "system bus AP selected at examine");
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(arm_sysbus_handle_region_command)
+{
+	struct arm_sysbus *sysbus = arm_sysbus_from_command(CMD);
+	struct arm_sysbus_region *region, *tmp;
+	if (!sysbus)
+		return ERROR_FAIL;
+
+	if (CMD_ARGC == 1 && !strcmp(CMD_ARGV[0], "clear")) {
+		list_for_each_entry_safe(region, tmp, &sysbus->regions, lh) {
+			list_del(&region->lh);
+			free(region);
+		}
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC == 3) {
+		target_addr_t base, size;
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[0], base);
+		COMMAND_PARSE_NUMBER(target_addr, CMD_ARGV[1], size);
+		const struct nvp *n = nvp_name2value(nvp_sysbus_policies, CMD_ARGV[2]);
+		if (!n->name || !size)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		list_for_each_entry(region, &sysbus->regions, lh) {
+			if (base - region->base < region->size || region->base - base < size) {
+				command_print(CMD, "region overlaps " TARGET_ADDR_FMT "+" TARGET_ADDR_FMT,
+						region->base, region->size);
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+		}
+
+		region = malloc(sizeof(*region));
+		if (!region) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		region->base = base;
+		region->size = size;
+		region->policy = n->value;
+		list_add_tail(&region->lh, &sysbus->regions);
+	} else if (CMD_ARGC != 0) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	list_for_each_entry(region, &sysbus->regions, lh)
+		command_print(CMD, TARGET_ADDR_FMT " " TARGET_ADDR_FMT " %s", region->base, region->size,
+				nvp_value2name(nvp_sysbus_policies, region->policy)->name);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration arm_sysbus_subcommand_handlers[] = {
+	{
+		.name = "ap",
+		.handler = arm_sysbus_handle_ap_command,
+		.mode = COMMAND_ANY,
+		.help = "select the MEM-AP used for system bus memory accesses",
+		.usage = "['auto'|'none'|ap_num]",
+	},
+	{
+		.name = "region",
+		.handler = arm_sysbus_handle_region_command,
+		.mode = COMMAND_ANY,
+		.help = "list, add or clear the physical memory regions "
+			"with their own access policy",
+		.usage = "['clear' | address size ('cpu'|'bus'|'bus-nocache')]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct command_registration arm_sysbus_command_handlers[] = {
+	{
+		.name = "sysbus",
+		.mode = COMMAND_ANY,
+		.help = "system bus memory access commands",
+		.usage = "",
+		.chain = arm_sysbus_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Memory access through a system bus MEM-AP (AXI-AP or AHB-AP) for the
+ * Cortex-A/R and AArch64 targets, next to the slower access through the
+ * core in debug state.
+ */
+
+#ifndef OPENOCD_TARGET_ARM_SYSBUS_H
+#define OPENOCD_TARGET_ARM_SYSBUS_H
+
+#include <helper/command.h>
+#include <helper/list.h>
+#include <helper/types.h>
+
+struct adiv5_ap;
+struct adiv5_dap;
+
+/** How an access to a physical address range reaches the memory */
+enum arm_sysbus_policy {
+	/** through the core, in debug state */
+	ARM_SYSBUS_CPU,
+	/** through the system MEM-AP, after cleaning the core data caches */
+	ARM_SYSBUS_BUS,
+	/** through the system MEM-AP, without any cache maintenance */
+	ARM_SYSBUS_BUS_NOCACHE,
+};
+
+/** How the system MEM-AP is selected */
+enum arm_sysbus_mode {
+	ARM_SYSBUS_AP_AUTO,
+	ARM_SYSBUS_AP_NONE,
+	ARM_SYSBUS_AP_NUM,
+};
+
+struct arm_sysbus_region {
+	struct list_head lh;
+	target_addr_t base;
+	target_addr_t size;
+	enum arm_sysbus_policy policy;
+};
+
+struct arm_sysbus {
+	enum arm_sysbus_mode mode;
+	/** AP number used with ARM_SYSBUS_AP_NUM */
+	uint64_t ap_num;
+	/** system MEM-AP in use, NULL when accesses go through the core */
+	struct adiv5_ap *ap;
+	/** AP_TYPE_xxx of the system MEM-AP */
+	uint32_t ap_type;
+	/** the core was in Secure state at the last debug entry */
+	bool secure;
+	/** the core data caches were cleaned since the last debug entry */
+	bool caches_clean;
+	/** the MMU state was read at a debug entry; until then a virtual
+	 * address cannot be taken for a physical one */
+	bool mmu_state_known;
+	/** policy overrides, by physical address */
+	struct list_head regions;
+};
+
+void arm_sysbus_init(struct arm_sysbus *sysbus);
+int arm_sysbus_examine(struct arm_sysbus *sysbus, struct adiv5_dap *dap);
+void arm_sysbus_release(struct arm_sysbus *sysbus);
+void arm_sysbus_set_security(struct arm_sysbus *sysbus, bool secure);
+enum arm_sysbus_policy arm_sysbus_route(struct arm_sysbus *sysbus,
+		target_addr_t address, uint32_t size, uint32_t count, uint32_t *route_count);
+
+extern const struct command_registration arm_sysbus_command_handlers[];
+
+#endif /* OPENOCD_TARGET_ARM_SYSBUS_H */
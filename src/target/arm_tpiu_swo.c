@@ -30,20 +30,24 @@
 #include <helper/jim-nvp.h>
 #include <helper/list.h>
 #include <helper/log.h>
+#include <helper/time_support.h>
 #include <helper/types.h>
 #include <jtag/interface.h>
 #include <server/server.h>
 #include <target/arm_adi_v5.h>
+#include <target/arm_itm_decode.h>
+#include <target/cortex_m.h>
+#include <target/profile_histogram.h>
 #include <target/target.h>
 #include <transport/transport.h>
 #include "arm_tpiu_swo.h"
 
 /* START_DEPRECATED_TPIU */
-#include <target/cortex_m.h>
 #define MSG "DEPRECATED \'tpiu config\' command: "
 /* END_DEPRECATED_TPIU */
 
 #define TCP_SERVICE_NAME                "tpiu_swo_trace"
+#define ITM_TCP_SERVICE_NAME            "tpiu_swo_itm"
 
 /* default for Cortex-M3 and Cortex-M4 specific TPIU */
 #define TPIU_SWO_DEFAULT_BASE           0xE0040000
@@ -112,6 +116,26 @@ struct arm_tpiu_swo_object {
 	char *out_filename;
 	/** track TCP connections */
 	struct list_head connections;
+	/** TPIU source ID of the ITM */
+	unsigned int itm_stream_id;
+	/** outputs of the decoded ITM stream */
+	struct list_head itm_sinks;
+	/** the sink of each stimulus port, the last one for the DWT packets */
+	struct arm_tpiu_swo_itm_sink *itm_port_sink[ARM_ITM_STIMULUS_PORTS + 1];
+	/** the ITM stream is decoded while capturing */
+	bool itm_decoding;
+	struct arm_itm_decoder itm_decoder;
+	/** PC samples of the DWT are binned in profile_hist */
+	bool profiling;
+	struct profile_histogram profile_hist;
+	uint64_t profile_sleep_samples;
+	/** target whose DWT is sampling */
+	struct target *profile_target;
+	/** DWT_CTRL before the sampling started */
+	uint32_t profile_saved_dwt_ctrl;
+	int64_t profile_start_ms;
+	/** sampling time before the last start */
+	int64_t profile_duration_ms;
 	/* START_DEPRECATED_TPIU */
 	bool recheck_ap_cur_target;
 	/* END_DEPRECATED_TPIU */
@@ -130,6 +154,154 @@ static OOCD_LIST_HEAD(all_tpiu_swo);
 
 #define ARM_TPIU_SWO_TRACE_BUF_SIZE	4096
 
+/* port number of the sink of the DWT packets */
+#define ARM_TPIU_SWO_ITM_EVENTS		ARM_ITM_STIMULUS_PORTS
+
+/* the longest line written to the events sink */
+#define ARM_TPIU_SWO_ITM_EVENT_LEN	64
+
+struct arm_tpiu_swo_itm_sink {
+	struct list_head lh;
+	/** stimulus port, or ARM_TPIU_SWO_ITM_EVENTS */
+	unsigned int port;
+	/** file name, or ':' followed by the TCP port */
+	char *output;
+	FILE *file;
+	bool service_started;
+	/** track TCP connections */
+	struct list_head connections;
+	/** data decoded by the current poll */
+	uint8_t buffer[ARM_TPIU_SWO_TRACE_BUF_SIZE];
+	size_t length;
+	uint64_t bytes;
+	/** bytes not accepted by the file or by a TCP client */
+	uint64_t lost;
+};
+
+struct arm_tpiu_swo_priv_itm_connection {
+	struct arm_tpiu_swo_itm_sink *sink;
+};
+
+static void arm_tpiu_swo_itm_sink_flush(struct arm_tpiu_swo_itm_sink *sink)
+{
+	struct arm_tpiu_swo_connection *c;
+
+	if (!sink->length)
+		return;
+
+	sink->bytes += sink->length;
+
+	if (sink->file) {
+		if (fwrite(sink->buffer, 1, sink->length, sink->file) == sink->length) {
+			fflush(sink->file);
+		} else {
+			LOG_DEBUG("Error writing ITM port %u to \"%s\"", sink->port, sink->output);
+			sink->lost += sink->length;
+		}
+	}
+
+	/* sockets are non-blocking, whatever a slow client does not take is lost */
+	list_for_each_entry(c, &sink->connections, lh) {
+		int written = connection_write(c->connection, sink->buffer, sink->length);
+		if (written < 0)
+			written = 0;
+		sink->lost += sink->length - written;
+	}
+
+	sink->length = 0;
+}
+
+static void arm_tpiu_swo_itm_sink_write(struct arm_tpiu_swo_itm_sink *sink,
+		const uint8_t *data, size_t size)
+{
+	if (size > sizeof(sink->buffer) - sink->length)
+		arm_tpiu_swo_itm_sink_flush(sink);
+
+	memcpy(sink->buffer + sink->length, data, size);
+	sink->length += size;
+}
+
+static void arm_tpiu_swo_itm_stimulus(void *priv, unsigned int port,
+		const uint8_t *data, unsigned int size)
+{
+	struct arm_tpiu_swo_object *obj = priv;
+	struct arm_tpiu_swo_itm_sink *sink = obj->itm_port_sink[port];
+
+	if (sink)
+		arm_tpiu_swo_itm_sink_write(sink, data, size);
+}
+
+static const char * const arm_tpiu_swo_exception_functions[] = {
+	[ARM_ITM_EXCEPTION_ENTERED] = "entered",
+	[ARM_ITM_EXCEPTION_EXITED] = "exited",
+	[ARM_ITM_EXCEPTION_RETURNED] = "returned",
+};
+
+/* the DWT packets are written as text, one line per packet */
+static void arm_tpiu_swo_itm_event(void *priv, const struct arm_itm_event *event)
+{
+	struct arm_tpiu_swo_object *obj = priv;
+	struct arm_tpiu_swo_itm_sink *sink = obj->itm_port_sink[ARM_TPIU_SWO_ITM_EVENTS];
+	char line[ARM_TPIU_SWO_ITM_EVENT_LEN];
+	int len;
+
+	if (event->type == ARM_ITM_EVENT_PC_SAMPLE && obj->profiling) {
+		if (event->sleep)
+			obj->profile_sleep_samples++;
+		else
+			profile_histogram_add(&obj->profile_hist, event->value, 1);
+	}
+
+	if (!sink)
+		return;
+
+	switch (event->type) {
+	case ARM_ITM_EVENT_PC_SAMPLE:
+		if (event->sleep)
+			len = snprintf(line, sizeof(line), "pc sleep\n");
+		else
+			len = snprintf(line, sizeof(line), "pc 0x%08" PRIx32 "\n", event->value);
+		break;
+	case ARM_ITM_EVENT_EXCEPTION:
+		len = snprintf(line, sizeof(line), "exception %" PRIu32 " %s\n", event->value,
+			event->function ? arm_tpiu_swo_exception_functions[event->function] : "unknown");
+		break;
+	case ARM_ITM_EVENT_DATA_PC:
+		len = snprintf(line, sizeof(line), "data %u pc 0x%08" PRIx32 "\n",
+			event->comparator, event->value);
+		break;
+	case ARM_ITM_EVENT_DATA_ADDRESS:
+		len = snprintf(line, sizeof(line), "data %u address 0x%04" PRIx32 "\n",
+			event->comparator, event->value);
+		break;
+	case ARM_ITM_EVENT_DATA_VALUE:
+		len = snprintf(line, sizeof(line), "data %u %s 0x%0*" PRIx32 "\n",
+			event->comparator, event->function ? "write" : "read",
+			(int)event->size * 2, event->value);
+		break;
+	case ARM_ITM_EVENT_COUNTER:
+		len = snprintf(line, sizeof(line), "counter 0x%02" PRIx32 "\n", event->value);
+		break;
+	case ARM_ITM_EVENT_OVERFLOW:
+		len = snprintf(line, sizeof(line), "overflow\n");
+		break;
+	default:
+		return;
+	}
+
+	arm_tpiu_swo_itm_sink_write(sink, (const uint8_t *)line, len);
+}
+
+static void arm_tpiu_swo_itm_decode(struct arm_tpiu_swo_object *obj, const uint8_t *buf, size_t size)
+{
+	struct arm_tpiu_swo_itm_sink *sink;
+
+	arm_itm_decode(&obj->itm_decoder, buf, size);
+
+	list_for_each_entry(sink, &obj->itm_sinks, lh)
+		arm_tpiu_swo_itm_sink_flush(sink);
+}
+
 static int arm_tpiu_swo_poll_trace(void *priv)
 {
 	struct arm_tpiu_swo_object *obj = priv;
@@ -157,6 +329,9 @@ static int arm_tpiu_swo_poll_trace(void *priv)
 			if (connection_write(c->connection, buf, size) != (int)size)
 				LOG_ERROR("Error writing to connection"); /* FIXME: which connection? */
 
+	if (obj->itm_decoding)
+		arm_tpiu_swo_itm_decode(obj, buf, size);
+
 	return ERROR_OK;
 }
 
@@ -196,14 +371,43 @@ static int arm_tpiu_swo_handle_event(struct arm_tpiu_swo_object *obj, enum arm_t
 	return ERROR_OK;
 }
 
+static void arm_tpiu_swo_itm_sink_close(struct arm_tpiu_swo_itm_sink *sink)
+{
+	if (sink->file) {
+		fclose(sink->file);
+		sink->file = NULL;
+	}
+	if (sink->service_started) {
+		remove_service(ITM_TCP_SERVICE_NAME, &sink->output[1]);
+		sink->service_started = false;
+	}
+	sink->length = 0;
+}
+
 static void arm_tpiu_swo_close_output(struct arm_tpiu_swo_object *obj)
 {
+	struct arm_tpiu_swo_itm_sink *sink;
+
 	if (obj->file) {
 		fclose(obj->file);
 		obj->file = NULL;
 	}
 	if (obj->out_filename[0] == ':')
 		remove_service(TCP_SERVICE_NAME, &obj->out_filename[1]);
+
+	list_for_each_entry(sink, &obj->itm_sinks, lh)
+		arm_tpiu_swo_itm_sink_close(sink);
+	obj->itm_decoding = false;
+}
+
+static void arm_tpiu_swo_itm_sink_free(struct arm_tpiu_swo_object *obj,
+		struct arm_tpiu_swo_itm_sink *sink)
+{
+	arm_tpiu_swo_itm_sink_close(sink);
+	obj->itm_port_sink[sink->port] = NULL;
+	list_del(&sink->lh);
+	free(sink->output);
+	free(sink);
 }
 
 int arm_tpiu_swo_cleanup_all(void)
@@ -235,6 +439,11 @@ int arm_tpiu_swo_cleanup_all(void)
 			ea = next;
 		}
 
+		struct arm_tpiu_swo_itm_sink *sink, *sink_tmp;
+		list_for_each_entry_safe(sink, sink_tmp, &obj->itm_sinks, lh)
+			arm_tpiu_swo_itm_sink_free(obj, sink);
+		profile_histogram_free(&obj->profile_hist);
+
 		if (obj->ap)
 			dap_put_ap(obj->ap);
 
@@ -292,6 +501,103 @@ static int arm_tpiu_swo_service_connection_closed(struct connection *connection)
 	return ERROR_FAIL;
 }
 
+static int arm_tpiu_swo_itm_service_new_connection(struct connection *connection)
+{
+	struct arm_tpiu_swo_priv_itm_connection *priv = connection->service->priv;
+	struct arm_tpiu_swo_connection *c = malloc(sizeof(*c));
+	if (!c) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	c->connection = connection;
+	list_add(&c->lh, &priv->sink->connections);
+	return ERROR_OK;
+}
+
+static int arm_tpiu_swo_itm_service_connection_closed(struct connection *connection)
+{
+	struct arm_tpiu_swo_priv_itm_connection *priv = connection->service->priv;
+	struct arm_tpiu_swo_connection *c, *tmp;
+
+	list_for_each_entry_safe(c, tmp, &priv->sink->connections, lh)
+		if (c->connection == connection) {
+			list_del(&c->lh);
+			free(c);
+			return ERROR_OK;
+		}
+	LOG_ERROR("Failed to find connection to close!");
+	return ERROR_FAIL;
+}
+
+static const struct service_driver arm_tpiu_swo_itm_service_driver = {
+	.name = ITM_TCP_SERVICE_NAME,
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = arm_tpiu_swo_itm_service_new_connection,
+	.input_handler = arm_tpiu_swo_service_input,
+	.connection_closed_handler = arm_tpiu_swo_itm_service_connection_closed,
+	.keep_client_alive_handler = NULL,
+};
+
+static int arm_tpiu_swo_itm_sink_open(struct arm_tpiu_swo_itm_sink *sink)
+{
+	if (sink->output[0] != ':') {
+		sink->file = fopen(sink->output, "ab");
+		if (!sink->file) {
+			LOG_ERROR("Can't open ITM destination file \"%s\"", sink->output);
+			return ERROR_FAIL;
+		}
+		return ERROR_OK;
+	}
+
+	struct arm_tpiu_swo_priv_itm_connection *priv = malloc(sizeof(*priv));
+	if (!priv) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	priv->sink = sink;
+	int retval = add_service(&arm_tpiu_swo_itm_service_driver, &sink->output[1],
+		CONNECTION_LIMIT_UNLIMITED, priv);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Can't configure ITM TCP port %s", &sink->output[1]);
+		free(priv);
+		return retval;
+	}
+	sink->service_started = true;
+	return ERROR_OK;
+}
+
+/* Start decoding the ITM stream, once the adapter captures the trace */
+static int arm_tpiu_swo_itm_start(struct arm_tpiu_swo_object *obj)
+{
+	struct arm_tpiu_swo_itm_sink *sink;
+	const struct arm_itm_decoder_callbacks callbacks = {
+		.stimulus = arm_tpiu_swo_itm_stimulus,
+		.event = arm_tpiu_swo_itm_event,
+		.priv = obj,
+	};
+
+	if (obj->itm_decoding || (list_empty(&obj->itm_sinks) && !obj->profiling))
+		return ERROR_OK;
+
+	list_for_each_entry(sink, &obj->itm_sinks, lh) {
+		int retval = arm_tpiu_swo_itm_sink_open(sink);
+		if (retval != ERROR_OK) {
+			/* the next start opens them all again */
+			struct arm_tpiu_swo_itm_sink *opened;
+			list_for_each_entry(opened, &obj->itm_sinks, lh) {
+				if (opened == sink)
+					break;
+				arm_tpiu_swo_itm_sink_close(opened);
+			}
+			return retval;
+		}
+	}
+
+	arm_itm_decoder_init(&obj->itm_decoder, obj->en_formatter, obj->itm_stream_id, &callbacks);
+	obj->itm_decoding = true;
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_arm_tpiu_swo_event_list)
 {
 	struct arm_tpiu_swo_object *obj = CMD_DATA;
@@ -749,6 +1055,13 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_enable)
 			}
 		}
 
+		retval = arm_tpiu_swo_itm_start(obj);
+		if (retval != ERROR_OK) {
+			command_print(CMD, "Can't open the ITM outputs of %s", obj->name);
+			arm_tpiu_swo_close_output(obj);
+			return retval;
+		}
+
 		retval = adapter_config_trace(true, obj->pin_protocol, obj->port_width,
 			&swo_pin_freq, obj->traceclkin_freq, &prescaler);
 		if (retval != ERROR_OK) {
@@ -839,6 +1152,30 @@ error_exit:
 	return retval;
 }
 
+static int arm_tpiu_swo_profile_stop(struct arm_tpiu_swo_object *obj)
+{
+	struct target *target = obj->profile_target;
+	const uint32_t mask = DWT_CTRL_CYCCNTENA | DWT_CTRL_POSTPRESET_MASK |
+		DWT_CTRL_CYCTAP | DWT_CTRL_PCSAMPLENA;
+	uint32_t dwt_ctrl;
+
+	if (!obj->profiling)
+		return ERROR_OK;
+
+	obj->profiling = false;
+	obj->profile_duration_ms += timeval_ms() - obj->profile_start_ms;
+
+	if (!target_was_examined(target))
+		return ERROR_OK;
+
+	int retval = target_read_u32(target, DWT_CTRL, &dwt_ctrl);
+	if (retval != ERROR_OK)
+		return retval;
+
+	dwt_ctrl = (dwt_ctrl & ~mask) | (obj->profile_saved_dwt_ctrl & mask);
+	return target_write_u32(target, DWT_CTRL, dwt_ctrl);
+}
+
 COMMAND_HANDLER(handle_arm_tpiu_swo_disable)
 {
 	struct arm_tpiu_swo_object *obj = CMD_DATA;
@@ -852,6 +1189,9 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_disable)
 
 	arm_tpiu_swo_handle_event(obj, TPIU_SWO_EVENT_PRE_DISABLE);
 
+	if (arm_tpiu_swo_profile_stop(obj) != ERROR_OK)
+		command_print(CMD, "Failed to stop the PC sampling");
+
 	if (obj->en_capture) {
 		obj->en_capture = false;
 
@@ -876,6 +1216,423 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_disable)
 	return ERROR_OK;
 }
 
+/* Show, set or remove the output of a stimulus port or of the DWT packets */
+static COMMAND_HELPER(arm_tpiu_swo_itm_output, struct arm_tpiu_swo_object *obj,
+		unsigned int port, const char *output)
+{
+	struct arm_tpiu_swo_itm_sink *sink = obj->itm_port_sink[port];
+
+	if (!output) {
+		command_print(CMD, "%s", sink ? sink->output : "off");
+		return ERROR_OK;
+	}
+
+	if (output[0] == ':') {
+		char *end;
+		long tcp_port = strtol(output + 1, &end, 0);
+		if (tcp_port <= 0 || tcp_port > UINT16_MAX || *end != '\0') {
+			command_print(CMD, "Invalid TCP port '%s'", output + 1);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	if (sink)
+		arm_tpiu_swo_itm_sink_free(obj, sink);
+
+	if (!strcmp(output, "off"))
+		return ERROR_OK;
+
+	sink = calloc(1, sizeof(*sink));
+	if (!sink) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	sink->output = strdup(output);
+	if (!sink->output) {
+		LOG_ERROR("Out of memory");
+		free(sink);
+		return ERROR_FAIL;
+	}
+	sink->port = port;
+	INIT_LIST_HEAD(&sink->connections);
+	list_add_tail(&sink->lh, &obj->itm_sinks);
+	obj->itm_port_sink[port] = sink;
+
+	if (!obj->en_capture)
+		return ERROR_OK;
+
+	/* the trace is already captured, start the output right away */
+	int retval;
+	if (obj->itm_decoding)
+		retval = arm_tpiu_swo_itm_sink_open(sink);
+	else
+		retval = arm_tpiu_swo_itm_start(obj);
+	if (retval != ERROR_OK) {
+		command_print(CMD, "Can't start ITM output \"%s\"", output);
+		arm_tpiu_swo_itm_sink_free(obj, sink);
+	}
+	return retval;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_itm_port)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+	unsigned int port;
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], port);
+	if (port >= ARM_ITM_STIMULUS_PORTS) {
+		command_print(CMD, "Invalid stimulus port %u", port);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	return CALL_COMMAND_HANDLER(arm_tpiu_swo_itm_output, obj, port,
+		CMD_ARGC == 2 ? CMD_ARGV[1] : NULL);
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_itm_events)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	return CALL_COMMAND_HANDLER(arm_tpiu_swo_itm_output, obj, ARM_TPIU_SWO_ITM_EVENTS,
+		CMD_ARGC == 1 ? CMD_ARGV[0] : NULL);
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_itm_stream_id)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+	unsigned int id;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (obj->enabled) {
+			command_print(CMD, "Cannot configure TPIU/SWO; %s is enabled!", obj->name);
+			return ERROR_FAIL;
+		}
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], id);
+		/* valid trace source IDs */
+		if (id < 0x01 || id > 0x6f) {
+			command_print(CMD, "Invalid trace source ID 0x%x", id);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		obj->itm_stream_id = id;
+	}
+
+	command_print(CMD, "0x%02x", obj->itm_stream_id);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_itm_stats)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+	struct arm_tpiu_swo_itm_sink *sink;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		memset(obj->itm_decoder.stats, 0, sizeof(obj->itm_decoder.stats));
+		list_for_each_entry(sink, &obj->itm_sinks, lh) {
+			sink->bytes = 0;
+			sink->lost = 0;
+		}
+		return ERROR_OK;
+	}
+
+	if (!obj->itm_decoding)
+		command_print(CMD, "%s: ITM decoder not running", obj->name);
+
+	for (unsigned int i = 0; i < ARM_ITM_STAT_COUNT; i++)
+		command_print(CMD, "  %-22s %" PRIu64, arm_itm_stat_name(i), obj->itm_decoder.stats[i]);
+
+	list_for_each_entry(sink, &obj->itm_sinks, lh) {
+		if (sink->port == ARM_TPIU_SWO_ITM_EVENTS)
+			command_print_sameline(CMD, "  events  ");
+		else
+			command_print_sameline(CMD, "  port %3u", sink->port);
+		command_print(CMD, " %-20s %12" PRIu64 " bytes %12" PRIu64 " lost",
+			sink->output, sink->bytes, sink->lost);
+	}
+
+	return ERROR_OK;
+}
+
+static const struct command_registration arm_tpiu_swo_itm_command_handlers[] = {
+	{
+		.name = "port",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_swo_itm_port,
+		.help = "Display, set or remove the output of an ITM stimulus port",
+		.usage = "port_num [filename|:tcp_port|off]",
+	},
+	{
+		.name = "events",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_swo_itm_events,
+		.help = "Display, set or remove the output of the decoded DWT packets",
+		.usage = "[filename|:tcp_port|off]",
+	},
+	{
+		.name = "stream_id",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_swo_itm_stream_id,
+		.help = "Display or set the TPIU source ID of the ITM stream",
+		.usage = "[id]",
+	},
+	{
+		.name = "stats",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_swo_itm_stats,
+		.help = "Display or reset the counters of the ITM decoder and of its outputs",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+/* DWT samples the PC every (POSTPRESET + 1) times 64 or 1024 cycles */
+static uint32_t arm_tpiu_swo_profile_period(unsigned int period, unsigned int *actual)
+{
+	unsigned int best = UINT_MAX;
+	uint32_t dwt_ctrl = 0;
+
+	for (unsigned int tap = 0; tap < 2; tap++) {
+		for (unsigned int n = 1; n <= 16; n++) {
+			unsigned int cycles = n * (tap ? 1024 : 64);
+			unsigned int diff = (cycles > period) ? cycles - period : period - cycles;
+			if (diff >= best)
+				continue;
+			best = diff;
+			*actual = cycles;
+			dwt_ctrl = (tap ? DWT_CTRL_CYCTAP : 0) | ((n - 1) << DWT_CTRL_POSTPRESET_SHIFT);
+		}
+	}
+
+	return dwt_ctrl;
+}
+
+static int64_t arm_tpiu_swo_profile_duration_ms(struct arm_tpiu_swo_object *obj)
+{
+	int64_t duration_ms = obj->profile_duration_ms;
+
+	if (obj->profiling)
+		duration_ms += timeval_ms() - obj->profile_start_ms;
+	return duration_ms;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_profile_start)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+	unsigned int period = 4096;
+	unsigned int actual_period = 0;
+	uint32_t dwt_ctrl;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], period);
+
+	if (obj->profiling) {
+		command_print(CMD, "%s: PC sampling already running", obj->name);
+		return ERROR_FAIL;
+	}
+
+	if (!obj->en_capture) {
+		command_print(CMD, "%s: the trace has to be captured by the adapter", obj->name);
+		return ERROR_FAIL;
+	}
+
+	struct target *target = get_current_target(CMD_CTX);
+	if (strcmp(target_type_name(target), "cortex_m") &&
+		strcmp(target_type_name(target), "hla_target")) {
+		command_print(CMD, "Current target is not a Cortex-M nor a HLA");
+		return ERROR_FAIL;
+	}
+	if (!target_was_examined(target)) {
+		command_print(CMD, "Current target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	if (!obj->profile_hist.entries) {
+		int retval = profile_histogram_init(&obj->profile_hist);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	int retval = target_read_u32(target, DWT_CTRL, &dwt_ctrl);
+	if (retval != ERROR_OK)
+		return retval;
+	obj->profile_saved_dwt_ctrl = dwt_ctrl;
+
+	dwt_ctrl &= ~(DWT_CTRL_POSTPRESET_MASK | DWT_CTRL_CYCTAP);
+	dwt_ctrl |= arm_tpiu_swo_profile_period(period, &actual_period) |
+		DWT_CTRL_CYCCNTENA | DWT_CTRL_PCSAMPLENA;
+
+	obj->profiling = true;
+	obj->profile_target = target;
+	obj->profile_start_ms = timeval_ms();
+
+	retval = arm_tpiu_swo_itm_start(obj);
+	if (retval == ERROR_OK)
+		retval = target_write_u32(target, DWT_CTRL, dwt_ctrl);
+	if (retval != ERROR_OK) {
+		obj->profiling = false;
+		return retval;
+	}
+
+	command_print(CMD, "%s: sampling the PC every %u cycles", obj->name, actual_period);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_profile_stop)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	return arm_tpiu_swo_profile_stop(obj);
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_profile_reset)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (obj->profile_hist.entries)
+		profile_histogram_reset(&obj->profile_hist);
+	obj->profile_sleep_samples = 0;
+	obj->profile_duration_ms = 0;
+	obj->profile_start_ms = timeval_ms();
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_profile_status)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	int64_t duration_ms = arm_tpiu_swo_profile_duration_ms(obj);
+	uint64_t samples = obj->profile_hist.samples + obj->profile_sleep_samples;
+
+	command_print(CMD, "%s: PC sampling %s", obj->name, obj->profiling ? "running" : "stopped");
+	command_print(CMD, "%" PRIu64 " samples, %" PRIu64 " while sleeping, %u distinct PCs",
+		samples, obj->profile_sleep_samples, obj->profile_hist.used);
+	command_print(CMD, "%" PRId64 ".%03" PRId64 " s, %" PRIu64 " samples/s",
+		duration_ms / 1000, duration_ms % 1000,
+		duration_ms > 0 ? samples * 1000 / duration_ms : 0);
+	command_print(CMD, "%" PRIu64 " ITM overflows", obj->itm_decoder.stats[ARM_ITM_STAT_OVERFLOW]);
+	return ERROR_OK;
+}
+
+/* Write a snapshot of the histogram, the sampling goes on */
+COMMAND_HANDLER(handle_arm_tpiu_swo_profile_write)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+	bool gmon = !strcmp(CMD_NAME, "gmon");
+	uint32_t start_address = 0;
+	uint32_t end_address = 0;
+	int retval;
+
+	if (CMD_ARGC != 1 && !(gmon && CMD_ARGC == 3))
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 3) {
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], start_address);
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], end_address);
+		if (start_address > end_address || (end_address - start_address) < 2) {
+			command_print(CMD, "Error: end - start < 2");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	if (!obj->profile_hist.entries) {
+		command_print(CMD, "%s: no PC samples", obj->name);
+		return ERROR_FAIL;
+	}
+
+	if (gmon)
+		retval = profile_histogram_write_gmon(&obj->profile_hist, CMD_ARGV[0],
+			CMD_ARGC == 3, start_address, end_address, obj->profile_target,
+			arm_tpiu_swo_profile_duration_ms(obj));
+	else if (!strcmp(CMD_NAME, "folded"))
+		retval = profile_histogram_write_folded(&obj->profile_hist, CMD_ARGV[0]);
+	else
+		retval = profile_histogram_write_csv(&obj->profile_hist, CMD_ARGV[0]);
+	if (retval != ERROR_OK)
+		return retval;
+
+	command_print(CMD, "Wrote %s", CMD_ARGV[0]);
+	return ERROR_OK;
+}
+
+static const struct command_registration arm_tpiu_swo_profile_command_handlers[] = {
+	{
+		.name = "start",
+		.mode = COMMAND_EXEC,
+		.handler = handle_arm_tpiu_swo_profile_start,
+		.help = "Start the DWT PC sampling of the current target and bin the samples",
+		.usage = "[period_cycles]",
+	},
+	{
+		.name = "stop",
+		.mode = COMMAND_EXEC,
+		.handler = handle_arm_tpiu_swo_profile_stop,
+		.help = "Stop the DWT PC sampling, the histogram is kept",
+		.usage = "",
+	},
+	{
+		.name = "reset",
+		.mode = COMMAND_EXEC,
+		.handler = handle_arm_tpiu_swo_profile_reset,
+		.help = "Clear the histogram",
+		.usage = "",
+	},
+	{
+		.name = "status",
+		.mode = COMMAND_EXEC,
+		.handler = handle_arm_tpiu_swo_profile_status,
+		.help = "Display the number and the rate of the PC samples",
+		.usage = "",
+	},
+	{
+		.name = "gmon",
+		.mode = COMMAND_EXEC,
+		.handler = handle_arm_tpiu_swo_profile_write,
+		.help = "Write the histogram as a gmon.out file",
+		.usage = "filename [start end]",
+	},
+	{
+		.name = "folded",
+		.mode = COMMAND_EXEC,
+		.handler = handle_arm_tpiu_swo_profile_write,
+		.help = "Write the histogram in the folded stack format of flame graphs",
+		.usage = "filename",
+	},
+	{
+		.name = "csv",
+		.mode = COMMAND_EXEC,
+		.handler = handle_arm_tpiu_swo_profile_write,
+		.help = "Write the histogram as CSV",
+		.usage = "filename",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration arm_tpiu_swo_instance_command_handlers[] = {
 	{
 		.name = "configure",
@@ -912,6 +1669,20 @@ static const struct command_registration arm_tpiu_swo_instance_command_handlers[
 		.usage = "",
 		.help = "Disables the TPIU/SWO output",
 	},
+	{
+		.name = "itm",
+		.mode = COMMAND_ANY,
+		.help = "ITM decoder command group",
+		.usage = "",
+		.chain = arm_tpiu_swo_itm_command_handlers,
+	},
+	{
+		.name = "profile",
+		.mode = COMMAND_EXEC,
+		.help = "PC sampling profiler command group",
+		.usage = "",
+		.chain = arm_tpiu_swo_profile_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -936,6 +1707,8 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_create)
 		return ERROR_FAIL;
 	}
 	INIT_LIST_HEAD(&obj->connections);
+	INIT_LIST_HEAD(&obj->itm_sinks);
+	obj->itm_stream_id = 1;
 	adiv5_mem_ap_spot_init(&obj->spot);
 	obj->spot.base = TPIU_SWO_DEFAULT_BASE;
 	obj->port_width = 1;
@@ -13,6 +13,8 @@
 #include "armv4_5_mmu.h"
 #include "armv4_5_cache.h"
 #include "arm_dpm.h"
+#include "arm_mmu_tlb.h"
+#include "arm_sysbus.h"
 
 enum {
 	ARM_PC  = 15,
@@ -82,6 +84,9 @@ struct armv7a_mmu_common {
 			uint32_t count, uint8_t *buffer);
 	struct armv7a_cache_common armv7a_cache;
 	bool mmu_enabled;
+
+	/* translations done during the current halt */
+	struct arm_mmu_tlb tlb;
 };
 
 struct armv7a_common {
@@ -94,6 +99,10 @@ struct armv7a_common {
 	struct arm_dpm dpm;
 	target_addr_t debug_base;
 	struct adiv5_ap *debug_ap;
+
+	/* Memory access through the system bus */
+	struct arm_sysbus sysbus;
+
 	/* mdir */
 	uint8_t multi_processor_system;
 	uint8_t multi_threading_processor;
@@ -53,6 +53,64 @@ static int armv7a_l1_i_cache_sanity_check(struct target *target)
 	return ERROR_OK;
 }
 
+/*
+ * Clean and invalidate a cache level with the DCC in stall mode: the
+ * accesses to DTRRX and ITR wait for the core to be ready, so the set/way
+ * operations of a set are queued without polling DSCR per line.
+ */
+static int armv7a_l1_d_cache_flush_level_stall(struct target *target, struct armv7a_cachesize *size, int cl)
+{
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+	struct adiv5_ap *ap = armv7a->debug_ap;
+	target_addr_t base = armv7a->debug_base;
+	uint32_t dscr, stall_dscr;
+
+	int retval = mem_ap_read_atomic_u32(ap, base + CPUDBG_DSCR, &dscr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	stall_dscr = (dscr & ~DSCR_EXT_DCC_MASK) | DSCR_EXT_DCC_STALL_MODE;
+	retval = mem_ap_write_atomic_u32(ap, base + CPUDBG_DSCR, stall_dscr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (int32_t c_index = size->index; c_index >= 0 && retval == ERROR_OK; c_index--) {
+		keep_alive();
+		for (int32_t c_way = size->way; c_way >= 0 && retval == ERROR_OK; c_way--) {
+			uint32_t value = (c_index << size->index_shift)
+				| (c_way << size->way_shift) | (cl << 1);
+
+			retval = mem_ap_write_u32(ap, base + CPUDBG_DTRRX, value);
+			/* MRC p14, 0, r0, c0, c5, 0 - r0 from DTRRX */
+			if (retval == ERROR_OK)
+				retval = mem_ap_write_u32(ap, base + CPUDBG_ITR,
+						ARMV4_5_MRC(14, 0, 0, 0, 5, 0));
+			/* DCCISW - Clean and invalidate data cache line by Set/Way */
+			if (retval == ERROR_OK)
+				retval = mem_ap_write_u32(ap, base + CPUDBG_ITR,
+						ARMV4_5_MCR(15, 0, 0, 7, 14, 2));
+		}
+		if (retval == ERROR_OK)
+			retval = dap_run(ap->dap);
+	}
+
+	/* back to non-blocking mode, then check the operations did not abort */
+	int retval2 = mem_ap_write_atomic_u32(ap, base + CPUDBG_DSCR,
+			(dscr & ~DSCR_EXT_DCC_MASK) | DSCR_EXT_DCC_NON_BLOCKING);
+	if (retval == ERROR_OK)
+		retval = retval2;
+	if (retval == ERROR_OK)
+		retval = mem_ap_read_atomic_u32(ap, base + CPUDBG_DSCR, &dscr);
+	if (retval == ERROR_OK && (dscr & (DSCR_STICKY_ABORT_PRECISE | DSCR_STICKY_UNDEFINED))) {
+		LOG_TARGET_ERROR(target, "d-cache clean by set/way failed, dscr 0x%08" PRIx32, dscr);
+		mem_ap_write_atomic_u32(ap, base + CPUDBG_DRCR, DRCR_CLEAR_EXCEPTIONS);
+		retval = ERROR_FAIL;
+	}
+
+	keep_alive();
+	return retval;
+}
+
 static int armv7a_l1_d_cache_flush_level(struct arm_dpm *dpm, struct armv7a_cachesize *size, int cl)
 {
 	int retval = ERROR_OK;
@@ -100,13 +158,17 @@ static int armv7a_l1_d_cache_clean_inval_all(struct target *target)
 	if (retval != ERROR_OK)
 		goto done;
 
+	int64_t then = timeval_ms();
 	for (cl = 0; cl < cache->loc; cl++) {
 		/* skip i-only caches */
 		if (cache->arch[cl].ctype < CACHE_LEVEL_HAS_D_CACHE)
 			continue;
 
-		armv7a_l1_d_cache_flush_level(dpm, &cache->arch[cl].d_u_size, cl);
+		if (armv7a_l1_d_cache_flush_level_stall(target, &cache->arch[cl].d_u_size, cl) != ERROR_OK)
+			armv7a_l1_d_cache_flush_level(dpm, &cache->arch[cl].d_u_size, cl);
 	}
+	LOG_DEBUG("d-cache clean and invalidate by set/way took %" PRId64 " ms",
+		timeval_ms() - then);
 
 	retval = dpm->finish(dpm);
 	return retval;
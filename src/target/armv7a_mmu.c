@@ -23,17 +23,13 @@
 
 #define SCTLR_BIT_AFE (1 << 29)
 
-/*  V7 method VA TO PA  */
-int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
-	target_addr_t *val, int meminfo)
+/* Translate with the CP15 VA to PA operation and return the PAR */
+static int armv7a_mmu_translate_at(struct target *target, uint32_t va, uint32_t *par)
 {
-	int retval = ERROR_FAIL;
 	struct armv7a_common *armv7a = target_to_armv7a(target);
 	struct arm_dpm *dpm = armv7a->arm.dpm;
-	uint32_t virt = va & ~0xfff, value;
-	uint32_t NOS, NS, INNER, OUTER, SS;
-	*val = 0xdeadbeef;
-	retval = dpm->prepare(dpm);
+	uint32_t virt = va & ~0xfff;
+	int retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		goto done;
 	/*  mmu must be enable in order to get a correct translation
@@ -45,9 +41,61 @@ int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
 		goto done;
 	retval = dpm->instr_read_data_r0(dpm,
 			ARMV4_5_MRC(15, 0, 0, 7, 4, 0),
-			&value);
-	if (retval != ERROR_OK)
-		goto done;
+			par);
+
+done:
+	dpm->finish(dpm);
+
+	return retval;
+}
+
+void armv7a_mmu_invalidate_translations(struct armv7a_common *armv7a)
+{
+	arm_mmu_tlb_invalidate(&armv7a->armv7a_mmu.tlb);
+}
+
+/*
+ * V7 method VA TO PA
+ *
+ * The translations are cached until the core resumes, with the PAR to
+ * decode the memory attributes.
+ */
+int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
+	target_addr_t *val, int meminfo)
+{
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+	struct arm_mmu_tlb *tlb = &armv7a->armv7a_mmu.tlb;
+	uint32_t NOS, NS, INNER, OUTER, SS;
+	target_addr_t pa;
+	uint64_t attr;
+	uint32_t value;
+	*val = 0xdeadbeef;
+
+	if (arm_mmu_tlb_lookup(tlb, va, &pa, &attr)) {
+		value = attr;
+	} else {
+		int retval = armv7a_mmu_translate_at(target, va, &value);
+		if (retval != ERROR_OK)
+			return retval;
+
+		SS = (value >> 1) & 1;
+		if (SS) {
+			/* PAR[31:24] contains PA[31:24] */
+			pa = value & 0xff000000;
+			/* PAR [23:16] contains PA[39:32] */
+			pa |= (target_addr_t)(value & 0x00ff0000) << 16;
+		} else {
+			pa = value & ~0xfff;
+		}
+
+		/* keep the faults out of the cache, the next attempt may succeed */
+		if (!(value & 1))
+			arm_mmu_tlb_insert(tlb, va, pa, SS ? 24 : 12, value);
+
+		/* PA[23:12] is the same as VA[23:12] in a super section */
+		pa |= va & (SS ? 0xffffff : 0xfff);
+	}
+	*val = pa;
 
 	/* decode memory attribute */
 	SS = (value >> 1) & 1;
@@ -56,16 +104,6 @@ int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
 	INNER = (value >> 4) &  0x7;
 	OUTER = (value >> 2) & 0x3;
 
-	if (SS) {
-		/* PAR[31:24] contains PA[31:24] */
-		*val = value & 0xff000000;
-		/* PAR [23:16] contains PA[39:32] */
-		*val |= (target_addr_t)(value & 0x00ff0000) << 16;
-		/* PA[23:12] is the same as VA[23:12] */
-		*val |= (va & 0xffffff);
-	} else {
-		*val = (value & ~0xfff)  +  (va & 0xfff);
-	}
 	if (meminfo) {
 		LOG_INFO("%" PRIx32 " : %" TARGET_PRIxADDR " %s outer shareable %s secured %s super section",
 			va, *val,
@@ -110,10 +148,7 @@ int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
 		}
 	}
 
-done:
-	dpm->finish(dpm);
-
-	return retval;
+	return ERROR_OK;
 }
 
 static const char *desc_bits_to_string(bool c_bit, bool b_bit, bool s_bit, bool ap2, int ap10, bool afe)
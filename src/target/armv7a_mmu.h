@@ -8,8 +8,11 @@
 #ifndef OPENOCD_TARGET_ARMV7A_MMU_H
 #define OPENOCD_TARGET_ARMV7A_MMU_H
 
+struct armv7a_common;
+
 extern int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
 	target_addr_t *val, int meminfo);
+void armv7a_mmu_invalidate_translations(struct armv7a_common *armv7a);
 
 extern const struct command_registration armv7a_mmu_command_handlers[];
 
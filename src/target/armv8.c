@@ -1134,31 +1134,248 @@ static void armv8_decode_memory_attr(int attr)
 	}
 }
 
-/*  V8 method VA TO PA  */
-int armv8_mmu_translate_va_pa(struct target *target, target_addr_t va,
-	target_addr_t *val, int meminfo)
+#define HCR_EL2_VM		(1ULL << 0)
+#define HCR_EL2_DC		(1ULL << 12)
+#define HCR_EL2_TGE		(1ULL << 27)
+#define HCR_EL2_E2H		(1ULL << 34)
+
+#define SCTLR_EE		(1ULL << 25)
+
+#define TCR_EPD0		(1ULL << 7)
+#define TCR_EPD1		(1ULL << 23)
+
+/* output address of the descriptors and of PAR_EL1 */
+#define ARMV8_MMU_OA_MASK	0x0000FFFFFFFFF000ULL
+/* PAR_EL1 bits other than the physical address */
+#define ARMV8_PAR_ATTR_MASK	(~ARMV8_MMU_OA_MASK)
+
+/* number of level 3 descriptors read at once by the walker */
+#define ARMV8_MMU_WALK_PREFETCH	8
+
+void armv8_mmu_invalidate_translations(struct armv8_common *armv8)
 {
-	struct armv8_common *armv8 = target_to_armv8(target);
-	struct arm *arm = target_to_arm(target);
+	armv8->armv8_mmu.regime.valid = false;
+	arm_mmu_tlb_invalidate(&armv8->armv8_mmu.tlb);
+}
+
+/*
+ * Read the registers of the translation regime of the current exception
+ * level. The walker is left disabled where it would get the translation
+ * wrong: a stage 2 translation may follow, the EL2&0 regime or AArch32.
+ */
+static int armv8_mmu_read_regime(struct armv8_common *armv8)
+{
+	struct armv8_mmu_regime *regime = &armv8->armv8_mmu.regime;
 	struct arm_dpm *dpm = &armv8->dpm;
-	enum arm_mode target_mode = ARM_MODE_ANY;
-	uint32_t retval;
-	uint32_t instr = 0;
-	uint64_t par;
+	struct arm *arm = &armv8->arm;
+	uint64_t hcr = 0;
+	int retval;
 
-	static const char * const shared_name[] = {
-			"Non-", "UNDEFINED ", "Outer ", "Inner "
-	};
+	memset(regime, 0, sizeof(*regime));
+	regime->valid = true;
+	regime->mode = arm->core_mode;
 
-	static const char * const secure_name[] = {
-			"Secure", "Not Secure"
-	};
+	if (arm->core_state != ARM_STATE_AARCH64 || !armv8->armv8_mmu.mmu_enabled)
+		return ERROR_OK;
 
-	if (target->state != TARGET_HALTED) {
-		LOG_TARGET_ERROR(target, "not halted");
-		return ERROR_TARGET_NOT_HALTED;
+	retval = dpm->prepare(dpm);
+	if (retval != ERROR_OK)
+		return retval;
+
+	switch (armv8_curel_from_core_mode(arm->core_mode)) {
+	case SYSTEM_CUREL_EL0:
+	case SYSTEM_CUREL_EL1:
+		/* HCR_EL2 tells if a stage 2 follows, as for the AT instruction */
+		retval = armv8_dpm_modeswitch(dpm, ARMV8_64_EL2H);
+		if (retval == ERROR_OK)
+			retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_HCR_EL2, 0), &hcr);
+		if (retval != ERROR_OK || (hcr & (HCR_EL2_VM | HCR_EL2_DC | HCR_EL2_TGE)))
+			break;
+		retval = armv8_dpm_modeswitch(dpm, ARMV8_64_EL1H);
+		if (retval == ERROR_OK)
+			retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_SCTLR_EL1, 0), &regime->sctlr);
+		if (retval == ERROR_OK)
+			retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_TCR_EL1, 0), &regime->tcr);
+		if (retval == ERROR_OK)
+			retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_TTBR0_EL1, 0), &regime->ttbr[0]);
+		if (retval == ERROR_OK)
+			retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_TTBR1_EL1, 0), &regime->ttbr[1]);
+		if (retval == ERROR_OK)
+			retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_MAIR_EL1, 0), &regime->mair);
+		regime->walkable = retval == ERROR_OK;
+		break;
+	case SYSTEM_CUREL_EL2:
+		retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_HCR_EL2, 0), &hcr);
+		if (retval != ERROR_OK || (hcr & HCR_EL2_E2H))
+			break;
+		retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_SCTLR_EL2, 0), &regime->sctlr);
+		if (retval == ERROR_OK)
+			retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_TCR_EL2, 0), &regime->tcr);
+		if (retval == ERROR_OK)
+			retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_TTBR0_EL2, 0), &regime->ttbr[0]);
+		if (retval == ERROR_OK)
+			retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_MAIR_EL2, 0), &regime->mair);
+		regime->walkable = retval == ERROR_OK;
+		break;
+	case SYSTEM_CUREL_EL3:
+		retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_SCTLR_EL3, 0), &regime->sctlr);
+		if (retval == ERROR_OK)
+			retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_TCR_EL3, 0), &regime->tcr);
+		if (retval == ERROR_OK)
+			retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_TTBR0_EL3, 0), &regime->ttbr[0]);
+		if (retval == ERROR_OK)
+			retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_MAIR_EL3, 0), &regime->mair);
+		regime->walkable = retval == ERROR_OK;
+		break;
+	default:
+		break;
 	}
 
+	armv8_dpm_modeswitch(dpm, ARM_MODE_ANY);
+	dpm->finish(dpm);
+
+	LOG_DEBUG("page table walker %s, tcr 0x%" PRIx64 " ttbr0 0x%" PRIx64 " ttbr1 0x%" PRIx64,
+		regime->walkable ? "enabled" : "disabled", regime->tcr, regime->ttbr[0], regime->ttbr[1]);
+
+	/* the AT instruction remains, and reports the error if any */
+	return ERROR_OK;
+}
+
+/* PAR_EL1 attributes of a block or page descriptor */
+static uint64_t armv8_mmu_desc_attr(const struct armv8_mmu_regime *regime, uint64_t desc,
+		bool ns_table)
+{
+	uint64_t attr = (regime->mair >> (8 * ((desc >> 2) & 7))) & 0xFF;
+	uint64_t sh = (desc >> 8) & 3;
+	uint64_t ns = ((desc >> 5) & 1) | ns_table;
+
+	/* device and non-cacheable memory are reported outer shareable */
+	if ((attr & 0xF0) == 0 || attr == 0x44)
+		sh = 2;
+
+	return (attr << 56) | (ns << 9) | (sh << 7);
+}
+
+/*
+ * Walk the stage 1 translation tables in target memory. On success return
+ * the output address of the block or page and its size as a shift, and the
+ * attributes in the format of PAR_EL1. The neighbouring level 3 pages read
+ * along are added to the TLB. Any translation fault is left to the AT
+ * instruction, which reports it.
+ */
+static int armv8_mmu_walk(struct target *target, target_addr_t va, uint64_t *pa,
+		unsigned int *size_shift, uint64_t *par_attr)
+{
+	struct armv8_common *armv8 = target_to_armv8(target);
+	struct armv8_mmu_common *mmu = &armv8->armv8_mmu;
+	const struct armv8_mmu_regime *regime = &mmu->regime;
+	bool two_ranges = armv8_curel_from_core_mode(regime->mode) <= SYSTEM_CUREL_EL1;
+	bool upper = two_ranges && ((va >> 55) & 1);
+	bool big_endian = regime->sctlr & SCTLR_EE;
+	unsigned int tsz, granule;
+	bool tbi;
+
+	if (!upper) {
+		if (two_ranges && (regime->tcr & TCR_EPD0))
+			return ERROR_FAIL;
+		tsz = regime->tcr & 0x3F;
+		/* TG0: 4KB, 64KB, 16KB */
+		static const unsigned int tg0_granule[] = { 12, 16, 14, 0 };
+		granule = tg0_granule[(regime->tcr >> 14) & 3];
+		tbi = two_ranges ? (regime->tcr >> 37) & 1 : (regime->tcr >> 20) & 1;
+	} else {
+		if (regime->tcr & TCR_EPD1)
+			return ERROR_FAIL;
+		tsz = (regime->tcr >> 16) & 0x3F;
+		/* TG1: reserved, 16KB, 4KB, 64KB */
+		static const unsigned int tg1_granule[] = { 0, 14, 12, 16 };
+		granule = tg1_granule[(regime->tcr >> 30) & 3];
+		tbi = (regime->tcr >> 38) & 1;
+	}
+
+	if (!granule || tsz < 16 || tsz > 39)
+		return ERROR_FAIL;
+
+	/* the bits above the input address are all 0 for TTBR0, all 1 for TTBR1 */
+	unsigned int ia_size = 64 - tsz;
+	unsigned int top = tbi ? 56 : 64;
+	uint64_t high_mask = (1ULL << (top - ia_size)) - 1;
+	if (((va >> ia_size) & high_mask) != (upper ? high_mask : 0))
+		return ERROR_FAIL;
+
+	uint64_t ia = va & ((1ULL << ia_size) - 1);
+	unsigned int stride = granule - 3;
+	unsigned int level = 3 - (ia_size - 1 - granule) / stride;
+	uint64_t table = regime->ttbr[upper ? 1 : 0] & ARMV8_MMU_OA_MASK;
+	bool ns_table = false;
+
+	for (;; level++) {
+		unsigned int shift = granule + (3 - level) * stride;
+		unsigned int index = (ia >> shift) & ((1U << stride) - 1);
+		unsigned int first = index;
+		unsigned int count = 1;
+		uint8_t buf[8 * ARMV8_MMU_WALK_PREFETCH];
+
+		if (level == 3) {
+			first = index & ~(ARMV8_MMU_WALK_PREFETCH - 1);
+			count = ARMV8_MMU_WALK_PREFETCH;
+		}
+
+		int retval = mmu->read_physical_memory(target, table + 8 * first, 8, count, buf);
+		if (retval != ERROR_OK)
+			return retval;
+
+		const uint8_t *p = buf + 8 * (index - first);
+		uint64_t desc = big_endian ? be_to_h_u64(p) : le_to_h_u64(p);
+
+		if (!(desc & 1))
+			return ERROR_FAIL;
+
+		if (level < 3 && (desc & 2)) {
+			table = desc & ARMV8_MMU_OA_MASK & ~((1ULL << granule) - 1);
+			ns_table |= (desc >> 63) & 1;
+			continue;
+		}
+
+		/* no level 0 blocks, nor level 1 blocks with 16KB and 64KB granules */
+		if (level == 0 || (level == 1 && granule != 12) || (level == 3 && !(desc & 2)))
+			return ERROR_FAIL;
+
+		/* the access flag is not set, the access faults */
+		if (!(desc & (1 << 10)))
+			return ERROR_FAIL;
+
+		*pa = desc & ARMV8_MMU_OA_MASK & ~((1ULL << shift) - 1);
+		*size_shift = shift;
+		*par_attr = armv8_mmu_desc_attr(regime, desc, ns_table);
+
+		for (unsigned int i = 0; level == 3 && i < count; i++) {
+			if (first + i == index)
+				continue;
+			p = buf + 8 * i;
+			desc = big_endian ? be_to_h_u64(p) : le_to_h_u64(p);
+			if ((desc & 3) != 3 || !(desc & (1 << 10)))
+				continue;
+			target_addr_t page_va = (va & ~((1ULL << (shift + stride)) - 1)) |
+				((target_addr_t)(first + i) << shift);
+			arm_mmu_tlb_insert(&mmu->tlb, page_va, desc & ARMV8_MMU_OA_MASK, shift,
+				armv8_mmu_desc_attr(regime, desc, ns_table));
+		}
+
+		return ERROR_OK;
+	}
+}
+
+/* Translate with the AT instruction and return PAR_EL1 */
+static int armv8_mmu_translate_at(struct target *target, target_addr_t va, uint64_t *par)
+{
+	struct armv8_common *armv8 = target_to_armv8(target);
+	struct arm *arm = target_to_arm(target);
+	struct arm_dpm *dpm = &armv8->dpm;
+	enum arm_mode target_mode = ARM_MODE_ANY;
+	int retval;
+	uint32_t instr = 0;
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		return retval;
@@ -1192,7 +1409,7 @@ int armv8_mmu_translate_va_pa(struct target *target, target_addr_t va,
 	retval = dpm->instr_write_data_r0_64(dpm, instr, (uint64_t)va);
 	/* read result from PAR_EL1 */
 	if (retval == ERROR_OK)
-		retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_PAR_EL1, 0), &par);
+		retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_PAR_EL1, 0), par);
 
 	/* switch back to saved PE mode */
 	if (target_mode != ARM_MODE_ANY)
@@ -1200,29 +1417,92 @@ int armv8_mmu_translate_va_pa(struct target *target, target_addr_t va,
 
 	dpm->finish(dpm);
 
-	if (retval != ERROR_OK)
-		return retval;
+	return retval;
+}
+
+/*
+ * V8 method VA TO PA
+ *
+ * The translations are cached until the core resumes. On a miss the page
+ * tables are walked by OpenOCD when possible, else the translation is done
+ * by the core with the AT instruction.
+ */
+int armv8_mmu_translate_va_pa(struct target *target, target_addr_t va,
+	target_addr_t *val, int meminfo)
+{
+	struct armv8_common *armv8 = target_to_armv8(target);
+	struct arm *arm = target_to_arm(target);
+	struct armv8_mmu_common *mmu = &armv8->armv8_mmu;
+	int retval;
+	target_addr_t pa;
+	uint64_t par_attr;
 
-	if (par & 1) {
-		LOG_ERROR("Address translation failed at stage %i, FST=%x, PTW=%i",
-				((int)(par >> 9) & 1)+1, (int)(par >> 1) & 0x3f, (int)(par >> 8) & 1);
+	static const char * const shared_name[] = {
+			"Non-", "UNDEFINED ", "Outer ", "Inner "
+	};
+
+	static const char * const secure_name[] = {
+			"Secure", "Not Secure"
+	};
+
+	if (target->state != TARGET_HALTED) {
+		LOG_TARGET_ERROR(target, "not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	/* e.g. the mode was changed by a write to the PSR */
+	if (mmu->regime.valid && mmu->regime.mode != arm->core_mode)
+		armv8_mmu_invalidate_translations(armv8);
+
+	if (!mmu->regime.valid) {
+		retval = armv8_mmu_read_regime(armv8);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (!arm_mmu_tlb_lookup(&mmu->tlb, va, &pa, &par_attr)) {
+		unsigned int size_shift;
 
-		*val = 0;
 		retval = ERROR_FAIL;
-	} else {
-		*val = (par & 0xFFFFFFFFF000UL) | (va & 0xFFF);
-		if (meminfo) {
-			int SH = (par >> 7) & 3;
-			int NS = (par >> 9) & 1;
-			int ATTR = (par >> 56) & 0xFF;
-
-			LOG_USER("%sshareable, %s",
-					shared_name[SH], secure_name[NS]);
-			armv8_decode_memory_attr(ATTR);
+		if (mmu->regime.walkable)
+			retval = armv8_mmu_walk(target, va, &pa, &size_shift, &par_attr);
+
+		if (retval != ERROR_OK) {
+			uint64_t par;
+
+			retval = armv8_mmu_translate_at(target, va, &par);
+			if (retval != ERROR_OK)
+				return retval;
+
+			if (par & 1) {
+				LOG_ERROR("Address translation failed at stage %i, FST=%x, PTW=%i",
+						((int)(par >> 9) & 1)+1, (int)(par >> 1) & 0x3f, (int)(par >> 8) & 1);
+
+				*val = 0;
+				return ERROR_FAIL;
+			}
+
+			pa = par & ARMV8_MMU_OA_MASK;
+			size_shift = 12;
+			par_attr = par & ARMV8_PAR_ATTR_MASK;
 		}
+
+		arm_mmu_tlb_insert(&mmu->tlb, va, pa, size_shift, par_attr);
+		pa |= va & ((1ULL << size_shift) - 1);
 	}
 
-	return retval;
+	*val = pa;
+	if (meminfo) {
+		int SH = (par_attr >> 7) & 3;
+		int NS = (par_attr >> 9) & 1;
+		int ATTR = (par_attr >> 56) & 0xFF;
+
+		LOG_USER("%sshareable, %s",
+				shared_name[SH], secure_name[NS]);
+		armv8_decode_memory_attr(ATTR);
+	}
+
+	return ERROR_OK;
 }
 
 COMMAND_HANDLER(armv8_handle_exception_catch_command)
@@ -1746,9 +2026,22 @@ static int armv8_set_core_reg(struct reg *reg, uint8_t *buf)
 	return ERROR_OK;
 }
 
+static int armv8_get_core_regs(struct reg **regs, unsigned int count)
+{
+	struct arm_reg *armv8_reg = regs[0]->arch_info;
+	struct target *target = armv8_reg->target;
+	struct arm *arm = target_to_arm(target);
+
+	if (target->state != TARGET_HALTED)
+		return ERROR_TARGET_NOT_HALTED;
+
+	return armv8_dpm_read_core_regs(arm->dpm, regs, count);
+}
+
 static const struct reg_arch_type armv8_reg_type = {
 	.get = armv8_get_core_reg,
 	.set = armv8_set_core_reg,
+	.get_many = armv8_get_core_regs,
 };
 
 static int armv8_get_core_reg32(struct reg *reg)
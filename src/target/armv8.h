@@ -13,6 +13,8 @@
 #include "armv4_5_cache.h"
 #include "armv8_dpm.h"
 #include "arm_cti.h"
+#include "arm_mmu_tlb.h"
+#include "arm_sysbus.h"
 
 enum {
 	ARMV8_R0 = 0,
@@ -167,6 +169,19 @@ struct armv8_cache_common {
 			struct armv8_cache_common *armv8_cache);
 };
 
+/* Translation regime of the halted core, for the page table walker */
+struct armv8_mmu_regime {
+	bool valid;
+	/* false when the walker can't translate, e.g. under a stage 2 */
+	bool walkable;
+	/* core mode the registers below were read in */
+	enum arm_mode mode;
+	uint64_t sctlr;
+	uint64_t tcr;
+	uint64_t ttbr[2];
+	uint64_t mair;
+};
+
 struct armv8_mmu_common {
 	/* following field mmu working way */
 	int32_t ttbr1_used; /*  -1 not initialized, 0 no ttbr1 1 ttbr1 used and  */
@@ -180,6 +195,10 @@ struct armv8_mmu_common {
 			uint32_t size, uint32_t count, uint8_t *buffer);
 	struct armv8_cache_common armv8_cache;
 	bool mmu_enabled;
+
+	/* translations done during the current halt */
+	struct armv8_mmu_regime regime;
+	struct arm_mmu_tlb tlb;
 };
 
 struct armv8_common {
@@ -193,6 +212,9 @@ struct armv8_common {
 	target_addr_t debug_base;
 	struct adiv5_ap *debug_ap;
 
+	/* Memory access through the system bus */
+	struct arm_sysbus sysbus;
+
 	const uint32_t *opcodes;
 
 	/* armv8 aarch64 need below information for page translation */
@@ -294,6 +316,7 @@ int armv8_identify_cache(struct armv8_common *armv8);
 int armv8_init_arch_info(struct target *target, struct armv8_common *armv8);
 int armv8_mmu_translate_va_pa(struct target *target, target_addr_t va,
 		target_addr_t *val, int meminfo);
+void armv8_mmu_invalidate_translations(struct armv8_common *armv8);
 
 int armv8_handle_cache_info_command(struct command_invocation *cmd,
 		struct armv8_cache_common *armv8_cache);
@@ -9,6 +9,8 @@
 #include "config.h"
 #endif
 
+#include <helper/time_support.h>
+
 #include "armv8_cache.h"
 #include "armv8_dpm.h"
 #include "armv8_opcodes.h"
@@ -39,33 +41,54 @@ static int armv8_i_cache_sanity_check(struct armv8_common *armv8)
 	return ERROR_TARGET_INVALID;
 }
 
+/*
+ * Clean and invalidate a cache level, one way at a time. In AArch64 state
+ * the sets of a way are done in a single DPM batch: X0 is loaded with the
+ * first set of the way, then DC CISW and an ADD to the next set are
+ * repeated, with no DCC transfer nor polling per line. Set/way operations
+ * can be repeated, so a way whose batch failed is done again line by line,
+ * from the drained DCC and reloaded X0 left by armv8_dpm_instr_batch_r0().
+ */
 static int armv8_cache_d_inner_flush_level(struct armv8_common *armv8, struct armv8_cachesize *size, int cl)
 {
 	struct arm_dpm *dpm = armv8->arm.dpm;
+	unsigned int sets = size->index + 1;
+	uint32_t *opcodes = NULL;
 	int retval = ERROR_OK;
-	int32_t c_way, c_index = size->index;
 
 	LOG_DEBUG("cl %" PRId32, cl);
-	do {
-		c_way = size->way;
-		do {
-			uint32_t value = (c_index << size->index_shift)
-				| (c_way << size->way_shift) | (cl << 1);
+
+	if (armv8->arm.core_state == ARM_STATE_AARCH64)
+		opcodes = malloc(2 * sets * sizeof(*opcodes));
+	if (opcodes) {
+		for (unsigned int i = 0; i < sets; i++) {
+			opcodes[2 * i] = ARMV8_SYS(SYSTEM_DCCISW, 0);
+			opcodes[2 * i + 1] = ARMV8_ADD_IMM_64(0, 0, 1 << size->index_shift);
+		}
+	}
+
+	for (int32_t c_way = size->way; c_way >= 0; c_way--) {
+		uint32_t way_value = (c_way << size->way_shift) | (cl << 1);
+
+		keep_alive();
+		if (opcodes && armv8_dpm_instr_batch_r0(dpm, way_value, opcodes, 2 * sets) == ERROR_OK)
+			continue;
+
+		for (int32_t c_index = size->index; c_index >= 0; c_index--) {
 			/*
 			 * DC CISW - Clean and invalidate data cache
 			 * line by Set/Way.
 			 */
 			retval = dpm->instr_write_data_r0(dpm,
-					armv8_opcode(armv8, ARMV8_OPC_DCCISW), value);
+					armv8_opcode(armv8, ARMV8_OPC_DCCISW),
+					(c_index << size->index_shift) | way_value);
 			if (retval != ERROR_OK)
 				goto done;
-			c_way -= 1;
-		} while (c_way >= 0);
-		keep_alive();
-		c_index -= 1;
-	} while (c_index >= 0);
+		}
+	}
 
  done:
+	free(opcodes);
 	return retval;
 }
 
@@ -84,6 +107,7 @@ static int armv8_cache_d_inner_clean_inval_all(struct armv8_common *armv8)
 	if (retval != ERROR_OK)
 		goto done;
 
+	int64_t then = timeval_ms();
 	for (cl = 0; cl < cache->loc; cl++) {
 		/* skip i-only caches */
 		if (cache->arch[cl].ctype < CACHE_LEVEL_HAS_D_CACHE)
@@ -91,6 +115,8 @@ static int armv8_cache_d_inner_clean_inval_all(struct armv8_common *armv8)
 
 		armv8_cache_d_inner_flush_level(armv8, &cache->arch[cl].d_u_size, cl);
 	}
+	LOG_DEBUG("d-cache clean and invalidate by set/way took %" PRId64 " ms",
+		timeval_ms() - then);
 
 	retval = dpm->finish(dpm);
 	return retval;
@@ -141,7 +167,7 @@ done:
 	return retval;
 }
 
-static int armv8_cache_i_inner_clean_inval_all(struct armv8_common *armv8)
+int armv8_cache_i_inner_clean_inval_all(struct armv8_common *armv8)
 {
 	struct arm_dpm *dpm = armv8->arm.dpm;
 	int retval;
@@ -478,6 +478,11 @@ static int dpmv8_bpwp_disable(struct arm_dpm *dpm, unsigned int index_t)
  * Coprocessor support
  */
 
+static void dpmv8_invalidate_translations(struct arm_dpm *dpm)
+{
+	armv8_mmu_invalidate_translations(dpm->arm->arch_info);
+}
+
 /* Read coprocessor */
 static int dpmv8_mrc(struct target *target, int cpnum,
 	uint32_t op1, uint32_t op2, uint32_t crn, uint32_t crm,
@@ -524,6 +529,8 @@ static int dpmv8_mcr(struct target *target, int cpnum,
 	retval = dpm->instr_write_data_r0(dpm,
 			ARMV4_5_MCR(cpnum, op1, 0, crn, crm, op2),
 			value);
+	if (retval == ERROR_OK)
+		arm_dpm_report_cp_write(dpm, cpnum, crn);
 
 	dpm->finish(dpm);
 	return retval;
@@ -729,6 +736,260 @@ static int dpmv8_write_reg(struct arm_dpm *dpm, struct reg *r, unsigned int regn
 	return retval;
 }
 
+/*
+ * Batched register transfers in AArch64 state.
+ *
+ * Each operation moves a 64-bit value through DTRRX/DTRTX and executes up
+ * to two instructions through ITR. All the operations of a batch are
+ * queued in a single DAP transaction, without polling ITE, TXfull or
+ * RXfull in between. Should the core not keep up, EDSCR.ITO, TXU or RXO
+ * are set: these sticky errors are checked once at the end, and cleared,
+ * and the caller falls back on the polled accesses.
+ */
+#define DPMV8_BATCH_MAX_OPS		34
+
+struct dpmv8_batch_op {
+	/* the value is read from the DCC after the instructions, else written before */
+	bool read;
+	unsigned int num_opcodes;
+	uint32_t opcode[2];
+	uint64_t value;
+	uint32_t data[2];
+};
+
+static void dpmv8_batch_read(struct dpmv8_batch_op *op, uint32_t opcode1, uint32_t opcode2)
+{
+	op->read = true;
+	op->num_opcodes = 0;
+	if (opcode1)
+		op->opcode[op->num_opcodes++] = opcode1;
+	op->opcode[op->num_opcodes++] = opcode2;
+}
+
+static void dpmv8_batch_write(struct dpmv8_batch_op *op, uint64_t value,
+	uint32_t opcode1, uint32_t opcode2)
+{
+	op->read = false;
+	op->value = value;
+	op->num_opcodes = 0;
+	op->opcode[op->num_opcodes++] = opcode1;
+	if (opcode2)
+		op->opcode[op->num_opcodes++] = opcode2;
+}
+
+/* Set up the operation transferring the AArch64 register regnum, false if not batched */
+static bool dpmv8_batch_reg(struct dpmv8_batch_op *op, struct reg *r, unsigned int regnum,
+	bool read)
+{
+	uint64_t value = read ? 0 : buf_get_u64(r->value, 0, r->size);
+
+	switch (regnum) {
+	case ARMV8_R0 ... ARMV8_R30:
+		if (read)
+			dpmv8_batch_read(op, 0, ARMV8_MSR_GP(SYSTEM_DBG_DBGDTR_EL0, regnum));
+		else
+			dpmv8_batch_write(op, value, ARMV8_MRS(SYSTEM_DBG_DBGDTR_EL0, regnum), 0);
+		return true;
+	/* through the scratch register X0 */
+	case ARMV8_SP:
+		if (read)
+			dpmv8_batch_read(op, ARMV8_MOVFSP_64(0), ARMV8_MSR_GP(SYSTEM_DBG_DBGDTR_EL0, 0));
+		else
+			dpmv8_batch_write(op, value, ARMV8_MRS(SYSTEM_DBG_DBGDTR_EL0, 0), ARMV8_MOVTSP_64(0));
+		return true;
+	case ARMV8_PC:
+		if (read)
+			dpmv8_batch_read(op, ARMV8_MRS_DLR(0), ARMV8_MSR_GP(SYSTEM_DBG_DBGDTR_EL0, 0));
+		else
+			dpmv8_batch_write(op, value, ARMV8_MRS(SYSTEM_DBG_DBGDTR_EL0, 0), ARMV8_MSR_DLR(0));
+		return true;
+	case ARMV8_XPSR:
+		if (read)
+			return false;
+		dpmv8_batch_write(op, value, ARMV8_MRS(SYSTEM_DBG_DBGDTR_EL0, 0), ARMV8_MSR_DSPSR(0));
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Recover from an overrun batch: clear the sticky errors, then drain the
+ * DCC registers left full by the instructions that did not complete, as
+ * dpmv8_dpm_prepare() does, so that the polled accesses can go on.
+ */
+static int dpmv8_batch_recover(struct arm_dpm *dpm)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+	target_addr_t base = armv8->debug_base;
+	uint32_t dscr, dummy;
+
+	int retval = mem_ap_write_atomic_u32(armv8->debug_ap, base + CPUV8_DBG_DRCR, DRCR_CSE);
+	if (retval == ERROR_OK)
+		retval = mem_ap_read_atomic_u32(armv8->debug_ap, base + CPUV8_DBG_DSCR, &dscr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (dscr & DSCR_DTR_RX_FULL) {
+		retval = mem_ap_read_atomic_u32(armv8->debug_ap, base + CPUV8_DBG_DTRRX, &dummy);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	if (dscr & DSCR_DTR_TX_FULL) {
+		retval = mem_ap_read_atomic_u32(armv8->debug_ap, base + CPUV8_DBG_DTRTX, &dummy);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return mem_ap_read_atomic_u32(armv8->debug_ap, base + CPUV8_DBG_DSCR, &dpm->dscr);
+}
+
+/* Flush the queued batch, then wait for its last instruction and check the sticky errors */
+static int dpmv8_batch_wait(struct arm_dpm *dpm, int retval)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+	target_addr_t base = armv8->debug_base;
+	uint32_t dscr;
+
+	long long then = timeval_ms();
+	do {
+		int retval2 = mem_ap_read_atomic_u32(armv8->debug_ap, base + CPUV8_DBG_DSCR, &dscr);
+		if (retval == ERROR_OK)
+			retval = retval2;
+		if (retval != ERROR_OK)
+			return retval;
+		if (timeval_ms() > then + 1000) {
+			LOG_ERROR("Timeout waiting for batched DPM operations");
+			return ERROR_FAIL;
+		}
+	} while ((dscr & DSCR_ITE) == 0);
+
+	dpm->dscr = dscr;
+	dpm->last_el = (dscr >> 8) & 3;
+
+	if (dscr & DSCR_ERR) {
+		if (dscr & (DSCR_ITO | DSCR_TXU | DSCR_RTO)) {
+			LOG_DEBUG("batched DPM operations overran, dscr 0x%08" PRIx32, dscr);
+			int retval2 = dpmv8_batch_recover(dpm);
+			if (retval2 != ERROR_OK)
+				return retval2;
+		} else {
+			LOG_ERROR("Batched DPM operations, DSCR.ERR=1, DSCR.EL=%i", dpm->last_el);
+			armv8_dpm_handle_exception(dpm, true);
+		}
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static int dpmv8_batch_run(struct arm_dpm *dpm, struct dpmv8_batch_op *ops, unsigned int count)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+	target_addr_t base = armv8->debug_base;
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < count && retval == ERROR_OK; i++) {
+		struct dpmv8_batch_op *op = &ops[i];
+
+		if (!op->read) {
+			retval = mem_ap_write_u32(armv8->debug_ap, base + CPUV8_DBG_DTRRX, op->value);
+			if (retval == ERROR_OK)
+				retval = mem_ap_write_u32(armv8->debug_ap, base + CPUV8_DBG_DTRTX,
+					op->value >> 32);
+		}
+		for (unsigned int j = 0; j < op->num_opcodes && retval == ERROR_OK; j++)
+			retval = mem_ap_write_u32(armv8->debug_ap, base + CPUV8_DBG_ITR, op->opcode[j]);
+		if (op->read && retval == ERROR_OK) {
+			retval = mem_ap_read_u32(armv8->debug_ap, base + CPUV8_DBG_DTRTX, &op->data[0]);
+			if (retval == ERROR_OK)
+				retval = mem_ap_read_u32(armv8->debug_ap, base + CPUV8_DBG_DTRRX, &op->data[1]);
+		}
+	}
+
+	retval = dpmv8_batch_wait(dpm, retval);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < count; i++)
+		if (ops[i].read)
+			ops[i].value = ops[i].data[0] | (uint64_t)ops[i].data[1] << 32;
+
+	return ERROR_OK;
+}
+
+/*
+ * Load X0, then execute the A64 instructions of the list in one batch. On
+ * failure the instructions may have been executed in part only; the DCC is
+ * drained and X0 loaded again, so that the caller can redo them one by one.
+ */
+int armv8_dpm_instr_batch_r0(struct arm_dpm *dpm, uint64_t x0, const uint32_t *opcodes,
+	unsigned int count)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+	target_addr_t base = armv8->debug_base;
+
+	if (armv8_dpm_get_core_state(dpm) != ARM_STATE_AARCH64)
+		return ERROR_FAIL;
+
+	int retval = mem_ap_write_u32(armv8->debug_ap, base + CPUV8_DBG_DTRRX, x0);
+	if (retval == ERROR_OK)
+		retval = mem_ap_write_u32(armv8->debug_ap, base + CPUV8_DBG_DTRTX, x0 >> 32);
+	if (retval == ERROR_OK)
+		retval = mem_ap_write_u32(armv8->debug_ap, base + CPUV8_DBG_ITR,
+			ARMV8_MRS(SYSTEM_DBG_DBGDTR_EL0, 0));
+	for (unsigned int i = 0; i < count && retval == ERROR_OK; i++)
+		retval = mem_ap_write_u32(armv8->debug_ap, base + CPUV8_DBG_ITR, opcodes[i]);
+
+	retval = dpmv8_batch_wait(dpm, retval);
+	if (retval != ERROR_OK && dpmv8_write_dcc_64(armv8, x0) == ERROR_OK)
+		dpmv8_exec_opcode(dpm, ARMV8_MRS(SYSTEM_DBG_DBGDTR_EL0, 0), NULL);
+
+	return retval;
+}
+
+/*
+ * Read or write the registers of the list in one batch, marking them
+ * clean and valid. Nothing is marked on failure, so the caller can go on
+ * with the polled accesses.
+ */
+static int dpmv8_batch_regs(struct arm_dpm *dpm, struct reg **regs, unsigned int count,
+	bool read)
+{
+	struct dpmv8_batch_op ops[DPMV8_BATCH_MAX_OPS];
+
+	assert(count <= ARRAY_SIZE(ops));
+	if (count == 0)
+		return ERROR_OK;
+
+	/* the opcodes are A64 ones */
+	if (armv8_dpm_get_core_state(dpm) != ARM_STATE_AARCH64)
+		return ERROR_FAIL;
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct arm_reg *arm_reg = regs[i]->arch_info;
+		if (!dpmv8_batch_reg(&ops[i], regs[i], arm_reg->num, read))
+			return ERROR_FAIL;
+	}
+
+	int retval = dpmv8_batch_run(dpm, ops, count);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (read) {
+			buf_set_u64(regs[i]->value, 0, regs[i]->size, ops[i].value);
+			regs[i]->valid = true;
+			LOG_DEBUG("READ: %s, %16.8" PRIx64, regs[i]->name, ops[i].value);
+		} else {
+			LOG_DEBUG("WRITE: %s, %16.8" PRIx64, regs[i]->name, ops[i].value);
+		}
+		regs[i]->dirty = false;
+	}
+
+	return ERROR_OK;
+}
+
 /**
  * Read basic registers of the current context:  R0 to R15, and CPSR in AArch32
  * state or R0 to R31, PC and CPSR in AArch64 state;
@@ -778,6 +1039,20 @@ int armv8_dpm_read_current_registers(struct arm_dpm *dpm)
 	/* update core mode and state */
 	armv8_set_cpsr(arm, cpsr);
 
+	/* X2 to X30, SP and PC in one batch, the polled reads below are the fallback */
+	if (arm->core_state == ARM_STATE_AARCH64) {
+		struct reg *batch[DPMV8_BATCH_MAX_OPS];
+		unsigned int count = 0;
+
+		for (unsigned int i = ARMV8_R2; i <= ARMV8_PC; i++) {
+			r = cache->reg_list + i;
+			if (r->exist && !r->valid)
+				batch[count++] = r;
+		}
+		if (dpmv8_batch_regs(dpm, batch, count, true) != ERROR_OK)
+			LOG_DEBUG("batched register read failed, reading one by one");
+	}
+
 	/* read the remaining registers that would be required by GDB 'g' packet */
 	for (unsigned int i = ARMV8_R2; i <= ARMV8_PC ; i++) {
 		struct arm_reg *arm_reg;
@@ -924,6 +1199,23 @@ int armv8_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 	if (retval != ERROR_OK)
 		goto done;
 
+	/*
+	 * X1 to X30 and SP in one batch, the loop below is the fallback. The
+	 * other registers don't use X1 to X30 as scratch, so can come after.
+	 */
+	if (arm->core_state == ARM_STATE_AARCH64) {
+		struct reg *batch[DPMV8_BATCH_MAX_OPS];
+		unsigned int count = 0;
+
+		for (unsigned int i = ARMV8_R1; i <= ARMV8_SP; i++) {
+			struct reg *r = cache->reg_list + i;
+			if (r->exist && r->valid && r->dirty)
+				batch[count++] = r;
+		}
+		if (dpmv8_batch_regs(dpm, batch, count, false) != ERROR_OK)
+			LOG_DEBUG("batched register write failed, writing one by one");
+	}
+
 	/* check everything except our scratch register R0 */
 	for (unsigned int i = 1; i < cache->num_regs; i++) {
 		struct arm_reg *r;
@@ -952,6 +1244,16 @@ int armv8_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 			break;
 	}
 
+	/* flush CPSR, PC and R0 -- it's *very* dirty by now -- in one batch */
+	struct reg *last[] = {
+		&cache->reg_list[ARMV8_XPSR],
+		&cache->reg_list[ARMV8_PC],
+		&cache->reg_list[ARMV8_R0],
+	};
+	if (retval == ERROR_OK && arm->core_state == ARM_STATE_AARCH64 &&
+			dpmv8_batch_regs(dpm, last, ARRAY_SIZE(last), false) == ERROR_OK)
+		goto sync;
+
 	/* flush CPSR and PC */
 	if (retval == ERROR_OK)
 		retval = dpmv8_write_reg(dpm, &cache->reg_list[ARMV8_XPSR], ARMV8_XPSR);
@@ -960,6 +1262,7 @@ int armv8_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 	/* flush R0 -- it's *very* dirty by now */
 	if (retval == ERROR_OK)
 		retval = dpmv8_write_reg(dpm, &cache->reg_list[0], 0);
+sync:
 	if (retval == ERROR_OK)
 		dpm->instr_cpsr_sync(dpm);
 done:
@@ -1001,6 +1304,33 @@ fail:
 	return retval;
 }
 
+/**
+ * Read a set of core registers within a single DPM prepare/finish. The
+ * registers of another core, or past the first failure, are left invalid.
+ */
+int armv8_dpm_read_core_regs(struct arm_dpm *dpm, struct reg **regs, unsigned int count)
+{
+	int retval;
+
+	retval = dpm->prepare(dpm);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct arm_reg *arm_reg = regs[i]->arch_info;
+
+		if (arm_reg->arm != dpm->arm)
+			continue;
+
+		retval = dpmv8_read_reg(dpm, regs[i], arm_reg->num);
+		if (retval != ERROR_OK)
+			break;
+	}
+
+	dpm->finish(dpm);
+	return retval;
+}
+
 static int armv8_dpm_write_core_reg(struct target *target, struct reg *r,
 	int regnum, enum arm_mode mode, uint8_t *value)
 {
@@ -1425,6 +1755,7 @@ int armv8_dpm_setup(struct arm_dpm *dpm)
 	/* coprocessor access setup */
 	arm->mrc = dpmv8_mrc;
 	arm->mcr = dpmv8_mcr;
+	dpm->invalidate_translations = dpmv8_invalidate_translations;
 
 	dpm->prepare = dpmv8_dpm_prepare;
 	dpm->finish = dpmv8_dpm_finish;
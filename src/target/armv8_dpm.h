@@ -25,6 +25,9 @@ int armv8_dpm_setup(struct arm_dpm *dpm);
 int armv8_dpm_initialize(struct arm_dpm *dpm);
 
 int armv8_dpm_read_current_registers(struct arm_dpm *dpm);
+int armv8_dpm_read_core_regs(struct arm_dpm *dpm, struct reg **regs, unsigned int count);
+int armv8_dpm_instr_batch_r0(struct arm_dpm *dpm, uint64_t x0, const uint32_t *opcodes,
+	unsigned int count);
 int armv8_dpm_modeswitch(struct arm_dpm *dpm, enum arm_mode mode);
 
 
@@ -88,6 +88,12 @@
 #define SYSTEM_TTBR0_EL3		0xF100
 #define SYSTEM_TTBR1_EL1		0xC101
 
+#define SYSTEM_MAIR_EL1			0xC510
+#define SYSTEM_MAIR_EL2			0xE510
+#define SYSTEM_MAIR_EL3			0xF510
+
+#define SYSTEM_HCR_EL2			0xE088
+
 /* ARMv8 address translation */
 #define SYSTEM_PAR_EL1			0xC3A0
 #define SYSTEM_ATS12E0R			0x63C6
@@ -153,6 +159,7 @@
 #define ARMV8_MOVTSP_64(rt) ((1 << 31) | 0x11000000 | (rt << 5) | (0x1F))
 #define ARMV8_MOVFSP_32(rt) (0x11000000 | (0x1f << 5) | (rt))
 #define ARMV8_MOVTSP_32(rt) (0x11000000 | (rt << 5) | (0x1F))
+#define ARMV8_ADD_IMM_64(rd, rn, imm) ((1 << 31) | 0x11000000 | ((imm) & 0xfff) << 10 | (rn) << 5 | (rd))
 
 #define ARMV8_LDRB_IP(rd, rn) (0x38401400 | (rn << 5) | rd)
 #define ARMV8_LDRH_IP(rd, rn) (0x78402400 | (rn << 5) | rd)
@@ -630,6 +630,11 @@ static int cortex_a_bpwp_disable(struct arm_dpm *dpm, unsigned int index_t)
 	return mem_ap_write_atomic_u32(a->armv7a_common.debug_ap, cr, 0);
 }
 
+static void cortex_a_invalidate_translations(struct arm_dpm *dpm)
+{
+	armv7a_mmu_invalidate_translations(&dpm_to_a(dpm)->armv7a_common);
+}
+
 static int cortex_a_dpm_setup(struct cortex_a_common *a, uint32_t didr)
 {
 	struct arm_dpm *dpm = &a->armv7a_common.dpm;
@@ -653,6 +658,8 @@ static int cortex_a_dpm_setup(struct cortex_a_common *a, uint32_t didr)
 	dpm->bpwp_enable = cortex_a_bpwp_enable;
 	dpm->bpwp_disable = cortex_a_bpwp_disable;
 
+	dpm->invalidate_translations = cortex_a_invalidate_translations;
+
 	retval = arm_dpm_setup(dpm);
 	if (retval == ERROR_OK)
 		retval = arm_dpm_initialize(dpm);
@@ -1063,6 +1070,11 @@ static int cortex_a_debug_entry(struct target *target)
 		arm_dpm_report_wfar(&armv7a->dpm, wfar);
 	}
 
+	/* the translations and cache state of the previous halt may no longer hold */
+	armv7a_mmu_invalidate_translations(armv7a);
+	armv7a->sysbus.caches_clean = false;
+	arm_sysbus_set_security(&armv7a->sysbus, !(cortex_a->cpudbg_dscr & DSCR_NON_SECURE));
+
 	/* First load register accessible through core debug port */
 	retval = arm_dpm_read_current_registers(&armv7a->dpm);
 	if (retval != ERROR_OK)
@@ -1126,6 +1138,7 @@ static int cortex_a_post_debug_entry(struct target *target)
 	} else {
 		armv7a->armv7a_mmu.mmu_enabled = cortex_a->cp15_control_reg & 0x1U;
 	}
+	armv7a->sysbus.mmu_state_known = true;
 	armv7a->armv7a_mmu.armv7a_cache.d_u_cache_enabled =
 		cortex_a->cp15_control_reg & 0x4U;
 	armv7a->armv7a_mmu.armv7a_cache.i_cache_enabled =
@@ -1308,6 +1321,8 @@ static int cortex_a_restore_context(struct target *target, bool bpwp)
 	if (armv7a->pre_restore_context)
 		armv7a->pre_restore_context(target);
 
+	armv7a_mmu_invalidate_translations(armv7a);
+
 	return arm_dpm_write_dirty_registers(&armv7a->dpm, bpwp);
 }
 
@@ -2757,35 +2772,126 @@ static int cortex_a_read_cpu_memory(struct target *target,
  * ap number for every access.
  */
 
+/*
+ * Prepare an access through the system MEM-AP. Accesses in debug state
+ * neither allocate nor dirty cache lines (see DSCCR), so cleaning the data
+ * caches once per halt keeps them coherent with the system bus. A running
+ * core is accessed as it is.
+ */
+static int cortex_a_sysbus_prepare(struct target *target, enum arm_sysbus_policy policy)
+{
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+	struct armv7a_cache_common *cache = &armv7a->armv7a_mmu.armv7a_cache;
+
+	if (policy != ARM_SYSBUS_BUS || target->state != TARGET_HALTED || armv7a->sysbus.caches_clean)
+		return ERROR_OK;
+
+	if (cache->d_u_cache_enabled && cache->flush_all_data_cache) {
+		int retval = cache->flush_all_data_cache(target);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	armv7a->sysbus.caches_clean = true;
+	return ERROR_OK;
+}
+
+static int cortex_a_read_routed_memory(struct target *target,
+	target_addr_t address, uint32_t size,
+	uint32_t count, uint8_t *buffer, bool phys_access)
+{
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+	int retval = ERROR_OK;
+
+	while (count && retval == ERROR_OK) {
+		uint32_t n;
+		enum arm_sysbus_policy policy = arm_sysbus_route(&armv7a->sysbus,
+				address, size, count, &n);
+
+		if (policy == ARM_SYSBUS_CPU) {
+			/* read memory through the CPU */
+			cortex_a_prep_memaccess(target, phys_access);
+			retval = cortex_a_read_cpu_memory(target, address, size, n, buffer);
+			cortex_a_post_memaccess(target, phys_access);
+		} else {
+			retval = cortex_a_sysbus_prepare(target, policy);
+			if (retval == ERROR_OK)
+				retval = mem_ap_read_buf(armv7a->sysbus.ap, buffer, size, n, address);
+		}
+
+		address += n * size;
+		buffer += n * size;
+		count -= n;
+	}
+
+	return retval;
+}
+
+static int cortex_a_write_routed_memory(struct target *target,
+	target_addr_t address, uint32_t size,
+	uint32_t count, const uint8_t *buffer, bool phys_access)
+{
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+	bool i_cache_stale = false;
+	int retval = ERROR_OK;
+
+	while (count && retval == ERROR_OK) {
+		uint32_t n;
+		enum arm_sysbus_policy policy = arm_sysbus_route(&armv7a->sysbus,
+				address, size, count, &n);
+
+		if (policy == ARM_SYSBUS_CPU) {
+			/* write memory through the CPU */
+			cortex_a_prep_memaccess(target, phys_access);
+			retval = cortex_a_write_cpu_memory(target, address, size, n, buffer);
+			cortex_a_post_memaccess(target, phys_access);
+		} else {
+			retval = cortex_a_sysbus_prepare(target, policy);
+			if (retval == ERROR_OK)
+				retval = mem_ap_write_buf(armv7a->sysbus.ap, buffer, size, n, address);
+			i_cache_stale |= policy == ARM_SYSBUS_BUS;
+		}
+
+		address += n * size;
+		buffer += n * size;
+		count -= n;
+	}
+
+	/* the instruction cache does not snoop the system bus */
+	if (retval == ERROR_OK && i_cache_stale && target->state == TARGET_HALTED
+			&& armv7a->armv7a_mmu.armv7a_cache.i_cache_enabled)
+		retval = armv7a_l1_i_cache_inval_all(target);
+
+	return retval;
+}
+
 static int cortex_a_read_phys_memory(struct target *target,
 	target_addr_t address, uint32_t size,
 	uint32_t count, uint8_t *buffer)
 {
-	int retval;
-
 	if (!count || !buffer)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
 	LOG_DEBUG("Reading memory at real address " TARGET_ADDR_FMT "; size %" PRIu32 "; count %" PRIu32,
 		address, size, count);
 
-	/* read memory through the CPU */
-	cortex_a_prep_memaccess(target, true);
-	retval = cortex_a_read_cpu_memory(target, address, size, count, buffer);
-	cortex_a_post_memaccess(target, true);
-
-	return retval;
+	return cortex_a_read_routed_memory(target, address, size, count, buffer, true);
 }
 
 static int cortex_a_read_memory(struct target *target, target_addr_t address,
 	uint32_t size, uint32_t count, uint8_t *buffer)
 {
+	struct armv7a_common *armv7a = target_to_armv7a(target);
 	int retval;
 
 	/* cortex_a handles unaligned memory access */
 	LOG_DEBUG("Reading memory at address " TARGET_ADDR_FMT "; size %" PRIu32 "; count %" PRIu32,
 		address, size, count);
 
+	/* without the MMU at the last halt, virtual and physical addresses match */
+	if (armv7a->is_armv7r || (armv7a->sysbus.mmu_state_known && !armv7a->armv7a_mmu.mmu_enabled))
+		return cortex_a_read_routed_memory(target, address, size, count, buffer, false);
+
 	cortex_a_prep_memaccess(target, false);
 	retval = cortex_a_read_cpu_memory(target, address, size, count, buffer);
 	cortex_a_post_memaccess(target, false);
@@ -2797,31 +2903,29 @@ static int cortex_a_write_phys_memory(struct target *target,
 	target_addr_t address, uint32_t size,
 	uint32_t count, const uint8_t *buffer)
 {
-	int retval;
-
 	if (!count || !buffer)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
 	LOG_DEBUG("Writing memory to real address " TARGET_ADDR_FMT "; size %" PRIu32 "; count %" PRIu32,
 		address, size, count);
 
-	/* write memory through the CPU */
-	cortex_a_prep_memaccess(target, true);
-	retval = cortex_a_write_cpu_memory(target, address, size, count, buffer);
-	cortex_a_post_memaccess(target, true);
-
-	return retval;
+	return cortex_a_write_routed_memory(target, address, size, count, buffer, true);
 }
 
 static int cortex_a_write_memory(struct target *target, target_addr_t address,
 	uint32_t size, uint32_t count, const uint8_t *buffer)
 {
+	struct armv7a_common *armv7a = target_to_armv7a(target);
 	int retval;
 
 	/* cortex_a handles unaligned memory access */
 	LOG_DEBUG("Writing memory at address " TARGET_ADDR_FMT "; size %" PRIu32 "; count %" PRIu32,
 		address, size, count);
 
+	/* without the MMU at the last halt, virtual and physical addresses match */
+	if (armv7a->is_armv7r || (armv7a->sysbus.mmu_state_known && !armv7a->armv7a_mmu.mmu_enabled))
+		return cortex_a_write_routed_memory(target, address, size, count, buffer, false);
+
 	cortex_a_prep_memaccess(target, false);
 	retval = cortex_a_write_cpu_memory(target, address, size, count, buffer);
 	cortex_a_post_memaccess(target, false);
@@ -2973,6 +3077,11 @@ static int cortex_a_examine_first(struct target *target)
 
 	armv7a->debug_ap->memaccess_tck = 80;
 
+	/* optional, memory is accessed through the core without it */
+	retval = arm_sysbus_examine(&armv7a->sysbus, swjdp);
+	if (retval != ERROR_OK)
+		return retval;
+
 	if (!target->dbgbase_set) {
 		LOG_TARGET_DEBUG(target, "dbgbase is not set, trying to detect using the ROM table");
 		/* Lookup Processor DAP */
@@ -3171,6 +3280,8 @@ static int cortex_a_init_arch_info(struct target *target,
 
 	/* REVISIT v7a setup should be in a v7a-specific routine */
 	armv7a_init_arch_info(target, armv7a);
+	arm_sysbus_init(&armv7a->sysbus);
+	armv7a->arm.sysbus = &armv7a->sysbus;
 	target_register_timer_callback(cortex_a_handle_target_request, 1,
 		TARGET_TIMER_TYPE_PERIODIC, target);
 
@@ -3239,6 +3350,7 @@ static void cortex_a_deinit_target(struct target *target)
 
 	if (armv7a->debug_ap)
 		dap_put_ap(armv7a->debug_ap);
+	arm_sysbus_release(&armv7a->sysbus);
 
 	free(cortex_a->wrp_list);
 	free(cortex_a->brp_list);
@@ -3400,6 +3512,9 @@ static const struct command_registration cortex_a_exec_command_handlers[] = {
 	{
 		.chain = armv7a_mmu_command_handlers,
 	},
+	{
+		.chain = arm_sysbus_command_handlers,
+	},
 	{
 		.chain = smp_command_handlers,
 	},
@@ -3486,6 +3601,9 @@ static const struct command_registration cortex_r4_exec_command_handlers[] = {
 		.help = "mask cortex_r4 interrupts",
 		.usage = "['on'|'off']",
 	},
+	{
+		.chain = arm_sysbus_command_handlers,
+	},
 
 	COMMAND_REGISTRATION_DONE
 };
@@ -156,6 +156,26 @@ static inline void cortex_m_cumulate_dhcsr_sticky(struct cortex_m_common *cortex
 	cortex_m->dcb_dhcsr_cumulated_sticky |= dhcsr;
 }
 
+/** Complete the DHCSR read queued for the poll, if any, and cumulate
+ * its sticky bits: the read has cleared them in the target
+ */
+static void cortex_m_collect_queued_dhcsr(struct target *target)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+
+	if (!cortex_m->dcb_dhcsr_queued_pending)
+		return;
+
+	struct adiv5_dap *dap = target_to_armv7m(target)->debug_ap->dap;
+	cortex_m->dcb_dhcsr_queued_pending = false;
+
+	if (dap->poll_batch_pending)
+		dap_run(dap);
+
+	if (dap->poll_batch_retval == ERROR_OK)
+		cortex_m_cumulate_dhcsr_sticky(cortex_m, cortex_m->dcb_dhcsr_queued);
+}
+
 /** Read DCB DHCSR register to cortex_m->dcb_dhcsr and cumulate
  * sticky bits in cortex_m->dcb_dhcsr_cumulated_sticky
  */
@@ -164,6 +184,8 @@ static int cortex_m_read_dhcsr_atomic_sticky(struct target *target)
 	struct cortex_m_common *cortex_m = target_to_cm(target);
 	struct armv7m_common *armv7m = target_to_armv7m(target);
 
+	cortex_m_collect_queued_dhcsr(target);
+
 	int retval = mem_ap_read_atomic_u32(armv7m->debug_ap, DCB_DHCSR,
 				&cortex_m->dcb_dhcsr);
 	if (retval != ERROR_OK)
@@ -173,6 +195,50 @@ static int cortex_m_read_dhcsr_atomic_sticky(struct target *target)
 	return ERROR_OK;
 }
 
+/** Queue the read of DCB DHCSR for the next poll. The reads of all
+ * the targets on the DAP are completed by the first dap_run().
+ */
+static int cortex_m_queue_poll(struct target *target)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+
+	/* a read left from a round where this target was not polled */
+	cortex_m_collect_queued_dhcsr(target);
+
+	int retval = mem_ap_read_u32(armv7m->debug_ap, DCB_DHCSR, &cortex_m->dcb_dhcsr_queued);
+	if (retval != ERROR_OK)
+		return retval;
+
+	cortex_m->dcb_dhcsr_queued_pending = true;
+	armv7m->debug_ap->dap->poll_batch_pending = true;
+	cortex_m->dcb_dhcsr_queued_state = target->state;
+	return ERROR_OK;
+}
+
+/** Read DCB DHCSR for the poll, use the queued read if there is one */
+static int cortex_m_poll_read_dhcsr(struct target *target)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+
+	if (!target->poll_queued || !cortex_m->dcb_dhcsr_queued_pending)
+		return cortex_m_read_dhcsr_atomic_sticky(target);
+
+	struct adiv5_dap *dap = target_to_armv7m(target)->debug_ap->dap;
+
+	target->poll_queued = false;
+	cortex_m_collect_queued_dhcsr(target);
+
+	/* the target could have been resumed or reset by the poll of another
+	 * target on the same DAP, e.g. by an event handler */
+	if (dap->poll_batch_retval != ERROR_OK ||
+			target->state != cortex_m->dcb_dhcsr_queued_state)
+		return cortex_m_read_dhcsr_atomic_sticky(target);
+
+	cortex_m->dcb_dhcsr = cortex_m->dcb_dhcsr_queued;
+	return ERROR_OK;
+}
+
 static int cortex_m_load_core_reg_u32(struct target *target,
 		uint32_t regsel, uint32_t *value)
 {
@@ -955,7 +1021,7 @@ static int cortex_m_poll_one(struct target *target)
 	struct armv7m_common *armv7m = &cortex_m->armv7m;
 
 	/* Read from Debug Halting Control and Status Register */
-	retval = cortex_m_read_dhcsr_atomic_sticky(target);
+	retval = cortex_m_poll_read_dhcsr(target);
 	if (retval != ERROR_OK) {
 		target->state = TARGET_UNKNOWN;
 		return retval;
@@ -1217,6 +1283,10 @@ static int cortex_m_halt_one(struct target *target)
 	/* Write to Debug Halting Control and Status Register */
 	retval = cortex_m_write_debug_halt_mask(target, C_HALT, 0);
 
+	/* a DHCSR read queued for the poll is outdated now, but for its sticky bits */
+	cortex_m_collect_queued_dhcsr(target);
+	target->poll_queued = false;
+
 	/* Do this really early to minimize the window where the MASKINTS erratum
 	 * can pile up pending interrupts. */
 	cortex_m_set_maskints_for_halt(target);
@@ -2267,6 +2337,78 @@ static int cortex_m_write_memory(struct target *target, target_addr_t address,
 	return mem_ap_write_buf(armv7m->debug_ap, buffer, size, count, address);
 }
 
+/* Queue all the accesses as word transfers and flush the DAP queue once.
+ * Reads are widened to whole words, writes have to be word aligned.
+ */
+static int cortex_m_access_memory_batch(struct target *target,
+	struct target_memory_access *accesses, unsigned int count)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct adiv5_ap *ap = armv7m->debug_ap;
+	size_t total_words = 0;
+
+	if (ap->dap->ti_be_32_quirks)
+		return ERROR_NOT_IMPLEMENTED;
+
+	for (unsigned int i = 0; i < count; i++) {
+		const struct target_memory_access *a = &accesses[i];
+		if (a->write && ((a->address | a->size) & 0x3u))
+			return ERROR_NOT_IMPLEMENTED;
+		if (a->size)
+			total_words += ((a->address + a->size + 3) / 4) - (a->address / 4);
+	}
+
+	uint32_t *words = malloc(total_words * sizeof(uint32_t));
+	if (!words && total_words) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = ERROR_OK;
+	uint32_t *w = words;
+	for (unsigned int i = 0; i < count && retval == ERROR_OK; i++) {
+		const struct target_memory_access *a = &accesses[i];
+		if (!a->size)
+			continue;
+
+		target_addr_t first = a->address & ~(target_addr_t)0x3u;
+		uint32_t n = ((a->address + a->size + 3) / 4) - (a->address / 4);
+
+		if (a->write) {
+			for (uint32_t j = 0; j < n; j++)
+				w[j] = le_to_h_u32(a->buffer + 4 * j);
+			retval = mem_ap_queue_write_words(ap, first, n, w);
+		} else {
+			retval = mem_ap_queue_read_words(ap, first, n, w);
+		}
+		w += n;
+	}
+
+	if (retval == ERROR_OK)
+		retval = dap_run(ap->dap);
+
+	if (retval == ERROR_OK) {
+		w = words;
+		for (unsigned int i = 0; i < count; i++) {
+			const struct target_memory_access *a = &accesses[i];
+			if (!a->size)
+				continue;
+
+			uint32_t n = ((a->address + a->size + 3) / 4) - (a->address / 4);
+			if (!a->write) {
+				/* the words hold the bytes in address order, as on the bus */
+				for (uint32_t j = 0; j < n; j++)
+					h_u32_to_le((uint8_t *)&w[j], w[j]);
+				memcpy(a->buffer, (uint8_t *)w + (a->address & 0x3u), a->size);
+			}
+			w += n;
+		}
+	}
+
+	free(words);
+	return retval;
+}
+
 static int cortex_m_init_target(struct command_context *cmd_ctx,
 	struct target *target)
 {
@@ -2292,11 +2434,57 @@ void cortex_m_deinit_target(struct target *target)
 	free(cortex_m);
 }
 
+/* PCSR samples read in one DAP transaction */
+#define CORTEX_M_PCSR_BURST		1024
+
+static int cortex_m_read_pcsr(struct target *target, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	uint32_t read_count = MIN(max_num_samples, CORTEX_M_PCSR_BURST);
+	int retval;
+
+	*num_samples = 0;
+	if (!read_count)
+		return ERROR_OK;
+
+	if (armv7m && armv7m->debug_ap) {
+		retval = mem_ap_read_buf_noincr(armv7m->debug_ap,
+					(void *)samples, 4, read_count, DWT_PCSR);
+	} else {
+		read_count = 1;
+		retval = target_read_u32(target, DWT_PCSR, samples);
+	}
+
+	if (retval != ERROR_OK) {
+		LOG_TARGET_ERROR(target, "Error while reading PCSR");
+		return retval;
+	}
+
+	*num_samples = read_count;
+	return ERROR_OK;
+}
+
+int cortex_m_profiling_sample(struct target *target, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples)
+{
+	int retval = cortex_m_read_pcsr(target, samples, max_num_samples, num_samples);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* PCSR is RAZ when not implemented, the PC of a Cortex-M is never 0 */
+	if (*num_samples && samples[0] == 0) {
+		*num_samples = 0;
+		return ERROR_NOT_IMPLEMENTED;
+	}
+
+	return ERROR_OK;
+}
+
 int cortex_m_profiling(struct target *target, uint32_t *samples,
 			      uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
 {
 	struct timeval timeout, now;
-	struct armv7m_common *armv7m = target_to_armv7m(target);
 	uint32_t reg_value;
 	int retval;
 
@@ -2328,24 +2516,13 @@ int cortex_m_profiling(struct target *target, uint32_t *samples,
 	uint32_t sample_count = 0;
 
 	for (;;) {
-		if (armv7m && armv7m->debug_ap) {
-			uint32_t read_count = max_num_samples - sample_count;
-			if (read_count > 1024)
-				read_count = 1024;
-
-			retval = mem_ap_read_buf_noincr(armv7m->debug_ap,
-						(void *)&samples[sample_count],
-						4, read_count, DWT_PCSR);
-			sample_count += read_count;
-		} else {
-			target_read_u32(target, DWT_PCSR, &samples[sample_count++]);
-		}
+		uint32_t read_count;
 
-		if (retval != ERROR_OK) {
-			LOG_TARGET_ERROR(target, "Error while reading PCSR");
+		retval = cortex_m_read_pcsr(target, &samples[sample_count],
+			max_num_samples - sample_count, &read_count);
+		if (retval != ERROR_OK)
 			return retval;
-		}
-
+		sample_count += read_count;
 
 		gettimeofday(&now, NULL);
 		if (sample_count >= max_num_samples || timeval_compare(&now, &timeout) > 0) {
@@ -3291,6 +3468,7 @@ struct target_type cortexm_target = {
 	.name = "cortex_m",
 
 	.poll = cortex_m_poll,
+	.queue_poll = cortex_m_queue_poll,
 	.arch_state = armv7m_arch_state,
 
 	.target_request_data = cortex_m_target_request_data,
@@ -3308,6 +3486,7 @@ struct target_type cortexm_target = {
 
 	.read_memory = cortex_m_read_memory,
 	.write_memory = cortex_m_write_memory,
+	.access_memory_batch = cortex_m_access_memory_batch,
 	.checksum_memory = armv7m_checksum_memory,
 	.blank_check_memory = armv7m_blank_check_memory,
 
@@ -3329,4 +3508,5 @@ struct target_type cortexm_target = {
 	.deinit_target = cortex_m_deinit_target,
 
 	.profiling = cortex_m_profiling,
+	.profiling_sample = cortex_m_profiling_sample,
 };
@@ -98,6 +98,12 @@ struct cortex_m_part_info {
 #define DWT_DEVARCH_ARMV8M_V2_0	0x101A02
 #define DWT_DEVARCH_ARMV8M_V2_1	0x111A02
 
+#define DWT_CTRL_CYCCNTENA		BIT(0)
+#define DWT_CTRL_POSTPRESET_SHIFT	1
+#define DWT_CTRL_POSTPRESET_MASK	(0xf << DWT_CTRL_POSTPRESET_SHIFT)
+#define DWT_CTRL_CYCTAP			BIT(9)
+#define DWT_CTRL_PCSAMPLENA		BIT(12)
+
 #define FP_CTRL		0xE0002000
 #define FP_REMAP	0xE0002004
 #define FP_COMP0	0xE0002008
@@ -233,6 +239,12 @@ struct cortex_m_common {
 	uint32_t dcb_dhcsr_cumulated_sticky;
 	/* DCB DHCSR has been at least once read, so the sticky bits have been reset */
 	bool dcb_dhcsr_sticky_is_recent;
+	/* DHCSR read queued for the poll, its sticky bits are cumulated even
+	 * when the poll does not use it */
+	uint32_t dcb_dhcsr_queued;
+	bool dcb_dhcsr_queued_pending;
+	/* target state when the poll read of DHCSR got queued */
+	enum target_state dcb_dhcsr_queued_state;
 	uint32_t nvic_dfsr;  /* Debug Fault Status Register - shows reason for debug halt */
 	uint32_t nvic_icsr;  /* Interrupt Control State Register - shows active and pending IRQ */
 
@@ -352,6 +364,8 @@ int cortex_m_remove_watchpoint(struct target *target, struct watchpoint *watchpo
 void cortex_m_enable_breakpoints(struct target *target);
 void cortex_m_enable_watchpoints(struct target *target);
 void cortex_m_deinit_target(struct target *target);
+int cortex_m_profiling_sample(struct target *target, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples);
 int cortex_m_profiling(struct target *target, uint32_t *samples,
 	uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds);
 
@@ -675,4 +675,5 @@ struct target_type hla_target = {
 	.add_watchpoint = cortex_m_add_watchpoint,
 	.remove_watchpoint = cortex_m_remove_watchpoint,
 	.profiling = cortex_m_profiling,
+	.profiling_sample = cortex_m_profiling_sample,
 };
@@ -751,6 +751,134 @@ static int image_elf_read_section(struct image *image,
 		return image_elf32_read_section(image, section, offset, size, buffer, size_read);
 }
 
+/* read a part of the ELF file into a new buffer */
+static uint8_t *image_elf_read_part(struct image_elf *elf, uint64_t offset, uint64_t size)
+{
+	size_t read_bytes;
+
+	if (size == 0 || size > SIZE_MAX || fileio_seek(elf->fileio, offset) != ERROR_OK)
+		return NULL;
+
+	uint8_t *buffer = malloc(size);
+	if (!buffer) {
+		LOG_ERROR("insufficient memory to read ELF file");
+		return NULL;
+	}
+
+	if (fileio_read(elf->fileio, size, buffer, &read_bytes) != ERROR_OK ||
+			read_bytes != size) {
+		LOG_ERROR("cannot read ELF file");
+		free(buffer);
+		return NULL;
+	}
+
+	return buffer;
+}
+
+/* check the name of a symbol against its string table entry */
+static bool image_elf_symbol_name_matches(const uint8_t *strtab, uint64_t strtab_size,
+		uint32_t st_name, const char *name)
+{
+	size_t length = strlen(name);
+
+	return st_name < strtab_size && strtab_size - st_name > length &&
+		!memcmp(strtab + st_name, name, length + 1);
+}
+
+static int image_elf32_find_symbol(struct image *image, const char *name,
+		target_addr_t *address)
+{
+	struct image_elf *elf = image->type_private;
+	uint32_t shnum = field16(elf, elf->header32->e_shnum);
+	int retval = ERROR_FAIL;
+
+	if (field16(elf, elf->header32->e_shentsize) != sizeof(Elf32_Shdr))
+		return ERROR_IMAGE_FORMAT_ERROR;
+
+	Elf32_Shdr *shdr = (Elf32_Shdr *)image_elf_read_part(elf,
+			field32(elf, elf->header32->e_shoff), shnum * sizeof(Elf32_Shdr));
+	if (!shdr)
+		return ERROR_IMAGE_FORMAT_ERROR;
+
+	for (uint32_t i = 0; i < shnum && retval != ERROR_OK; i++) {
+		if (field32(elf, shdr[i].sh_type) != SHT_SYMTAB)
+			continue;
+
+		uint32_t link = field32(elf, shdr[i].sh_link);
+		if (link >= shnum)
+			continue;
+
+		uint32_t strtab_size = field32(elf, shdr[link].sh_size);
+		uint8_t *strtab = image_elf_read_part(elf, field32(elf, shdr[link].sh_offset),
+				strtab_size);
+		uint32_t symtab_size = field32(elf, shdr[i].sh_size);
+		Elf32_Sym *symtab = (Elf32_Sym *)image_elf_read_part(elf,
+				field32(elf, shdr[i].sh_offset), symtab_size);
+
+		for (uint32_t j = 0; strtab && symtab && j < symtab_size / sizeof(Elf32_Sym); j++) {
+			if (image_elf_symbol_name_matches(strtab, strtab_size,
+					field32(elf, symtab[j].st_name), name)) {
+				*address = field32(elf, symtab[j].st_value);
+				retval = ERROR_OK;
+				break;
+			}
+		}
+
+		free(symtab);
+		free(strtab);
+	}
+
+	free(shdr);
+	return retval;
+}
+
+static int image_elf64_find_symbol(struct image *image, const char *name,
+		target_addr_t *address)
+{
+	struct image_elf *elf = image->type_private;
+	uint32_t shnum = field16(elf, elf->header64->e_shnum);
+	int retval = ERROR_FAIL;
+
+	if (field16(elf, elf->header64->e_shentsize) != sizeof(Elf64_Shdr))
+		return ERROR_IMAGE_FORMAT_ERROR;
+
+	Elf64_Shdr *shdr = (Elf64_Shdr *)image_elf_read_part(elf,
+			field64(elf, elf->header64->e_shoff), shnum * sizeof(Elf64_Shdr));
+	if (!shdr)
+		return ERROR_IMAGE_FORMAT_ERROR;
+
+	for (uint32_t i = 0; i < shnum && retval != ERROR_OK; i++) {
+		if (field32(elf, shdr[i].sh_type) != SHT_SYMTAB)
+			continue;
+
+		uint32_t link = field32(elf, shdr[i].sh_link);
+		if (link >= shnum)
+			continue;
+
+		uint64_t strtab_size = field64(elf, shdr[link].sh_size);
+		uint8_t *strtab = image_elf_read_part(elf, field64(elf, shdr[link].sh_offset),
+				strtab_size);
+		uint64_t symtab_size = field64(elf, shdr[i].sh_size);
+		Elf64_Sym *symtab = (Elf64_Sym *)image_elf_read_part(elf,
+				field64(elf, shdr[i].sh_offset), symtab_size);
+
+		for (uint64_t j = 0; strtab && symtab && j < symtab_size / sizeof(Elf64_Sym); j++) {
+			if (image_elf_symbol_name_matches(strtab, strtab_size,
+					field32(elf, symtab[j].st_name), name)) {
+				*address = field64(elf, symtab[j].st_value);
+				retval = ERROR_OK;
+				break;
+			}
+		}
+
+		free(symtab);
+		free(strtab);
+	}
+
+	free(shdr);
+	return retval;
+}
+
 static int image_mot_buffer_complete_inner(struct image *image,
 	char *lpsz_line,
 	struct imagesection *section)
@@ -1208,6 +1336,21 @@ int image_add_section(struct image *image, target_addr_t base, uint32_t size, ui
 	return ERROR_OK;
 }
 
+int image_find_symbol(struct image *image, const char *name, target_addr_t *address)
+{
+	if (image->type != IMAGE_ELF) {
+		LOG_ERROR("symbols can only be looked up in ELF images");
+		return ERROR_IMAGE_TYPE_UNKNOWN;
+	}
+
+	struct image_elf *elf = image->type_private;
+
+	if (elf->is_64_bit)
+		return image_elf64_find_symbol(image, name, address);
+	else
+		return image_elf32_find_symbol(image, name, address);
+}
+
 void image_close(struct image *image)
 {
 	if (image->type == IMAGE_BINARY) {
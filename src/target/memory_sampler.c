@@ -0,0 +1,665 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Sampling of target memory while the target runs.
+ *
+ * A set of probes, each an address and a width, is read periodically from
+ * a timer callback. All the probes of a sample are read with a single
+ * target_access_memory_batch(), i.e. with one flush of the adapter queue on
+ * targets which support it, so that the values of a record are consistent
+ * with each other and the link round trip bounds the sample rate.
+ *
+ * Each sample is written as one line of text, the host time in
+ * microseconds since the start followed by the value of each probe:
+ *	"1234 0x00000010 0x2a"
+ * to a file or to the clients of a TCP port.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/list.h>
+#include <helper/log.h>
+#include <helper/time_support.h>
+#include <server/server.h>
+#include "memory_sampler.h"
+#include "target.h"
+
+#define MEMORY_SAMPLER_SERVICE_NAME		"memory_sampler"
+
+/* Default period of the sampling */
+#define MEMORY_SAMPLER_INTERVAL_MS		10
+
+struct memory_sampler_probe {
+	struct list_head lh;
+	target_addr_t address;
+	/** width in bytes */
+	unsigned int size;
+};
+
+struct memory_sampler_connection {
+	struct list_head lh;
+	struct connection *connection;
+};
+
+struct memory_sampler {
+	struct target *target;
+	struct list_head probes;
+	unsigned int probe_count;
+	bool running;
+	unsigned int interval_ms;
+	/** file name, or ':' followed by the TCP port */
+	char *output;
+	FILE *file;
+	bool service_started;
+	/** track TCP connections */
+	struct list_head connections;
+	/** one read per probe, into values */
+	struct target_memory_access *accesses;
+	uint8_t *values;
+	/** line of text of the current record */
+	char *record;
+	size_t record_size;
+	/** monotonic_us() at the last start, origin of the timestamps */
+	int64_t start_us;
+	/** monotonic_us() at the last start or status reset, origin of duration_us */
+	int64_t stats_start_us;
+	/** sampling time before the last start */
+	int64_t duration_us;
+	uint64_t samples;
+	/** time spent reading the probes */
+	int64_t read_us;
+	uint64_t failed;
+	/** records not accepted by the file or by a TCP client */
+	uint64_t lost;
+	/** a failure has been reported, until the next successful sample */
+	bool failing;
+};
+
+struct memory_sampler_priv_connection {
+	struct memory_sampler *sampler;
+};
+
+static struct memory_sampler *memory_sampler_get(struct target *target)
+{
+	struct memory_sampler *sampler = target->memory_sampler;
+
+	if (sampler)
+		return sampler;
+
+	sampler = calloc(1, sizeof(*sampler));
+	if (!sampler) {
+		LOG_ERROR("Out of memory");
+		return NULL;
+	}
+	sampler->target = target;
+	INIT_LIST_HEAD(&sampler->probes);
+	INIT_LIST_HEAD(&sampler->connections);
+	target->memory_sampler = sampler;
+	return sampler;
+}
+
+static struct memory_sampler_probe *memory_sampler_find(struct memory_sampler *sampler,
+		target_addr_t address)
+{
+	struct memory_sampler_probe *probe;
+
+	list_for_each_entry(probe, &sampler->probes, lh)
+		if (probe->address == address)
+			return probe;
+	return NULL;
+}
+
+/* First line of a stream, names the columns of the records */
+static int memory_sampler_header(struct memory_sampler *sampler, char *buf, size_t size)
+{
+	struct memory_sampler_probe *probe;
+	size_t len;
+
+	len = snprintf(buf, size, "# time_us");
+	list_for_each_entry(probe, &sampler->probes, lh)
+		len += snprintf(buf + len, size - len, " " TARGET_ADDR_FMT "/%u",
+			probe->address, probe->size * 8);
+	len += snprintf(buf + len, size - len, "\n");
+	return len;
+}
+
+static void memory_sampler_emit(struct memory_sampler *sampler, const char *record, size_t len)
+{
+	struct memory_sampler_connection *c;
+
+	if (sampler->file) {
+		if (fwrite(record, 1, len, sampler->file) == len) {
+			fflush(sampler->file);
+		} else {
+			LOG_DEBUG("Error writing memory samples to \"%s\"", sampler->output);
+			sampler->lost++;
+		}
+	}
+
+	/* sockets are non-blocking, a record a slow client does not take is lost */
+	list_for_each_entry(c, &sampler->connections, lh)
+		if (connection_write(c->connection, record, len) != (int)len)
+			sampler->lost++;
+}
+
+static int memory_sampler_sample(struct memory_sampler *sampler)
+{
+	struct target *target = sampler->target;
+	struct memory_sampler_probe *probe;
+
+	int64_t before_us = monotonic_us();
+	int retval = target_access_memory_batch(target, sampler->accesses, sampler->probe_count);
+	int64_t after_us = monotonic_us();
+	if (retval != ERROR_OK)
+		return retval;
+
+	sampler->samples++;
+	sampler->read_us += after_us - before_us;
+
+	/* the values have been read somewhen in between */
+	int64_t time_us = (before_us + after_us) / 2 - sampler->start_us;
+	size_t len = snprintf(sampler->record, sampler->record_size, "%" PRId64, time_us);
+
+	unsigned int i = 0;
+	list_for_each_entry(probe, &sampler->probes, lh) {
+		const uint8_t *buf = sampler->accesses[i++].buffer;
+		uint64_t value;
+
+		switch (probe->size) {
+		case 8:
+			value = target_buffer_get_u64(target, buf);
+			break;
+		case 4:
+			value = target_buffer_get_u32(target, buf);
+			break;
+		case 2:
+			value = target_buffer_get_u16(target, buf);
+			break;
+		default:
+			value = *buf;
+			break;
+		}
+		len += snprintf(sampler->record + len, sampler->record_size - len,
+			" 0x%0*" PRIx64, (int)probe->size * 2, value);
+	}
+	len += snprintf(sampler->record + len, sampler->record_size - len, "\n");
+
+	memory_sampler_emit(sampler, sampler->record, len);
+	return ERROR_OK;
+}
+
+static int memory_sampler_timer(void *priv)
+{
+	struct memory_sampler *sampler = priv;
+	struct target *target = sampler->target;
+
+	if (!target_was_examined(target) || target->state == TARGET_RESET)
+		return ERROR_OK;
+
+	/* keep sampling, e.g. the reads fail while the target goes through a reset */
+	if (memory_sampler_sample(sampler) != ERROR_OK) {
+		sampler->failed++;
+		if (!sampler->failing)
+			LOG_TARGET_WARNING(target, "memory sampling failed, retrying");
+		sampler->failing = true;
+	} else {
+		sampler->failing = false;
+	}
+
+	return ERROR_OK;
+}
+
+static int memory_sampler_service_input(struct connection *connection)
+{
+	/* read a dummy buffer to check if the connection is still active */
+	long dummy;
+	int bytes_read = connection_read(connection, &dummy, sizeof(dummy));
+
+	if (bytes_read == 0) {
+		return ERROR_SERVER_REMOTE_CLOSED;
+	} else if (bytes_read == -1) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int memory_sampler_service_new_connection(struct connection *connection)
+{
+	struct memory_sampler_priv_connection *priv = connection->service->priv;
+	struct memory_sampler *sampler = priv->sampler;
+	struct memory_sampler_connection *c = malloc(sizeof(*c));
+	if (!c) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	c->connection = connection;
+	list_add(&c->lh, &sampler->connections);
+
+	/* a client can connect in the middle of the stream */
+	int len = memory_sampler_header(sampler, sampler->record, sampler->record_size);
+	connection_write(connection, sampler->record, len);
+	return ERROR_OK;
+}
+
+static int memory_sampler_service_connection_closed(struct connection *connection)
+{
+	struct memory_sampler_priv_connection *priv = connection->service->priv;
+	struct memory_sampler_connection *c, *tmp;
+
+	list_for_each_entry_safe(c, tmp, &priv->sampler->connections, lh)
+		if (c->connection == connection) {
+			list_del(&c->lh);
+			free(c);
+			return ERROR_OK;
+		}
+	LOG_ERROR("Failed to find connection to close!");
+	return ERROR_FAIL;
+}
+
+static const struct service_driver memory_sampler_service_driver = {
+	.name = MEMORY_SAMPLER_SERVICE_NAME,
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = memory_sampler_service_new_connection,
+	.input_handler = memory_sampler_service_input,
+	.connection_closed_handler = memory_sampler_service_connection_closed,
+	.keep_client_alive_handler = NULL,
+};
+
+static int memory_sampler_open(struct memory_sampler *sampler)
+{
+	if (sampler->output[0] != ':') {
+		sampler->file = fopen(sampler->output, "a");
+		if (!sampler->file) {
+			LOG_ERROR("Can't open memory sampling destination file \"%s\"", sampler->output);
+			return ERROR_FAIL;
+		}
+		int len = memory_sampler_header(sampler, sampler->record, sampler->record_size);
+		memory_sampler_emit(sampler, sampler->record, len);
+		return ERROR_OK;
+	}
+
+	struct memory_sampler_priv_connection *priv = malloc(sizeof(*priv));
+	if (!priv) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	priv->sampler = sampler;
+	int retval = add_service(&memory_sampler_service_driver, &sampler->output[1],
+		CONNECTION_LIMIT_UNLIMITED, priv);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Can't configure memory sampling TCP port %s", &sampler->output[1]);
+		free(priv);
+		return retval;
+	}
+	sampler->service_started = true;
+	return ERROR_OK;
+}
+
+static void memory_sampler_close(struct memory_sampler *sampler)
+{
+	if (sampler->file) {
+		fclose(sampler->file);
+		sampler->file = NULL;
+	}
+	if (sampler->service_started) {
+		remove_service(MEMORY_SAMPLER_SERVICE_NAME, &sampler->output[1]);
+		sampler->service_started = false;
+	}
+}
+
+static void memory_sampler_stop(struct memory_sampler *sampler)
+{
+	if (!sampler->running)
+		return;
+
+	target_unregister_timer_callback(memory_sampler_timer, sampler);
+	sampler->running = false;
+	sampler->duration_us += monotonic_us() - sampler->stats_start_us;
+	memory_sampler_close(sampler);
+}
+
+/* Lay out one read per probe and the buffer of the records */
+static int memory_sampler_prepare(struct memory_sampler *sampler)
+{
+	struct memory_sampler_probe *probe;
+	size_t values_size = 0;
+
+	list_for_each_entry(probe, &sampler->probes, lh)
+		values_size += probe->size;
+
+	struct target_memory_access *accesses = realloc(sampler->accesses,
+		sampler->probe_count * sizeof(*accesses));
+	uint8_t *values = realloc(sampler->values, values_size);
+	/* the header takes " 0x", up to 16 digits and "/64" per probe */
+	size_t record_size = 32 + sampler->probe_count * 24;
+	char *record = realloc(sampler->record, record_size);
+	if (accesses)
+		sampler->accesses = accesses;
+	if (values)
+		sampler->values = values;
+	if (record) {
+		sampler->record = record;
+		sampler->record_size = record_size;
+	}
+	if (!accesses || !values || !record) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	unsigned int i = 0;
+	uint8_t *buf = values;
+	list_for_each_entry(probe, &sampler->probes, lh) {
+		accesses[i].address = probe->address;
+		accesses[i].size = probe->size;
+		accesses[i].buffer = buf;
+		accesses[i].write = false;
+		buf += probe->size;
+		i++;
+	}
+
+	return ERROR_OK;
+}
+
+void memory_sampler_free(struct target *target)
+{
+	struct memory_sampler *sampler = target->memory_sampler;
+	struct memory_sampler_probe *probe, *tmp;
+
+	if (!sampler)
+		return;
+
+	memory_sampler_stop(sampler);
+	list_for_each_entry_safe(probe, tmp, &sampler->probes, lh) {
+		list_del(&probe->lh);
+		free(probe);
+	}
+	free(sampler->accesses);
+	free(sampler->values);
+	free(sampler->record);
+	free(sampler->output);
+	free(sampler);
+	target->memory_sampler = NULL;
+}
+
+COMMAND_HANDLER(handle_memory_sampler_add)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	target_addr_t address;
+	unsigned int width;
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], width);
+	if (width != 8 && width != 16 && width != 32 && width != 64) {
+		command_print(CMD, "invalid width %u, must be 8, 16, 32 or 64", width);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	if (address % (width / 8)) {
+		command_print(CMD, "address " TARGET_ADDR_FMT " is not aligned to %u bits",
+			address, width);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct memory_sampler *sampler = memory_sampler_get(target);
+	if (!sampler)
+		return ERROR_FAIL;
+
+	if (sampler->running) {
+		command_print(CMD, "Stop the sampling of %s before changing the probes",
+			target_name(target));
+		return ERROR_FAIL;
+	}
+
+	if (memory_sampler_find(sampler, address)) {
+		command_print(CMD, "address " TARGET_ADDR_FMT " is already sampled", address);
+		return ERROR_FAIL;
+	}
+
+	struct memory_sampler_probe *probe = malloc(sizeof(*probe));
+	if (!probe) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	probe->address = address;
+	probe->size = width / 8;
+	list_add_tail(&probe->lh, &sampler->probes);
+	sampler->probe_count++;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sampler_remove)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct memory_sampler *sampler = target->memory_sampler;
+	struct memory_sampler_probe *probe, *tmp;
+	target_addr_t address = 0;
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	bool all = !strcmp(CMD_ARGV[0], "all");
+	if (!all)
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+
+	if (sampler && sampler->running) {
+		command_print(CMD, "Stop the sampling of %s before changing the probes",
+			target_name(target));
+		return ERROR_FAIL;
+	}
+
+	if (all) {
+		if (sampler) {
+			list_for_each_entry_safe(probe, tmp, &sampler->probes, lh) {
+				list_del(&probe->lh);
+				free(probe);
+			}
+			sampler->probe_count = 0;
+		}
+		return ERROR_OK;
+	}
+
+	probe = sampler ? memory_sampler_find(sampler, address) : NULL;
+	if (!probe) {
+		command_print(CMD, "address " TARGET_ADDR_FMT " is not sampled", address);
+		return ERROR_FAIL;
+	}
+	list_del(&probe->lh);
+	free(probe);
+	sampler->probe_count--;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sampler_list)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct memory_sampler *sampler = target->memory_sampler;
+	struct memory_sampler_probe *probe;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!sampler)
+		return ERROR_OK;
+
+	list_for_each_entry(probe, &sampler->probes, lh)
+		command_print(CMD, TARGET_ADDR_FMT " %u", probe->address, probe->size * 8);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sampler_start)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	unsigned int interval_ms = MEMORY_SAMPLER_INTERVAL_MS;
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 2) {
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], interval_ms);
+		if (interval_ms == 0)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct memory_sampler *sampler = target->memory_sampler;
+	if (!sampler || !sampler->probe_count) {
+		command_print(CMD, "No memory to sample on %s, add probes first", target_name(target));
+		return ERROR_FAIL;
+	}
+
+	if (sampler->running) {
+		command_print(CMD, "Sampling of %s already running", target_name(target));
+		return ERROR_FAIL;
+	}
+
+	if (!target_was_examined(target)) {
+		command_print(CMD, "Target %s not examined yet", target_name(target));
+		return ERROR_TARGET_NOT_EXAMINED;
+	}
+
+	int retval = memory_sampler_prepare(sampler);
+	if (retval != ERROR_OK)
+		return retval;
+
+	char *output = strdup(CMD_ARGV[0]);
+	if (!output) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	free(sampler->output);
+	sampler->output = output;
+
+	/* report probes which cannot be read right away */
+	retval = target_access_memory_batch(target, sampler->accesses, sampler->probe_count);
+	if (retval != ERROR_OK) {
+		command_print(CMD, "Failed to read the probes of %s", target_name(target));
+		return retval;
+	}
+
+	retval = memory_sampler_open(sampler);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = target_register_timer_callback(memory_sampler_timer, interval_ms,
+		TARGET_TIMER_TYPE_PERIODIC, sampler);
+	if (retval != ERROR_OK) {
+		memory_sampler_close(sampler);
+		return retval;
+	}
+
+	sampler->interval_ms = interval_ms;
+	sampler->running = true;
+	sampler->failing = false;
+	sampler->start_us = monotonic_us();
+	sampler->stats_start_us = sampler->start_us;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sampler_stop)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (target->memory_sampler)
+		memory_sampler_stop(target->memory_sampler);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sampler_status)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct memory_sampler *sampler = target->memory_sampler;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		if (sampler) {
+			sampler->samples = 0;
+			sampler->read_us = 0;
+			sampler->failed = 0;
+			sampler->lost = 0;
+			sampler->duration_us = 0;
+			/* start_us stays, the timestamps of the records go on */
+			sampler->stats_start_us = monotonic_us();
+		}
+		return ERROR_OK;
+	}
+
+	if (!sampler || (!sampler->running && !sampler->samples)) {
+		command_print(CMD, "%s: memory sampling never started", target_name(target));
+		return ERROR_OK;
+	}
+
+	int64_t duration_us = sampler->duration_us;
+	if (sampler->running)
+		duration_us += monotonic_us() - sampler->stats_start_us;
+
+	command_print(CMD, "%s: memory sampling %s, %u probes every %u ms to %s",
+		target_name(target), sampler->running ? "running" : "stopped",
+		sampler->probe_count, sampler->interval_ms, sampler->output);
+	command_print(CMD, "%" PRIu64 " samples in %" PRId64 ".%03" PRId64 " s, %" PRIu64
+		" samples/s, %" PRId64 " us per read", sampler->samples,
+		duration_us / 1000000, duration_us / 1000 % 1000,
+		duration_us > 0 ? sampler->samples * 1000000 / duration_us : 0,
+		sampler->samples ? sampler->read_us / (int64_t)sampler->samples : 0);
+	command_print(CMD, "%" PRIu64 " failed reads, %" PRIu64 " records lost",
+		sampler->failed, sampler->lost);
+	return ERROR_OK;
+}
+
+const struct command_registration memory_sampler_command_handlers[] = {
+	{
+		.name = "add",
+		.mode = COMMAND_ANY,
+		.handler = handle_memory_sampler_add,
+		.help = "Add a probe, the memory at address is read at each sample",
+		.usage = "address ('8'|'16'|'32'|'64')",
+	},
+	{
+		.name = "remove",
+		.mode = COMMAND_ANY,
+		.handler = handle_memory_sampler_remove,
+		.help = "Remove the probe at address, or all of them",
+		.usage = "(address|'all')",
+	},
+	{
+		.name = "list",
+		.mode = COMMAND_ANY,
+		.handler = handle_memory_sampler_list,
+		.help = "List the probes, as address and width",
+		.usage = "",
+	},
+	{
+		.name = "start",
+		.mode = COMMAND_EXEC,
+		.handler = handle_memory_sampler_start,
+		.help = "Start sampling the probes to a file, or to a TCP port given as ':port'",
+		.usage = "(filename|:port) [interval_ms]",
+	},
+	{
+		.name = "stop",
+		.mode = COMMAND_EXEC,
+		.handler = handle_memory_sampler_stop,
+		.help = "Stop sampling the probes",
+		.usage = "",
+	},
+	{
+		.name = "status",
+		.mode = COMMAND_EXEC,
+		.handler = handle_memory_sampler_status,
+		.help = "Display or reset the achieved sample rate and the losses",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
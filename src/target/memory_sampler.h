@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Periodic sampling of target memory while the target runs, streamed as
+ * timestamped records to a file or to TCP clients.
+ */
+
+#ifndef OPENOCD_TARGET_MEMORY_SAMPLER_H
+#define OPENOCD_TARGET_MEMORY_SAMPLER_H
+
+#include <helper/command.h>
+
+struct target;
+
+/** Subcommands of '$target_name sample' */
+extern const struct command_registration memory_sampler_command_handlers[];
+
+/** Stop the sampling of the target and release its probes */
+void memory_sampler_free(struct target *target);
+
+#endif /* OPENOCD_TARGET_MEMORY_SAMPLER_H */
@@ -0,0 +1,322 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Histogram of PC samples.
+ *
+ * The samples are binned as they arrive in a hash of the sampled PCs, so
+ * there is no limit on the number of samples and a snapshot can be written
+ * at any time, while the sampling goes on.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/log.h>
+#include "profile_histogram.h"
+#include "target.h"
+
+#define PROFILE_HISTOGRAM_INITIAL_SIZE	4096
+
+static unsigned int profile_histogram_slot(const struct profile_histogram *hist, uint32_t pc)
+{
+	/* Fibonacci hashing, the low bits of PCs are far from random */
+	return (uint32_t)(pc * 0x9e3779b1u) & (hist->size - 1);
+}
+
+static int profile_histogram_alloc(struct profile_histogram *hist, unsigned int size)
+{
+	hist->entries = calloc(size, sizeof(*hist->entries));
+	if (!hist->entries) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	hist->size = size;
+	hist->used = 0;
+	return ERROR_OK;
+}
+
+int profile_histogram_init(struct profile_histogram *hist)
+{
+	hist->samples = 0;
+	return profile_histogram_alloc(hist, PROFILE_HISTOGRAM_INITIAL_SIZE);
+}
+
+void profile_histogram_free(struct profile_histogram *hist)
+{
+	free(hist->entries);
+	hist->entries = NULL;
+	hist->size = 0;
+	hist->used = 0;
+	hist->samples = 0;
+}
+
+void profile_histogram_reset(struct profile_histogram *hist)
+{
+	memset(hist->entries, 0, hist->size * sizeof(*hist->entries));
+	hist->used = 0;
+	hist->samples = 0;
+}
+
+static struct profile_histogram_entry *profile_histogram_lookup(struct profile_histogram *hist,
+		uint32_t pc)
+{
+	unsigned int slot = profile_histogram_slot(hist, pc);
+
+	while (hist->entries[slot].count && hist->entries[slot].pc != pc)
+		slot = (slot + 1) & (hist->size - 1);
+
+	return &hist->entries[slot];
+}
+
+static int profile_histogram_grow(struct profile_histogram *hist)
+{
+	struct profile_histogram_entry *old = hist->entries;
+	unsigned int old_size = hist->size;
+
+	int retval = profile_histogram_alloc(hist, old_size * 2);
+	if (retval != ERROR_OK) {
+		hist->entries = old;
+		hist->size = old_size;
+		return retval;
+	}
+
+	for (unsigned int i = 0; i < old_size; i++) {
+		if (!old[i].count)
+			continue;
+		*profile_histogram_lookup(hist, old[i].pc) = old[i];
+		hist->used++;
+	}
+
+	free(old);
+	return ERROR_OK;
+}
+
+int profile_histogram_add(struct profile_histogram *hist, uint32_t pc, uint64_t count)
+{
+	struct profile_histogram_entry *entry = profile_histogram_lookup(hist, pc);
+
+	if (!entry->count) {
+		/* keep the load below one half */
+		if (2 * (hist->used + 1) > hist->size) {
+			int retval = profile_histogram_grow(hist);
+			if (retval != ERROR_OK)
+				return retval;
+			entry = profile_histogram_lookup(hist, pc);
+		}
+		entry->pc = pc;
+		hist->used++;
+	}
+
+	entry->count += count;
+	hist->samples += count;
+	return ERROR_OK;
+}
+
+static int profile_entry_compare(const void *a, const void *b)
+{
+	const struct profile_histogram_entry *ea = a;
+	const struct profile_histogram_entry *eb = b;
+
+	if (ea->pc != eb->pc)
+		return ea->pc < eb->pc ? -1 : 1;
+	return 0;
+}
+
+/* The sampled PCs in ascending order, the caller has to free the array */
+static struct profile_histogram_entry *profile_histogram_sorted(const struct profile_histogram *hist)
+{
+	struct profile_histogram_entry *sorted = malloc((hist->used + 1) * sizeof(*sorted));
+	if (!sorted) {
+		LOG_ERROR("Out of memory");
+		return NULL;
+	}
+
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < hist->size; i++)
+		if (hist->entries[i].count)
+			sorted[n++] = hist->entries[i];
+
+	qsort(sorted, n, sizeof(*sorted), profile_entry_compare);
+	return sorted;
+}
+
+static void write_data(FILE *f, const void *data, size_t len)
+{
+	size_t written = fwrite(data, 1, len, f);
+	if (written != len)
+		LOG_ERROR("failed to write %zu bytes: %s", len, strerror(errno));
+}
+
+static void write_long(FILE *f, int l, struct target *target)
+{
+	uint8_t val[4];
+
+	target_buffer_set_u32(target, val, l);
+	write_data(f, val, 4);
+}
+
+static void write_string(FILE *f, char *s)
+{
+	write_data(f, s, strlen(s));
+}
+
+typedef unsigned char UNIT[2];  /* unit of profiling */
+
+/* Dump a gmon.out histogram file. */
+int profile_histogram_write_gmon(const struct profile_histogram *hist, const char *filename,
+		bool with_range, uint32_t start_address, uint32_t end_address,
+		struct target *target, uint32_t duration_ms)
+{
+	uint32_t i;
+	FILE *f = fopen(filename, "wb");
+	if (!f) {
+		LOG_ERROR("Can't open \"%s\"", filename);
+		return ERROR_FAIL;
+	}
+	write_string(f, "gmon");
+	write_long(f, 0x00000001, target); /* Version */
+	write_long(f, 0, target); /* padding */
+	write_long(f, 0, target); /* padding */
+	write_long(f, 0, target); /* padding */
+
+	uint8_t zero = 0;  /* GMON_TAG_TIME_HIST */
+	write_data(f, &zero, 1);
+
+	/* figure out bucket size */
+	uint32_t min;
+	uint32_t max;
+	if (with_range) {
+		min = start_address;
+		max = end_address;
+	} else {
+		min = UINT32_MAX;
+		max = 0;
+		for (i = 0; i < hist->size; i++) {
+			if (!hist->entries[i].count)
+				continue;
+			if (min > hist->entries[i].pc)
+				min = hist->entries[i].pc;
+			if (max < hist->entries[i].pc)
+				max = hist->entries[i].pc;
+		}
+		if (!hist->used)
+			min = 0;
+
+		/* max should be (largest sample + 1)
+		 * Refer to binutils/gprof/hist.c (find_histogram_for_pc) */
+		if (max < UINT32_MAX)
+			max++;
+
+		/* gprof requires (max - min) >= 2 */
+		while ((max - min) < 2) {
+			if (max < UINT32_MAX)
+				max++;
+			else
+				min--;
+		}
+	}
+
+	uint32_t address_space = max - min;
+
+	/* FIXME: What is the reasonable number of buckets?
+	 * The profiling result will be more accurate if there are enough buckets. */
+	static const uint32_t max_buckets = 128 * 1024; /* maximum buckets. */
+	uint32_t num_buckets = address_space / sizeof(UNIT);
+	if (num_buckets > max_buckets)
+		num_buckets = max_buckets;
+	uint64_t *buckets = calloc(num_buckets, sizeof(*buckets));
+	if (!buckets) {
+		fclose(f);
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	for (i = 0; i < hist->size; i++) {
+		uint32_t address = hist->entries[i].pc;
+
+		if (!hist->entries[i].count || (address < min) || (max <= address))
+			continue;
+
+		long long a = address - min;
+		long long b = num_buckets;
+		long long c = address_space;
+		int index_t = (a * b) / c; /* danger!!!! int32 overflows */
+		buckets[index_t] += hist->entries[i].count;
+	}
+
+	/* append binary memory gmon.out &profile_hist_hdr ((char*)&profile_hist_hdr + sizeof(struct gmon_hist_hdr)) */
+	write_long(f, min, target);			/* low_pc */
+	write_long(f, max, target);			/* high_pc */
+	write_long(f, num_buckets, target);	/* # of buckets */
+	float sample_rate = hist->samples / (duration_ms / 1000.0);
+	write_long(f, sample_rate, target);
+	write_string(f, "seconds");
+	for (i = 0; i < (15-strlen("seconds")); i++)
+		write_data(f, &zero, 1);
+	write_string(f, "s");
+
+	/*append binary memory gmon.out profile_hist_data (profile_hist_data + profile_hist_hdr.hist_size) */
+
+	char *data = malloc(2 * num_buckets);
+	if (data) {
+		for (i = 0; i < num_buckets; i++) {
+			uint64_t val;
+			val = buckets[i];
+			if (val > 65535)
+				val = 65535;
+			data[i * 2] = val&0xff;
+			data[i * 2 + 1] = (val >> 8) & 0xff;
+		}
+		free(buckets);
+		write_data(f, data, num_buckets * 2);
+		free(data);
+	} else
+		free(buckets);
+
+	if (fclose(f) != 0) {
+		LOG_ERROR("failed to write \"%s\"", filename);
+		return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
+static int profile_histogram_write_text(const struct profile_histogram *hist,
+		const char *filename, const char *header, char separator)
+{
+	struct profile_histogram_entry *sorted = profile_histogram_sorted(hist);
+	if (!sorted)
+		return ERROR_FAIL;
+
+	FILE *f = fopen(filename, "w");
+	if (!f) {
+		LOG_ERROR("Can't open \"%s\"", filename);
+		free(sorted);
+		return ERROR_FAIL;
+	}
+
+	if (header)
+		fputs(header, f);
+	for (unsigned int i = 0; i < hist->used; i++)
+		fprintf(f, "0x%08" PRIx32 "%c%" PRIu64 "\n", sorted[i].pc, separator, sorted[i].count);
+
+	free(sorted);
+
+	bool ok = !ferror(f);
+	if (fclose(f) != 0)
+		ok = false;
+	if (!ok) {
+		LOG_ERROR("failed to write \"%s\"", filename);
+		return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
+int profile_histogram_write_folded(const struct profile_histogram *hist, const char *filename)
+{
+	return profile_histogram_write_text(hist, filename, NULL, ' ');
+}
+
+int profile_histogram_write_csv(const struct profile_histogram *hist, const char *filename)
+{
+	return profile_histogram_write_text(hist, filename, "pc,count\n", ',');
+}
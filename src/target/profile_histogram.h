@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Histogram of PC samples, filled as the samples arrive, and its export
+ * to gmon.out, folded stacks and CSV.
+ */
+
+#ifndef OPENOCD_TARGET_PROFILE_HISTOGRAM_H
+#define OPENOCD_TARGET_PROFILE_HISTOGRAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct target;
+
+struct profile_histogram_entry {
+	uint32_t pc;
+	/** zero for a free slot */
+	uint64_t count;
+};
+
+/** Open addressing hash of the sampled PCs, grown as needed */
+struct profile_histogram {
+	struct profile_histogram_entry *entries;
+	/** number of slots, a power of 2 */
+	unsigned int size;
+	/** number of distinct PCs */
+	unsigned int used;
+	/** total number of samples */
+	uint64_t samples;
+};
+
+int profile_histogram_init(struct profile_histogram *hist);
+void profile_histogram_free(struct profile_histogram *hist);
+void profile_histogram_reset(struct profile_histogram *hist);
+int profile_histogram_add(struct profile_histogram *hist, uint32_t pc, uint64_t count);
+
+/**
+ * Write the histogram as a gmon.out file, over the range of the samples
+ * or over [start_address, end_address) when with_range is set.
+ * @param duration_ms time over which the samples were taken, for the sample rate
+ */
+int profile_histogram_write_gmon(const struct profile_histogram *hist, const char *filename,
+		bool with_range, uint32_t start_address, uint32_t end_address,
+		struct target *target, uint32_t duration_ms);
+
+/** Write one "pc count" line per sampled PC, the format of flame graph tools */
+int profile_histogram_write_folded(const struct profile_histogram *hist, const char *filename);
+
+/** Write one "pc,count" line per sampled PC, after a header line */
+int profile_histogram_write_csv(const struct profile_histogram *hist, const char *filename);
+
+#endif /* OPENOCD_TARGET_PROFILE_HISTOGRAM_H */
@@ -102,6 +102,218 @@ void register_cache_invalidate(struct reg_cache *cache)
 	}
 }
 
+static bool register_needs_fetch(const struct reg *reg)
+{
+	return reg && reg->exist && !reg->valid && reg->type && reg->type->get_many;
+}
+
+/**
+ * Reads the invalid registers of a list with one get_many() call per
+ * register type. The registers which could not be read that way are left
+ * invalid, for the caller to read them one by one with get().
+ */
+int register_fetch_list(struct reg **reg_list, unsigned int count)
+{
+	const struct reg_arch_type **types = calloc(count, sizeof(*types));
+	struct reg **batch = calloc(count, sizeof(*batch));
+	unsigned int num_types = 0;
+	int retval = ERROR_OK;
+
+	if (!types || !batch) {
+		LOG_ERROR("Out of memory");
+		free(types);
+		free(batch);
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (!register_needs_fetch(reg_list[i]))
+			continue;
+
+		const struct reg_arch_type *type = reg_list[i]->type;
+		unsigned int t;
+		for (t = 0; t < num_types; t++)
+			if (types[t] == type)
+				break;
+		if (t < num_types)
+			continue;
+		types[num_types++] = type;
+
+		unsigned int n = 0;
+		for (unsigned int j = i; j < count; j++)
+			if (register_needs_fetch(reg_list[j]) && reg_list[j]->type == type)
+				batch[n++] = reg_list[j];
+
+		int result = type->get_many(batch, n);
+		if (result != ERROR_OK) {
+			LOG_DEBUG("batched read of %u registers from %s failed", n, reg_list[i]->name);
+			if (retval == ERROR_OK)
+				retval = result;
+		}
+	}
+
+	free(types);
+	free(batch);
+	return retval;
+}
+
+/*
+ * Hash index of the registers of a cache chain, by name and by number.
+ * It records the caches it was built from, so that a chain where caches
+ * were added, removed or rebuilt is detected and indexed again.
+ */
+struct reg_index_entry {
+	struct reg *reg;
+	/* position of the cache in the chain, for lookups in the first one only */
+	unsigned int cache_pos;
+};
+
+struct reg_index_cache {
+	const struct reg_cache *cache;
+	const struct reg *reg_list;
+	unsigned int num_regs;
+};
+
+struct reg_index {
+	struct reg_index_cache *caches;
+	unsigned int num_caches;
+	/* open addressing, linear probing: equal keys keep the cache order */
+	struct reg_index_entry *by_name;
+	struct reg_index_entry *by_number;
+	unsigned int mask;
+};
+
+static uint32_t register_hash_name(const char *name)
+{
+	/* FNV-1a */
+	uint32_t hash = 2166136261u;
+	while (*name) {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static uint32_t register_hash_number(uint32_t number)
+{
+	return number * 2654435761u;
+}
+
+static void register_index_insert(struct reg_index_entry *table, unsigned int mask,
+		uint32_t hash, struct reg *reg, unsigned int cache_pos)
+{
+	unsigned int slot = hash & mask;
+	while (table[slot].reg)
+		slot = (slot + 1) & mask;
+	table[slot].reg = reg;
+	table[slot].cache_pos = cache_pos;
+}
+
+void register_index_free(struct reg_index *index)
+{
+	if (!index)
+		return;
+
+	free(index->caches);
+	free(index->by_name);
+	free(index->by_number);
+	free(index);
+}
+
+struct reg_index *register_index_create(struct reg_cache *first)
+{
+	struct reg_index *index = calloc(1, sizeof(*index));
+	if (!index)
+		return NULL;
+
+	unsigned int num_regs = 0;
+	for (struct reg_cache *cache = first; cache; cache = cache->next) {
+		index->num_caches++;
+		num_regs += cache->num_regs;
+	}
+
+	/* at most half full */
+	unsigned int size = 16;
+	while (size < 2 * num_regs)
+		size *= 2;
+	index->mask = size - 1;
+
+	index->caches = calloc(index->num_caches, sizeof(*index->caches));
+	index->by_name = calloc(size, sizeof(*index->by_name));
+	index->by_number = calloc(size, sizeof(*index->by_number));
+	if ((index->num_caches && !index->caches) || !index->by_name || !index->by_number) {
+		register_index_free(index);
+		return NULL;
+	}
+
+	unsigned int pos = 0;
+	for (struct reg_cache *cache = first; cache; cache = cache->next, pos++) {
+		index->caches[pos].cache = cache;
+		index->caches[pos].reg_list = cache->reg_list;
+		index->caches[pos].num_regs = cache->num_regs;
+
+		for (unsigned int i = 0; i < cache->num_regs; i++) {
+			struct reg *reg = &cache->reg_list[i];
+			if (reg->name)
+				register_index_insert(index->by_name, index->mask,
+						register_hash_name(reg->name), reg, pos);
+			register_index_insert(index->by_number, index->mask,
+					register_hash_number(reg->number), reg, pos);
+		}
+	}
+
+	return index;
+}
+
+bool register_index_is_current(const struct reg_index *index, const struct reg_cache *first)
+{
+	unsigned int pos = 0;
+
+	for (const struct reg_cache *cache = first; cache; cache = cache->next, pos++) {
+		if (pos >= index->num_caches)
+			return false;
+		const struct reg_index_cache *c = &index->caches[pos];
+		if (c->cache != cache || c->reg_list != cache->reg_list || c->num_regs != cache->num_regs)
+			return false;
+	}
+
+	return pos == index->num_caches;
+}
+
+/** Same as register_get_by_number(), with the index of the cache chain. */
+struct reg *register_index_get_by_number(const struct reg_index *index,
+		uint32_t reg_num, bool search_all)
+{
+	unsigned int slot = register_hash_number(reg_num) & index->mask;
+
+	for (; index->by_number[slot].reg; slot = (slot + 1) & index->mask) {
+		const struct reg_index_entry *entry = &index->by_number[slot];
+		if (!search_all && entry->cache_pos)
+			continue;
+		if (entry->reg->exist && entry->reg->number == reg_num)
+			return entry->reg;
+	}
+
+	return NULL;
+}
+
+/** Same as register_get_by_name(), with the index of the cache chain. */
+struct reg *register_index_get_by_name(const struct reg_index *index,
+		const char *name, bool search_all)
+{
+	unsigned int slot = register_hash_name(name) & index->mask;
+
+	for (; index->by_name[slot].reg; slot = (slot + 1) & index->mask) {
+		const struct reg_index_entry *entry = &index->by_name[slot];
+		if (!search_all && entry->cache_pos)
+			continue;
+		if (entry->reg->exist && strcmp(entry->reg->name, name) == 0)
+			return entry->reg;
+	}
+
+	return NULL;
+}
+
 static int register_get_dummy_core_reg(struct reg *reg)
 {
 	return ERROR_OK;
@@ -151,6 +151,9 @@ struct reg_cache {
 struct reg_arch_type {
 	int (*get)(struct reg *reg);
 	int (*set)(struct reg *reg, uint8_t *buf);
+	/* Optional: read a set of registers of this type in one batch. The
+	 * registers it can't read are left invalid, for get() to read them. */
+	int (*get_many)(struct reg **regs, unsigned int count);
 };
 
 struct reg *register_get_by_number(struct reg_cache *first,
@@ -160,6 +163,16 @@ struct reg *register_get_by_name(struct reg_cache *first,
 struct reg_cache **register_get_last_cache_p(struct reg_cache **first);
 void register_unlink_cache(struct reg_cache **cache_p, const struct reg_cache *cache);
 void register_cache_invalidate(struct reg_cache *cache);
+int register_fetch_list(struct reg **reg_list, unsigned int count);
+
+struct reg_index;
+struct reg_index *register_index_create(struct reg_cache *first);
+void register_index_free(struct reg_index *index);
+bool register_index_is_current(const struct reg_index *index, const struct reg_cache *first);
+struct reg *register_index_get_by_number(const struct reg_index *index,
+		uint32_t reg_num, bool search_all);
+struct reg *register_index_get_by_name(const struct reg_index *index,
+		const char *name, bool search_all);
 
 void register_init_dummy(struct reg *reg);
 
@@ -37,6 +37,8 @@ static void riscv013_clear_abstract_error(struct target *target);
 /* Implementations of the functions in struct riscv_info. */
 static int riscv013_get_register(struct target *target,
 		riscv_reg_t *value, int rid);
+static int riscv013_get_registers(struct target *target, riscv_reg_t *values,
+		const uint32_t *numbers, unsigned int count);
 static int riscv013_set_register(struct target *target, int regid, uint64_t value);
 static int riscv013_select_current_hart(struct target *target);
 static int riscv013_halt_prep(struct target *target);
@@ -2277,6 +2279,7 @@ static int init_target(struct command_context *cmd_ctx,
 	RISCV_INFO(generic_info);
 
 	generic_info->get_register = &riscv013_get_register;
+	generic_info->get_registers = &riscv013_get_registers;
 	generic_info->set_register = &riscv013_set_register;
 	generic_info->get_register_buf = &riscv013_get_register_buf;
 	generic_info->set_register_buf = &riscv013_set_register_buf;
@@ -4092,6 +4095,75 @@ static int riscv013_get_register(struct target *target,
 	return result;
 }
 
+/*
+ * Read GPRs with one abstract command each, all queued in a single batch.
+ * An abstract command issued while the previous one is busy fails the
+ * whole batch through cmderr, so the caller can fall back on single reads.
+ */
+static int riscv013_get_registers(struct target *target, riscv_reg_t *values,
+		const uint32_t *numbers, unsigned int count)
+{
+	RISCV013_INFO(info);
+	unsigned int xlen = riscv_xlen(target);
+	int result = ERROR_FAIL;
+
+	if (riscv_select_current_hart(target) != ERROR_OK)
+		return ERROR_FAIL;
+
+	struct riscv_batch *batch = riscv_batch_alloc(target, count * 3,
+			info->dmi_busy_delay + info->ac_busy_delay);
+	if (!batch)
+		return ERROR_FAIL;
+
+	for (unsigned int i = 0; i < count; i++) {
+		assert(numbers[i] > GDB_REGNO_ZERO && numbers[i] <= GDB_REGNO_XPR31);
+		riscv_batch_add_dmi_write(batch, DM_COMMAND,
+			access_register_command(target, numbers[i], xlen, AC_ACCESS_REGISTER_TRANSFER));
+		if (xlen > 32)
+			riscv_batch_add_dmi_read(batch, DM_DATA1);
+		riscv_batch_add_dmi_read(batch, DM_DATA0);
+	}
+
+	if (batch_run(target, batch) != ERROR_OK)
+		goto out;
+
+	uint32_t abstractcs;
+	do {
+		if (dmi_read(target, &abstractcs, DM_ABSTRACTCS) != ERROR_OK)
+			goto out;
+	} while (get_field(abstractcs, DM_ABSTRACTCS_BUSY));
+
+	info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+	if (info->cmderr != CMDERR_NONE) {
+		LOG_DEBUG("batched register read failed; abstractcs=0x%x", abstractcs);
+		if (info->cmderr == CMDERR_BUSY)
+			increase_ac_busy_delay(target);
+		riscv013_clear_abstract_error(target);
+		goto out;
+	}
+
+	size_t key = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		riscv_reg_t value = 0;
+		for (unsigned int word = 0; word < xlen / 32; word++) {
+			if (riscv_batch_get_dmi_read_op(batch, key) != DMI_STATUS_SUCCESS) {
+				LOG_DEBUG("batched register read encountered a DMI error");
+				goto out;
+			}
+			value = (value << 32) | riscv_batch_get_dmi_read_data(batch, key);
+			key++;
+		}
+		values[i] = value;
+		LOG_DEBUG("{%d} %s = 0x%" PRIx64, riscv_current_hartid(target),
+				gdb_regno_name(numbers[i]), value);
+	}
+	result = ERROR_OK;
+
+out:
+	riscv_batch_free(batch);
+	return result;
+}
+
 static int riscv013_set_register(struct target *target, int rid, uint64_t value)
 {
 	riscv013_select_current_hart(target);
@@ -1843,7 +1843,7 @@ static int riscv_run_algorithm(struct target *target, int num_mem_params,
 	}
 
 	/* Save registers */
-	struct reg *reg_pc = register_get_by_name(target->reg_cache, "pc", true);
+	struct reg *reg_pc = target_get_reg_by_name(target, "pc", true);
 	if (!reg_pc || reg_pc->type->get(reg_pc) != ERROR_OK)
 		return ERROR_FAIL;
 	uint64_t saved_pc = buf_get_u64(reg_pc->value, 0, reg_pc->size);
@@ -1852,7 +1852,7 @@ static int riscv_run_algorithm(struct target *target, int num_mem_params,
 	uint64_t saved_regs[32];
 	for (int i = 0; i < num_reg_params; i++) {
 		LOG_DEBUG("save %s", reg_params[i].reg_name);
-		struct reg *r = register_get_by_name(target->reg_cache, reg_params[i].reg_name, false);
+		struct reg *r = target_get_reg_by_name(target, reg_params[i].reg_name, false);
 		if (!r) {
 			LOG_ERROR("Couldn't find register named '%s'", reg_params[i].reg_name);
 			return ERROR_FAIL;
@@ -1885,7 +1885,7 @@ static int riscv_run_algorithm(struct target *target, int num_mem_params,
 	uint8_t mstatus_bytes[8] = { 0 };
 
 	LOG_DEBUG("Disabling Interrupts");
-	struct reg *reg_mstatus = register_get_by_name(target->reg_cache,
+	struct reg *reg_mstatus = target_get_reg_by_name(target,
 			"mstatus", true);
 	if (!reg_mstatus) {
 		LOG_ERROR("Couldn't find mstatus!");
@@ -1967,7 +1967,7 @@ static int riscv_run_algorithm(struct target *target, int num_mem_params,
 	for (int i = 0; i < num_reg_params; i++) {
 		if (reg_params[i].direction == PARAM_IN ||
 				reg_params[i].direction == PARAM_IN_OUT) {
-			struct reg *r = register_get_by_name(target->reg_cache, reg_params[i].reg_name, false);
+			struct reg *r = target_get_reg_by_name(target, reg_params[i].reg_name, false);
 			if (r->type->get(r) != ERROR_OK) {
 				LOG_ERROR("get(%s) failed", r->name);
 				return ERROR_FAIL;
@@ -1975,7 +1975,7 @@ static int riscv_run_algorithm(struct target *target, int num_mem_params,
 			buf_cpy(r->value, reg_params[i].value, reg_params[i].size);
 		}
 		LOG_DEBUG("restore %s", reg_params[i].reg_name);
-		struct reg *r = register_get_by_name(target->reg_cache, reg_params[i].reg_name, false);
+		struct reg *r = target_get_reg_by_name(target, reg_params[i].reg_name, false);
 		buf_set_u64(buf, 0, info->xlen, saved_regs[r->number]);
 		if (r->type->set(r, buf) != ERROR_OK) {
 			LOG_ERROR("set(%s) failed", r->name);
@@ -3770,9 +3770,55 @@ static int register_set(struct reg *reg, uint8_t *buf)
 	return ERROR_OK;
 }
 
+/* Read the GPRs of the list in one batch, the other registers are left to register_get() */
+static int register_get_many(struct reg **regs, unsigned int count)
+{
+	riscv_reg_info_t *reg_info = regs[0]->arch_info;
+	struct target *target = reg_info->target;
+	RISCV_INFO(r);
+
+	if (!r->get_registers)
+		return ERROR_OK;
+
+	uint32_t numbers[GDB_REGNO_XPR31 + 1];
+	riscv_reg_t values[GDB_REGNO_XPR31 + 1];
+	struct reg *gprs[GDB_REGNO_XPR31 + 1];
+	unsigned int n = 0;
+
+	for (unsigned int i = 0; i < count && n < ARRAY_SIZE(gprs); i++) {
+		reg_info = regs[i]->arch_info;
+		if (reg_info->target != target || regs[i]->number == GDB_REGNO_ZERO ||
+				regs[i]->number > GDB_REGNO_XPR31)
+			continue;
+		/* x16-x31 don't exist with the E extension, see riscv_get_register() */
+		if (regs[i]->number > GDB_REGNO_XPR15 && riscv_supports_extension(target, 'E'))
+			continue;
+		gprs[n] = regs[i];
+		numbers[n] = regs[i]->number;
+		n++;
+	}
+
+	if (n == 0)
+		return ERROR_OK;
+
+	keep_alive();
+
+	int result = r->get_registers(target, values, numbers, n);
+	if (result != ERROR_OK)
+		return result;
+
+	for (unsigned int i = 0; i < n; i++) {
+		buf_set_u64(gprs[i]->value, 0, gprs[i]->size, values[i]);
+		gprs[i]->valid = gdb_regno_cacheable(gprs[i]->number, false);
+	}
+
+	return ERROR_OK;
+}
+
 static struct reg_arch_type riscv_reg_arch_type = {
 	.get = register_get,
-	.set = register_set
+	.set = register_set,
+	.get_many = register_get_many,
 };
 
 struct csr_info {
@@ -140,6 +140,9 @@ struct riscv_info {
 	/* Helper functions that target the various RISC-V debug spec
 	 * implementations. */
 	int (*get_register)(struct target *target, riscv_reg_t *value, int regid);
+	/* Optional: read a set of GPRs at once */
+	int (*get_registers)(struct target *target, riscv_reg_t *values,
+			const uint32_t *numbers, unsigned int count);
 	int (*set_register)(struct target *target, int regid, uint64_t value);
 	int (*get_register_buf)(struct target *target, uint8_t *buf, int regno);
 	int (*set_register_buf)(struct target *target, int regno,
@@ -18,12 +18,15 @@
 
 #include "target.h"
 
-static int read_rtt_channel(struct target *target,
-		const struct rtt_control *ctrl, unsigned int channel_index,
-		enum rtt_channel_type type, struct rtt_channel *channel)
+/* Maximum number of bytes read from an up-channel per poll */
+#define RTT_READ_MAX_SIZE	(16 * 1024)
+
+/* Size of the reads while searching for the control block */
+#define RTT_SEARCH_CHUNK_SIZE	(64 * 1024)
+
+static target_addr_t rtt_channel_address(const struct rtt_control *ctrl,
+		unsigned int channel_index, enum rtt_channel_type type)
 {
-	int ret;
-	uint8_t buf[RTT_CHANNEL_SIZE];
 	target_addr_t address;
 
 	address = ctrl->address + RTT_CB_SIZE + (channel_index * RTT_CHANNEL_SIZE);
@@ -31,11 +34,12 @@ static int read_rtt_channel(struct target *target,
 	if (type == RTT_CHANNEL_TYPE_DOWN)
 		address += ctrl->num_up_channels * RTT_CHANNEL_SIZE;
 
-	ret = target_read_buffer(target, address, RTT_CHANNEL_SIZE, buf);
-
-	if (ret != ERROR_OK)
-		return ret;
+	return address;
+}
 
+static void parse_rtt_channel(struct target *target, target_addr_t address,
+		const uint8_t *buf, struct rtt_channel *channel)
+{
 	channel->address = address;
 	channel->name_addr = target_buffer_get_u32(target, buf + 0);
 	channel->buffer_addr = target_buffer_get_u32(target, buf + 4);
@@ -43,6 +47,24 @@ static int read_rtt_channel(struct target *target,
 	channel->write_pos = target_buffer_get_u32(target, buf + 12);
 	channel->read_pos = target_buffer_get_u32(target, buf + 16);
 	channel->flags = target_buffer_get_u32(target, buf + 20);
+}
+
+static int read_rtt_channel(struct target *target,
+		const struct rtt_control *ctrl, unsigned int channel_index,
+		enum rtt_channel_type type, struct rtt_channel *channel)
+{
+	int ret;
+	uint8_t buf[RTT_CHANNEL_SIZE];
+	target_addr_t address;
+
+	address = rtt_channel_address(ctrl, channel_index, type);
+
+	ret = target_read_buffer(target, address, RTT_CHANNEL_SIZE, buf);
+
+	if (ret != ERROR_OK)
+		return ret;
+
+	parse_rtt_channel(target, address, buf, channel);
 
 	return ERROR_OK;
 }
@@ -236,48 +258,82 @@ int target_rtt_read_control_block(struct target *target,
 	return ERROR_OK;
 }
 
+/* Find the first occurrence of the ID in the buffer */
+static const uint8_t *find_id(const uint8_t *buf, size_t length, const char *id,
+		size_t id_length)
+{
+	const uint8_t *end = buf + length;
+
+	while ((size_t)(end - buf) >= id_length) {
+		const uint8_t *p = memchr(buf, id[0], end - buf - id_length + 1);
+
+		if (!p)
+			return NULL;
+
+		if (!memcmp(p, id, id_length))
+			return p;
+
+		buf = p + 1;
+	}
+
+	return NULL;
+}
+
+/*
+ * The search area is read in large chunks, each of them is a single
+ * buffer read which the adapter layer transfers with a single flush. The
+ * chunks overlap by the ID length, so that an ID across a chunk boundary
+ * is found.
+ */
 int target_rtt_find_control_block(struct target *target,
 		target_addr_t *address, size_t size, const char *id, bool *found,
 		void *user_data)
 {
-	target_addr_t address_end = *address + size;
-	uint8_t buf[1024];
+	const size_t id_length = strlen(id);
+	const size_t chunk_size = MIN(size, RTT_SEARCH_CHUNK_SIZE);
 
 	*found = false;
 
-	size_t id_matched_length = 0;
-	const size_t id_length = strlen(id);
+	if (!id_length || size < id_length)
+		return ERROR_OK;
+
+	uint8_t *buf = malloc(chunk_size + id_length - 1);
+
+	if (!buf) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
 
 	LOG_INFO("rtt: Searching for control block '%s'", id);
 
-	for (target_addr_t addr = *address; addr < address_end; addr += sizeof(buf)) {
-		int ret;
+	/* bytes kept from the end of the previous chunk */
+	size_t kept = 0;
+	int ret = ERROR_OK;
 
-		const size_t buf_size = MIN(sizeof(buf), address_end - addr);
-		ret = target_read_buffer(target, addr, buf_size, buf);
+	for (target_addr_t offset = 0; offset < size; offset += chunk_size) {
+		const size_t read_size = MIN(chunk_size, size - offset);
+
+		ret = target_read_buffer(target, *address + offset, read_size, buf + kept);
 
 		if (ret != ERROR_OK)
-			return ret;
+			break;
 
-		for (size_t buf_off = 0; buf_off < buf_size; buf_off++) {
-			if (id_matched_length > 0 &&
-			    buf[buf_off] != id[id_matched_length]) {
-				/* Start from beginning */
-				id_matched_length = 0;
-			}
-
-			if (buf[buf_off] == id[id_matched_length])
-				id_matched_length++;
-
-			if (id_matched_length == id_length) {
-				*address = addr + buf_off + 1 - id_length;
-				*found = true;
-				return ERROR_OK;
-			}
+		const uint8_t *match = find_id(buf, kept + read_size, id, id_length);
+
+		if (match) {
+			*address += offset - kept + (match - buf);
+			*found = true;
+			break;
 		}
+
+		size_t keep = MIN(id_length - 1, kept + read_size);
+		memmove(buf, buf + kept + read_size - keep, keep);
+		kept = keep;
 	}
 
-	return ERROR_OK;
+	free(buf);
+
+	return ret;
 }
 
 int target_rtt_read_channel_info(struct target *target,
@@ -308,103 +364,212 @@ int target_rtt_read_channel_info(struct target *target,
 	return ERROR_OK;
 }
 
-static int read_from_channel(struct target *target,
-		const struct rtt_channel *channel, uint8_t *buffer,
-		size_t *length)
+/* State of an up-channel during one poll */
+struct rtt_up_read {
+	struct rtt_channel channel;
+	uint32_t length;
+	uint8_t read_pos[4];
+	uint8_t *buffer;
+};
+
+/* Number of bytes pending in an up-channel */
+static uint32_t channel_pending(const struct rtt_channel *channel)
 {
-	int ret;
-	uint32_t len;
+	if (channel->read_pos <= channel->write_pos)
+		return channel->write_pos - channel->read_pos;
 
-	if (!*length)
-		return ERROR_OK;
+	return channel->size - channel->read_pos + channel->write_pos;
+}
 
-	if (channel->read_pos == channel->write_pos) {
-		len = 0;
-	} else if (channel->read_pos < channel->write_pos) {
-		len = MIN(*length, channel->write_pos - channel->read_pos);
+/* Queue the reads of up->length bytes of a channel, return the number of
+ * accesses added */
+static unsigned int queue_read_from_channel(struct rtt_up_read *up,
+		struct target_memory_access *accesses)
+{
+	const struct rtt_channel *channel = &up->channel;
+	unsigned int n = 0;
+	uint32_t first_length;
+
+	first_length = MIN(up->length, channel->size - channel->read_pos);
+
+	accesses[n++] = (struct target_memory_access) {
+		.address = channel->buffer_addr + channel->read_pos,
+		.size = first_length,
+		.buffer = up->buffer,
+	};
+
+	if (up->length > first_length) {
+		accesses[n++] = (struct target_memory_access) {
+			.address = channel->buffer_addr,
+			.size = up->length - first_length,
+			.buffer = up->buffer + first_length,
+		};
+	}
 
-		ret = target_read_buffer(target,
-			channel->buffer_addr + channel->read_pos, len, buffer);
+	return n;
+}
 
-		if (ret != ERROR_OK)
-			return ret;
-	} else {
-		uint32_t first_length;
+/* Queue the update of the read pointer of a channel once its data is read */
+static void queue_consume_channel(struct target *target, struct rtt_up_read *up,
+		struct target_memory_access *access)
+{
+	const struct rtt_channel *channel = &up->channel;
 
-		len = MIN(*length,
-			channel->size - channel->read_pos + channel->write_pos);
-		first_length = MIN(len, channel->size - channel->read_pos);
+	target_buffer_set_u32(target, up->read_pos,
+		(channel->read_pos + up->length) % channel->size);
 
-		ret = target_read_buffer(target,
-			channel->buffer_addr + channel->read_pos, first_length, buffer);
+	*access = (struct target_memory_access) {
+		.address = channel->address + 16,
+		.size = sizeof(up->read_pos),
+		.buffer = up->read_pos,
+		.write = true,
+	};
+}
 
-		if (ret != ERROR_OK)
-			return ret;
+/*
+ * The descriptors of all the up-channels are read with one burst, then the
+ * pending data of all channels in one batch, and only once all of it is
+ * read, the updates of their read pointers in a second batch. With a target
+ * which supports batched memory accesses a poll takes three flushes of the
+ * adapter queue, regardless of the number of channels.
+ *
+ * The pending data is read as far as the sinks of the channel can take it,
+ * the rest is left in the target buffer for a later poll.
+ */
+int target_rtt_read_callback(struct target *target,
+		const struct rtt_control *ctrl, struct rtt_sink_list **sinks,
+		size_t num_channels, struct rtt_poll_status *status, void *user_data)
+{
+	num_channels = MIN(num_channels, ctrl->num_up_channels);
 
-		ret = target_read_buffer(target, channel->buffer_addr,
-			len - first_length, buffer + first_length);
+	/* only the channels up to the last one with a sink are of interest */
+	while (num_channels && !sinks[num_channels - 1])
+		num_channels--;
 
-		if (ret != ERROR_OK)
-			return ret;
-	}
+	if (!num_channels)
+		return ERROR_OK;
 
-	if (len > 0) {
-		ret = target_write_u32(target, channel->address + 16,
-			(channel->read_pos + len) % channel->size);
+	uint8_t *descriptors = malloc(num_channels * RTT_CHANNEL_SIZE);
+	struct rtt_up_read *up = calloc(num_channels, sizeof(*up));
+	struct target_memory_access *accesses = malloc(2 * num_channels * sizeof(*accesses));
+	uint8_t *data = NULL;
+	int ret = ERROR_FAIL;
 
-		if (ret != ERROR_OK)
-			return ret;
+	if (!descriptors || !up || !accesses) {
+		LOG_ERROR("Out of memory");
+		goto out;
 	}
 
-	*length = len;
+	target_addr_t address = rtt_channel_address(ctrl, 0, RTT_CHANNEL_TYPE_UP);
+	ret = target_read_buffer(target, address, num_channels * RTT_CHANNEL_SIZE,
+		descriptors);
 
-	return ERROR_OK;
-}
+	if (ret != ERROR_OK) {
+		LOG_ERROR("rtt: Failed to read up-channel descriptions");
+		goto out;
+	}
 
-int target_rtt_read_callback(struct target *target,
-		const struct rtt_control *ctrl, struct rtt_sink_list **sinks,
-		size_t num_channels, void *user_data)
-{
-	num_channels = MIN(num_channels, ctrl->num_up_channels);
+	size_t total_length = 0;
 
 	for (size_t i = 0; i < num_channels; i++) {
-		int ret;
-		struct rtt_channel channel;
-		uint8_t buffer[1024];
-		size_t length;
+		struct rtt_channel *channel = &up[i].channel;
 
 		if (!sinks[i])
 			continue;
 
-		ret = read_rtt_channel(target, ctrl, i, RTT_CHANNEL_TYPE_UP,
-			&channel);
+		parse_rtt_channel(target, address + i * RTT_CHANNEL_SIZE,
+			descriptors + i * RTT_CHANNEL_SIZE, channel);
 
-		if (ret != ERROR_OK) {
-			LOG_ERROR("rtt: Failed to read up-channel %zu description", i);
-			return ret;
-		}
-
-		if (!channel_is_active(&channel)) {
+		if (!channel_is_active(channel)) {
 			LOG_WARNING("rtt: Up-channel %zu is not active", i);
 			continue;
 		}
 
-		if (channel.size < RTT_CHANNEL_BUFFER_MIN_SIZE) {
+		if (channel->size < RTT_CHANNEL_BUFFER_MIN_SIZE) {
 			LOG_WARNING("rtt: Up-channel %zu is not large enough", i);
 			continue;
 		}
 
-		length = sizeof(buffer);
-		ret = read_from_channel(target, &channel, buffer, &length);
+		/* corrupted descriptor, e.g. target not yet initialised */
+		if (channel->read_pos >= channel->size || channel->write_pos >= channel->size)
+			continue;
+
+		uint32_t pending = channel_pending(channel);
+		size_t space = rtt_sink_list_space(i, sinks[i]);
 
-		if (ret != ERROR_OK) {
-			LOG_ERROR("rtt: Failed to read from up-channel %zu", i);
-			return ret;
+		if (!pending)
+			continue;
+
+		if (!space) {
+			LOG_DEBUG("rtt: Up-channel %zu congested, %" PRIu32 " bytes pending",
+				i, pending);
+			continue;
 		}
 
+		status->max_fill = MAX(status->max_fill,
+			(unsigned int)(100ULL * pending / channel->size));
+
+		up[i].length = MIN(MIN(pending, space), RTT_READ_MAX_SIZE);
+		total_length += up[i].length;
+	}
+
+	if (!total_length)
+		goto out;
+
+	data = malloc(total_length);
+
+	if (!data) {
+		LOG_ERROR("Out of memory");
+		ret = ERROR_FAIL;
+		goto out;
+	}
+
+	unsigned int num_accesses = 0;
+	size_t offset = 0;
+
+	for (size_t i = 0; i < num_channels; i++) {
+		if (!up[i].length)
+			continue;
+
+		up[i].buffer = data + offset;
+		offset += up[i].length;
+		num_accesses += queue_read_from_channel(&up[i], accesses + num_accesses);
+	}
+
+	ret = target_access_memory_batch(target, accesses, num_accesses);
+
+	if (ret != ERROR_OK) {
+		LOG_ERROR("rtt: Failed to read from up-channels");
+		goto out;
+	}
+
+	/* the data is consumed from the target only once all of it is read */
+	num_accesses = 0;
+	for (size_t i = 0; i < num_channels; i++) {
+		if (up[i].length)
+			queue_consume_channel(target, &up[i], accesses + num_accesses++);
+	}
+
+	ret = target_access_memory_batch(target, accesses, num_accesses);
+
+	/* the data read is delivered anyway, at worst the next poll reads it again */
+	if (ret != ERROR_OK)
+		LOG_ERROR("rtt: Failed to update the read pointers of the up-channels");
+
+	for (size_t i = 0; i < num_channels; i++) {
+		if (!up[i].length)
+			continue;
+
+		status->bytes += up[i].length;
+
 		for (struct rtt_sink_list *sink = sinks[i]; sink; sink = sink->next)
-			sink->read(i, buffer, length, sink->user_data);
+			sink->read(i, up[i].buffer, up[i].length, sink->user_data);
 	}
 
-	return ERROR_OK;
+out:
+	free(data);
+	free(accesses);
+	free(up);
+	free(descriptors);
+	return ret;
 }
@@ -95,6 +95,12 @@ static int semihosting_common_fileio_end(struct target *target, int result,
 static void semihosting_set_field(struct target *target, uint64_t value, size_t index, uint8_t *fields);
 static int semihosting_write_fields(struct target *target, size_t number, uint8_t *fields);
 
+/* Longest delay of the buffered host output, from the write that started the buffer */
+#define SEMIHOSTING_OUTPUT_FLUSH_MS	20
+
+/* Strings are read in aligned blocks of this size */
+#define SEMIHOSTING_STRING_CHUNK	64
+
 /**
  * Initialize common semihosting support.
  *
@@ -139,6 +145,21 @@ int semihosting_common_init(struct target *target, void *setup,
 	semihosting->sys_errno = -1;
 	semihosting->cmdline = NULL;
 	semihosting->basedir = NULL;
+	semihosting->buffered_output = true;
+	semihosting->output_length = 0;
+	semihosting->output_fd = -1;
+	semihosting->output_redirected = false;
+	semihosting->output_flush_pending = false;
+	semihosting->output_error = 0;
+	semihosting->output_error_fd = -1;
+	semihosting->ring_active = false;
+	semihosting->ring_address = 0;
+	semihosting->ring_slots = 0;
+	semihosting->ring_interval_ms = 0;
+	semihosting->ring_failing = false;
+	semihosting->ring_calls = 0;
+	semihosting->ring_fallbacks = 0;
+	semihosting->ring_sys_errno = 0;
 
 	/* If possible, update it in setup(). */
 	semihosting->setup_time = clock();
@@ -201,7 +222,7 @@ static bool semihosting_is_redirected(struct semihosting *semihosting, int fd)
 	return fd == semihosting->stdout_fd || fd == semihosting->stderr_fd;
 }
 
-static ssize_t semihosting_redirect_write(struct semihosting *semihosting, void *buf, int size)
+static ssize_t semihosting_redirect_write(struct semihosting *semihosting, const void *buf, int size)
 {
 	if (!semihosting->tcp_connection) {
 		LOG_ERROR("No connected TCP client for semihosting");
@@ -219,9 +240,113 @@ static ssize_t semihosting_redirect_write(struct semihosting *semihosting, void
 	return retval;
 }
 
+static void semihosting_flush_output(struct semihosting *semihosting)
+{
+	size_t done = 0;
+
+	if (!semihosting->output_length)
+		return;
+
+	if (semihosting->output_redirected && !semihosting->tcp_connection) {
+		LOG_DEBUG("semihosting: TCP client gone, %zu bytes of output dropped",
+			semihosting->output_length);
+		semihosting->output_length = 0;
+		return;
+	}
+
+	if (!semihosting->output_redirected && semihosting->output_fd == fileno(stdout))
+		fflush(stdout);
+
+	/*
+	 * The target has been told that the data were written, a failure is
+	 * reported by the next write or the close of the file.
+	 */
+	while (done < semihosting->output_length) {
+		const uint8_t *buf = semihosting->output_buffer + done;
+		size_t size = semihosting->output_length - done;
+		ssize_t written;
+
+		if (semihosting->output_redirected)
+			written = semihosting_redirect_write(semihosting, buf, size);
+		else
+			written = write(semihosting->output_fd, buf, size);
+		if (written <= 0) {
+			LOG_ERROR("semihosting: failed to write %zu bytes of output", size);
+			semihosting->output_error = (written < 0 && errno) ? errno : EIO;
+			semihosting->output_error_fd = semihosting->output_fd;
+			break;
+		}
+		done += written;
+	}
+
+	semihosting->output_length = 0;
+}
+
+static int semihosting_output_flush_timer(void *priv)
+{
+	struct semihosting *semihosting = priv;
+
+	semihosting->output_flush_pending = false;
+	semihosting_flush_output(semihosting);
+	return ERROR_OK;
+}
+
+/*
+ * Consecutive writes to the same file are gathered and written to the
+ * host at once, with a single system call or TCP send.
+ */
+static ssize_t semihosting_buffer_output(struct semihosting *semihosting, int fd,
+	bool redirected, const void *buf, size_t size)
+{
+	if (semihosting->output_error && fd == semihosting->output_error_fd) {
+		semihosting->sys_errno = semihosting->output_error;
+		semihosting->output_error = 0;
+		return -1;
+	}
+
+	if (fd != semihosting->output_fd || redirected != semihosting->output_redirected ||
+			size > sizeof(semihosting->output_buffer) - semihosting->output_length)
+		semihosting_flush_output(semihosting);
+
+	if (size > sizeof(semihosting->output_buffer)) {
+		if (redirected)
+			return semihosting_redirect_write(semihosting, buf, size);
+		ssize_t result = write(fd, buf, size);
+		if (result == -1)
+			semihosting->sys_errno = errno;
+		return result;
+	}
+
+	memcpy(semihosting->output_buffer + semihosting->output_length, buf, size);
+	semihosting->output_length += size;
+	semihosting->output_fd = fd;
+	semihosting->output_redirected = redirected;
+
+	/* a steady stream of writes is flushed periodically, not only once the buffer fills */
+	if (!semihosting->output_flush_pending) {
+		semihosting->output_flush_pending = target_register_timer_callback(semihosting_output_flush_timer,
+				SEMIHOSTING_OUTPUT_FLUSH_MS, TARGET_TIMER_TYPE_ONESHOT, semihosting) == ERROR_OK;
+		if (!semihosting->output_flush_pending)
+			semihosting_flush_output(semihosting);
+	}
+
+	return size;
+}
+
+static bool semihosting_can_buffer_output(struct semihosting *semihosting, bool redirected)
+{
+	/* without a client the write has to fail right away */
+	return semihosting->buffered_output && (!redirected || semihosting->tcp_connection);
+}
+
 static ssize_t semihosting_write(struct semihosting *semihosting, int fd, void *buf, int size)
 {
-	if (semihosting_is_redirected(semihosting, fd))
+	bool redirected = semihosting_is_redirected(semihosting, fd);
+
+	if (semihosting_can_buffer_output(semihosting, redirected))
+		return semihosting_buffer_output(semihosting, fd, redirected, buf, size);
+
+	if (redirected)
 		return semihosting_redirect_write(semihosting, buf, size);
 
 	/* default write */
@@ -231,6 +356,21 @@ static ssize_t semihosting_write(struct semihosting *semihosting, int fd, void *
 	return result;
 }
 
+/* Write to the debug channel of SYS_WRITEC and SYS_WRITE0 */
+static void semihosting_debug_write(struct semihosting *semihosting, const uint8_t *buf, size_t size)
+{
+	int fd = semihosting->stdout_fd;
+	bool redirected = semihosting_is_redirected(semihosting, fd);
+
+	if (semihosting_can_buffer_output(semihosting, redirected))
+		semihosting_buffer_output(semihosting, redirected ? fd : fileno(stdout),
+			redirected, buf, size);
+	else if (redirected)
+		semihosting_redirect_write(semihosting, buf, size);
+	else
+		fwrite(buf, 1, size, stdout);
+}
+
 static ssize_t semihosting_redirect_read(struct semihosting *semihosting, void *buf, int size)
 {
 	if (!semihosting->tcp_connection) {
@@ -257,15 +397,6 @@ static ssize_t semihosting_redirect_read(struct semihosting *semihosting, void *
 	return retval;
 }
 
-static inline int semihosting_putchar(struct semihosting *semihosting, int fd, int c)
-{
-	if (semihosting_is_redirected(semihosting, fd))
-		return semihosting_redirect_write(semihosting, &c, 1);
-
-	/* default putchar */
-	return putchar(c);
-}
-
 static inline ssize_t semihosting_read(struct semihosting *semihosting, int fd, void *buf, int size)
 {
 	if (semihosting_is_redirected(semihosting, fd))
@@ -294,6 +425,32 @@ static inline int semihosting_getchar(struct semihosting *semihosting, int fd)
 	return getchar();
 }
 
+/*
+ * Read the next piece of the string at addr, up to the end of its aligned
+ * SEMIHOSTING_STRING_CHUNK block, so that no memory beyond the block of
+ * the terminating NUL is read. Sets len to the number of characters before
+ * the NUL and end when the NUL has been found.
+ */
+static int semihosting_read_string_chunk(struct target *target, uint64_t addr,
+	uint8_t *chunk, size_t *len, bool *end)
+{
+	size_t size = SEMIHOSTING_STRING_CHUNK - (addr % SEMIHOSTING_STRING_CHUNK);
+
+	int retval = target_read_buffer(target, addr, size, chunk);
+	if (retval != ERROR_OK) {
+		/* go on a character at a time, as for the end of a memory region */
+		size = 1;
+		retval = target_read_memory(target, addr, 1, 1, chunk);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	const uint8_t *nul = memchr(chunk, '\0', size);
+	*end = nul;
+	*len = nul ? (size_t)(nul - chunk) : size;
+	return ERROR_OK;
+}
+
 /**
  * User operation parameter string storage buffer. Contains valid data when the
  * TARGET_EVENT_SEMIHOSTING_USER_CMD_xxxxx event callbacks are running.
@@ -378,6 +535,28 @@ int semihosting_common(struct target *target)
 		return ERROR_OK;
 	}
 
+	int retval = semihosting_common_perform(target);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (!semihosting->hit_fileio) {
+		retval = semihosting->post_result(target);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Failed to post semihosting result");
+			return retval;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * Performs the pending semihosting operation, up to setting
+ * semihosting->result, without posting the result to the target.
+ */
+int semihosting_common_perform(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
 	struct gdb_fileio_info *fileio_info = target->fileio_info;
 
 	/*
@@ -398,6 +577,19 @@ int semihosting_common(struct target *target)
 			  semihosting_opcode_to_str(semihosting->op),
 			  semihosting->param);
 
+	/* keep the buffered output in order with the other operations */
+	if (semihosting->is_fileio || (semihosting->op != SEMIHOSTING_SYS_WRITE &&
+			semihosting->op != SEMIHOSTING_SYS_WRITEC &&
+			semihosting->op != SEMIHOSTING_SYS_WRITE0))
+		semihosting_flush_output(semihosting);
+
+	if (semihosting->output_error && (semihosting->op == SEMIHOSTING_SYS_EXIT ||
+			semihosting->op == SEMIHOSTING_SYS_EXIT_EXTENDED)) {
+		LOG_ERROR("semihosting: output of the application lost: %s",
+			strerror(semihosting->output_error));
+		semihosting->output_error = 0;
+	}
+
 	switch (semihosting->op) {
 
 		case SEMIHOSTING_SYS_CLOCK:	/* 0x10 */
@@ -454,13 +646,20 @@ int semihosting_common(struct target *target)
 				return retval;
 			else {
 				int fd = semihosting_get_field(target, 0, fields);
+				/* Report a failed write of the buffered output, see semihosting_flush_output() */
+				bool output_failed = semihosting->output_error && fd == semihosting->output_error_fd;
+				int output_errno = semihosting->output_error;
+				if (output_failed)
+					semihosting->output_error = 0;
 				/* Do not allow to close OpenOCD's own standard streams */
 				if (fd == 0 || fd == 1 || fd == 2) {
 					LOG_DEBUG("ignoring semihosting attempt to close %s",
 							(fd == 0) ? "stdin" :
 							(fd == 1) ? "stdout" : "stderr");
-					/* Just pretend success */
-					semihosting->result = 0;
+					/* Just pretend success, but for lost output */
+					semihosting->result = output_failed ? -1 : 0;
+					if (output_failed)
+						semihosting->sys_errno = output_errno;
 					break;
 				}
 				/* Close the descriptor */
@@ -474,6 +673,10 @@ int semihosting_common(struct target *target)
 						semihosting->sys_errno = errno;
 					LOG_DEBUG("close(%d)=%" PRId64, fd, semihosting->result);
 				}
+				if (output_failed && !semihosting->hit_fileio) {
+					semihosting->result = -1;
+					semihosting->sys_errno = output_errno;
+				}
 			}
 			break;
 
@@ -1439,7 +1642,7 @@ int semihosting_common(struct target *target)
 				retval = target_read_memory(target, addr, 1, 1, &c);
 				if (retval != ERROR_OK)
 					return retval;
-				semihosting_putchar(semihosting, semihosting->stdout_fd, c);
+				semihosting_debug_write(semihosting, &c, 1);
 				semihosting->result = 0;
 			}
 			break;
@@ -1460,14 +1663,15 @@ int semihosting_common(struct target *target)
 			if (semihosting->is_fileio) {
 				size_t count = 0;
 				uint64_t addr = semihosting->param;
-				for (;; addr++) {
-					unsigned char c;
-					retval = target_read_memory(target, addr, 1, 1, &c);
+				bool end = false;
+				while (!end) {
+					uint8_t chunk[SEMIHOSTING_STRING_CHUNK];
+					size_t len;
+					retval = semihosting_read_string_chunk(target, addr, chunk, &len, &end);
 					if (retval != ERROR_OK)
 						return retval;
-					if (c == '\0')
-						break;
-					count++;
+					addr += len;
+					count += len;
 				}
 				semihosting->hit_fileio = true;
 				fileio_info->identifier = "write";
@@ -1476,15 +1680,16 @@ int semihosting_common(struct target *target)
 				fileio_info->param_3 = count;
 			} else {
 				uint64_t addr = semihosting->param;
-				do {
-					unsigned char c;
-					retval = target_read_memory(target, addr++, 1, 1, &c);
+				bool end = false;
+				while (!end) {
+					uint8_t chunk[SEMIHOSTING_STRING_CHUNK];
+					size_t len;
+					retval = semihosting_read_string_chunk(target, addr, chunk, &len, &end);
 					if (retval != ERROR_OK)
 						return retval;
-					if (!c)
-						break;
-					semihosting_putchar(semihosting, semihosting->stdout_fd, c);
-				} while (1);
+					semihosting_debug_write(semihosting, chunk, len);
+					addr += len;
+				}
 				semihosting->result = 0;
 			}
 			break;
@@ -1639,17 +1844,28 @@ int semihosting_common(struct target *target)
 			semihosting->sys_errno = ENOTSUP;
 	}
 
-	if (!semihosting->hit_fileio) {
-		retval = semihosting->post_result(target);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Failed to post semihosting result");
-			return retval;
-		}
-	}
-
 	return ERROR_OK;
 }
 
+/**
+ * Write the pending output and release the semihosting of the target.
+ */
+void semihosting_common_free(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting)
+		return;
+
+	semihosting_ring_stop(target);
+	semihosting_flush_output(semihosting);
+	if (semihosting->output_flush_pending)
+		target_unregister_timer_callback(semihosting_output_flush_timer, semihosting);
+
+	free(semihosting->basedir);
+	free(semihosting);
+	target->semihosting = NULL;
+}
+
 /* -------------------------------------------------------------------------
  * Local functions. */
 
@@ -1806,8 +2022,11 @@ static int semihosting_service_input_handler(struct connection *connection)
 static int semihosting_service_connection_closed_handler(struct connection *connection)
 {
 	struct semihosting_tcp_service *service = connection->service->priv;
-	if (service)
+	if (service) {
+		if (service->semihosting->tcp_connection == connection)
+			service->semihosting->tcp_connection = NULL;
 		free(service->name);
+	}
 
 	return ERROR_OK;
 }
@@ -1867,6 +2086,8 @@ COMMAND_HANDLER(handle_common_semihosting_command)
 
 		/* FIXME never let that "catch" be dropped! (???) */
 		semihosting->is_active = is_active;
+		if (!is_active)
+			semihosting_ring_stop(target);
 	}
 
 	command_print(CMD, "semihosting is %s",
@@ -1925,6 +2146,7 @@ COMMAND_HANDLER(handle_common_semihosting_redirect_command)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 	}
 
+	semihosting_flush_output(semihosting);
 	semihosting_tcp_close_cnx(semihosting);
 	semihosting->redirect_cfg = SEMIHOSTING_REDIRECT_CFG_NONE;
 
@@ -1981,8 +2203,10 @@ COMMAND_HANDLER(handle_common_semihosting_fileio_command)
 		return ERROR_FAIL;
 	}
 
-	if (CMD_ARGC > 0)
+	if (CMD_ARGC > 0) {
+		semihosting_flush_output(semihosting);
 		COMMAND_PARSE_ENABLE(CMD_ARGV[0], semihosting->is_fileio);
+	}
 
 	command_print(CMD, "semihosting fileio is %s",
 		semihosting->is_fileio
@@ -2054,6 +2278,36 @@ COMMAND_HANDLER(handle_common_semihosting_resumable_exit_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_common_semihosting_buffer_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!target) {
+		LOG_ERROR("No target selected");
+		return ERROR_FAIL;
+	}
+
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		command_print(CMD, "semihosting not supported for current target");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC > 0) {
+		semihosting_flush_output(semihosting);
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], semihosting->buffered_output);
+	}
+
+	command_print(CMD, "semihosting output buffering is %s",
+		semihosting->buffered_output
+		? "enabled" : "disabled");
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_common_semihosting_read_user_param_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -2152,6 +2406,16 @@ const struct command_registration semihosting_common_handlers[] = {
 		.usage = "['enable'|'disable']",
 		.help = "activate support for semihosting resumable exit",
 	},
+	{
+		.name = "semihosting_buffer",
+		.handler = handle_common_semihosting_buffer_command,
+		.mode = COMMAND_ANY,
+		.usage = "['enable'|'disable']",
+		.help = "buffer the host output of consecutive semihosting writes",
+	},
+	{
+		.chain = semihosting_ring_command_handlers,
+	},
 	{
 		.name = "semihosting_read_user_param",
 		.handler = handle_common_semihosting_read_user_param_command,
@@ -75,6 +75,9 @@ enum semihosting_operation_numbers {
 /** Maximum allowed Tcl command segment length in bytes*/
 #define SEMIHOSTING_MAX_TCL_COMMAND_FIELD_LENGTH (1024 * 1024)
 
+/** Size of the buffer of the host output of SYS_WRITE, SYS_WRITEC and SYS_WRITE0 */
+#define SEMIHOSTING_OUTPUT_BUFFER_SIZE 4096
+
 /*
  * Codes used by SEMIHOSTING_SYS_EXIT (formerly
  * SEMIHOSTING_REPORT_EXCEPTION).
@@ -177,6 +180,38 @@ struct semihosting {
 	/** Base directory for semihosting I/O operations. */
 	char *basedir;
 
+	/**
+	 * Buffer the host output of consecutive writes to the same file, it
+	 * is flushed by any other operation and shortly after the first buffered write.
+	 */
+	bool buffered_output;
+
+	/** Pending host output, for output_fd, redirected over TCP or not */
+	uint8_t output_buffer[SEMIHOSTING_OUTPUT_BUFFER_SIZE];
+	size_t output_length;
+	int output_fd;
+	bool output_redirected;
+
+	/** The flush of the pending output is scheduled */
+	bool output_flush_pending;
+
+	/** errno of a failed deferred flush to output_error_fd, reported to the target
+	 * by the next write or the close of that file, or at exit */
+	int output_error;
+	int output_error_fd;
+
+	/** Requests are also taken from the ring in target memory, see semihosting_ring.c */
+	bool ring_active;
+	uint64_t ring_address;
+	unsigned int ring_slots;
+	unsigned int ring_interval_ms;
+	/** the ring cannot be read, until the next successful poll */
+	bool ring_failing;
+	uint64_t ring_calls;
+	uint64_t ring_fallbacks;
+	/** errno of the last call taken from the ring, kept apart from sys_errno */
+	int ring_sys_errno;
+
 	/**
 	 * Target's extension of semihosting user commands.
 	 * @returns ERROR_NOT_IMPLEMENTED when user command is not handled, otherwise
@@ -191,6 +226,9 @@ struct semihosting {
 int semihosting_common_init(struct target *target, void *setup,
 	void *post_result);
 int semihosting_common(struct target *target);
+int semihosting_common_perform(struct target *target);
+void semihosting_ring_stop(struct target *target);
+void semihosting_common_free(struct target *target);
 
 /* utility functions which may also be used by semihosting extensions (custom vendor-defined syscalls) */
 int semihosting_read_fields(struct target *target, size_t number,
@@ -199,5 +237,6 @@ uint64_t semihosting_get_field(struct target *target, size_t index,
 	uint8_t *fields);
 
 extern const struct command_registration semihosting_common_handlers[];
+extern const struct command_registration semihosting_ring_command_handlers[];
 
 #endif	/* OPENOCD_TARGET_SEMIHOSTING_COMMON_H */
@@ -0,0 +1,335 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Semihosting through a ring of requests in target memory.
+ *
+ * A semihosting call through the trap instruction costs a halt, its
+ * detection by the poll, the service and a resume. With the ring
+ * transport the semihosting stub of the target posts its requests in a
+ * control block in RAM instead, polled from a timer and serviced while the
+ * target keeps running:
+ *
+ *	offset	written by	content
+ *	0x00	target		SEMIHOSTING_RING_MAGIC
+ *	0x04	target		number of slots
+ *	0x08	target		head, number of requests posted
+ *	0x0c	OpenOCD		tail, number of requests completed
+ *	0x10			slots of 4 words: op, param, result, status
+ *
+ * All the fields are 32-bit words in the byte order of the target. The
+ * request n uses the slot n modulo the number of slots. The stub fills op
+ * and param and clears status, then increments head. OpenOCD writes result
+ * and status, then increments tail. An operation which needs the target to
+ * halt, e.g. SYS_EXIT, is completed with SEMIHOSTING_RING_UNSUPPORTED and
+ * the stub issues it again through the trap instruction.
+ *
+ * The parameter blocks are made of 32-bit words too, the ring is only
+ * available on 32-bit targets.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/log.h>
+#include "target.h"
+#include "semihosting_common.h"
+
+#define SEMIHOSTING_RING_MAGIC			0x53485247	/* "SHRG" */
+#define SEMIHOSTING_RING_HEAD			0x08
+#define SEMIHOSTING_RING_TAIL			0x0c
+#define SEMIHOSTING_RING_SLOTS			0x10
+#define SEMIHOSTING_RING_SLOT_SIZE		16
+#define SEMIHOSTING_RING_MAX_SLOTS		1024
+
+/* Default period of the poll of the ring */
+#define SEMIHOSTING_RING_INTERVAL_MS	5
+
+enum semihosting_ring_status {
+	SEMIHOSTING_RING_POSTED = 0,
+	SEMIHOSTING_RING_DONE = 1,
+	SEMIHOSTING_RING_UNSUPPORTED = 2,
+};
+
+static bool semihosting_ring_can_perform(struct semihosting *semihosting, uint32_t op)
+{
+	/* GDB answers File-I/O requests only while the target is halted */
+	if (semihosting->is_fileio)
+		return false;
+
+	switch (op) {
+	/* the target has to stop on exit */
+	case SEMIHOSTING_SYS_EXIT:
+	case SEMIHOSTING_SYS_EXIT_EXTENDED:
+		return false;
+	default:
+		/* the handlers of the user commands expect a halted target */
+		return op <= 0x31;
+	}
+}
+
+/* Service the request in the slot at address, return its result and status */
+static int semihosting_ring_perform(struct target *target, target_addr_t address,
+		uint8_t *result_status)
+{
+	struct semihosting *semihosting = target->semihosting;
+	uint8_t request[8];
+
+	int retval = target_read_buffer(target, address, sizeof(request), request);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint32_t op = target_buffer_get_u32(target, request);
+	uint32_t param = target_buffer_get_u32(target, request + 4);
+
+	if (!semihosting_ring_can_perform(semihosting, op)) {
+		LOG_TARGET_DEBUG(target, "semihosting ring: op 0x%" PRIx32 " left to the trap", op);
+		semihosting->ring_fallbacks++;
+		target_buffer_set_u32(target, result_status, (uint32_t)-1);
+		target_buffer_set_u32(target, result_status + 4, SEMIHOSTING_RING_UNSUPPORTED);
+		return ERROR_OK;
+	}
+
+	/* keep the state of a call taken through the trap */
+	int saved_op = semihosting->op;
+	uint64_t saved_param = semihosting->param;
+	int64_t saved_result = semihosting->result;
+	size_t saved_word_size_bytes = semihosting->word_size_bytes;
+	int saved_sys_errno = semihosting->sys_errno;
+
+	semihosting->op = op;
+	semihosting->param = param;
+	semihosting->word_size_bytes = 4;
+	/* SYS_ERRNO taken from the ring reports the last ring call */
+	semihosting->sys_errno = semihosting->ring_sys_errno;
+
+	retval = semihosting_common_perform(target);
+	if (retval != ERROR_OK) {
+		LOG_TARGET_ERROR(target, "Failed semihosting operation (0x%02" PRIx32 ")", op);
+		semihosting->result = -1;
+	}
+	semihosting->ring_calls++;
+	semihosting->ring_sys_errno = semihosting->sys_errno;
+
+	target_buffer_set_u32(target, result_status, semihosting->result);
+	target_buffer_set_u32(target, result_status + 4, SEMIHOSTING_RING_DONE);
+
+	semihosting->op = saved_op;
+	semihosting->param = saved_param;
+	semihosting->result = saved_result;
+	semihosting->word_size_bytes = saved_word_size_bytes;
+	semihosting->sys_errno = saved_sys_errno;
+	return ERROR_OK;
+}
+
+static int semihosting_ring_service(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+	uint8_t indexes[8];
+
+	int retval = target_read_buffer(target, semihosting->ring_address + SEMIHOSTING_RING_HEAD,
+		sizeof(indexes), indexes);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint32_t head = target_buffer_get_u32(target, indexes);
+	uint32_t tail = target_buffer_get_u32(target, indexes + 4);
+
+	/* e.g. the RAM has not been initialized yet after a reset */
+	if (head - tail > semihosting->ring_slots)
+		return ERROR_FAIL;
+
+	while (tail != head) {
+		target_addr_t slot = semihosting->ring_address + SEMIHOSTING_RING_SLOTS +
+			(tail % semihosting->ring_slots) * SEMIHOSTING_RING_SLOT_SIZE;
+		uint8_t result_status[8];
+		uint8_t new_tail[4];
+
+		retval = semihosting_ring_perform(target, slot, result_status);
+		if (retval != ERROR_OK)
+			return retval;
+
+		/* the result has to be in place before the stub sees the new tail */
+		tail++;
+		target_buffer_set_u32(target, new_tail, tail);
+		struct target_memory_access accesses[] = {
+			{
+				.address = slot + 8,
+				.size = sizeof(result_status),
+				.buffer = result_status,
+				.write = true,
+			},
+			{
+				.address = semihosting->ring_address + SEMIHOSTING_RING_TAIL,
+				.size = sizeof(new_tail),
+				.buffer = new_tail,
+				.write = true,
+			},
+		};
+		retval = target_access_memory_batch(target, accesses, ARRAY_SIZE(accesses));
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
+static int semihosting_ring_timer(void *priv)
+{
+	struct target *target = priv;
+	struct semihosting *semihosting = target->semihosting;
+
+	/* e.g. the events of a reset disabled semihosting */
+	if (!semihosting->is_active) {
+		semihosting_ring_stop(target);
+		return ERROR_OK;
+	}
+
+	if (!target_was_examined(target) || target->state == TARGET_RESET)
+		return ERROR_OK;
+
+	/* a halting call waits for GDB */
+	if (semihosting->hit_fileio)
+		return ERROR_OK;
+
+	if (semihosting_ring_service(target) != ERROR_OK) {
+		if (!semihosting->ring_failing)
+			LOG_TARGET_WARNING(target, "semihosting ring at 0x%" PRIx64 " unreadable or corrupted",
+				semihosting->ring_address);
+		semihosting->ring_failing = true;
+	} else {
+		semihosting->ring_failing = false;
+	}
+
+	return ERROR_OK;
+}
+
+void semihosting_ring_stop(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+
+	if (!semihosting || !semihosting->ring_active)
+		return;
+
+	target_unregister_timer_callback(semihosting_ring_timer, target);
+	semihosting->ring_active = false;
+}
+
+static int semihosting_ring_start(struct command_invocation *cmd, struct target *target,
+		uint64_t address, unsigned int interval_ms)
+{
+	struct semihosting *semihosting = target->semihosting;
+	uint8_t header[8];
+
+	if (target_address_bits(target) > 32) {
+		command_print(cmd, "The semihosting ring is only available on 32-bit targets");
+		return ERROR_FAIL;
+	}
+
+	if (address % 4) {
+		command_print(cmd, "The semihosting ring has to be word aligned");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	int retval = target_read_buffer(target, address, sizeof(header), header);
+	if (retval != ERROR_OK) {
+		command_print(cmd, "Can't read the semihosting ring at 0x%" PRIx64, address);
+		return retval;
+	}
+
+	uint32_t magic = target_buffer_get_u32(target, header);
+	uint32_t slots = target_buffer_get_u32(target, header + 4);
+	if (magic != SEMIHOSTING_RING_MAGIC) {
+		command_print(cmd, "No semihosting ring at 0x%" PRIx64, address);
+		return ERROR_FAIL;
+	}
+	if (slots == 0 || slots > SEMIHOSTING_RING_MAX_SLOTS) {
+		command_print(cmd, "Invalid number of semihosting ring slots %" PRIu32, slots);
+		return ERROR_FAIL;
+	}
+
+	retval = target_register_timer_callback(semihosting_ring_timer, interval_ms,
+		TARGET_TIMER_TYPE_PERIODIC, target);
+	if (retval != ERROR_OK)
+		return retval;
+
+	semihosting->ring_address = address;
+	semihosting->ring_slots = slots;
+	semihosting->ring_interval_ms = interval_ms;
+	semihosting->ring_failing = false;
+	semihosting->ring_calls = 0;
+	semihosting->ring_fallbacks = 0;
+	semihosting->ring_sys_errno = 0;
+	semihosting->ring_active = true;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_common_semihosting_ring_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!target) {
+		LOG_ERROR("No target selected");
+		return ERROR_FAIL;
+	}
+
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		command_print(CMD, "semihosting not supported for current target");
+		return ERROR_FAIL;
+	}
+
+	if (!semihosting->is_active) {
+		command_print(CMD, "semihosting not yet enabled for current target");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC > 0) {
+		semihosting_ring_stop(target);
+
+		if (strcmp(CMD_ARGV[0], "disable") != 0) {
+			uint64_t address;
+			unsigned int interval_ms = SEMIHOSTING_RING_INTERVAL_MS;
+
+			COMMAND_PARSE_NUMBER(u64, CMD_ARGV[0], address);
+			if (CMD_ARGC == 2) {
+				COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], interval_ms);
+				if (interval_ms == 0)
+					return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+
+			int retval = semihosting_ring_start(CMD, target, address, interval_ms);
+			if (retval != ERROR_OK)
+				return retval;
+		} else if (CMD_ARGC > 1) {
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		}
+	}
+
+	if (!semihosting->ring_active) {
+		command_print(CMD, "semihosting ring is disabled");
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "semihosting ring at 0x%" PRIx64 ", %u slots polled every %u ms, "
+		"%" PRIu64 " calls, %" PRIu64 " left to the trap", semihosting->ring_address,
+		semihosting->ring_slots, semihosting->ring_interval_ms,
+		semihosting->ring_calls, semihosting->ring_fallbacks);
+
+	return ERROR_OK;
+}
+
+const struct command_registration semihosting_ring_command_handlers[] = {
+	{
+		.name = "semihosting_ring",
+		.handler = handle_common_semihosting_ring_command,
+		.mode = COMMAND_EXEC,
+		.usage = "[address [interval_ms] | 'disable']",
+		.help = "service the semihosting requests posted in a ring in target memory",
+	},
+	COMMAND_REGISTRATION_DONE
+};
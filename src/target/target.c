@@ -43,6 +43,8 @@
 #include "breakpoints.h"
 #include "register.h"
 #include "trace.h"
+#include "profile_histogram.h"
+#include "memory_sampler.h"
 #include "image.h"
 #include "rtos/rtos.h"
 #include "transport/transport.h"
@@ -69,6 +71,10 @@ static int target_get_gdb_fileio_info_default(struct target *target,
 		struct gdb_fileio_info *fileio_info);
 static int target_gdb_fileio_end_default(struct target *target, int retcode,
 		int fileio_errno, bool ctrl_c);
+static void target_profile_session_free(struct target *target);
+static int target_working_area_access(struct target *target, target_addr_t address,
+		uint64_t size, bool write);
+static int target_working_areas_before_run(struct target *target, bool resume);
 
 static struct target_type *target_types[] = {
 	// Keep in alphabetic order this list of targets
@@ -114,8 +120,19 @@ static struct target_type *target_types[] = {
 
 struct target *all_targets;
 static struct target_event_callback *target_event_callbacks;
-static struct target_timer_callback *target_timer_callbacks;
-static int64_t target_timer_next_event_value;
+
+/* Timer callbacks are kept in a binary min-heap ordered by expiry time, so
+ * that finding the expired ones does not need to walk all registered timers */
+#define TIMER_HEAP_INDEX_NONE	UINT_MAX
+static struct {
+	struct target_timer_callback **heap;
+	unsigned int count;
+	unsigned int size;
+	/* callbacks taken out of the heap while being called */
+	struct target_timer_callback **due;
+	unsigned int due_count;
+	unsigned int due_size;
+} target_timers;
 static OOCD_LIST_HEAD(target_reset_callback_list);
 static OOCD_LIST_HEAD(target_trace_callback_list);
 static const int polling_interval = TARGET_DEFAULT_POLLING_INTERVAL;
@@ -573,6 +590,10 @@ int target_resume(struct target *target, bool current, target_addr_t address,
 		return ERROR_FAIL;
 	}
 
+	retval = target_working_areas_before_run(target, true);
+	if (retval != ERROR_OK)
+		return retval;
+
 	target_call_event_callbacks(target, TARGET_EVENT_RESUME_START);
 
 	/* note that resume *must* be asynchronous. The CPU can halt before
@@ -798,6 +819,10 @@ int target_run_algorithm(struct target *target,
 		goto done;
 	}
 
+	retval = target_working_areas_before_run(target, false);
+	if (retval != ERROR_OK)
+		goto done;
+
 	target->running_alg = true;
 	retval = target->type->run_algorithm(target,
 			num_mem_params, mem_params,
@@ -843,6 +868,10 @@ int target_start_algorithm(struct target *target,
 		goto done;
 	}
 
+	retval = target_working_areas_before_run(target, false);
+	if (retval != ERROR_OK)
+		goto done;
+
 	target->running_alg = true;
 	retval = target->type->start_algorithm(target,
 			num_mem_params, mem_params,
@@ -1255,6 +1284,9 @@ int target_read_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support read_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	int retval = target_working_area_access(target, address, (uint64_t)size * count, false);
+	if (retval != ERROR_OK)
+		return retval;
 	return target->type->read_memory(target, address, size, count, buffer);
 }
 
@@ -1283,6 +1315,9 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	int retval = target_working_area_access(target, address, (uint64_t)size * count, true);
+	if (retval != ERROR_OK)
+		return retval;
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
@@ -1408,6 +1443,94 @@ int target_get_gdb_reg_list_noread(struct target *target,
 	return target_get_gdb_reg_list(target, reg_list, reg_list_size, reg_class);
 }
 
+static void target_take_reg_snapshot(struct target *target)
+{
+	struct target_reg_snapshot *snapshot = &target->reg_snapshot;
+	struct reg **reg_list;
+	int reg_list_size;
+
+	snapshot->taken = snapshot->generation;
+	free(snapshot->filled);
+	snapshot->filled = NULL;
+	snapshot->filled_count = 0;
+
+	if (target_get_gdb_reg_list_noread(target, &reg_list, &reg_list_size,
+				REG_CLASS_GENERAL) != ERROR_OK)
+		return;
+
+	/* the registers already in the cache cost no read anyway */
+	unsigned int count = 0;
+	for (int i = 0; i < reg_list_size; i++) {
+		if (!reg_list[i]->valid)
+			reg_list[count++] = reg_list[i];
+	}
+
+	/* whatever is not read in batch is read by the callers one by one */
+	register_fetch_list(reg_list, count);
+
+	snapshot->filled = reg_list;
+	for (unsigned int i = 0; i < count; i++) {
+		if (reg_list[i]->valid)
+			reg_list[snapshot->filled_count++] = reg_list[i];
+	}
+}
+
+/* Count the first use of a register filled by the batch read */
+static void target_reg_snapshot_hit(struct target_reg_snapshot *snapshot, struct reg *reg)
+{
+	for (unsigned int i = 0; i < snapshot->filled_count; i++) {
+		if (snapshot->filled[i] == reg) {
+			snapshot->filled[i] = snapshot->filled[--snapshot->filled_count];
+			snapshot->hits++;
+			return;
+		}
+	}
+}
+
+int target_get_reg_snapshot(struct target *target, struct reg *reg)
+{
+	struct target_reg_snapshot *snapshot = &target->reg_snapshot;
+
+	if (target->state == TARGET_HALTED && snapshot->taken != snapshot->generation)
+		target_take_reg_snapshot(target);
+
+	if (reg->valid) {
+		target_reg_snapshot_hit(snapshot, reg);
+		return ERROR_OK;
+	}
+
+	snapshot->reads++;
+	return reg->type->get(reg);
+}
+
+static struct reg_index *target_reg_index(struct target *target)
+{
+	if (target->reg_index && register_index_is_current(target->reg_index, target->reg_cache))
+		return target->reg_index;
+
+	register_index_free(target->reg_index);
+	target->reg_index = register_index_create(target->reg_cache);
+	return target->reg_index;
+}
+
+struct reg *target_get_reg_by_name(struct target *target, const char *name, bool search_all)
+{
+	struct reg_index *index = target_reg_index(target);
+	if (!index)
+		return register_get_by_name(target->reg_cache, name, search_all);
+
+	return register_index_get_by_name(index, name, search_all);
+}
+
+struct reg *target_get_reg_by_number(struct target *target, uint32_t reg_num, bool search_all)
+{
+	struct reg_index *index = target_reg_index(target);
+	if (!index)
+		return register_get_by_number(target->reg_cache, reg_num, search_all);
+
+	return register_index_get_by_number(index, reg_num, search_all);
+}
+
 bool target_supports_gdb_connection(const struct target *target)
 {
 	/*
@@ -1422,6 +1545,10 @@ int target_step(struct target *target,
 {
 	int retval;
 
+	retval = target_working_areas_before_run(target, true);
+	if (retval != ERROR_OK)
+		return retval;
+
 	target_call_event_callbacks(target, TARGET_EVENT_STEP_START);
 
 	retval = target->type->step(target, current, address, handle_breakpoints);
@@ -1665,31 +1792,106 @@ int target_register_trace_callback(int (*callback)(struct target *target,
 	return ERROR_OK;
 }
 
-int target_register_timer_callback(int (*callback)(void *priv),
-		unsigned int time_ms, enum target_timer_type type, void *priv)
+static void target_timer_heap_set(unsigned int index, struct target_timer_callback *cb)
+{
+	target_timers.heap[index] = cb;
+	cb->heap_index = index;
+}
+
+static void target_timer_heap_up(unsigned int index)
+{
+	struct target_timer_callback *cb = target_timers.heap[index];
+
+	while (index > 0) {
+		unsigned int parent = (index - 1) / 2;
+		if (target_timers.heap[parent]->when <= cb->when)
+			break;
+		target_timer_heap_set(index, target_timers.heap[parent]);
+		index = parent;
+	}
+	target_timer_heap_set(index, cb);
+}
+
+static void target_timer_heap_down(unsigned int index)
+{
+	struct target_timer_callback *cb = target_timers.heap[index];
+
+	while (true) {
+		unsigned int child = 2 * index + 1;
+		if (child >= target_timers.count)
+			break;
+		if (child + 1 < target_timers.count &&
+				target_timers.heap[child + 1]->when < target_timers.heap[child]->when)
+			child++;
+		if (cb->when <= target_timers.heap[child]->when)
+			break;
+		target_timer_heap_set(index, target_timers.heap[child]);
+		index = child;
+	}
+	target_timer_heap_set(index, cb);
+}
+
+static int target_timer_heap_push(struct target_timer_callback *cb)
+{
+	if (target_timers.count == target_timers.size) {
+		unsigned int size = target_timers.size ? 2 * target_timers.size : 16;
+		struct target_timer_callback **heap = realloc(target_timers.heap, size * sizeof(*heap));
+		if (!heap)
+			return ERROR_FAIL;
+		target_timers.heap = heap;
+		target_timers.size = size;
+	}
+
+	target_timer_heap_set(target_timers.count++, cb);
+	target_timer_heap_up(cb->heap_index);
+	return ERROR_OK;
+}
+
+static void target_timer_heap_remove(struct target_timer_callback *cb)
 {
-	struct target_timer_callback **callbacks_p = &target_timer_callbacks;
+	unsigned int index = cb->heap_index;
+	struct target_timer_callback *last = target_timers.heap[--target_timers.count];
+
+	cb->heap_index = TIMER_HEAP_INDEX_NONE;
+	if (last == cb)
+		return;
+
+	target_timer_heap_set(index, last);
+	if (index > 0 && target_timers.heap[(index - 1) / 2]->when > last->when)
+		target_timer_heap_up(index);
+	else
+		target_timer_heap_down(index);
+}
 
+int target_register_named_timer_callback(int (*callback)(void *priv), const char *name,
+		unsigned int time_ms, enum target_timer_type type, void *priv)
+{
 	if (!callback)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	if (*callbacks_p) {
-		while ((*callbacks_p)->next)
-			callbacks_p = &((*callbacks_p)->next);
-		callbacks_p = &((*callbacks_p)->next);
+	struct target_timer_callback *cb = calloc(1, sizeof(struct target_timer_callback));
+	if (!cb) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
 	}
 
-	(*callbacks_p) = malloc(sizeof(struct target_timer_callback));
-	(*callbacks_p)->callback = callback;
-	(*callbacks_p)->type = type;
-	(*callbacks_p)->time_ms = time_ms;
-	(*callbacks_p)->removed = false;
+	/* the name is the stringified expression passed to the macro */
+	if (name && name[0] == '&')
+		name++;
 
-	(*callbacks_p)->when = timeval_ms() + time_ms;
-	target_timer_next_event_value = MIN(target_timer_next_event_value, (*callbacks_p)->when);
+	cb->callback = callback;
+	cb->name = name;
+	cb->type = type;
+	cb->time_ms = time_ms;
+	cb->removed = false;
+	cb->when = monotonic_us() + time_ms * 1000LL;
+	cb->priv = priv;
 
-	(*callbacks_p)->priv = priv;
-	(*callbacks_p)->next = NULL;
+	if (target_timer_heap_push(cb) != ERROR_OK) {
+		free(cb);
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
 
 	return ERROR_OK;
 }
@@ -1760,9 +1962,19 @@ int target_unregister_timer_callback(int (*callback)(void *priv), void *priv)
 	if (!callback)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	for (struct target_timer_callback *c = target_timer_callbacks;
-	     c; c = c->next) {
+	for (unsigned int i = 0; i < target_timers.count; i++) {
+		struct target_timer_callback *c = target_timers.heap[i];
 		if ((c->callback == callback) && (c->priv == priv)) {
+			target_timer_heap_remove(c);
+			free(c);
+			return ERROR_OK;
+		}
+	}
+
+	/* a callback being processed is freed once the processing is done */
+	for (unsigned int i = 0; i < target_timers.due_count; i++) {
+		struct target_timer_callback *c = target_timers.due[i];
+		if ((c->callback == callback) && (c->priv == priv) && !c->removed) {
 			c->removed = true;
 			return ERROR_OK;
 		}
@@ -1776,6 +1988,12 @@ int target_call_event_callbacks(struct target *target, enum target_event event)
 	struct target_event_callback *callback = target_event_callbacks;
 	struct target_event_callback *next_callback;
 
+	if (event == TARGET_EVENT_HALTED || event == TARGET_EVENT_DEBUG_HALTED) {
+		/* the registers of the previous halt are stale */
+		target->reg_snapshot.generation++;
+		target->reg_snapshot.filled_count = 0;
+	}
+
 	if (event == TARGET_EVENT_HALTED) {
 		/* execute early halted first */
 		target_call_event_callbacks(target, TARGET_EVENT_GDB_HALT);
@@ -1819,22 +2037,16 @@ int target_call_trace_callbacks(struct target *target, size_t len, uint8_t *data
 	return ERROR_OK;
 }
 
-static int target_timer_callback_periodic_restart(
-		struct target_timer_callback *cb, int64_t *now)
+static void target_call_timer_callback(struct target_timer_callback *cb)
 {
-	cb->when = *now + cb->time_ms;
-	return ERROR_OK;
-}
+	int64_t start = monotonic_us();
 
-static int target_call_timer_callback(struct target_timer_callback *cb,
-		int64_t *now)
-{
 	cb->callback(cb->priv);
 
-	if (cb->type == TARGET_TIMER_TYPE_PERIODIC)
-		return target_timer_callback_periodic_restart(cb, now);
-
-	return target_unregister_timer_callback(cb->callback, cb->priv);
+	int64_t runtime = monotonic_us() - start;
+	cb->calls++;
+	cb->runtime_us += runtime;
+	cb->max_runtime_us = MAX(cb->max_runtime_us, runtime);
 }
 
 static int target_call_timer_callbacks_check_time(int checktime)
@@ -1849,37 +2061,55 @@ static int target_call_timer_callbacks_check_time(int checktime)
 
 	keep_alive();
 
-	int64_t now = timeval_ms();
-
-	/* Initialize to a default value that's a ways into the future.
-	 * The loop below will make it closer to now if there are
-	 * callbacks that want to be called sooner. */
-	target_timer_next_event_value = now + 1000;
-
-	/* Store an address of the place containing a pointer to the
-	 * next item; initially, that's a standalone "root of the
-	 * list" variable. */
-	struct target_timer_callback **callback = &target_timer_callbacks;
-	while (callback && *callback) {
-		if ((*callback)->removed) {
-			struct target_timer_callback *p = *callback;
-			*callback = (*callback)->next;
-			free(p);
-			continue;
+	int64_t now = monotonic_us();
+
+	/* invoke all the periodic callbacks, move them to the top of the heap */
+	if (!checktime) {
+		for (unsigned int i = 0; i < target_timers.count; i++) {
+			struct target_timer_callback *c = target_timers.heap[i];
+			if (c->type == TARGET_TIMER_TYPE_PERIODIC && c->when > now) {
+				c->when = now;
+				target_timer_heap_up(i);
+			}
 		}
+	}
 
-		bool call_it = (*callback)->callback &&
-			((!checktime && (*callback)->type == TARGET_TIMER_TYPE_PERIODIC) ||
-			 now >= (*callback)->when);
+	/* Take the expired callbacks out of the heap first, so that callbacks
+	 * registered by them are not called in this round. */
+	while (target_timers.count && target_timers.heap[0]->when <= now) {
+		if (target_timers.due_count == target_timers.due_size) {
+			unsigned int size = target_timers.due_size ? 2 * target_timers.due_size : 16;
+			struct target_timer_callback **due = realloc(target_timers.due, size * sizeof(*due));
+			if (!due)
+				break;
+			target_timers.due = due;
+			target_timers.due_size = size;
+		}
+		struct target_timer_callback *c = target_timers.heap[0];
+		target_timer_heap_remove(c);
+		target_timers.due[target_timers.due_count++] = c;
+	}
 
-		if (call_it)
-			target_call_timer_callback(*callback, &now);
+	for (unsigned int i = 0; i < target_timers.due_count; i++) {
+		struct target_timer_callback *c = target_timers.due[i];
+		if (!c->removed)
+			target_call_timer_callback(c);
+	}
 
-		if (!(*callback)->removed && (*callback)->when < target_timer_next_event_value)
-			target_timer_next_event_value = (*callback)->when;
+	for (unsigned int i = 0; i < target_timers.due_count; i++) {
+		struct target_timer_callback *c = target_timers.due[i];
+		if (c->removed || c->type != TARGET_TIMER_TYPE_PERIODIC) {
+			free(c);
+			continue;
+		}
 
-		callback = &(*callback)->next;
+		c->when = now + c->time_ms * 1000LL;
+		if (target_timer_heap_push(c) != ERROR_OK) {
+			LOG_ERROR("Out of memory, timer callback %s dropped", c->name);
+			free(c);
+		}
 	}
+	target_timers.due_count = 0;
 
 	callback_processing = false;
 	return ERROR_OK;
@@ -1898,7 +2128,13 @@ int target_call_timer_callbacks_now(void)
 
 int64_t target_timer_next_event(void)
 {
-	return target_timer_next_event_value;
+	/* a ways into the future if no timer expires earlier */
+	int64_t next_event = monotonic_us() + 1000000;
+
+	if (target_timers.count && target_timers.heap[0]->when < next_event)
+		next_event = target_timers.heap[0]->when;
+
+	return next_event;
 }
 
 /* Prints the working area layout for debug purposes */
@@ -1908,7 +2144,7 @@ static void print_wa_layout(struct target *target)
 
 	while (c) {
 		LOG_DEBUG("%c%c " TARGET_ADDR_FMT "-" TARGET_ADDR_FMT " (%" PRIu32 " bytes)",
-			c->backup ? 'b' : ' ', c->free ? ' ' : '*',
+			c->backup ? 'b' : ' ', c->free ? (c->pooled ? 'p' : ' ') : '*',
 			c->address, c->address + c->size - 1, c->size);
 		c = c->next;
 	}
@@ -1917,7 +2153,7 @@ static void print_wa_layout(struct target *target)
 /* Reduce area to size bytes, create a new free area from the remaining bytes, if any. */
 static void target_split_working_area(struct working_area *area, uint32_t size)
 {
-	assert(area->free); /* Shouldn't split an allocated area */
+	assert(area->free && !area->pooled); /* Shouldn't split an allocated area */
 	assert(size <= area->size); /* Caller should guarantee this */
 
 	/* Split only if not already the right size */
@@ -1931,8 +2167,11 @@ static void target_split_working_area(struct working_area *area, uint32_t size)
 		new_wa->size = area->size - size;
 		new_wa->address = area->address + size;
 		new_wa->backup = NULL;
+		new_wa->backup_start = 0;
+		new_wa->backup_end = 0;
 		new_wa->user = NULL;
 		new_wa->free = true;
+		new_wa->pooled = false;
 
 		area->next = new_wa;
 		area->size = size;
@@ -1952,8 +2191,8 @@ static void target_merge_working_areas(struct target *target)
 	while (c && c->next) {
 		assert(c->next->address == c->address + c->size); /* This is an invariant */
 
-		/* Find two adjacent free areas */
-		if (c->free && c->next->free) {
+		/* Find two adjacent free areas, pooled ones still hold a backup */
+		if (c->free && c->next->free && !c->pooled && !c->next->pooled) {
 			/* Merge the last into the first */
 			c->size += c->next->size;
 
@@ -1973,6 +2212,195 @@ static void target_merge_working_areas(struct target *target)
 	}
 }
 
+/* Save the bytes [start, end) of the area, and those up to the part already saved */
+static int target_backup_working_area_range(struct target *target, struct working_area *area,
+		uint32_t start, uint32_t end)
+{
+	int retval;
+
+	if (!area->backup) {
+		area->backup = malloc(area->size);
+		if (!area->backup)
+			return ERROR_FAIL;
+	}
+
+	if (area->backup_start == area->backup_end) {
+		area->backup_start = start;
+		area->backup_end = start;
+	}
+
+	if (start < area->backup_start) {
+		retval = target_read_memory(target, area->address + start, 4,
+				(area->backup_start - start) / 4, area->backup + start);
+		if (retval != ERROR_OK)
+			return retval;
+		target->working_area_stats.backup_bytes += area->backup_start - start;
+		area->backup_start = start;
+	}
+
+	if (end > area->backup_end) {
+		retval = target_read_memory(target, area->address + area->backup_end, 4,
+				(end - area->backup_end) / 4, area->backup + area->backup_end);
+		if (retval != ERROR_OK)
+			return retval;
+		target->working_area_stats.backup_bytes += end - area->backup_end;
+		area->backup_end = end;
+	}
+
+	return ERROR_OK;
+}
+
+static int target_restore_working_area(struct target *target, struct working_area *area)
+{
+	int retval = ERROR_OK;
+
+	if (target->backup_working_area && area->backup && area->backup_start < area->backup_end) {
+		uint32_t size = area->backup_end - area->backup_start;
+		/* not through target_write_memory(), whose working area hook
+		 * would restore this pooled area again */
+		retval = target->type->write_memory(target, area->address + area->backup_start, 4,
+				size / 4, area->backup + area->backup_start);
+		if (retval != ERROR_OK) {
+			/* keep the backup, for another attempt */
+			LOG_ERROR("failed to restore %" PRIu32 " bytes of working area at address " TARGET_ADDR_FMT,
+					size, area->address + area->backup_start);
+			return retval;
+		}
+		target->working_area_stats.restore_bytes += size;
+	}
+
+	area->backup_start = 0;
+	area->backup_end = 0;
+
+	return retval;
+}
+
+/* Restore a pooled area and return it to the allocation pool for good */
+static int target_release_pooled_working_area(struct target *target, struct working_area *area)
+{
+	/* still pooled on failure, so that the restore is attempted again */
+	int retval = target_restore_working_area(target, area);
+	if (retval == ERROR_OK)
+		area->pooled = false;
+
+	return retval;
+}
+
+static int target_release_pooled_working_areas(struct target *target)
+{
+	int retval = ERROR_OK;
+	bool released = false;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (!c->pooled)
+			continue;
+
+		int retval2 = target_release_pooled_working_area(target, c);
+		if (retval == ERROR_OK)
+			retval = retval2;
+		released = true;
+	}
+
+	if (released)
+		target_merge_working_areas(target);
+
+	return retval;
+}
+
+/*
+ * Before the host accesses [address, address + size): restore the pooled
+ * areas there, and for a write, save the allocated areas there.
+ */
+static int target_working_area_access(struct target *target, target_addr_t address,
+		uint64_t size, bool write)
+{
+	if (!target->backup_working_area || !size)
+		return ERROR_OK;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (c->free ? !c->pooled : !write)
+			continue;
+		if (address >= c->address + c->size || c->address >= address + size)
+			continue;
+
+		int retval;
+		if (c->pooled) {
+			retval = target_release_pooled_working_area(target, c);
+		} else {
+			uint32_t start = address > c->address ? address - c->address : 0;
+			uint32_t end = MIN(address + size - c->address, (uint64_t)c->size);
+			retval = target_backup_working_area_range(target, c,
+					ALIGN_DOWN(start, 4), ALIGN_UP(end, 4));
+		}
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
+/*
+ * The target is about to run code, which may write anywhere in the
+ * allocated areas: save them whole. With @a resume, the target resumes
+ * and the pooled areas are restored too, also those of the other targets
+ * of its SMP group.
+ */
+static int target_working_areas_before_run(struct target *target, bool resume)
+{
+	if (resume && target->smp) {
+		/* the resume of an SMP target restarts the whole group */
+		struct target_list *head;
+		foreach_smp_target(head, target->smp_targets) {
+			struct target *curr = head->target;
+			if (curr == target || !curr->backup_working_area || !target_was_examined(curr))
+				continue;
+
+			int retval = target_release_pooled_working_areas(curr);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	if (!target->backup_working_area)
+		return ERROR_OK;
+
+	if (resume) {
+		int retval = target_release_pooled_working_areas(target);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (c->free)
+			continue;
+
+		int retval = target_backup_working_area_range(target, c, 0, c->size);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
+static struct working_area *target_find_working_area(struct target *target, uint32_t size)
+{
+	struct working_area *c;
+
+	/* A pooled area of the same size is reused with its backup */
+	for (c = target->working_areas; c; c = c->next) {
+		if (c->pooled && c->size == size)
+			return c;
+	}
+
+	/* Find the first large enough working area */
+	for (c = target->working_areas; c; c = c->next) {
+		if (c->free && !c->pooled && c->size >= size)
+			return c;
+	}
+
+	return NULL;
+}
+
 int target_alloc_working_area_try(struct target *target, uint32_t size, struct working_area **area)
 {
 	/* Reevaluate working area address based on MMU state*/
@@ -2015,8 +2443,11 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 			new_wa->size = ALIGN_DOWN(target->working_area_size, 4); /* 4-byte align */
 			new_wa->address = target->working_area;
 			new_wa->backup = NULL;
+			new_wa->backup_start = 0;
+			new_wa->backup_end = 0;
 			new_wa->user = NULL;
 			new_wa->free = true;
+			new_wa->pooled = false;
 		}
 
 		target->working_areas = new_wa;
@@ -2025,36 +2456,40 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 	/* only allocate multiples of 4 byte */
 	size = ALIGN_UP(size, 4);
 
-	struct working_area *c = target->working_areas;
-
-	/* Find the first large enough working area */
-	while (c) {
-		if (c->free && c->size >= size)
-			break;
-		c = c->next;
+	struct working_area *c = target_find_working_area(target, size);
+	if (!c) {
+		/* the pooled areas may merge into a large enough one */
+		for (c = target->working_areas; c && !c->pooled; c = c->next)
+			;
+		if (c) {
+			int retval = target_release_pooled_working_areas(target);
+			if (retval != ERROR_OK)
+				return retval;
+			c = target_find_working_area(target, size);
+		}
 	}
 
 	if (!c)
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 
-	/* Split the working area into the requested size */
-	target_split_working_area(c, size);
-
-	LOG_DEBUG("allocated new working area of %" PRIu32 " bytes at address " TARGET_ADDR_FMT,
-			  size, c->address);
-
-	if (target->backup_working_area) {
-		if (!c->backup) {
-			c->backup = malloc(c->size);
-			if (!c->backup)
-				return ERROR_FAIL;
-		}
+	if (c->pooled) {
+		/* its content is still saved in the backup */
+		c->pooled = false;
+		target->working_area_stats.reused++;
+		LOG_DEBUG("reused working area of %" PRIu32 " bytes at address " TARGET_ADDR_FMT,
+				  size, c->address);
+	} else {
+		/* Split the working area into the requested size */
+		target_split_working_area(c, size);
 
-		int retval = target_read_memory(target, c->address, 4, c->size / 4, c->backup);
-		if (retval != ERROR_OK)
-			return retval;
+		LOG_DEBUG("allocated new working area of %" PRIu32 " bytes at address " TARGET_ADDR_FMT,
+				  size, c->address);
 	}
 
+	/* the backup is taken on the first write, see target_working_area_access() */
+	if (target->backup_working_area)
+		target->working_area_stats.full_bytes += 2 * (uint64_t)c->size;
+
 	/* mark as used, and return the new (reused) area */
 	c->free = false;
 	*area = c;
@@ -2078,20 +2513,6 @@ int target_alloc_working_area(struct target *target, uint32_t size, struct worki
 
 }
 
-static int target_restore_working_area(struct target *target, struct working_area *area)
-{
-	int retval = ERROR_OK;
-
-	if (target->backup_working_area && area->backup) {
-		retval = target_write_memory(target, area->address, 4, area->size / 4, area->backup);
-		if (retval != ERROR_OK)
-			LOG_ERROR("failed to restore %" PRIu32 " bytes of working area at address " TARGET_ADDR_FMT,
-					area->size, area->address);
-	}
-
-	return retval;
-}
-
 /* Restore the area's backup memory, if any, and return the area to the allocation pool */
 static int target_free_working_area_restore(struct target *target, struct working_area *area, int restore)
 {
@@ -2099,11 +2520,18 @@ static int target_free_working_area_restore(struct target *target, struct workin
 		return ERROR_OK;
 
 	int retval = ERROR_OK;
-	if (restore) {
+	if (restore && target->backup_working_area && target->pool_working_area
+			&& target->state == TARGET_HALTED && area->backup_start < area->backup_end) {
+		/* keep the backup, the area may be allocated again before the target runs */
+		area->pooled = true;
+	} else if (restore) {
 		retval = target_restore_working_area(target, area);
 		/* REVISIT: Perhaps the area should be freed even if restoring fails. */
 		if (retval != ERROR_OK)
 			return retval;
+	} else {
+		area->backup_start = 0;
+		area->backup_end = 0;
 	}
 
 	area->free = true;
@@ -2139,11 +2567,16 @@ static void target_free_all_working_areas_restore(struct target *target, int res
 
 	LOG_DEBUG("freeing all working areas");
 
-	/* Loop through all areas, restoring the allocated ones and marking them as free */
+	/* Loop through all areas, restoring the allocated and pooled ones and marking them as free */
 	while (c) {
-		if (!c->free) {
+		if (!c->free || c->pooled) {
+			c->pooled = false;
 			if (restore)
 				target_restore_working_area(target, c);
+			c->backup_start = 0;
+			c->backup_end = 0;
+		}
+		if (!c->free) {
 			c->free = true;
 			*c->user = NULL; /* Same as above */
 			c->user = NULL;
@@ -2175,13 +2608,16 @@ uint32_t target_get_working_area_avail(struct target *target)
 {
 	struct working_area *c = target->working_areas;
 	uint32_t max_size = 0;
+	uint32_t free_size = 0;
 
 	if (!c)
 		return ALIGN_DOWN(target->working_area_size, 4);
 
+	/* adjacent pooled and free areas are merged when needed */
 	while (c) {
-		if (c->free && max_size < c->size)
-			max_size = c->size;
+		free_size = c->free ? free_size + c->size : 0;
+		if (max_size < free_size)
+			max_size = free_size;
 
 		c = c->next;
 	}
@@ -2197,9 +2633,7 @@ static void target_destroy(struct target *target)
 	if (target->type->deinit_target)
 		target->type->deinit_target(target);
 
-	if (target->semihosting)
-		free(target->semihosting->basedir);
-	free(target->semihosting);
+	semihosting_common_free(target);
 
 	jtag_unregister_event_callback(jtag_enable_callback, target);
 
@@ -2212,6 +2646,11 @@ static void target_destroy(struct target *target)
 
 	target_free_all_working_areas(target);
 
+	target_profile_session_free(target);
+	memory_sampler_free(target);
+	register_index_free(target->reg_index);
+	free(target->reg_snapshot.filled);
+
 	/* release the targets SMP list */
 	if (target->smp) {
 		struct target_list *head, *tmp;
@@ -2246,13 +2685,11 @@ void target_quit(void)
 	}
 	target_event_callbacks = NULL;
 
-	struct target_timer_callback *pt = target_timer_callbacks;
-	while (pt) {
-		struct target_timer_callback *t = pt->next;
-		free(pt);
-		pt = t;
-	}
-	target_timer_callbacks = NULL;
+	for (unsigned int i = 0; i < target_timers.count; i++)
+		free(target_timers.heap[i]);
+	free(target_timers.heap);
+	free(target_timers.due);
+	memset(&target_timers, 0, sizeof(target_timers));
 
 	for (struct target *target = all_targets; target;) {
 		struct target *tmp;
@@ -2309,7 +2746,7 @@ int target_profiling_default(struct target *target, uint32_t *samples,
 
 	uint32_t sample_count = 0;
 	/* hopefully it is safe to cache! We want to stop/restart as quickly as possible. */
-	struct reg *reg = register_get_by_name(target->reg_cache, "pc", true);
+	struct reg *reg = target_get_reg_by_name(target, "pc", true);
 
 	int retval = ERROR_OK;
 	for (;;) {
@@ -2369,6 +2806,10 @@ int target_write_buffer(struct target *target, target_addr_t address, uint32_t s
 		return ERROR_FAIL;
 	}
 
+	int retval = target_working_area_access(target, address, size, true);
+	if (retval != ERROR_OK)
+		return retval;
+
 	return target->type->write_buffer(target, address, size, buffer);
 }
 
@@ -2434,9 +2875,54 @@ int target_read_buffer(struct target *target, target_addr_t address, uint32_t si
 		return ERROR_FAIL;
 	}
 
+	int retval = target_working_area_access(target, address, size, false);
+	if (retval != ERROR_OK)
+		return retval;
+
 	return target->type->read_buffer(target, address, size, buffer);
 }
 
+int target_access_memory_batch(struct target *target,
+		struct target_memory_access *accesses, unsigned int count)
+{
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		const struct target_memory_access *a = &accesses[i];
+		if (a->size && (a->address + a->size - 1) < a->address) {
+			LOG_ERROR("address + size wrapped (" TARGET_ADDR_FMT ", 0x%08" PRIx32 ")",
+					  a->address, a->size);
+			return ERROR_FAIL;
+		}
+		int retval = target_working_area_access(target, a->address, a->size, a->write);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (target->type->access_memory_batch) {
+		int retval = target->type->access_memory_batch(target, accesses, count);
+		if (retval != ERROR_NOT_IMPLEMENTED)
+			return retval;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		const struct target_memory_access *a = &accesses[i];
+		int retval;
+
+		if (a->write)
+			retval = target_write_buffer(target, a->address, a->size, a->buffer);
+		else
+			retval = target_read_buffer(target, a->address, a->size, a->buffer);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
 static int target_read_buffer_default(struct target *target, target_addr_t address, uint32_t count, uint8_t *buffer)
 {
 	uint32_t size;
@@ -2488,6 +2974,11 @@ int target_checksum_memory(struct target *target, target_addr_t address, uint32_
 		return ERROR_FAIL;
 	}
 
+	/* the algorithm reads the memory on the target, past the access hook */
+	retval = target_working_area_access(target, address, size, false);
+	if (retval != ERROR_OK)
+		return retval;
+
 	retval = target->type->checksum_memory(target, address, size, &checksum);
 	if (retval != ERROR_OK) {
 		buffer = malloc(size);
@@ -2529,6 +3020,13 @@ int target_blank_check_memory(struct target *target,
 	if (!target->type->blank_check_memory)
 		return ERROR_NOT_IMPLEMENTED;
 
+	/* the algorithm reads the memory on the target, past the access hook */
+	for (int i = 0; i < num_blocks; i++) {
+		int retval = target_working_area_access(target, blocks[i].address, blocks[i].size, false);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
 	return target->type->blank_check_memory(target, blocks, num_blocks, erased_value);
 }
 
@@ -2968,6 +3466,20 @@ static int handle_target(void *priv)
 		recursive = 0;
 	}
 
+	/* Let the targets queue their status reads first, the targets sharing
+	 * a DAP then get polled with a single flush of the adapter queue.
+	 */
+	for (struct target *target = all_targets;
+			is_jtag_poll_safe() && target;
+			target = target->next) {
+		if (!target->type->queue_poll || !target_was_examined(target) ||
+				!target->tap->enabled || power_dropout || srst_asserted ||
+				target->backoff.times > target->backoff.count)
+			continue;
+
+		target->poll_queued = target->type->queue_poll(target) == ERROR_OK;
+	}
+
 	/* Poll targets for state changes unless that's globally disabled.
 	 * Skip targets that are currently disabled.
 	 */
@@ -2992,6 +3504,7 @@ static int handle_target(void *priv)
 		if (!power_dropout && !srst_asserted) {
 			/* polling may fail silently until the target has been examined */
 			retval = target_poll(target);
+			target->poll_queued = false;
 			if (retval != ERROR_OK) {
 				/* 100ms polling interval. Increase interval between polling up to 5000ms */
 				if (target->backoff.times * polling_interval < 5000) {
@@ -3014,7 +3527,7 @@ static int handle_target(void *priv)
 					target_set_examined(target);
 					LOG_TARGET_ERROR(target, "Examination failed, GDB will be halted. Polling again in %dms",
 						 target->backoff.times * polling_interval);
-					return retval;
+					break;
 				}
 			}
 
@@ -3023,6 +3536,10 @@ static int handle_target(void *priv)
 		}
 	}
 
+	/* the queued reads of targets not polled in this round are stale now */
+	for (struct target *target = all_targets; target; target = target->next)
+		target->poll_queued = false;
+
 	return retval;
 }
 
@@ -3103,7 +3620,7 @@ COMMAND_HANDLER(handle_reg_command)
 		}
 	} else {
 		/* access a single register by its name */
-		reg = register_get_by_name(target->reg_cache, CMD_ARGV[0], true);
+		reg = target_get_reg_by_name(target, CMD_ARGV[0], true);
 
 		if (!reg)
 			goto not_found;
@@ -3121,7 +3638,7 @@ COMMAND_HANDLER(handle_reg_command)
 			reg->valid = false;
 
 		if (!reg->valid) {
-			int retval = reg->type->get(reg);
+			int retval = target_get_reg_snapshot(target, reg);
 			if (retval != ERROR_OK) {
 				LOG_ERROR("Could not read register '%s'", reg->name);
 				return retval;
@@ -4190,224 +4707,415 @@ COMMAND_HANDLER(handle_virt2phys_command)
 	return retval;
 }
 
-static void write_data(FILE *f, const void *data, size_t len)
+/* profiling samples the CPU PC as quickly as OpenOCD is able,
+ * which will be used as a random sampling of PC */
+COMMAND_HANDLER(handle_profile_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if ((CMD_ARGC != 2) && (CMD_ARGC != 4))
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	const uint32_t MAX_PROFILE_SAMPLE_NUM = 1000000;
+	uint32_t offset;
+	uint32_t num_of_samples;
+	int retval = ERROR_OK;
+	bool halted_before_profiling = target->state == TARGET_HALTED;
+
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], offset);
+
+	uint32_t start_address = 0;
+	uint32_t end_address = 0;
+	bool with_range = false;
+	if (CMD_ARGC == 4) {
+		with_range = true;
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], start_address);
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[3], end_address);
+		if (start_address > end_address || (end_address - start_address) < 2) {
+			command_print(CMD, "Error: end - start < 2");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	uint32_t *samples = malloc(sizeof(uint32_t) * MAX_PROFILE_SAMPLE_NUM);
+	if (!samples) {
+		LOG_ERROR("No memory to store samples.");
+		return ERROR_FAIL;
+	}
+
+	uint64_t timestart_ms = timeval_ms();
+	/**
+	 * Some cores let us sample the PC without the
+	 * annoying halt/resume step; for example, ARMv7 PCSR.
+	 * Provide a way to use that more efficient mechanism.
+	 */
+	retval = target_profiling(target, samples, MAX_PROFILE_SAMPLE_NUM,
+				&num_of_samples, offset);
+	if (retval != ERROR_OK) {
+		free(samples);
+		return retval;
+	}
+	uint32_t duration_ms = timeval_ms() - timestart_ms;
+
+	assert(num_of_samples <= MAX_PROFILE_SAMPLE_NUM);
+
+	retval = target_poll(target);
+	if (retval != ERROR_OK) {
+		free(samples);
+		return retval;
+	}
+
+	if (target->state == TARGET_RUNNING && halted_before_profiling) {
+		/* The target was halted before we started and is running now. Halt it,
+		 * for consistency. */
+		retval = target_halt(target);
+		if (retval != ERROR_OK) {
+			free(samples);
+			return retval;
+		}
+	} else if (target->state == TARGET_HALTED && !halted_before_profiling) {
+		/* The target was running before we started and is halted now. Resume
+		 * it, for consistency. */
+		retval = target_resume(target, true, 0, false, false);
+		if (retval != ERROR_OK) {
+			free(samples);
+			return retval;
+		}
+	}
+
+	retval = target_poll(target);
+	if (retval != ERROR_OK) {
+		free(samples);
+		return retval;
+	}
+
+	struct profile_histogram hist;
+	retval = profile_histogram_init(&hist);
+	for (uint32_t i = 0; retval == ERROR_OK && i < num_of_samples; i++)
+		retval = profile_histogram_add(&hist, samples[i], 1);
+	free(samples);
+
+	if (retval == ERROR_OK)
+		retval = profile_histogram_write_gmon(&hist, CMD_ARGV[1],
+			with_range, start_address, end_address, target, duration_ms);
+	profile_histogram_free(&hist);
+	if (retval != ERROR_OK)
+		return retval;
+
+	command_print(CMD, "Wrote %s", CMD_ARGV[1]);
+	return ERROR_OK;
+}
+
+/* Default period and size of the bursts of the background profiling */
+#define TARGET_PROFILE_INTERVAL_MS	10
+#define TARGET_PROFILE_BURST		256
+
+struct target_profile_session {
+	struct profile_histogram hist;
+	bool running;
+	unsigned int interval_ms;
+	unsigned int burst;
+	uint32_t *samples;
+	/* sampling time before the last start */
+	int64_t duration_ms;
+	int64_t start_ms;
+};
+
+static int target_profile_session_sample(struct target *target)
+{
+	struct target_profile_session *session = target->profile_session;
+	uint32_t num_samples;
+
+	int retval = target->type->profiling_sample(target, session->samples,
+		session->burst, &num_samples);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (uint32_t i = 0; i < num_samples; i++) {
+		retval = profile_histogram_add(&session->hist, session->samples[i], 1);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
+static int target_profile_session_timer(void *priv);
+
+static void target_profile_session_stop(struct target *target)
+{
+	struct target_profile_session *session = target->profile_session;
+
+	if (!session || !session->running)
+		return;
+
+	target_unregister_timer_callback(target_profile_session_timer, target);
+	session->running = false;
+	session->duration_ms += timeval_ms() - session->start_ms;
+}
+
+/* Each tick takes one burst of samples, the server loop runs in between */
+static int target_profile_session_timer(void *priv)
+{
+	struct target *target = priv;
+
+	/* the PC can only be sampled while the target runs */
+	if (target->state != TARGET_RUNNING)
+		return ERROR_OK;
+
+	int retval = target_profile_session_sample(target);
+	if (retval != ERROR_OK) {
+		LOG_TARGET_ERROR(target, "background profiling stopped");
+		target_profile_session_stop(target);
+	}
+
+	return ERROR_OK;
+}
+
+static void target_profile_session_free(struct target *target)
+{
+	struct target_profile_session *session = target->profile_session;
+
+	if (!session)
+		return;
+
+	target_profile_session_stop(target);
+	profile_histogram_free(&session->hist);
+	free(session->samples);
+	free(session);
+	target->profile_session = NULL;
+}
+
+static int64_t target_profile_session_duration_ms(const struct target_profile_session *session)
 {
-	size_t written = fwrite(data, 1, len, f);
-	if (written != len)
-		LOG_ERROR("failed to write %zu bytes: %s", len, strerror(errno));
+	int64_t duration_ms = session->duration_ms;
+
+	if (session->running)
+		duration_ms += timeval_ms() - session->start_ms;
+	return duration_ms;
 }
 
-static void write_long(FILE *f, int l, struct target *target)
+COMMAND_HANDLER(handle_target_profile_start)
 {
-	uint8_t val[4];
+	struct target *target = get_current_target(CMD_CTX);
+	unsigned int interval_ms = TARGET_PROFILE_INTERVAL_MS;
+	unsigned int burst = TARGET_PROFILE_BURST;
+
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC >= 1) {
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], interval_ms);
+		/* a 0 ms periodic timer would spin the event loop */
+		if (interval_ms == 0)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	if (CMD_ARGC == 2) {
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], burst);
+		if (burst == 0)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
 
-	target_buffer_set_u32(target, val, l);
-	write_data(f, val, 4);
-}
+	if (!target->type->profiling_sample) {
+		command_print(CMD, "Target %s cannot sample its PC without halting", target_name(target));
+		return ERROR_NOT_IMPLEMENTED;
+	}
 
-static void write_string(FILE *f, char *s)
-{
-	write_data(f, s, strlen(s));
-}
+	if (!target_was_examined(target)) {
+		command_print(CMD, "Target %s not examined yet", target_name(target));
+		return ERROR_TARGET_NOT_EXAMINED;
+	}
 
-typedef unsigned char UNIT[2];  /* unit of profiling */
+	struct target_profile_session *session = target->profile_session;
+	if (session && session->running) {
+		command_print(CMD, "Profiling of %s already running", target_name(target));
+		return ERROR_FAIL;
+	}
 
-/* Dump a gmon.out histogram file. */
-static void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filename, bool with_range,
-			uint32_t start_address, uint32_t end_address, struct target *target, uint32_t duration_ms)
-{
-	uint32_t i;
-	FILE *f = fopen(filename, "wb");
-	if (!f)
-		return;
-	write_string(f, "gmon");
-	write_long(f, 0x00000001, target); /* Version */
-	write_long(f, 0, target); /* padding */
-	write_long(f, 0, target); /* padding */
-	write_long(f, 0, target); /* padding */
-
-	uint8_t zero = 0;  /* GMON_TAG_TIME_HIST */
-	write_data(f, &zero, 1);
-
-	/* figure out bucket size */
-	uint32_t min;
-	uint32_t max;
-	if (with_range) {
-		min = start_address;
-		max = end_address;
-	} else {
-		min = samples[0];
-		max = samples[0];
-		for (i = 0; i < sample_num; i++) {
-			if (min > samples[i])
-				min = samples[i];
-			if (max < samples[i])
-				max = samples[i];
+	if (!session) {
+		session = calloc(1, sizeof(*session));
+		if (!session) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		if (profile_histogram_init(&session->hist) != ERROR_OK) {
+			free(session);
+			return ERROR_FAIL;
 		}
+		target->profile_session = session;
+	}
 
-		/* max should be (largest sample + 1)
-		 * Refer to binutils/gprof/hist.c (find_histogram_for_pc) */
-		if (max < UINT32_MAX)
-			max++;
+	uint32_t *samples = realloc(session->samples, burst * sizeof(*samples));
+	if (!samples) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	session->samples = samples;
+	session->burst = burst;
+	session->interval_ms = interval_ms;
 
-		/* gprof requires (max - min) >= 2 */
-		while ((max - min) < 2) {
-			if (max < UINT32_MAX)
-				max++;
-			else
-				min--;
+	/* report a target which cannot sample right away */
+	if (target->state == TARGET_RUNNING) {
+		int retval = target_profile_session_sample(target);
+		if (retval != ERROR_OK) {
+			command_print(CMD, "Failed to sample the PC of %s", target_name(target));
+			return retval;
 		}
 	}
 
-	uint32_t address_space = max - min;
+	int retval = target_register_timer_callback(target_profile_session_timer, interval_ms,
+		TARGET_TIMER_TYPE_PERIODIC, target);
+	if (retval != ERROR_OK)
+		return retval;
 
-	/* FIXME: What is the reasonable number of buckets?
-	 * The profiling result will be more accurate if there are enough buckets. */
-	static const uint32_t max_buckets = 128 * 1024; /* maximum buckets. */
-	uint32_t num_buckets = address_space / sizeof(UNIT);
-	if (num_buckets > max_buckets)
-		num_buckets = max_buckets;
-	int *buckets = malloc(sizeof(int) * num_buckets);
-	if (!buckets) {
-		fclose(f);
-		return;
-	}
-	memset(buckets, 0, sizeof(int) * num_buckets);
-	for (i = 0; i < sample_num; i++) {
-		uint32_t address = samples[i];
+	session->running = true;
+	session->start_ms = timeval_ms();
+	return ERROR_OK;
+}
 
-		if ((address < min) || (max <= address))
-			continue;
+COMMAND_HANDLER(handle_target_profile_stop)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
 
-		long long a = address - min;
-		long long b = num_buckets;
-		long long c = address_space;
-		int index_t = (a * b) / c; /* danger!!!! int32 overflows */
-		buckets[index_t]++;
-	}
-
-	/* append binary memory gmon.out &profile_hist_hdr ((char*)&profile_hist_hdr + sizeof(struct gmon_hist_hdr)) */
-	write_long(f, min, target);			/* low_pc */
-	write_long(f, max, target);			/* high_pc */
-	write_long(f, num_buckets, target);	/* # of buckets */
-	float sample_rate = sample_num / (duration_ms / 1000.0);
-	write_long(f, sample_rate, target);
-	write_string(f, "seconds");
-	for (i = 0; i < (15-strlen("seconds")); i++)
-		write_data(f, &zero, 1);
-	write_string(f, "s");
-
-	/*append binary memory gmon.out profile_hist_data (profile_hist_data + profile_hist_hdr.hist_size) */
-
-	char *data = malloc(2 * num_buckets);
-	if (data) {
-		for (i = 0; i < num_buckets; i++) {
-			int val;
-			val = buckets[i];
-			if (val > 65535)
-				val = 65535;
-			data[i * 2] = val&0xff;
-			data[i * 2 + 1] = (val >> 8) & 0xff;
-		}
-		free(buckets);
-		write_data(f, data, num_buckets * 2);
-		free(data);
-	} else
-		free(buckets);
+	target_profile_session_stop(get_current_target(CMD_CTX));
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_target_profile_reset)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct target_profile_session *session = target->profile_session;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	fclose(f);
+	if (session) {
+		profile_histogram_reset(&session->hist);
+		session->duration_ms = 0;
+		session->start_ms = timeval_ms();
+	}
+	return ERROR_OK;
 }
 
-/* profiling samples the CPU PC as quickly as OpenOCD is able,
- * which will be used as a random sampling of PC */
-COMMAND_HANDLER(handle_profile_command)
+COMMAND_HANDLER(handle_target_profile_status)
 {
 	struct target *target = get_current_target(CMD_CTX);
+	struct target_profile_session *session = target->profile_session;
 
-	if ((CMD_ARGC != 2) && (CMD_ARGC != 4))
+	if (CMD_ARGC != 0)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	const uint32_t MAX_PROFILE_SAMPLE_NUM = 1000000;
-	uint32_t offset;
-	uint32_t num_of_samples;
-	int retval = ERROR_OK;
-	bool halted_before_profiling = target->state == TARGET_HALTED;
+	if (!session) {
+		command_print(CMD, "%s: profiling never started", target_name(target));
+		return ERROR_OK;
+	}
 
-	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], offset);
+	int64_t duration_ms = target_profile_session_duration_ms(session);
+	command_print(CMD, "%s: profiling %s, bursts of %u samples every %u ms", target_name(target),
+		session->running ? "running" : "stopped", session->burst, session->interval_ms);
+	command_print(CMD, "%" PRIu64 " samples, %u distinct PCs, %" PRId64 ".%03" PRId64
+		" s, %" PRIu64 " samples/s", session->hist.samples, session->hist.used,
+		duration_ms / 1000, duration_ms % 1000,
+		duration_ms > 0 ? session->hist.samples * 1000 / duration_ms : 0);
+	return ERROR_OK;
+}
 
+/* Write a snapshot of the histogram, the sampling goes on */
+COMMAND_HANDLER(handle_target_profile_write)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct target_profile_session *session = target->profile_session;
+	bool gmon = !strcmp(CMD_NAME, "gmon");
 	uint32_t start_address = 0;
 	uint32_t end_address = 0;
-	bool with_range = false;
-	if (CMD_ARGC == 4) {
-		with_range = true;
-		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], start_address);
-		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[3], end_address);
+	int retval;
+
+	if (CMD_ARGC != 1 && !(gmon && CMD_ARGC == 3))
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 3) {
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], start_address);
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], end_address);
 		if (start_address > end_address || (end_address - start_address) < 2) {
 			command_print(CMD, "Error: end - start < 2");
 			return ERROR_COMMAND_ARGUMENT_INVALID;
 		}
 	}
 
-	uint32_t *samples = malloc(sizeof(uint32_t) * MAX_PROFILE_SAMPLE_NUM);
-	if (!samples) {
-		LOG_ERROR("No memory to store samples.");
+	if (!session) {
+		command_print(CMD, "%s: no PC samples", target_name(target));
 		return ERROR_FAIL;
 	}
 
-	uint64_t timestart_ms = timeval_ms();
-	/**
-	 * Some cores let us sample the PC without the
-	 * annoying halt/resume step; for example, ARMv7 PCSR.
-	 * Provide a way to use that more efficient mechanism.
-	 */
-	retval = target_profiling(target, samples, MAX_PROFILE_SAMPLE_NUM,
-				&num_of_samples, offset);
-	if (retval != ERROR_OK) {
-		free(samples);
-		return retval;
-	}
-	uint32_t duration_ms = timeval_ms() - timestart_ms;
-
-	assert(num_of_samples <= MAX_PROFILE_SAMPLE_NUM);
-
-	retval = target_poll(target);
-	if (retval != ERROR_OK) {
-		free(samples);
-		return retval;
-	}
-
-	if (target->state == TARGET_RUNNING && halted_before_profiling) {
-		/* The target was halted before we started and is running now. Halt it,
-		 * for consistency. */
-		retval = target_halt(target);
-		if (retval != ERROR_OK) {
-			free(samples);
-			return retval;
-		}
-	} else if (target->state == TARGET_HALTED && !halted_before_profiling) {
-		/* The target was running before we started and is halted now. Resume
-		 * it, for consistency. */
-		retval = target_resume(target, true, 0, false, false);
-		if (retval != ERROR_OK) {
-			free(samples);
-			return retval;
-		}
-	}
-
-	retval = target_poll(target);
-	if (retval != ERROR_OK) {
-		free(samples);
+	if (gmon)
+		retval = profile_histogram_write_gmon(&session->hist, CMD_ARGV[0],
+			CMD_ARGC == 3, start_address, end_address, target,
+			target_profile_session_duration_ms(session));
+	else if (!strcmp(CMD_NAME, "folded"))
+		retval = profile_histogram_write_folded(&session->hist, CMD_ARGV[0]);
+	else
+		retval = profile_histogram_write_csv(&session->hist, CMD_ARGV[0]);
+	if (retval != ERROR_OK)
 		return retval;
-	}
-
-	write_gmon(samples, num_of_samples, CMD_ARGV[1],
-		   with_range, start_address, end_address, target, duration_ms);
-	command_print(CMD, "Wrote %s", CMD_ARGV[1]);
 
-	free(samples);
-	return retval;
+	command_print(CMD, "Wrote %s", CMD_ARGV[0]);
+	return ERROR_OK;
 }
 
+static const struct command_registration target_profile_command_handlers[] = {
+	{
+		.name = "start",
+		.mode = COMMAND_EXEC,
+		.handler = handle_target_profile_start,
+		.help = "Start sampling the PC in the background",
+		.usage = "[interval_ms [burst]]",
+	},
+	{
+		.name = "stop",
+		.mode = COMMAND_EXEC,
+		.handler = handle_target_profile_stop,
+		.help = "Stop sampling the PC, the histogram is kept",
+		.usage = "",
+	},
+	{
+		.name = "reset",
+		.mode = COMMAND_EXEC,
+		.handler = handle_target_profile_reset,
+		.help = "Clear the histogram",
+		.usage = "",
+	},
+	{
+		.name = "status",
+		.mode = COMMAND_EXEC,
+		.handler = handle_target_profile_status,
+		.help = "Display the number and the rate of the PC samples",
+		.usage = "",
+	},
+	{
+		.name = "gmon",
+		.mode = COMMAND_EXEC,
+		.handler = handle_target_profile_write,
+		.help = "Write the histogram as a gmon.out file",
+		.usage = "filename [start end]",
+	},
+	{
+		.name = "folded",
+		.mode = COMMAND_EXEC,
+		.handler = handle_target_profile_write,
+		.help = "Write the histogram in the folded stack format of flame graphs",
+		.usage = "filename",
+	},
+	{
+		.name = "csv",
+		.mode = COMMAND_EXEC,
+		.handler = handle_target_profile_write,
+		.help = "Write the histogram as CSV",
+		.usage = "filename",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 COMMAND_HANDLER(handle_target_read_memory)
 {
 	/*
@@ -4729,27 +5437,45 @@ COMMAND_HANDLER(handle_target_get_reg)
 
 	const int length = Jim_ListLength(CMD_CTX->interp, next_argv);
 
-	const struct target *target = get_current_target(CMD_CTX);
+	struct target *target = get_current_target(CMD_CTX);
+
+	/* read the invalid registers in batch, the others are read below */
+	if (!force && length > 0) {
+		struct reg **regs = calloc(length, sizeof(*regs));
+		if (!regs) {
+			LOG_ERROR("Failed to allocate memory");
+			return ERROR_FAIL;
+		}
+
+		for (int i = 0; i < length; i++) {
+			Jim_Obj *elem = Jim_ListGetIndex(CMD_CTX->interp, next_argv, i);
+			regs[i] = target_get_reg_by_name(target, Jim_String(elem), false);
+		}
+		register_fetch_list(regs, length);
+		free(regs);
+	}
 
 	for (int i = 0; i < length; i++) {
 		Jim_Obj *elem = Jim_ListGetIndex(CMD_CTX->interp, next_argv, i);
 
 		const char *reg_name = Jim_String(elem);
 
-		struct reg *reg = register_get_by_name(target->reg_cache, reg_name, false);
+		struct reg *reg = target_get_reg_by_name(target, reg_name, false);
 
 		if (!reg || !reg->exist) {
 			command_print(CMD, "unknown register '%s'", reg_name);
 			return ERROR_COMMAND_ARGUMENT_INVALID;
 		}
 
-		if (force || !reg->valid) {
-			int retval = reg->type->get(reg);
+		int retval;
+		if (force)
+			retval = reg->type->get(reg);
+		else
+			retval = target_get_reg_snapshot(target, reg);
 
-			if (retval != ERROR_OK) {
-				command_print(CMD, "failed to read register '%s'", reg_name);
-				return retval;
-			}
+		if (retval != ERROR_OK) {
+			command_print(CMD, "failed to read register '%s'", reg_name);
+			return retval;
 		}
 
 		char *reg_value = buf_to_hex_str(reg->value, reg->size);
@@ -4767,6 +5493,38 @@ COMMAND_HANDLER(handle_target_get_reg)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_reg_snapshot_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	const struct target_reg_snapshot *snapshot = &target->reg_snapshot;
+
+	command_print(CMD, "debug entry %u, register reads: %" PRIu64 " saved by the snapshot, %" PRIu64 " from the target",
+			snapshot->generation, snapshot->hits, snapshot->reads);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_work_area_stats_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	const struct working_area_stats *stats = &target->working_area_stats;
+	uint64_t transferred = stats->backup_bytes + stats->restore_bytes;
+
+	command_print(CMD, "work area backup: %" PRIu64 " bytes read, %" PRIu64 " bytes restored, "
+			"%" PRIu64 " bytes saved, %u areas reused",
+			stats->backup_bytes, stats->restore_bytes,
+			stats->full_bytes > transferred ? stats->full_bytes - transferred : 0,
+			stats->reused);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_set_reg_command)
 {
 	if (CMD_ARGC != 1)
@@ -4788,13 +5546,13 @@ COMMAND_HANDLER(handle_set_reg_command)
 
 	const unsigned int length = tmp;
 
-	const struct target *target = get_current_target(CMD_CTX);
+	struct target *target = get_current_target(CMD_CTX);
 	assert(target);
 
 	for (unsigned int i = 0; i < length; i += 2) {
 		const char *reg_name = Jim_String(dict[i]);
 		const char *reg_value = Jim_String(dict[i + 1]);
-		struct reg *reg = register_get_by_name(target->reg_cache, reg_name, false);
+		struct reg *reg = target_get_reg_by_name(target, reg_name, false);
 
 		if (!reg || !reg->exist) {
 			command_print(CMD, "unknown register '%s'", reg_name);
@@ -4847,6 +5605,7 @@ enum target_cfg_param {
 	TCFG_WORK_AREA_PHYS,
 	TCFG_WORK_AREA_SIZE,
 	TCFG_WORK_AREA_BACKUP,
+	TCFG_WORK_AREA_POOL,
 	TCFG_ENDIAN,
 	TCFG_COREID,
 	TCFG_CHAIN_POSITION,
@@ -4864,6 +5623,7 @@ static struct nvp nvp_config_opts[] = {
 	{ .name = "-work-area-phys",   .value = TCFG_WORK_AREA_PHYS },
 	{ .name = "-work-area-size",   .value = TCFG_WORK_AREA_SIZE },
 	{ .name = "-work-area-backup", .value = TCFG_WORK_AREA_BACKUP },
+	{ .name = "-work-area-pool",   .value = TCFG_WORK_AREA_POOL },
 	{ .name = "-endian",           .value = TCFG_ENDIAN },
 	{ .name = "-coreid",           .value = TCFG_COREID },
 	{ .name = "-chain-position",   .value = TCFG_CHAIN_POSITION },
@@ -5089,6 +5849,25 @@ static COMMAND_HELPER(target_configure, struct target *target, unsigned int inde
 			/* loop for more */
 			break;
 
+		case TCFG_WORK_AREA_POOL:
+			if (is_configure) {
+				if (index == CMD_ARGC) {
+					command_print(CMD, "missing argument to %s", CMD_ARGV[index - 1]);
+					return ERROR_COMMAND_ARGUMENT_INVALID;
+				}
+				retval = command_parse_bool_arg(CMD_ARGV[index], &target->pool_working_area);
+				if (retval != ERROR_OK)
+					return retval;
+				index++;
+				target_free_all_working_areas(target);
+			} else {
+				if (index != CMD_ARGC)
+					return ERROR_COMMAND_SYNTAX_ERROR;
+				command_print(CMD, target->pool_working_area ? "1" : "0");
+			}
+			/* loop for more */
+			break;
+
 		case TCFG_ENDIAN:
 			if (is_configure) {
 				if (index == CMD_ARGC) {
@@ -5603,6 +6382,22 @@ static const struct command_registration target_instance_command_handlers[] = {
 		.help = "Set target register values",
 		.usage = "dict",
 	},
+	{
+		.name = "reg_snapshot",
+		.mode = COMMAND_EXEC,
+		.handler = handle_reg_snapshot_command,
+		.help = "Display the register reads saved by the snapshot "
+			"of the current halt",
+		.usage = "",
+	},
+	{
+		.name = "work_area_stats",
+		.mode = COMMAND_EXEC,
+		.handler = handle_work_area_stats_command,
+		.help = "Display the bytes transferred and saved by the "
+			"work area backup",
+		.usage = "",
+	},
 	{
 		.name = "read_memory",
 		.mode = COMMAND_EXEC,
@@ -5701,6 +6496,20 @@ static const struct command_registration target_instance_command_handlers[] = {
 		.help = "invoke handler for specified event",
 		.usage = "event_name",
 	},
+	{
+		.name = "profile",
+		.mode = COMMAND_EXEC,
+		.help = "background PC sampling profiler",
+		.usage = "",
+		.chain = target_profile_command_handlers,
+	},
+	{
+		.name = "sample",
+		.mode = COMMAND_ANY,
+		.help = "sampling of memory in the background",
+		.usage = "",
+		.chain = memory_sampler_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -5783,6 +6592,7 @@ COMMAND_HANDLER(handle_target_create)
 	target->working_area_size   = 0x0;
 	target->working_areas       = NULL;
 	target->backup_working_area = false;
+	target->pool_working_area   = false;
 
 	target->state               = TARGET_UNKNOWN;
 	target->debug_reason        = DBG_REASON_UNDEFINED;
@@ -6042,6 +6852,41 @@ COMMAND_HANDLER(handle_target_smp)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_target_timers)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		for (unsigned int i = 0; i < target_timers.count; i++) {
+			struct target_timer_callback *c = target_timers.heap[i];
+			c->calls = 0;
+			c->runtime_us = 0;
+			c->max_runtime_us = 0;
+		}
+		return ERROR_OK;
+	}
+
+	int64_t now = monotonic_us();
+
+	command_print(CMD, "%-32s %-8s %9s %10s %12s %8s %8s %10s",
+		"callback", "type", "period ms", "calls", "total us", "avg us", "max us", "due in us");
+	for (unsigned int i = 0; i < target_timers.count; i++) {
+		struct target_timer_callback *c = target_timers.heap[i];
+		command_print(CMD, "%-32s %-8s %9u %10" PRIu64 " %12" PRId64 " %8" PRId64 " %8" PRId64 " %10" PRId64,
+			c->name ? c->name : "?",
+			c->type == TARGET_TIMER_TYPE_PERIODIC ? "periodic" : "oneshot",
+			c->time_ms,
+			c->calls, c->runtime_us, c->calls ? c->runtime_us / (int64_t)c->calls : 0,
+			c->max_runtime_us, MAX(c->when - now, 0));
+	}
+
+	return ERROR_OK;
+}
+
 static const struct command_registration target_subcommand_handlers[] = {
 	{
 		.name = "init",
@@ -6086,6 +6931,13 @@ static const struct command_registration target_subcommand_handlers[] = {
 		.usage = "targetname1 targetname2 ...",
 		.help = "gather several target in a smp list"
 	},
+	{
+		.name = "timers",
+		.mode = COMMAND_ANY,
+		.handler = handle_target_timers,
+		.usage = "['reset']",
+		.help = "Display or reset the runtime statistics of the timer callbacks",
+	},
 
 	COMMAND_REGISTRATION_DONE
 };
@@ -6712,6 +7564,22 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.help = "Set target register values",
 		.usage = "dict",
 	},
+	{
+		.name = "reg_snapshot",
+		.mode = COMMAND_EXEC,
+		.handler = handle_reg_snapshot_command,
+		.help = "Display the register reads saved by the snapshot "
+			"of the current halt",
+		.usage = "",
+	},
+	{
+		.name = "work_area_stats",
+		.mode = COMMAND_EXEC,
+		.handler = handle_work_area_stats_command,
+		.help = "Display the bytes transferred and saved by the "
+			"work area backup",
+		.usage = "",
+	},
 	{
 		.name = "read_memory",
 		.mode = COMMAND_EXEC,
@@ -36,6 +36,8 @@ struct mem_param;
 struct reg_param;
 struct target_list;
 struct gdb_fileio_info;
+struct target_profile_session;
+struct memory_sampler;
 
 /*
  * TARGET_UNKNOWN = 0: we don't know anything about the target yet
@@ -89,7 +91,12 @@ struct working_area {
 	target_addr_t address;
 	uint32_t size;
 	bool free;
+	/* freed while halted, the backup is restored when the target runs or the area is needed */
+	bool pooled;
 	uint8_t *backup;
+	/* part of the area saved in backup, as offsets [backup_start, backup_end) */
+	uint32_t backup_start;
+	uint32_t backup_end;
 	struct working_area **user;
 	struct working_area *next;
 };
@@ -153,7 +160,17 @@ struct target {
 	target_addr_t working_area_phys;			/* physical address */
 	uint32_t working_area_size;			/* size in bytes */
 	bool backup_working_area;			/* whether the content of the working area has to be preserved */
+	bool pool_working_area;				/* whether a freed area may stay unrestored until the target runs */
 	struct working_area *working_areas;/* list of allocated working areas */
+	struct working_area_stats {
+		/* bytes a backup and restore of each whole area would transfer */
+		uint64_t full_bytes;
+		/* bytes actually backed up and restored */
+		uint64_t backup_bytes;
+		uint64_t restore_bytes;
+		/* allocations served from a pooled area */
+		unsigned int reused;
+	} working_area_stats;
 	enum target_debug_reason debug_reason;/* reason why the target entered debug state */
 	enum target_endianness endianness;	/* target endianness */
 	/* also see: target_state_name() */
@@ -187,6 +204,7 @@ struct target {
 	bool rtos_auto_detect;				/* A flag that indicates that the RTOS has been specified as "auto"
 										 * and must be detected when symbols are offered */
 	struct backoff_timer backoff;
+	bool poll_queued;					/* queue_poll() has been called for the next poll() */
 	unsigned int smp;					/* Unique non-zero number for each SMP group */
 	struct list_head *smp_targets;		/* list all targets in this smp group/cluster
 										 * The head of the list is shared between the
@@ -210,6 +228,30 @@ struct target {
 
 	/* The semihosting information, extracted from the target. */
 	struct semihosting *semihosting;
+
+	/* PC sampling in the background, see '$target_name profile' */
+	struct target_profile_session *profile_session;
+
+	/* Memory sampling in the background, see '$target_name sample' */
+	struct memory_sampler *memory_sampler;
+
+	/* Register values of the current halt, see target_get_reg_snapshot() */
+	struct target_reg_snapshot {
+		/* debug entries seen, each one gets a new snapshot */
+		unsigned int generation;
+		/* generation of the last batch read of the general registers */
+		unsigned int taken;
+		/* registers filled by the batch read and not used yet */
+		struct reg **filled;
+		unsigned int filled_count;
+		/* reads of a filled register which would have gone to the target,
+		 * and register reads which went to the target */
+		uint64_t hits;
+		uint64_t reads;
+	} reg_snapshot;
+
+	/* Hash index of the registers of all the caches, see target_get_reg_by_name() */
+	struct reg_index *reg_index;
 };
 
 struct target_list {
@@ -325,12 +367,19 @@ enum target_timer_type {
 
 struct target_timer_callback {
 	int (*callback)(void *priv);
+	/* name of the callback function, for the statistics */
+	const char *name;
 	unsigned int time_ms;
 	enum target_timer_type type;
 	bool removed;
-	int64_t when;	/* output of timeval_ms() */
+	int64_t when;	/* output of monotonic_us() */
 	void *priv;
-	struct target_timer_callback *next;
+	/* position in the timer heap, TIMER_HEAP_INDEX_NONE while being called */
+	unsigned int heap_index;
+	/* runtime accounting */
+	uint64_t calls;
+	int64_t runtime_us;
+	int64_t max_runtime_us;
 };
 
 struct target_memory_check_block {
@@ -393,8 +442,11 @@ int target_call_trace_callbacks(struct target *target, size_t len, uint8_t *data
  * The period is very approximate, the callback can happen much more often
  * or much more rarely than specified
  */
-int target_register_timer_callback(int (*callback)(void *priv),
+int target_register_named_timer_callback(int (*callback)(void *priv), const char *name,
 		unsigned int time_ms, enum target_timer_type type, void *priv);
+/* the name of the callback function is kept for the 'target timers' statistics */
+#define target_register_timer_callback(callback, time_ms, type, priv) \
+	target_register_named_timer_callback(callback, #callback, time_ms, type, priv)
 int target_unregister_timer_callback(int (*callback)(void *priv), void *priv);
 int target_call_timer_callbacks(void);
 /**
@@ -403,8 +455,8 @@ int target_call_timer_callbacks(void);
  */
 int target_call_timer_callbacks_now(void);
 /**
- * Returns when the next registered event will take place. Callers can use this
- * to go to sleep until that time occurs.
+ * Returns when the next registered event will take place, as monotonic_us()
+ * value. Callers can use this to go to sleep until that time occurs.
  */
 int64_t target_timer_next_event(void);
 
@@ -519,6 +571,24 @@ int target_get_gdb_reg_list_noread(struct target *target,
 		struct reg **reg_list[], int *reg_list_size,
 		enum target_register_class reg_class);
 
+/**
+ * Make sure the value of @a reg is in the register cache.
+ *
+ * The general registers are read in one batch at the first call after
+ * each debug entry and served to gdb, the rtos layer and the Tcl commands
+ * from the cache until the target runs again.
+ */
+int target_get_reg_snapshot(struct target *target, struct reg *reg);
+
+/**
+ * Look a register of @a target up by name or by number, as
+ * register_get_by_name() and register_get_by_number() do on the cache
+ * chain of the target, through a hash index built at the first lookup.
+ * The index is built again when the cache chain changed.
+ */
+struct reg *target_get_reg_by_name(struct target *target, const char *name, bool search_all);
+struct reg *target_get_reg_by_number(struct target *target, uint32_t reg_num, bool search_all);
+
 /**
  * Check if @a target allows GDB connections.
  *
@@ -650,6 +720,24 @@ int target_write_buffer(struct target *target,
 		target_addr_t address, uint32_t size, const uint8_t *buffer);
 int target_read_buffer(struct target *target,
 		target_addr_t address, uint32_t size, uint8_t *buffer);
+
+/** One buffer access of target_access_memory_batch() */
+struct target_memory_access {
+	target_addr_t address;
+	uint32_t size;
+	/* destination of a read, source of a write */
+	uint8_t *buffer;
+	bool write;
+};
+
+/**
+ * Perform the buffer reads and writes in the given order. Targets which
+ * support it complete all of them with a single flush of the adapter
+ * queue, e.g. to poll several RTT channels at once. On error it is not
+ * known which of the accesses have been done.
+ */
+int target_access_memory_batch(struct target *target,
+		struct target_memory_access *accesses, unsigned int count);
 int target_checksum_memory(struct target *target,
 		target_addr_t address, uint32_t size, uint32_t *crc);
 int target_blank_check_memory(struct target *target,
@@ -723,6 +811,12 @@ int target_alloc_working_area_try(struct target *target,
 /**
  * Free a working area.
  * Restore target data if area backup is configured.
+ *
+ * With the backup on, only the parts of the area written by the host, or
+ * the whole area once the target ran code, are saved and restored. An area
+ * freed while halted keeps its backup and can be allocated again at the
+ * same size without a new backup; it is restored before the target or its SMP group runs,
+ * before its memory is accessed, or when it is needed for a larger area.
  * @param target
  * @param area Pointer to the area to be freed or NULL
  * @returns ERROR_OK if successful; error code if restore failed
@@ -17,6 +17,7 @@
 #include <helper/jim-nvp.h>
 
 struct target;
+struct target_memory_access;
 
 /**
  * This holds methods shared between all instances of a given target
@@ -32,6 +33,10 @@ struct target_type {
 
 	/* poll current target status */
 	int (*poll)(struct target *target);
+	/* Optional. Queue the reads needed by the following poll() without
+	 * flushing the adapter queue, so that all the targets sharing a DAP
+	 * get polled with a single flush. */
+	int (*queue_poll)(struct target *target);
 	/* Invoked only from target_arch_state().
 	 * Issue USER() w/architecture specific status.  */
 	int (*arch_state)(struct target *target);
@@ -132,6 +137,13 @@ struct target_type {
 	int (*write_buffer)(struct target *target, target_addr_t address,
 			uint32_t size, const uint8_t *buffer);
 
+	/* Optional. Perform several buffer reads and writes, in order, with as
+	 * few adapter round trips as possible. Called by
+	 * target_access_memory_batch(), which falls back to single buffer
+	 * accesses without it or when it returns ERROR_NOT_IMPLEMENTED. */
+	int (*access_memory_batch)(struct target *target,
+			struct target_memory_access *accesses, unsigned int count);
+
 	int (*checksum_memory)(struct target *target, target_addr_t address,
 			uint32_t count, uint32_t *checksum);
 	int (*blank_check_memory)(struct target *target,
@@ -296,6 +308,15 @@ struct target_type {
 	int (*profiling)(struct target *target, uint32_t *samples,
 			uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds);
 
+	/**
+	 * Take a burst of at most max_num_samples PC samples from the running
+	 * target, without halting it. Used by the background profiling, it
+	 * must not block for long. Returns ERROR_NOT_IMPLEMENTED if the
+	 * target cannot sample its PC. Optional.
+	 */
+	int (*profiling_sample)(struct target *target, uint32_t *samples,
+			uint32_t max_num_samples, uint32_t *num_samples);
+
 	/* Return the number of address bits this target supports. This will
 	 * typically be 32 for 32-bit targets, and 64 for 64-bit targets. If not
 	 * implemented, it's assumed to be 32. */